@@ -1,5 +1,62 @@
 const std = @import("std");
 
+/// Options of addTemplates
+pub const TemplatesOptions = struct {
+    /// Directory of .pug/.zpug templates (in the calling package)
+    root_dir: std.Build.LazyPath,
+};
+
+/// Compile a directory of templates into a module embedded in the binary
+///
+/// Each template is parsed at build time and embedded in its precompiled
+/// form; rendering needs no file access and no parsing. Templates are
+/// named by their path relative to `root_dir`, without extension.
+///
+/// Usage (application build.zig):
+/// ```zig
+/// const zig_pug = b.dependency("zig_pug", .{ .target = target, .optimize = optimize });
+/// const templates = @import("zig_pug").addTemplates(b, zig_pug, .{ .root_dir = b.path("views") });
+/// exe.root_module.addImport("templates", templates);
+/// // in the application: try @import("templates").render(allocator, "home", data)
+/// ```
+pub fn addTemplates(b: *std.Build, zig_pug: *std.Build.Dependency, options: TemplatesOptions) *std.Build.Module {
+    // Runs on the build host; the parser needs neither libc nor mujs
+    const embed_exe = b.addExecutable(.{
+        .name = "zpug-embed",
+        .root_module = b.createModule(.{
+            .root_source_file = zig_pug.path("src/embed.zig"),
+            .target = b.graph.host,
+            .optimize = .ReleaseSafe,
+        }),
+    });
+
+    const run = b.addRunArtifact(embed_exe);
+    const out_dir = run.addOutputDirectoryArg("templates");
+    run.addDirectoryArg(options.root_dir);
+
+    // Rerun when any template changes
+    const root_path = options.root_dir.getPath2(b, &run.step);
+    if (std.fs.cwd().openDir(root_path, .{ .iterate = true })) |dir_const| {
+        var dir = dir_const;
+        defer dir.close();
+        var walker = dir.walk(b.allocator) catch @panic("OOM");
+        defer walker.deinit();
+        while (walker.next() catch null) |entry| {
+            if (entry.kind != .file) continue;
+            if (std.mem.endsWith(u8, entry.path, ".pug") or std.mem.endsWith(u8, entry.path, ".zpug")) {
+                run.addFileInput(options.root_dir.path(b, b.dupe(entry.path)));
+            }
+        }
+    } else |_| {}
+
+    return b.createModule(.{
+        .root_source_file = out_dir.path(b, "templates.zig"),
+        .imports = &.{
+            .{ .name = "zig_pug", .module = zig_pug.module("zig_pug") },
+        },
+    });
+}
+
 pub fn build(b: *std.Build) void {
     const target = b.standardTargetOptions(.{});
     // Force ReleaseFast because mujs requires optimization to work correctly
@@ -162,6 +219,34 @@ pub fn build(b: *std.Build) void {
     const run_step = b.step("run", "Run the CLI app");
     run_step.dependOn(&run_cmd.step);
 
+    // ========================================================================
+    // Benchmarks
+    // Usage: zig build bench -- --iterations 200 --json bench.json
+    // ========================================================================
+    const bench_exe = b.addExecutable(.{
+        .name = "zpug-bench",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("src/bench.zig"),
+            .target = exe_target,
+            .optimize = .ReleaseFast, // Always measure optimized code
+        }),
+    });
+
+    bench_exe.addIncludePath(b.path("vendor/mujs"));
+    bench_exe.addCSourceFile(.{
+        .file = b.path("vendor/mujs/one.c"),
+        .flags = &.{ "-std=c99", "-O2", "-DHAVE_STRLCPY=0" },
+    });
+    bench_exe.linkLibC();
+
+    const run_bench = b.addRunArtifact(bench_exe);
+    run_bench.setCwd(b.path(".")); // Corpus paths are relative to the repo root
+    if (b.args) |args| {
+        run_bench.addArgs(args);
+    }
+    const bench_step = b.step("bench", "Run render benchmarks (bench/corpus)");
+    bench_step.dependOn(&run_bench.step);
+
     // ========================================================================
     // Global Installation
     // Usage: sudo zig build -p /usr/local install
@@ -0,0 +1,71 @@
+// 06-ffi-benchmark.js - Ruta rápida con bun:ffi vs addon N-API
+// Ejecutar: bun run 06-ffi-benchmark.js
+//
+// Requiere libzigpug compilada: cd ../.. && zig build node
+
+const { PugCompiler } = require('../../nodejs');
+const { ZigPugFFI } = require('../../nodejs/bun');
+
+console.log('=== zig-pug: bun:ffi vs N-API ===\n');
+console.log('Bun version:', Bun.version);
+console.log('');
+
+// Template pequeño con varias variables: aquí domina el costo de la
+// frontera JS <-> nativo, que es lo que la ruta FFI reduce
+const template = `
+div.card
+  h2 #{title}
+  p.author Por #{author}
+  p.meta #{views} visitas
+  if published
+    span.badge Publicado
+`;
+
+const data = {
+    title: 'Bun + Zig',
+    author: 'Alice',
+    views: 1234,
+    published: true,
+};
+
+const iterations = 20000;
+const warmup = 1000;
+
+function bench(name, fn) {
+    for (let i = 0; i < warmup; i++) fn();
+
+    const start = Bun.nanoseconds();
+    for (let i = 0; i < iterations; i++) fn();
+    const elapsed = (Bun.nanoseconds() - start) / 1e6;
+
+    console.log(`${name}:`);
+    console.log(`  ${iterations} renders en ${elapsed.toFixed(2)}ms`);
+    console.log(`  ${(elapsed / iterations * 1000).toFixed(2)}µs por render`);
+    console.log(`  ~${Math.round(iterations / (elapsed / 1000))} renders/sec\n`);
+    return elapsed;
+}
+
+// N-API: una llamada por variable + string C asignado por render
+const napi = new PugCompiler();
+const napiTime = bench('N-API (PugCompiler.render)', () => napi.render(template, data));
+
+// FFI: variables empaquetadas en un solo buffer + salida decodificada
+const ffi = new ZigPugFFI();
+const ffiTime = bench('bun:ffi (ZigPugFFI.render)', () => ffi.render(template, data));
+
+// FFI sin decodificar: el HTML queda en un Uint8Array propio,
+// útil para escribirlo directo en una Response o un archivo
+const out = new Uint8Array(16 * 1024);
+const rawTime = bench('bun:ffi (compileInto, sin decodificar)', () => {
+    ffi.setVariables(data);
+    return ffi.compileInto(template, out);
+});
+
+// Verificar que ambas rutas generan el mismo HTML
+const same = napi.render(template, data) === ffi.render(template, data);
+console.log('Mismo HTML en ambas rutas:', same ? '✓' : '✗');
+
+console.log(`\nFFI vs N-API:          ${(napiTime / ffiTime).toFixed(2)}x`);
+console.log(`compileInto vs N-API:  ${(napiTime / rawTime).toFixed(2)}x`);
+
+ffi.close();
@@ -11,6 +11,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -22,6 +23,12 @@ extern "C" {
  */
 typedef struct ZigPugContext ZigPugContext;
 
+/**
+ * Opaque precompiled template handle
+ * A .zpugc file written by `zpug --precompile`, mapped into memory
+ */
+typedef struct ZigPugTemplate ZigPugTemplate;
+
 /**
  * Initialize a new zig-pug context
  *
@@ -36,6 +43,17 @@ typedef struct ZigPugContext ZigPugContext;
  */
 ZigPugContext* zigpug_init(void);
 
+/**
+ * Initialize a context that counts its allocations per phase
+ *
+ * Same as zigpug_init(), but every allocation made by the tokenizer, the
+ * parser, the compiler and the JavaScript heap is counted. Read the counters
+ * with zigpug_alloc_stats().
+ *
+ * @return Context handle, or NULL on error
+ */
+ZigPugContext* zigpug_init_with_alloc_stats(void);
+
 /**
  * Free a zig-pug context
  *
@@ -64,6 +82,115 @@ void zigpug_free(ZigPugContext* ctx);
  */
 char* zigpug_compile(ZigPugContext* ctx, const char* pug_source);
 
+/**
+ * Compile a Pug template into a caller-provided buffer
+ *
+ * Avoids the per-call string allocation of zigpug_compile(). Intended for
+ * FFI callers (e.g. bun:ffi) that keep a reusable output buffer.
+ *
+ * @param ctx Context handle
+ * @param pug_source Pug template bytes (need not be null-terminated)
+ * @param source_len Length of pug_source in bytes
+ * @param out Output buffer (may be NULL when out_cap is 0)
+ * @param out_cap Capacity of out in bytes
+ * @return Length of the generated HTML (not null-terminated), or -1 on error.
+ *         If the result is greater than out_cap nothing was written; get
+ *         the HTML with zigpug_copy_output() into a buffer of at least
+ *         that size (calling zigpug_compile_into again would render the
+ *         template twice).
+ *
+ * Example:
+ *   char buf[4096];
+ *   int64_t n = zigpug_compile_into(ctx, pug, strlen(pug), buf, sizeof(buf));
+ *   if (n >= 0 && n <= (int64_t)sizeof(buf)) {
+ *       fwrite(buf, 1, (size_t)n, stdout);
+ *   }
+ */
+int64_t zigpug_compile_into(ZigPugContext* ctx, const char* pug_source, size_t source_len,
+                            char* out, size_t out_cap);
+
+/**
+ * Copy the HTML of the last compile into a caller-provided buffer
+ *
+ * The retry for a zigpug_compile_into() call whose buffer was too small:
+ * the HTML is copied from the context instead of rendered again.
+ *
+ * @param ctx Context handle
+ * @param out Output buffer (may be NULL when out_cap is 0)
+ * @param out_cap Capacity of out in bytes
+ * @return Length of the HTML, or -1 if the last compile failed. If the
+ *         result is greater than out_cap nothing was written.
+ *
+ * Example:
+ *   int64_t n = zigpug_compile_into(ctx, pug, strlen(pug), buf, sizeof(buf));
+ *   if (n > (int64_t)sizeof(buf)) {
+ *       char* big = malloc((size_t)n);
+ *       zigpug_copy_output(ctx, big, (size_t)n);
+ *   }
+ */
+int64_t zigpug_copy_output(ZigPugContext* ctx, char* out, size_t out_cap);
+
+/**
+ * List the variables a template reads from its data
+ *
+ * Covers the template and the mixins it defines. Names bound by the
+ * template itself (loop variables, mixin parameters, variables its code
+ * declares) are not listed. Setting only these variables before
+ * zigpug_compile() renders the same HTML as setting the whole data object.
+ *
+ * Included and extended files are not followed, so for a template with
+ * include or extends the list would be incomplete: NULL is returned and
+ * the whole data object should be set.
+ *
+ * @param pug_source Null-terminated Pug template string
+ * @return Names separated by '\n' ("" if none; must be freed with
+ *         zigpug_free_string), or NULL if the template does not parse or
+ *         includes or extends another file
+ *
+ * Example:
+ *   char* names = zigpug_variables("p #{user.name} #{count}");
+ *   // names == "count\nuser"
+ *   zigpug_free_string(names);
+ */
+char* zigpug_variables(const char* pug_source);
+
+/**
+ * Load a precompiled template (.zpugc)
+ *
+ * The file is mapped into memory and rendered without tokenizing or
+ * parsing. Includes and extends are resolved relative to the .zpugc file.
+ * A template may be rendered by any number of contexts.
+ *
+ * @param path Path of a file written by `zpug --precompile` (null-terminated)
+ * @return Template handle (free with zigpug_template_free), or NULL if the
+ *         file is missing, damaged or from an incompatible zpug version
+ *
+ * Example:
+ *   ZigPugTemplate* page = zigpug_template_load("build/page.zpugc");
+ *   char* html = zigpug_template_render(ctx, page);
+ *   printf("%s\n", html);
+ *   zigpug_free_string(html);
+ *   zigpug_template_free(page);
+ */
+ZigPugTemplate* zigpug_template_load(const char* path);
+
+/**
+ * Render a precompiled template with the context's variables
+ *
+ * @param ctx Context handle
+ * @param tmpl Template handle from zigpug_template_load
+ * @return Null-terminated HTML string (must be freed with zigpug_free_string),
+ *         or NULL on error
+ */
+char* zigpug_template_render(ZigPugContext* ctx, ZigPugTemplate* tmpl);
+
+/**
+ * Free a precompiled template and unmap its file
+ *
+ * @param tmpl Template handle (can be NULL)
+ */
+void zigpug_template_free(ZigPugTemplate* tmpl);
+
 /**
  * Set a string variable in the context
  *
@@ -106,6 +233,70 @@ bool zigpug_set_int(ZigPugContext* ctx, const char* key, int64_t value);
  */
 bool zigpug_set_bool(ZigPugContext* ctx, const char* key, bool value);
 
+/**
+ * Set several variables at once from a packed binary buffer
+ *
+ * Layout (integers little-endian):
+ *   uint32 count
+ *   count x { uint8 tag, uint32 key_len, key bytes, value }
+ *
+ * Values by tag:
+ *   1 = string: uint32 len, UTF-8 bytes
+ *   2 = number: float64
+ *   3 = bool:   uint8 (0 or 1)
+ *   4 = JSON:   uint32 len, JSON text (arrays and objects)
+ *
+ * @param ctx Context handle
+ * @param data Packed buffer
+ * @param len Length of data in bytes
+ * @return true on success, false on malformed data or error
+ */
+bool zigpug_set_packed(ZigPugContext* ctx, const uint8_t* data, size_t len);
+
+/**
+ * Allocation counters of one phase
+ */
+typedef struct ZigPugAllocCounters {
+    uint64_t allocations; /* Successful allocations */
+    uint64_t frees;       /* Frees */
+    uint64_t bytes;       /* Total bytes allocated */
+    uint64_t live;        /* Bytes currently allocated */
+    uint64_t peak;        /* Highest live bytes */
+} ZigPugAllocCounters;
+
+/** Phases accepted by zigpug_alloc_stats() */
+#define ZIGPUG_PHASE_TOKENIZE 0
+#define ZIGPUG_PHASE_PARSE    1
+#define ZIGPUG_PHASE_COMPILE  2
+#define ZIGPUG_PHASE_JS_HEAP  3
+
+/**
+ * Read the allocation counters of a phase
+ *
+ * @param ctx Context created with zigpug_init_with_alloc_stats()
+ * @param phase One of the ZIGPUG_PHASE_* values
+ * @param out Receives the counters
+ * @return true on success, false if the context has no statistics or the
+ *         phase is invalid
+ *
+ * Example:
+ *   ZigPugAllocCounters c;
+ *   zigpug_alloc_stats_reset(ctx);
+ *   char* html = zigpug_compile(ctx, pug);
+ *   if (zigpug_alloc_stats(ctx, ZIGPUG_PHASE_COMPILE, &c)) {
+ *       printf("%llu allocations, peak %llu bytes\n",
+ *              (unsigned long long)c.allocations, (unsigned long long)c.peak);
+ *   }
+ */
+bool zigpug_alloc_stats(ZigPugContext* ctx, int phase, ZigPugAllocCounters* out);
+
+/**
+ * Zero the allocation counters (live bytes become the new peak)
+ *
+ * @param ctx Context handle
+ */
+void zigpug_alloc_stats_reset(ZigPugContext* ctx);
+
 /**
  * Free a string returned by zig-pug
  *
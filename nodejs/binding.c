@@ -14,6 +14,7 @@ typedef struct ZigPugContext ZigPugContext;
 extern ZigPugContext* zigpug_init(void);
 extern void zigpug_free(ZigPugContext* ctx);
 extern char* zigpug_compile(ZigPugContext* ctx, const char* pug_source);
+extern char* zigpug_variables(const char* pug_source);
 extern int zigpug_set_string(ZigPugContext* ctx, const char* key, const char* value);
 extern int zigpug_set_int(ZigPugContext* ctx, const char* key, long long value);
 extern int zigpug_set_bool(ZigPugContext* ctx, const char* key, int value);
@@ -310,6 +311,69 @@ static napi_value Compile(napi_env env, napi_callback_info info) {
     return result;
 }
 
+// List the variables a template reads from its data
+// JavaScript: const names = zigpug.variables(template)  // null if it does not parse
+static napi_value Variables(napi_env env, napi_callback_info info) {
+    napi_status status;
+    size_t argc = 1;
+    napi_value args[1];
+
+    status = napi_get_cb_info(env, info, &argc, args, NULL, NULL);
+    if (status != napi_ok || argc < 1) {
+        napi_throw_error(env, NULL, "Expected 1 argument: template");
+        return NULL;
+    }
+
+    // Get template string
+    size_t template_len;
+    status = napi_get_value_string_utf8(env, args[0], NULL, 0, &template_len);
+    if (status != napi_ok) {
+        napi_throw_error(env, NULL, "Invalid template");
+        return NULL;
+    }
+
+    char* template = malloc(template_len + 1);
+    status = napi_get_value_string_utf8(env, args[0], template, template_len + 1, &template_len);
+    if (status != napi_ok) {
+        free(template);
+        napi_throw_error(env, NULL, "Failed to get template string");
+        return NULL;
+    }
+
+    char* names = zigpug_variables(template);
+    free(template);
+
+    napi_value result;
+    if (!names) {
+        napi_get_null(env, &result);
+        return result;
+    }
+
+    // Names are separated by '\n'
+    status = napi_create_array(env, &result);
+    uint32_t count = 0;
+    char* start = names;
+    while (status == napi_ok && *start) {
+        char* end = strchr(start, '\n');
+        size_t len = end ? (size_t)(end - start) : strlen(start);
+
+        napi_value name;
+        status = napi_create_string_utf8(env, start, len, &name);
+        if (status == napi_ok) status = napi_set_element(env, result, count++, name);
+
+        if (!end) break;
+        start = end + 1;
+    }
+    zigpug_free_string(names);
+
+    if (status != napi_ok) {
+        napi_throw_error(env, NULL, "Failed to create variable list");
+        return NULL;
+    }
+
+    return result;
+}
+
 // Get zig-pug version
 // JavaScript: const version = zigpug.version()
 static napi_value Version(napi_env env, napi_callback_info info) {
@@ -363,6 +427,12 @@ static napi_value Init(napi_env env, napi_value exports) {
     status = napi_set_named_property(env, exports, "compile", fn);
     if (status != napi_ok) return NULL;
 
+    // variables
+    status = napi_create_function(env, NULL, 0, Variables, NULL, &fn);
+    if (status != napi_ok) return NULL;
+    status = napi_set_named_property(env, exports, "variables", fn);
+    if (status != napi_ok) return NULL;
+
     // version
     status = napi_create_function(env, NULL, 0, Version, NULL, &fn);
     if (status != napi_ok) return NULL;
@@ -0,0 +1,365 @@
+/**
+ * zig-pug - Bun FFI bindings
+ *
+ * Calls the zigpug_* C API in libzigpug directly through bun:ffi instead of
+ * going through the N-API addon:
+ *
+ * - All variables are sent in one call as a packed binary buffer
+ *   (see zigpug_set_packed in include/zigpug.h)
+ * - HTML is written into a caller-provided Uint8Array
+ *   (see zigpug_compile_into), so no C string is allocated per render
+ * - render() packs only the variables the template reads
+ *   (see zigpug_variables)
+ *
+ * Usage (Bun only):
+ *   const { ZigPugFFI } = require('zig-pug/bun');
+ *   const pug = new ZigPugFFI();
+ *   const html = pug.render('p Hello #{name}', { name: 'Bun' });
+ */
+
+const { dlopen, FFIType, suffix, CString } = require('bun:ffi');
+const path = require('path');
+const fs = require('fs');
+
+// Value tags understood by zigpug_set_packed
+const TAG_STRING = 1;
+const TAG_NUMBER = 2;
+const TAG_BOOL = 3;
+const TAG_JSON = 4;
+
+// Maximum number of encoded template sources kept per instance
+const TEMPLATE_CACHE_SIZE = 256;
+
+const encoder = new TextEncoder();
+const decoder = new TextDecoder();
+
+/**
+ * Locate libzigpug: ZIGPUG_LIB, then the addon build dir, then zig-out
+ * @returns {string} - Path to the shared library
+ */
+function findLibrary() {
+    const name = `libzigpug.${suffix}`;
+    const candidates = [
+        process.env.ZIGPUG_LIB,
+        path.join(__dirname, 'build', 'Release', name),
+        path.join(__dirname, '..', 'zig-out', 'nodejs', name),
+        path.join(__dirname, '..', 'zig-out', 'lib', name),
+    ].filter(Boolean);
+
+    for (const candidate of candidates) {
+        if (fs.existsSync(candidate)) {
+            return candidate;
+        }
+    }
+
+    throw new Error(
+        'libzigpug not found. ' +
+        'Please build it with: cd .. && zig build node (or set ZIGPUG_LIB)'
+    );
+}
+
+let lib = null;
+
+function load() {
+    if (lib) return lib;
+
+    lib = dlopen(findLibrary(), {
+        zigpug_init: { args: [], returns: FFIType.ptr },
+        zigpug_free: { args: [FFIType.ptr], returns: FFIType.void },
+        zigpug_set_packed: {
+            args: [FFIType.ptr, FFIType.ptr, FFIType.u64],
+            returns: FFIType.bool,
+        },
+        zigpug_compile_into: {
+            args: [FFIType.ptr, FFIType.ptr, FFIType.u64, FFIType.ptr, FFIType.u64],
+            returns: FFIType.i64_fast,
+        },
+        zigpug_copy_output: {
+            args: [FFIType.ptr, FFIType.ptr, FFIType.u64],
+            returns: FFIType.i64_fast,
+        },
+        zigpug_variables: { args: [FFIType.ptr], returns: FFIType.ptr },
+        zigpug_free_string: { args: [FFIType.ptr], returns: FFIType.void },
+        zigpug_version: { args: [], returns: FFIType.cstring },
+    }).symbols;
+
+    return lib;
+}
+
+/**
+ * Growable little-endian byte buffer in the zigpug_set_packed layout
+ */
+class Packer {
+    constructor(size = 4096) {
+        this.bytes = new Uint8Array(size);
+        this.view = new DataView(this.bytes.buffer);
+        this.pos = 0;
+    }
+
+    ensure(n) {
+        if (this.pos + n <= this.bytes.length) return;
+
+        let size = this.bytes.length * 2;
+        while (size < this.pos + n) size *= 2;
+
+        const bytes = new Uint8Array(size);
+        bytes.set(this.bytes.subarray(0, this.pos));
+        this.bytes = bytes;
+        this.view = new DataView(bytes.buffer);
+    }
+
+    u8(value) {
+        this.ensure(1);
+        this.view.setUint8(this.pos, value);
+        this.pos += 1;
+    }
+
+    f64(value) {
+        this.ensure(8);
+        this.view.setFloat64(this.pos, value, true);
+        this.pos += 8;
+    }
+
+    str(value) {
+        // UTF-8 needs at most 3 bytes per UTF-16 code unit
+        this.ensure(4 + value.length * 3);
+        const { written } = encoder.encodeInto(value, this.bytes.subarray(this.pos + 4));
+        this.view.setUint32(this.pos, written, true);
+        this.pos += 4 + written;
+    }
+
+    /**
+     * Pack an object of variables
+     * @param {Object} variables - Object with key-value pairs
+     * @param {string[]} [keys] - Only pack these keys (default: all)
+     * @returns {Uint8Array} - View over the packed bytes (valid until next pack)
+     */
+    pack(variables, keys) {
+        this.pos = 4;
+        let count = 0;
+
+        for (const key of keys || Object.keys(variables)) {
+            if (!Object.prototype.hasOwnProperty.call(variables, key)) continue;
+            const value = variables[key];
+            switch (typeof value) {
+                case 'string':
+                    this.u8(TAG_STRING);
+                    this.str(key);
+                    this.str(value);
+                    break;
+                case 'number':
+                    this.u8(TAG_NUMBER);
+                    this.str(key);
+                    this.f64(value);
+                    break;
+                case 'boolean':
+                    this.u8(TAG_BOOL);
+                    this.str(key);
+                    this.u8(value ? 1 : 0);
+                    break;
+                case 'object':
+                    this.u8(TAG_JSON);
+                    this.str(key);
+                    this.str(JSON.stringify(value));
+                    break;
+                default:
+                    // undefined and functions have no template representation
+                    continue;
+            }
+            count++;
+        }
+
+        this.view.setUint32(0, count, true);
+        return this.bytes.subarray(0, this.pos);
+    }
+}
+
+/**
+ * ZigPugFFI class - same role as ZigPugCompiler, without N-API
+ */
+class ZigPugFFI {
+    constructor(options = {}) {
+        this.symbols = load();
+        this.context = this.symbols.zigpug_init();
+        if (!this.context) {
+            throw new Error('Failed to create zig-pug context');
+        }
+
+        this.packer = new Packer();
+        this.output = new Uint8Array(options.outputSize || 64 * 1024);
+        this.templates = new Map();
+        this.templateVariables = new Map();
+    }
+
+    /**
+     * Set multiple variables in one FFI call
+     * @param {Object} variables - Object with key-value pairs
+     * @returns {ZigPugFFI} - Returns this for chaining
+     */
+    setVariables(variables) {
+        if (typeof variables !== 'object' || variables === null) {
+            throw new TypeError('Variables must be an object');
+        }
+
+        const data = this.packer.pack(variables);
+        if (!this.symbols.zigpug_set_packed(this.context, data, data.length)) {
+            throw new Error('Failed to set variables');
+        }
+        return this;
+    }
+
+    /**
+     * List the variables a template reads from its data (cached per template)
+     * @param {string} template - Pug template string
+     * @returns {string[]|null} - Variable names, or null if the template does not
+     *   parse or uses include/extends (the files it loads are not scanned)
+     */
+    variables(template) {
+        let names = this.templateVariables.get(template);
+        if (names !== undefined) return names;
+
+        if (this.templateVariables.size >= TEMPLATE_CACHE_SIZE) {
+            this.templateVariables.delete(this.templateVariables.keys().next().value);
+        }
+
+        const ptr = this.symbols.zigpug_variables(encoder.encode(template + '\0'));
+        if (ptr) {
+            const list = new CString(ptr).toString();
+            this.symbols.zigpug_free_string(ptr);
+            names = list ? list.split('\n') : [];
+        } else {
+            names = null;
+        }
+        this.templateVariables.set(template, names);
+        return names;
+    }
+
+    /**
+     * UTF-8 bytes of a template, cached so hot templates are encoded once
+     * @param {string} template - Pug template string
+     * @returns {Uint8Array}
+     */
+    encodeTemplate(template) {
+        let bytes = this.templates.get(template);
+        if (bytes) return bytes;
+
+        if (this.templates.size >= TEMPLATE_CACHE_SIZE) {
+            this.templates.delete(this.templates.keys().next().value);
+        }
+        // bun:ffi rejects zero-length buffers as pointers
+        bytes = encoder.encode(template.length ? template : ' ');
+        this.templates.set(template, bytes);
+        return bytes;
+    }
+
+    /**
+     * Compile a template into a caller-provided buffer
+     * @param {string} template - Pug template string
+     * @param {Uint8Array} out - Destination buffer
+     * @returns {number} - HTML length in bytes; if greater than out.length
+     *                     nothing was written: pass a larger buffer to
+     *                     copyOutput() (not to compileInto() again, which
+     *                     would render the template twice)
+     */
+    compileInto(template, out) {
+        if (typeof template !== 'string') {
+            throw new TypeError('Template must be a string');
+        }
+
+        const source = this.encodeTemplate(template);
+        const len = this.symbols.zigpug_compile_into(
+            this.context, source, source.length, out, out.length
+        );
+        if (len < 0) {
+            throw new Error('Failed to compile template');
+        }
+        return len;
+    }
+
+    /**
+     * Copy the HTML of the last compile into a caller-provided buffer
+     * @param {Uint8Array} out - Destination buffer
+     * @returns {number} - HTML length in bytes; if greater than out.length
+     *                     nothing was written
+     */
+    copyOutput(out) {
+        const len = this.symbols.zigpug_copy_output(this.context, out, out.length);
+        if (len < 0) {
+            throw new Error('No compiled output to copy');
+        }
+        return len;
+    }
+
+    /**
+     * Compile a Pug template to HTML using the internal output buffer
+     * @param {string} template - Pug template string
+     * @returns {string} - Compiled HTML
+     */
+    compile(template) {
+        let len = this.compileInto(template, this.output);
+        if (len > this.output.length) {
+            // Already rendered: copy it rather than render again
+            this.output = new Uint8Array(len * 2);
+            len = this.copyOutput(this.output);
+        }
+        return decoder.decode(this.output.subarray(0, len));
+    }
+
+    /**
+     * Compile a template with variables in one call
+     * @param {string} template - Pug template string
+     * @param {Object} variables - Variables to set before compiling
+     * @returns {string} - Compiled HTML
+     */
+    render(template, variables = {}) {
+        if (typeof variables !== 'object' || variables === null) {
+            throw new TypeError('Variables must be an object');
+        }
+
+        // Only what the template reads crosses the FFI boundary (everything
+        // when it includes or extends files, which may read any of it)
+        const data = this.packer.pack(variables, this.variables(template) || undefined);
+        if (!this.symbols.zigpug_set_packed(this.context, data, data.length)) {
+            throw new Error('Failed to set variables');
+        }
+        return this.compile(template);
+    }
+
+    /**
+     * Release the native context; the instance cannot be used afterwards
+     */
+    close() {
+        if (this.context) {
+            this.symbols.zigpug_free(this.context);
+            this.context = null;
+        }
+    }
+}
+
+let shared = null;
+
+/**
+ * Convenience function to compile a template with variables
+ * Reuses one shared context, so variables from earlier calls stay defined.
+ * @param {string} template - Pug template string
+ * @param {Object} variables - Variables for the template
+ * @returns {string} - Compiled HTML
+ */
+function compile(template, variables = {}) {
+    if (!shared) shared = new ZigPugFFI();
+    return shared.render(template, variables);
+}
+
+/**
+ * Get the zig-pug version
+ * @returns {string} - Version string
+ */
+function version() {
+    return load().zigpug_version().toString();
+}
+
+module.exports = {
+    ZigPugFFI,
+    compile,
+    version,
+};
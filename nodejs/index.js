@@ -25,6 +25,9 @@ try {
     }
 }
 
+// Maximum number of templates whose variable lists are kept per instance
+const VARIABLES_CACHE_SIZE = 256;
+
 /**
  * ZigPugCompiler class - High-level API for compiling Pug templates
  */
@@ -34,6 +37,7 @@ class ZigPugCompiler {
         if (!this.context) {
             throw new Error('Failed to create zig-pug context');
         }
+        this.templateVariables = new Map();
     }
 
     /**
@@ -152,14 +156,55 @@ class ZigPugCompiler {
         return html;
     }
 
+    /**
+     * List the variables a template reads from its data (cached per template)
+     * @param {string} template - Pug template string
+     * @returns {string[]|null} - Variable names, or null if the template does not
+     *   parse or uses include/extends (the files it loads are not scanned)
+     */
+    variables(template) {
+        if (typeof template !== 'string') {
+            throw new TypeError('Template must be a string');
+        }
+
+        let names = this.templateVariables.get(template);
+        if (names !== undefined) return names;
+
+        if (this.templateVariables.size >= VARIABLES_CACHE_SIZE) {
+            this.templateVariables.delete(this.templateVariables.keys().next().value);
+        }
+        names = binding.variables(template);
+        this.templateVariables.set(template, names);
+        return names;
+    }
+
     /**
      * Compile a template with variables in one call
+     *
+     * Only the variables the template reads are passed to the native
+     * context, so a partial reading two fields of a large request context
+     * does not pay for marshalling the rest. Templates with include or
+     * extends get every variable, since their layouts and partials may
+     * read any of them.
      * @param {string} template - Pug template string
      * @param {Object} variables - Variables to set before compiling
      * @returns {string} - Compiled HTML
      */
     render(template, variables = {}) {
-        this.setVariables(variables);
+        if (typeof variables !== 'object' || variables === null) {
+            throw new TypeError('Variables must be an object');
+        }
+
+        const names = this.variables(template);
+        if (names === null) {
+            this.setVariables(variables); // Includes files, or does not parse
+        } else {
+            for (const name of names) {
+                if (Object.prototype.hasOwnProperty.call(variables, name)) {
+                    this.set(name, variables[name]);
+                }
+            }
+        }
         return this.compile(template);
     }
 }
@@ -148,4 +148,36 @@ try {
     process.exit(1);
 }
 
+// Test 8: Variables read only by an included partial
+console.log('📋 Test 8: Variables read by an included partial');
+{
+    const fs = require('fs');
+    const os = require('os');
+    const path = require('path');
+    const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'zig-pug-test-'));
+    try {
+        const partial = path.join(dir, 'greeting.pug');
+        fs.writeFileSync(partial, 'p Hello #{name}\n');
+
+        // The same compiler renders twice, so a variable left unset would
+        // show the first render's value in the second
+        const compiler = new pug.ZigPugCompiler();
+        const template = `div\n  include ${partial}`;
+        const first = compiler.render(template, { name: 'Alice' });
+        const second = compiler.render(template, { name: 'Bob' });
+        console.log(`   Output: ${first} ${second}`);
+        if (first === '<div><p>Hello Alice</p></div>' && second === '<div><p>Hello Bob</p></div>') {
+            console.log('   ✅ Pass\n');
+        } else {
+            console.log('   ❌ Unexpected output\n');
+            process.exit(1);
+        }
+    } catch (error) {
+        console.error(`   ❌ Error: ${error.message}\n`);
+        process.exit(1);
+    } finally {
+        fs.rmSync(dir, { recursive: true, force: true });
+    }
+}
+
 console.log('✨ All tests passed! zig-pug is working correctly.\n');
@@ -0,0 +1,189 @@
+//! Allocation statistics module - Counting allocators for `zpug --alloc-stats`
+//!
+//! Wraps a backing allocator once per render phase so the allocations made
+//! by the tokenizer, the parser, the compiler and the mujs heap can be
+//! counted separately:
+//!
+//! - tokenize: Tokenizer indentation stack and token queues
+//! - parse: AST arena
+//! - compile: Compiler buffers, eval copies and the rendered HTML
+//! - js_heap: Everything mujs allocates (objects, strings, bytecode)
+//!
+//! Each phase records the number of allocations and frees, the total bytes
+//! allocated (including growth by resize) and the peak of live bytes. The
+//! counters are plain integers: use one AllocStats per thread.
+//!
+//! Example:
+//! ```zig
+//! var stats = AllocStats.init(allocator);
+//!
+//! var parser = try Parser.initWithTokenizerAllocator(
+//!     stats.allocator(.parse),
+//!     stats.allocator(.tokenize),
+//!     source,
+//! );
+//! defer parser.deinit();
+//!
+//! try stats.writeReport(writer);
+//! ```
+
+const std = @import("std");
+
+/// Render phase an allocation is attributed to
+pub const Phase = enum {
+    tokenize,
+    parse,
+    compile,
+    js_heap,
+};
+
+/// Allocation counters of one phase
+pub const Counters = struct {
+    allocations: u64 = 0, // Successful alloc calls
+    frees: u64 = 0, // Free calls
+    bytes: u64 = 0, // Total bytes allocated, including growth by resize
+    live: u64 = 0, // Bytes currently allocated
+    peak: u64 = 0, // Highest value of live
+
+    fn grow(self: *Counters, len: usize) void {
+        self.bytes += len;
+        self.live += len;
+        self.peak = @max(self.peak, self.live);
+    }
+
+    fn shrink(self: *Counters, len: usize) void {
+        self.live -|= len;
+    }
+};
+
+/// Allocator wrapper that counts what passes through it
+pub const CountingAllocator = struct {
+    child: std.mem.Allocator,
+    counters: Counters = .{},
+
+    const Self = @This();
+
+    const vtable = std.mem.Allocator.VTable{
+        .alloc = alloc,
+        .resize = resize,
+        .remap = remap,
+        .free = free,
+    };
+
+    pub fn allocator(self: *Self) std.mem.Allocator {
+        return .{ .ptr = self, .vtable = &vtable };
+    }
+
+    fn alloc(ctx: *anyopaque, len: usize, alignment: std.mem.Alignment, ret_addr: usize) ?[*]u8 {
+        const self: *Self = @ptrCast(@alignCast(ctx));
+        const ptr = self.child.rawAlloc(len, alignment, ret_addr) orelse return null;
+        self.counters.allocations += 1;
+        self.counters.grow(len);
+        return ptr;
+    }
+
+    fn resize(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) bool {
+        const self: *Self = @ptrCast(@alignCast(ctx));
+        if (!self.child.rawResize(memory, alignment, new_len, ret_addr)) return false;
+        self.resized(memory.len, new_len);
+        return true;
+    }
+
+    fn remap(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) ?[*]u8 {
+        const self: *Self = @ptrCast(@alignCast(ctx));
+        const ptr = self.child.rawRemap(memory, alignment, new_len, ret_addr) orelse return null;
+        self.resized(memory.len, new_len);
+        return ptr;
+    }
+
+    fn free(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, ret_addr: usize) void {
+        const self: *Self = @ptrCast(@alignCast(ctx));
+        self.child.rawFree(memory, alignment, ret_addr);
+        self.counters.frees += 1;
+        self.counters.shrink(memory.len);
+    }
+
+    fn resized(self: *Self, old_len: usize, new_len: usize) void {
+        if (new_len > old_len) {
+            self.counters.grow(new_len - old_len);
+        } else {
+            self.counters.shrink(old_len - new_len);
+        }
+    }
+};
+
+/// One counting allocator per render phase
+///
+/// Must not be moved after allocator() has been called.
+pub const AllocStats = struct {
+    phases: [phase_count]CountingAllocator,
+
+    const Self = @This();
+    const phase_count = @typeInfo(Phase).@"enum".fields.len;
+
+    pub fn init(child: std.mem.Allocator) Self {
+        return .{ .phases = [_]CountingAllocator{.{ .child = child }} ** phase_count };
+    }
+
+    /// Allocator whose allocations are counted under `phase`
+    pub fn allocator(self: *Self, phase: Phase) std.mem.Allocator {
+        return self.phases[@intFromEnum(phase)].allocator();
+    }
+
+    /// Counters of a phase
+    pub fn get(self: *const Self, phase: Phase) Counters {
+        return self.phases[@intFromEnum(phase)].counters;
+    }
+
+    /// Zero allocation counts and bytes, keeping live bytes as the new peak
+    ///
+    /// Used to measure one render at a time while memory from earlier
+    /// renders (cached templates, JS globals) is still allocated.
+    pub fn reset(self: *Self) void {
+        for (&self.phases) |*phase| {
+            phase.counters = .{ .live = phase.counters.live, .peak = phase.counters.live };
+        }
+    }
+
+    /// Write a table with one row per phase
+    pub fn writeReport(self: *const Self, w: anytype) !void {
+        try w.print("Allocations:\n", .{});
+        try w.print("  {s:<10} {s:>10} {s:>10} {s:>14} {s:>12} {s:>12}\n", .{ "phase", "allocs", "frees", "bytes", "peak", "live" });
+
+        var total = Counters{};
+        for (std.enums.values(Phase)) |phase| {
+            const c = self.get(phase);
+            try w.print("  {s:<10} {d:>10} {d:>10} {d:>14} {d:>12} {d:>12}\n", .{ @tagName(phase), c.allocations, c.frees, c.bytes, c.peak, c.live });
+            total.allocations += c.allocations;
+            total.frees += c.frees;
+            total.bytes += c.bytes;
+            total.peak += c.peak;
+            total.live += c.live;
+        }
+        try w.print("  {s:<10} {d:>10} {d:>10} {d:>14} {d:>12} {d:>12}\n", .{ "total", total.allocations, total.frees, total.bytes, total.peak, total.live });
+    }
+};
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+test "alloc stats - counts per phase" {
+    var stats = AllocStats.init(std.testing.allocator);
+
+    const parse_alloc = stats.allocator(.parse);
+    const a = try parse_alloc.alloc(u8, 100);
+    var b = try parse_alloc.alloc(u8, 50);
+    parse_alloc.free(a);
+    b = try parse_alloc.realloc(b, 80);
+    parse_alloc.free(b);
+
+    const parse = stats.get(.parse);
+    // realloc may grow in place or move (one more alloc and free)
+    try std.testing.expect(parse.allocations >= 2);
+    try std.testing.expectEqual(parse.allocations, parse.frees);
+    try std.testing.expect(parse.bytes >= 180);
+    try std.testing.expectEqual(@as(u64, 0), parse.live);
+    try std.testing.expectEqual(@as(u64, 150), parse.peak);
+    try std.testing.expectEqual(@as(u64, 0), stats.get(.compile).allocations);
+}
@@ -0,0 +1,1010 @@
+//! Analysis - Variables read and written by template expressions
+//!
+//! Template expressions are JavaScript run by mujs. This module scans them
+//! without a full JavaScript parser, to find the names an expression reads,
+//! assigns or declares, and whether it may have side effects. Results err
+//! on the safe side: a name can be reported as read when it is not (an
+//! object literal key, say), and anything that looks like a call counts as
+//! a call.
+//!
+//! Used for:
+//! - dependencies: the variables a template reads from its data
+//!   (`zpug --deps`, and binding only those from Node.js)
+//! - loopInvariants: expressions the Compiler evaluates once per loop
+//!   instead of once per iteration
+//! - isPureMixin: mixins whose output the Compiler reuses for calls with
+//!   equal arguments
+//!
+//! Example:
+//! ```zig
+//! var names = analysis.Names.init("total += item.price * rate");
+//! while (names.next()) |name| {
+//!     // "total" (.assigned), "item" (.read), "rate" (.read)
+//! }
+//! ```
+
+const std = @import("std");
+const ast = @import("ast.zig");
+
+// ============================================================================
+// Tokens
+// ============================================================================
+
+const Token = struct {
+    kind: Kind,
+    text: []const u8,
+
+    const Kind = enum { identifier, keyword, literal, punct };
+
+    fn is(self: Token, punct: []const u8) bool {
+        return self.kind == .punct and std.mem.eql(u8, self.text, punct);
+    }
+};
+
+/// Words that are never variable names
+const keywords = std.StaticStringMap(void).initComptime(.{
+    .{"break"},    .{"case"},      .{"catch"},     .{"class"},     .{"const"},
+    .{"continue"}, .{"debugger"},  .{"default"},   .{"delete"},    .{"do"},
+    .{"else"},     .{"export"},    .{"extends"},   .{"finally"},   .{"for"},
+    .{"function"}, .{"if"},        .{"import"},    .{"in"},        .{"instanceof"},
+    .{"let"},      .{"new"},       .{"of"},        .{"return"},    .{"super"},
+    .{"switch"},   .{"this"},      .{"throw"},     .{"try"},       .{"typeof"},
+    .{"var"},      .{"void"},      .{"while"},     .{"with"},      .{"yield"},
+    .{"await"},    .{"true"},      .{"false"},     .{"null"},      .{"undefined"},
+    .{"NaN"},      .{"Infinity"},  .{"arguments"},
+});
+
+const assignment_ops = std.StaticStringMap(void).initComptime(.{
+    .{"="},   .{"+="},  .{"-="},  .{"*="},   .{"/="},   .{"%="},   .{"**="},
+    .{"&="},  .{"|="},  .{"^="},  .{"<<="},  .{">>="},  .{">>>="}, .{"&&="},
+    .{"||="}, .{"??="},
+});
+
+/// Longest first, so `===` is not read as `==` `=`
+const puncts = [_][]const u8{
+    ">>>=", "===", "!==", "**=", "<<=", ">>=", ">>>", "&&=", "||=", "??=", "...",
+    "=>",   "==",  "!=",  "<=",  ">=",  "&&",  "||",  "??",  "?.",  "++",  "--",
+    "+=",   "-=",  "*=",  "/=",  "%=",  "&=",  "|=",  "^=",  "**",  "<<",  ">>",
+};
+
+/// Splits JavaScript into tokens, skipping string contents but not the
+/// `${...}` parts of template literals
+const Lexer = struct {
+    source: []const u8,
+    pos: usize = 0,
+    depth: u32 = 0, // Open braces
+    templates: [8]u32 = undefined, // Brace depth at each open `${`
+    template_count: usize = 0,
+
+    fn next(self: *Lexer) ?Token {
+        while (self.pos < self.source.len and std.ascii.isWhitespace(self.source[self.pos])) self.pos += 1;
+        if (self.pos >= self.source.len) return null;
+
+        const start = self.pos;
+        const c = self.source[start];
+
+        // Template literal text, from its start or from the end of a `${}`
+        const closes_template = c == '}' and self.template_count > 0 and
+            self.depth == self.templates[self.template_count - 1];
+        if (c == '`' or closes_template) {
+            if (closes_template) self.template_count -= 1;
+            self.pos += 1;
+            while (self.pos < self.source.len) {
+                const t = self.source[self.pos];
+                if (t == '\\') {
+                    self.pos += 2;
+                } else if (t == '`') {
+                    self.pos += 1;
+                    break;
+                } else if (t == '$' and self.pos + 1 < self.source.len and self.source[self.pos + 1] == '{') {
+                    self.pos += 2;
+                    if (self.template_count < self.templates.len) {
+                        self.templates[self.template_count] = self.depth;
+                        self.template_count += 1;
+                    }
+                    break;
+                } else {
+                    self.pos += 1;
+                }
+            }
+            self.pos = @min(self.pos, self.source.len);
+            return .{ .kind = .literal, .text = self.source[start..self.pos] };
+        }
+
+        if (c == '\'' or c == '"') {
+            self.pos += 1;
+            while (self.pos < self.source.len and self.source[self.pos] != c) {
+                self.pos += if (self.source[self.pos] == '\\') 2 else 1;
+            }
+            self.pos = @min(self.pos + 1, self.source.len);
+            return .{ .kind = .literal, .text = self.source[start..self.pos] };
+        }
+
+        if (isIdentifierStart(c) or std.ascii.isDigit(c)) {
+            while (self.pos < self.source.len and (isIdentifierPart(self.source[self.pos]) or
+                (std.ascii.isDigit(c) and self.source[self.pos] == '.'))) self.pos += 1;
+            const text = self.source[start..self.pos];
+            const kind: Token.Kind = if (std.ascii.isDigit(c)) .literal else if (keywords.has(text)) .keyword else .identifier;
+            return .{ .kind = kind, .text = text };
+        }
+
+        for (puncts) |p| {
+            if (std.mem.startsWith(u8, self.source[start..], p)) {
+                self.pos += p.len;
+                return .{ .kind = .punct, .text = p };
+            }
+        }
+
+        if (c == '{') self.depth += 1;
+        if (c == '}' and self.depth > 0) self.depth -= 1;
+        self.pos += 1;
+        return .{ .kind = .punct, .text = self.source[start..self.pos] };
+    }
+};
+
+fn isIdentifierStart(c: u8) bool {
+    return std.ascii.isAlphabetic(c) or c == '_' or c == '$' or c >= 0x80;
+}
+
+fn isIdentifierPart(c: u8) bool {
+    return isIdentifierStart(c) or std.ascii.isDigit(c);
+}
+
+// ============================================================================
+// Names
+// ============================================================================
+
+/// How an expression uses a name
+pub const Use = enum {
+    read,
+    assigned, // `x = ...`, `x += ...`, `x++`
+    declared, // `var x`, `let x`, `const x`
+};
+
+pub const Name = struct {
+    text: []const u8,
+    use: Use,
+};
+
+/// Iterator over the variables an expression uses
+///
+/// Property names (`b` in `a.b`) are not variables and are skipped. A name
+/// is reported once per occurrence.
+pub const Names = struct {
+    lexer: Lexer,
+    previous: ?Token = null,
+    declaring: bool = false, // After var/let/const
+
+    pub fn init(expression: []const u8) Names {
+        return .{ .lexer = .{ .source = expression } };
+    }
+
+    pub fn next(self: *Names) ?Name {
+        while (self.lexer.next()) |token| {
+            const previous = self.previous;
+            self.previous = token;
+
+            switch (token.kind) {
+                .keyword => {
+                    self.declaring = std.mem.eql(u8, token.text, "var") or
+                        std.mem.eql(u8, token.text, "let") or
+                        std.mem.eql(u8, token.text, "const");
+                    continue;
+                },
+                .identifier => {},
+                else => {
+                    self.declaring = false;
+                    continue;
+                },
+            }
+
+            if (previous) |p| {
+                if (p.is(".") or p.is("?.")) continue; // Property
+            }
+
+            const use: Use = if (self.declaring)
+                .declared
+            else if (previous != null and (previous.?.is("++") or previous.?.is("--")))
+                .assigned
+            else if (self.peek()) |after|
+                (if (after.kind == .punct and (assignment_ops.has(after.text) or after.is("++") or after.is("--"))) .assigned else .read)
+            else
+                .read;
+            self.declaring = false;
+            return .{ .text = token.text, .use = use };
+        }
+        return null;
+    }
+
+    fn peek(self: *const Names) ?Token {
+        var lexer = self.lexer;
+        return lexer.next();
+    }
+};
+
+/// Whether an expression uses a name (in any way)
+pub fn uses(expression: []const u8, name: []const u8) bool {
+    var names = Names.init(expression);
+    while (names.next()) |n| {
+        if (std.mem.eql(u8, n.text, name)) return true;
+    }
+    return false;
+}
+
+// ============================================================================
+// Effects
+// ============================================================================
+
+/// What running an expression may do besides producing a value
+pub const Effects = struct {
+    calls: bool = false, // Calls a function (any effect possible), or defines one
+    assigns: bool = false, // Assigns or declares a variable
+    mutates_objects: bool = false, // Assigns a property or deletes one
+
+    /// No effects: evaluating it twice gives the same result as once
+    pub fn isPure(self: Effects) bool {
+        return !self.calls and !self.assigns and !self.mutates_objects;
+    }
+};
+
+/// Side effects of an expression or statement
+pub fn effects(expression: []const u8) Effects {
+    var result = Effects{};
+    var lexer = Lexer{ .source = expression };
+    var previous: ?Token = null;
+    var before_previous: ?Token = null;
+
+    while (lexer.next()) |token| {
+        defer {
+            before_previous = previous;
+            previous = token;
+        }
+
+        switch (token.kind) {
+            .keyword => {
+                const word = token.text;
+                if (std.mem.eql(u8, word, "new") or std.mem.eql(u8, word, "function")) result.calls = true;
+                if (std.mem.eql(u8, word, "delete")) result.mutates_objects = true;
+                if (std.mem.eql(u8, word, "var") or std.mem.eql(u8, word, "let") or std.mem.eql(u8, word, "const")) result.assigns = true;
+            },
+            .punct => {
+                const p = previous orelse continue;
+                if (token.is("(") and (p.kind == .identifier or p.is(")") or p.is("]"))) result.calls = true;
+                if (token.is("=>")) result.calls = true;
+
+                const increments = token.is("++") or token.is("--");
+                if (!increments and !assignment_ops.has(token.text)) continue;
+
+                // Target is a property when it ends in `.name` or `[...]`
+                const property = p.is("]") or (p.kind == .identifier and before_previous != null and
+                    (before_previous.?.is(".") or before_previous.?.is("?.")));
+                if (property) {
+                    result.mutates_objects = true;
+                } else if (p.kind == .identifier or increments) {
+                    result.assigns = true;
+                    // `++a.b`: the target follows the operator
+                    if (increments and p.kind != .identifier) {
+                        var ahead = lexer;
+                        _ = ahead.next();
+                        if (ahead.next()) |after| {
+                            if (after.is(".") or after.is("[")) result.mutates_objects = true;
+                        }
+                    }
+                }
+            },
+            else => {},
+        }
+    }
+    return result;
+}
+
+/// Global functions that return the same value for the same arguments and
+/// change nothing
+const pure_functions = std.StaticStringMap(void).initComptime(.{
+    .{"String"},     .{"Number"},             .{"Boolean"},            .{"parseInt"},
+    .{"parseFloat"}, .{"isNaN"},              .{"isFinite"},           .{"encodeURI"},
+    .{"decodeURI"},  .{"encodeURIComponent"}, .{"decodeURIComponent"}, .{"escape"},
+    .{"unescape"},
+});
+
+/// Whether every function an expression calls is known to be pure
+///
+/// Only Math functions (but not Math.random) and the global conversions
+/// such as String() and parseInt() are known. Methods of template data may
+/// change it, and functions defined in the expression may do anything.
+pub fn callsArePure(expression: []const u8) bool {
+    var lexer = Lexer{ .source = expression };
+    var last = [_]?Token{null} ** 4; // Tokens before the current one, nearest first
+
+    while (lexer.next()) |token| {
+        defer {
+            const shifted = [_]?Token{ token, last[0], last[1], last[2] };
+            last = shifted;
+        }
+
+        if (token.kind == .keyword and (std.mem.eql(u8, token.text, "new") or std.mem.eql(u8, token.text, "function"))) return false;
+        if (token.is("=>")) return false;
+        if (!token.is("(")) continue;
+
+        const callee = last[0] orelse continue;
+        if (callee.is(")") or callee.is("]")) return false;
+        if (callee.kind != .identifier) continue;
+        if (!isMember(last[1])) {
+            if (!pure_functions.has(callee.text)) return false;
+            continue;
+        }
+
+        // A method: only Math.f(), where Math is not itself a property
+        const object = last[2] orelse return false;
+        if (object.kind != .identifier or !std.mem.eql(u8, object.text, "Math") or isMember(last[3])) return false;
+        if (std.mem.eql(u8, callee.text, "random")) return false;
+    }
+    return true;
+}
+
+fn isMember(token: ?Token) bool {
+    const t = token orelse return false;
+    return t.is(".") or t.is("?.");
+}
+
+// ============================================================================
+// Template variables
+// ============================================================================
+
+/// JavaScript globals, which are never template data
+const js_globals = std.StaticStringMap(void).initComptime(.{
+    .{"Math"},               .{"JSON"},               .{"Object"},    .{"Array"},
+    .{"String"},             .{"Number"},             .{"Boolean"},   .{"Date"},
+    .{"RegExp"},             .{"Error"},              .{"parseInt"},  .{"parseFloat"},
+    .{"isNaN"},              .{"isFinite"},           .{"encodeURI"}, .{"decodeURI"},
+    .{"encodeURIComponent"}, .{"decodeURIComponent"}, .{"escape"},    .{"unescape"},
+});
+
+/// The data a template reads: its free variables
+///
+/// Strings point into the template AST, so they are valid as long as the
+/// tree is.
+pub const Dependencies = struct {
+    variables: []const []const u8, // Read by the template, mixin bodies included (sorted)
+    mixins: []const Mixin, // Mixins defined by the template, in source order
+    includes: []const []const u8, // include and extends paths, as written
+
+    pub const Mixin = struct {
+        name: []const u8,
+        variables: []const []const u8, // Read by the body, parameters excluded (sorted)
+    };
+
+    pub fn deinit(self: *Dependencies, allocator: std.mem.Allocator) void {
+        allocator.free(self.variables);
+        for (self.mixins) |mixin| allocator.free(mixin.variables);
+        allocator.free(self.mixins);
+        allocator.free(self.includes);
+    }
+};
+
+/// Find the variables a template reads from its data
+///
+/// Every expression is covered: interpolations, code, attributes, if and
+/// case subjects, loop iterables and mixin arguments. A name is not free
+/// where the template binds it first: inside a loop for its iterator and
+/// index, inside a mixin for its parameters, and after template code
+/// declares or assigns it (until the end of the enclosing branch or loop
+/// body). Included files are listed, not followed.
+///
+/// The list errs on the side of including too much (object literal keys,
+/// for example), so binding only these variables renders the same HTML
+/// as binding all of them.
+///
+/// Parameters:
+/// - allocator: Allocator for the result
+/// - root: Template root (usually a Document)
+///
+/// Returns: Dependencies (free with deinit)
+///
+/// Example:
+/// ```zig
+/// var deps = try analysis.dependencies(allocator, tree);
+/// defer deps.deinit(allocator);
+/// for (deps.variables) |name| std.debug.print("{s}\n", .{name});
+/// ```
+pub fn dependencies(allocator: std.mem.Allocator, root: *const ast.AstNode) !Dependencies {
+    var scan = FreeScan{ .allocator = allocator };
+    defer scan.deinit();
+
+    try scan.node(root);
+
+    const variables = try scan.sortedNames();
+    errdefer allocator.free(variables);
+    const includes = try scan.includes.toOwnedSlice(allocator);
+    errdefer allocator.free(includes);
+
+    return .{
+        .variables = variables,
+        .mixins = try scan.mixins.toOwnedSlice(allocator),
+        .includes = includes,
+    };
+}
+
+/// Template walk collecting the names read before being bound
+const FreeScan = struct {
+    allocator: std.mem.Allocator,
+    bound: std.ArrayListUnmanaged([]const u8) = .{}, // Innermost scope last
+    found: std.StringArrayHashMapUnmanaged(void) = .{},
+    mixins: std.ArrayListUnmanaged(Dependencies.Mixin) = .{},
+    includes: std.ArrayListUnmanaged([]const u8) = .{},
+
+    fn deinit(self: *FreeScan) void {
+        self.bound.deinit(self.allocator);
+        self.found.deinit(self.allocator);
+        for (self.mixins.items) |m| self.allocator.free(m.variables);
+        self.mixins.deinit(self.allocator);
+        self.includes.deinit(self.allocator);
+    }
+
+    fn isBound(self: *const FreeScan, name: []const u8) bool {
+        for (self.bound.items) |b| {
+            if (std.mem.eql(u8, b, name)) return true;
+        }
+        return false;
+    }
+
+    fn expression(self: *FreeScan, expr: []const u8) !void {
+        var names = Names.init(expr);
+        while (names.next()) |name| {
+            // `x += 1` and `x++` read x too
+            if (name.use != .declared and !self.isBound(name.text) and !js_globals.has(name.text)) {
+                try self.found.put(self.allocator, name.text, {});
+            }
+            if (name.use != .read) try self.bound.append(self.allocator, name.text);
+        }
+    }
+
+    fn attributes(self: *FreeScan, attrs: []const ast.Attribute) !void {
+        for (attrs) |attr| {
+            if (attr.is_expression) try self.expression(attr.value orelse continue);
+        }
+    }
+
+    fn nodes(self: *FreeScan, list: []const *ast.AstNode) error{OutOfMemory}!void {
+        for (list) |n| try self.node(n);
+    }
+
+    /// Nodes whose bindings end with them (a branch, a loop body)
+    fn scoped(self: *FreeScan, list: []const *ast.AstNode) !void {
+        const mark = self.bound.items.len;
+        defer self.bound.shrinkRetainingCapacity(mark);
+        try self.nodes(list);
+    }
+
+    fn node(self: *FreeScan, n: *const ast.AstNode) !void {
+        switch (n.data) {
+            .Document => |doc| try self.nodes(doc.children.items),
+            .Tag => |tag| {
+                try self.attributes(tag.attributes.items);
+                try self.nodes(tag.children.items);
+            },
+            .Interpolation => |interp| try self.expression(interp.expression),
+            .Code => |code| try self.expression(code.code),
+            .Conditional => |cond| {
+                try self.expression(cond.condition);
+                try self.scoped(cond.then_branch.items);
+                if (cond.else_branch) |branch| try self.scoped(branch.items);
+            },
+            .Loop => |loop| {
+                try self.expression(loop.iterable);
+                const mark = self.bound.items.len;
+                if (!loop.is_while) try self.bound.append(self.allocator, loop.iterator);
+                if (loop.index) |index| try self.bound.append(self.allocator, index);
+                try self.nodes(loop.body.items);
+                self.bound.shrinkRetainingCapacity(mark);
+                if (loop.else_branch) |branch| try self.scoped(branch.items);
+            },
+            .Case => |case| {
+                try self.expression(case.expression);
+                for (case.cases.items) |when_node| try self.scoped(when_node.data.When.body.items);
+                if (case.default) |default| try self.scoped(default.items);
+            },
+            .MixinDef => |def| try self.mixin(&def),
+            .MixinCall => |call| {
+                for (call.args.items) |arg| try self.expression(arg);
+                try self.attributes(call.attributes.items);
+                if (call.body) |body| try self.scoped(body.items);
+            },
+            .Include => |include| try self.includes.append(self.allocator, include.path),
+            .Extends => |extends| try self.includes.append(self.allocator, extends.path),
+            .Block => |block| try self.nodes(block.body.items),
+            .Text, .Comment, .When => {},
+        }
+    }
+
+    /// A mixin body starts with only its parameters bound
+    fn mixin(self: *FreeScan, def: *const ast.MixinDefNode) !void {
+        var inner = FreeScan{ .allocator = self.allocator };
+        defer inner.deinit();
+
+        for (def.params.items) |param| try inner.bound.append(self.allocator, param);
+        if (def.rest_param) |rest| try inner.bound.append(self.allocator, rest);
+        try inner.nodes(def.body.items);
+
+        const variables = try inner.sortedNames();
+        errdefer self.allocator.free(variables);
+        for (variables) |name| try self.found.put(self.allocator, name, {});
+
+        // Mixins defined inside the body are reported too
+        try self.mixins.appendSlice(self.allocator, inner.mixins.items);
+        inner.mixins.clearRetainingCapacity();
+        try self.includes.appendSlice(self.allocator, inner.includes.items);
+        try self.mixins.append(self.allocator, .{ .name = def.name, .variables = variables });
+    }
+
+    fn sortedNames(self: *const FreeScan) ![]const []const u8 {
+        const names = try self.allocator.dupe([]const u8, self.found.keys());
+        std.mem.sort([]const u8, names, {}, lessThan);
+        return names;
+    }
+
+    fn lessThan(_: void, a: []const u8, b: []const u8) bool {
+        return std.mem.lessThan(u8, a, b);
+    }
+};
+
+// ============================================================================
+// Loop invariants
+// ============================================================================
+
+/// Expressions of a loop body that are the same in every iteration
+///
+/// An expression is invariant when it has no effects and reads no name the
+/// loop binds: the iterator and index, or any variable assigned or declared
+/// in the body (mixins called from the body included). Only expressions
+/// evaluated on every iteration are returned: attributes, interpolations,
+/// buffered code, and the subjects of if/case, but nothing inside their
+/// branches or in nested loops, so evaluating them ahead of time cannot
+/// raise an error the loop would not have raised.
+///
+/// A body is not analyzed (no invariants) when any of its expressions calls
+/// a function not known to be pure (see callsArePure) or changes objects,
+/// or when it includes other templates or renders blocks, since the
+/// variables those change are unknown. Buffered code, interpolations and
+/// attributes count as much as unbuffered code: `p= counter.bump()` changes
+/// what a later `p= counter.n` renders.
+///
+/// Parameters:
+/// - allocator: Allocator for the result and working memory
+/// - loop_node: A Loop node
+/// - mixins: Mixins defined so far (to follow mixin calls)
+///
+/// Returns: Expression slices of the body nodes (caller owns the slice)
+pub fn loopInvariants(
+    allocator: std.mem.Allocator,
+    loop_node: *const ast.AstNode,
+    mixins: *const std.StringHashMap(*ast.AstNode),
+) ![]const []const u8 {
+    const loop = &loop_node.data.Loop;
+
+    var scan = BodyScan{ .allocator = allocator, .mixins = mixins };
+    defer scan.deinit();
+
+    try scan.bind(loop.iterator);
+    if (loop.index) |index| try scan.bind(index);
+    try scan.nodes(loop.body.items);
+    if (scan.unknown) return &.{};
+
+    var invariants = std.ArrayList([]const u8){};
+    errdefer invariants.deinit(allocator);
+    try scan.collect(&invariants, loop.body.items);
+    return invariants.toOwnedSlice(allocator);
+}
+
+/// Names bound by a loop body, and whether it can be analyzed at all
+const BodyScan = struct {
+    allocator: std.mem.Allocator,
+    mixins: *const std.StringHashMap(*ast.AstNode),
+    bound: std.StringHashMapUnmanaged(void) = .{},
+    visited_mixins: std.StringHashMapUnmanaged(void) = .{},
+    unknown: bool = false,
+
+    fn deinit(self: *BodyScan) void {
+        self.bound.deinit(self.allocator);
+        self.visited_mixins.deinit(self.allocator);
+    }
+
+    fn bind(self: *BodyScan, name: []const u8) !void {
+        try self.bound.put(self.allocator, name, {});
+    }
+
+    /// Record what an expression assigns; it may not touch objects or call
+    /// functions that might
+    fn expression(self: *BodyScan, expr: []const u8) !void {
+        const e = effects(expr);
+        if (e.mutates_objects or (e.calls and !callsArePure(expr))) self.unknown = true;
+        if (!e.assigns) return;
+
+        var names = Names.init(expr);
+        while (names.next()) |name| {
+            if (name.use != .read) try self.bind(name.text);
+        }
+    }
+
+    fn nodes(self: *BodyScan, list: []const *ast.AstNode) error{OutOfMemory}!void {
+        for (list) |n| {
+            if (self.unknown) return;
+            try self.node(n);
+        }
+    }
+
+    fn node(self: *BodyScan, n: *const ast.AstNode) !void {
+        switch (n.data) {
+            .Tag => |tag| {
+                for (tag.attributes.items) |attr| {
+                    if (attr.is_expression) try self.expression(attr.value orelse continue);
+                }
+                try self.nodes(tag.children.items);
+            },
+            .Interpolation => |interp| try self.expression(interp.expression),
+            .Code => |code| try self.expression(code.code),
+            .Conditional => |cond| {
+                try self.expression(cond.condition);
+                try self.nodes(cond.then_branch.items);
+                if (cond.else_branch) |branch| try self.nodes(branch.items);
+            },
+            .Loop => |loop| {
+                try self.bind(loop.iterator);
+                if (loop.index) |index| try self.bind(index);
+                try self.expression(loop.iterable);
+                try self.nodes(loop.body.items);
+                if (loop.else_branch) |branch| try self.nodes(branch.items);
+            },
+            .Case => |case| {
+                try self.expression(case.expression);
+                for (case.cases.items) |when_node| try self.nodes(when_node.data.When.body.items);
+                if (case.default) |default| try self.nodes(default.items);
+            },
+            .MixinDef => |def| try self.mixin(&def),
+            .MixinCall => |call| {
+                for (call.args.items) |arg| try self.expression(arg);
+                for (call.attributes.items) |attr| {
+                    if (attr.is_expression) try self.expression(attr.value orelse continue);
+                }
+                if (call.body) |body| try self.nodes(body.items);
+                const def = self.mixins.get(call.name) orelse {
+                    self.unknown = true;
+                    return;
+                };
+                try self.mixin(&def.data.MixinDef);
+            },
+            .Include, .Block, .Extends, .Document => self.unknown = true,
+            .Text, .Comment, .When => {},
+        }
+    }
+
+    /// Parameters and assignments of a mixin body (once per mixin)
+    fn mixin(self: *BodyScan, def: *const ast.MixinDefNode) !void {
+        const gop = try self.visited_mixins.getOrPut(self.allocator, def.name);
+        if (gop.found_existing) return;
+
+        for (def.params.items) |param| try self.bind(param);
+        if (def.rest_param) |rest| try self.bind(rest);
+        try self.nodes(def.body.items);
+    }
+
+    /// Invariant expressions among the nodes run on every iteration
+    fn collect(self: *BodyScan, out: *std.ArrayList([]const u8), list: []const *ast.AstNode) error{OutOfMemory}!void {
+        for (list) |n| {
+            switch (n.data) {
+                .Tag => |tag| {
+                    for (tag.attributes.items) |attr| {
+                        if (attr.is_expression) try self.candidate(out, attr.value orelse continue);
+                    }
+                    try self.collect(out, tag.children.items);
+                },
+                .Interpolation => |interp| try self.candidate(out, interp.expression),
+                .Code => |code| if (code.is_buffered) try self.candidate(out, code.code),
+                .Conditional => |cond| try self.candidate(out, cond.condition),
+                .Case => |case| try self.candidate(out, case.expression),
+                else => {},
+            }
+        }
+    }
+
+    fn candidate(self: *BodyScan, out: *std.ArrayList([]const u8), expr: []const u8) !void {
+        if (!effects(expr).isPure()) return;
+        var names = Names.init(expr);
+        while (names.next()) |name| {
+            if (self.bound.contains(name.text)) return;
+        }
+        try out.append(self.allocator, expr);
+    }
+};
+
+// ============================================================================
+// Pure mixins
+// ============================================================================
+
+/// Whether a mixin's output depends on nothing but its arguments
+///
+/// The body may only read its parameters (and JavaScript globals such as
+/// Math) through expressions without effects, and call mixins that are
+/// pure themselves. Loops and unbuffered code bind variables, includes and
+/// blocks render unknown content, and recursion is not followed, so any of
+/// them makes a mixin impure. Calling a pure mixin twice with equal
+/// arguments renders the same HTML and changes nothing else, so the second
+/// call can reuse the first one's output.
+///
+/// Parameters:
+/// - allocator: Working memory
+/// - mixin_node: A MixinDef node
+/// - mixins: Mixins of the template (to follow mixin calls)
+pub fn isPureMixin(
+    allocator: std.mem.Allocator,
+    mixin_node: *const ast.AstNode,
+    mixins: *const std.StringHashMap(*ast.AstNode),
+) !bool {
+    var scan = PurityScan{ .allocator = allocator, .mixins = mixins };
+    defer scan.deinit();
+    return scan.mixin(&mixin_node.data.MixinDef);
+}
+
+/// Mixin body walk that stops at anything besides reading parameters
+const PurityScan = struct {
+    allocator: std.mem.Allocator,
+    mixins: *const std.StringHashMap(*ast.AstNode),
+    def: ?*const ast.MixinDefNode = null, // Mixin whose body is being scanned
+    active: std.StringHashMapUnmanaged(void) = .{}, // Mixins being scanned (to stop recursion)
+
+    fn deinit(self: *PurityScan) void {
+        self.active.deinit(self.allocator);
+    }
+
+    fn mixin(self: *PurityScan, def: *const ast.MixinDefNode) error{OutOfMemory}!bool {
+        const gop = try self.active.getOrPut(self.allocator, def.name);
+        if (gop.found_existing) return false;
+        defer _ = self.active.remove(def.name);
+
+        const caller = self.def;
+        defer self.def = caller;
+        self.def = def;
+        return self.nodes(def.body.items);
+    }
+
+    fn nodes(self: *PurityScan, list: []const *ast.AstNode) error{OutOfMemory}!bool {
+        for (list) |n| {
+            if (!try self.node(n)) return false;
+        }
+        return true;
+    }
+
+    fn node(self: *PurityScan, n: *const ast.AstNode) !bool {
+        switch (n.data) {
+            .Tag => |tag| return self.attributes(tag.attributes.items) and try self.nodes(tag.children.items),
+            .Interpolation => |interp| return self.expression(interp.expression),
+            .Code => |code| return code.is_buffered and self.expression(code.code),
+            .Conditional => |cond| {
+                if (!self.expression(cond.condition) or !try self.nodes(cond.then_branch.items)) return false;
+                return if (cond.else_branch) |branch| self.nodes(branch.items) else true;
+            },
+            .Case => |case| {
+                if (!self.expression(case.expression)) return false;
+                for (case.cases.items) |when_node| {
+                    if (!try self.nodes(when_node.data.When.body.items)) return false;
+                }
+                return if (case.default) |default| self.nodes(default.items) else true;
+            },
+            .MixinCall => |call| {
+                if (call.body != null or !self.attributes(call.attributes.items)) return false;
+                for (call.args.items) |arg| {
+                    if (!self.expression(arg)) return false;
+                }
+                const def = self.mixins.get(call.name) orelse return false;
+                return self.mixin(&def.data.MixinDef);
+            },
+            .Text, .Comment => return true,
+            .Loop, .MixinDef, .Include, .Extends, .Block, .Document, .When => return false,
+        }
+    }
+
+    fn attributes(self: *const PurityScan, attrs: []const ast.Attribute) bool {
+        for (attrs) |attr| {
+            if (attr.is_expression and !self.expression(attr.value orelse continue)) return false;
+        }
+        return true;
+    }
+
+    /// No effects, and reads nothing but parameters and JavaScript globals
+    fn expression(self: *const PurityScan, expr: []const u8) bool {
+        if (!effects(expr).isPure()) return false;
+        var names = Names.init(expr);
+        while (names.next()) |name| {
+            if (!self.isParam(name.text) and !js_globals.has(name.text)) return false;
+        }
+        return true;
+    }
+
+    fn isParam(self: *const PurityScan, name: []const u8) bool {
+        const def = self.def orelse return false;
+        for (def.params.items) |param| {
+            if (std.mem.eql(u8, param, name)) return true;
+        }
+        const rest = def.rest_param orelse return false;
+        return std.mem.eql(u8, rest, name);
+    }
+};
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+test "analysis - names" {
+    const expected = [_]Name{
+        .{ .text = "total", .use = .assigned },
+        .{ .text = "item", .use = .read },
+        .{ .text = "rate", .use = .read },
+        .{ .text = "fmt", .use = .read },
+        .{ .text = "item", .use = .read },
+        .{ .text = "x", .use = .declared },
+        .{ .text = "count", .use = .assigned },
+        .{ .text = "name", .use = .read },
+    };
+
+    var names = Names.init("total += item.price * rate; fmt('a + b', item.tax); var x = 1; count++; `hi ${name}`");
+    for (expected) |want| {
+        const name = names.next() orelse return error.TestUnexpectedResult;
+        try std.testing.expectEqualStrings(want.text, name.text);
+        try std.testing.expectEqual(want.use, name.use);
+    }
+    try std.testing.expect(names.next() == null);
+}
+
+test "analysis - effects" {
+    try std.testing.expect(effects("user.name + ' ' + currency").isPure());
+    try std.testing.expect(effects("a ? b[0] : c === 'x'").isPure());
+    try std.testing.expect(effects("format(price)").calls);
+    try std.testing.expect(effects("items.join(', ')").calls);
+    try std.testing.expect(effects("count = count + 1").assigns);
+    try std.testing.expect(effects("user.visits++").mutates_objects);
+    try std.testing.expect(effects("list[0] = 1").mutates_objects);
+    try std.testing.expect(!effects("a == b").assigns);
+}
+
+test "analysis - loop invariants" {
+    const Parser = @import("parser.zig").Parser;
+
+    var parser = try Parser.init(std.testing.allocator,
+        \\each item, i in items
+        \\  - var row = i * 2
+        \\  li(class=theme.row data-i=i)= currency + item.price
+        \\  if user.isAdmin
+        \\    p= note
+        \\  p= row
+    );
+    defer parser.deinit();
+    const tree = try parser.parse();
+
+    var mixins = std.StringHashMap(*ast.AstNode).init(std.testing.allocator);
+    defer mixins.deinit();
+
+    const invariants = try loopInvariants(std.testing.allocator, tree.data.Document.children.items[0], &mixins);
+    defer std.testing.allocator.free(invariants);
+
+    try std.testing.expectEqual(@as(usize, 2), invariants.len);
+    try std.testing.expectEqualStrings("theme.row", invariants[0]);
+    try std.testing.expectEqualStrings("user.isAdmin", invariants[1]);
+}
+
+test "analysis - calls in loop bodies" {
+    const Parser = @import("parser.zig").Parser;
+
+    var mixins = std.StringHashMap(*ast.AstNode).init(std.testing.allocator);
+    defer mixins.deinit();
+
+    // A mutating call in buffered code changes what later reads render
+    {
+        var parser = try Parser.init(std.testing.allocator,
+            \\each item in items
+            \\  p= counter.bump()
+            \\  p(class=theme)= counter.n
+        );
+        defer parser.deinit();
+        const tree = try parser.parse();
+
+        const invariants = try loopInvariants(std.testing.allocator, tree.data.Document.children.items[0], &mixins);
+        defer std.testing.allocator.free(invariants);
+        try std.testing.expectEqual(@as(usize, 0), invariants.len);
+    }
+
+    // Known pure functions don't stop the analysis
+    {
+        var parser = try Parser.init(std.testing.allocator,
+            \\each item in items
+            \\  p= Math.max(item, 1) + String(item)
+            \\  p(class=theme)= item
+        );
+        defer parser.deinit();
+        const tree = try parser.parse();
+
+        const invariants = try loopInvariants(std.testing.allocator, tree.data.Document.children.items[0], &mixins);
+        defer std.testing.allocator.free(invariants);
+        try std.testing.expectEqual(@as(usize, 1), invariants.len);
+        try std.testing.expectEqualStrings("theme", invariants[0]);
+    }
+
+    try std.testing.expect(callsArePure("Math.floor(x / 2) + parseInt(y)"));
+    try std.testing.expect(!callsArePure("Math.random()"));
+    try std.testing.expect(!callsArePure("data.Math.max(a)"));
+    try std.testing.expect(!callsArePure("items.push(x)"));
+    try std.testing.expect(!callsArePure("fns[0](x)"));
+    try std.testing.expect(!callsArePure("list.map(x => x)"));
+}
+
+test "analysis - template dependencies" {
+    const Parser = @import("parser.zig").Parser;
+
+    var parser = try Parser.init(std.testing.allocator,
+        \\include header.pug
+        \\mixin card(title)
+        \\  h2= title + site.suffix
+        \\- var count = 0
+        \\h1(class=theme)= user.name
+        \\each item, i in items
+        \\  +card(item.title)
+        \\  - count += i
+        \\p= Math.max(count, min) + currency
+    );
+    defer parser.deinit();
+    const tree = try parser.parse();
+
+    var deps = try dependencies(std.testing.allocator, tree);
+    defer deps.deinit(std.testing.allocator);
+
+    const expected = [_][]const u8{ "currency", "items", "min", "site", "theme", "user" };
+    try std.testing.expectEqual(expected.len, deps.variables.len);
+    for (expected, deps.variables) |want, name| try std.testing.expectEqualStrings(want, name);
+
+    try std.testing.expectEqual(@as(usize, 1), deps.mixins.len);
+    try std.testing.expectEqualStrings("card", deps.mixins[0].name);
+    try std.testing.expectEqual(@as(usize, 1), deps.mixins[0].variables.len);
+    try std.testing.expectEqualStrings("site", deps.mixins[0].variables[0]);
+
+    try std.testing.expectEqual(@as(usize, 1), deps.includes.len);
+    try std.testing.expectEqualStrings("header.pug", deps.includes[0]);
+}
+
+test "analysis - pure mixins" {
+    const Parser = @import("parser.zig").Parser;
+
+    var parser = try Parser.init(std.testing.allocator,
+        \\mixin icon(name, ...classes)
+        \\  svg(class=classes)
+        \\    use(href=name)
+        \\mixin button(label, kind)
+        \\  if kind
+        \\    +icon(kind)
+        \\  button= label
+        \\mixin price(amount)
+        \\  span= amount + currency
+        \\mixin list(items)
+        \\  each item in items
+        \\    li= item
+        \\mixin tree(node)
+        \\  +tree(node)
+    );
+    defer parser.deinit();
+    const tree = try parser.parse();
+
+    var mixins = std.StringHashMap(*ast.AstNode).init(std.testing.allocator);
+    defer mixins.deinit();
+    for (tree.data.Document.children.items) |child| {
+        try mixins.put(child.data.MixinDef.name, child);
+    }
+
+    const expected = [_]struct { []const u8, bool }{
+        .{ "icon", true },
+        .{ "button", true },
+        .{ "price", false }, // Reads currency
+        .{ "list", false }, // Loop
+        .{ "tree", false }, // Recursive
+    };
+    for (expected) |want| {
+        try std.testing.expectEqual(want[1], try isPureMixin(std.testing.allocator, mixins.get(want[0]).?, &mixins));
+    }
+}
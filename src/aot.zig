@@ -0,0 +1,350 @@
+//! AOT support - Runtime helpers for templates compiled to Zig
+//!
+//! `zpug --emit-zig page.pug` (see codegen.zig) turns a template into a Zig
+//! source file with a single generic function:
+//!
+//! ```zig
+//! pub fn render(o: *aot.Output, data: anytype) !void
+//! ```
+//!
+//! Static markup becomes string literals and control flow becomes native
+//! `if`/`for`. Identifiers and dotted paths (`title`, `user.name`,
+//! `items.length`) are looked up in the type of `data` at comptime and read
+//! as plain field accesses. Everything else - calls, operators, paths the
+//! data type does not have - is evaluated by the JsRuntime given to the
+//! Output, with `data` (and the loop variables in scope) bound as variables
+//! the first time JavaScript is needed. A template whose expressions are
+//! all resolved natively never touches the runtime.
+//!
+//! Example:
+//! ```zig
+//! const page = @import("page.zig"); // generated
+//!
+//! var out = aot.Output.init(allocator, null); // no JS needed by this page
+//! defer out.deinit();
+//!
+//! try page.render(&out, .{ .title = "Home", .items = &[_][]const u8{ "a", "b" } });
+//! std.debug.print("{s}\n", .{out.html.items});
+//! ```
+
+const std = @import("std");
+const runtime = @import("runtime.zig");
+
+// ============================================================================
+// Output
+// ============================================================================
+
+/// Output buffer and JavaScript fallback of a generated render function
+pub const Output = struct {
+    allocator: std.mem.Allocator,
+    html: std.ArrayList(u8) = .{}, // Rendered HTML
+    js: ?*runtime.JsRuntime, // Needed only by templates with JS expressions
+    scratch: std.heap.ArenaAllocator, // Eval results and formatted values
+    data_bound: bool = false, // Whether data has been set on the runtime
+
+    pub const Error = error{ OutOfMemory, JsRuntimeRequired, EvalFailed };
+
+    pub fn init(allocator: std.mem.Allocator, js: ?*runtime.JsRuntime) Output {
+        return .{
+            .allocator = allocator,
+            .js = js,
+            .scratch = std.heap.ArenaAllocator.init(allocator),
+        };
+    }
+
+    pub fn deinit(self: *Output) void {
+        self.html.deinit(self.allocator);
+        self.scratch.deinit();
+    }
+
+    /// Clear the HTML (keeping its capacity) before rendering again
+    pub fn reset(self: *Output) void {
+        self.html.clearRetainingCapacity();
+        _ = self.scratch.reset(.retain_capacity);
+        self.data_bound = false;
+    }
+
+    /// Append static markup
+    pub fn text(self: *Output, bytes: []const u8) Error!void {
+        try self.html.appendSlice(self.allocator, bytes);
+    }
+
+    /// Append a data value, HTML-escaped unless `escape` is false
+    pub fn value(self: *Output, v: anytype, comptime escape: bool) Error!void {
+        const str = try self.textOf(v);
+        if (escape) {
+            try writeEscaped(&self.html, self.allocator, str);
+        } else {
+            try self.html.appendSlice(self.allocator, str);
+        }
+    }
+
+    /// A data value as JavaScript would print it (in scratch memory)
+    pub fn textOf(self: *Output, v: anytype) Error![]const u8 {
+        const T = @TypeOf(v);
+        if (comptime isString(T)) return v;
+        return switch (@typeInfo(T)) {
+            .bool => if (v) "true" else "false",
+            .int, .comptime_int => try std.fmt.allocPrint(self.scratch.allocator(), "{d}", .{v}),
+            .float, .comptime_float => try std.fmt.allocPrint(self.scratch.allocator(), "{d}", .{v}),
+            .@"enum" => @tagName(v),
+            .optional => if (v) |inner| self.textOf(inner) else "null",
+            .null => "null",
+            .pointer => |info| if (info.size == .one) self.textOf(v.*) else self.textOfJs(v),
+            else => self.textOfJs(v),
+        };
+    }
+
+    /// Arrays and objects print like JavaScript's String(): joined with ","
+    fn textOfJs(self: *Output, v: anytype) Error![]const u8 {
+        const T = @TypeOf(v);
+        if (comptime isList(T)) {
+            var out = std.ArrayList(u8){};
+            for (v, 0..) |item, i| {
+                if (i > 0) try out.append(self.scratch.allocator(), ',');
+                try out.appendSlice(self.scratch.allocator(), try self.textOf(item));
+            }
+            return out.items;
+        }
+        return "[object Object]";
+    }
+
+    // ------------------------------------------------------------------------
+    // JavaScript fallback
+    // ------------------------------------------------------------------------
+
+    /// Evaluate an expression and append its result
+    ///
+    /// `scope` is a struct of the native loop variables visible at the
+    /// expression; they are bound on the runtime before evaluating.
+    pub fn evalJs(self: *Output, data: anytype, scope: anytype, expression: []const u8, comptime escape: bool) Error!void {
+        const result = try self.jsText(data, scope, expression);
+        if (escape) {
+            try writeEscaped(&self.html, self.allocator, result);
+        } else {
+            try self.html.appendSlice(self.allocator, result);
+        }
+    }
+
+    /// Evaluate an expression to its string form (in scratch memory)
+    pub fn jsText(self: *Output, data: anytype, scope: anytype, expression: []const u8) Error![]const u8 {
+        const js = try self.runtimeFor(data, scope);
+        return js.evalAlloc(self.scratch.allocator(), expression) catch |err| switch (err) {
+            error.OutOfMemory => error.OutOfMemory,
+            else => error.EvalFailed,
+        };
+    }
+
+    /// Evaluate a condition with the compiler's truthiness rules
+    pub fn jsTruthy(self: *Output, data: anytype, scope: anytype, expression: []const u8) Error!bool {
+        const result = try self.jsText(data, scope, expression);
+        return result.len > 0 and
+            !std.mem.eql(u8, result, "false") and
+            !std.mem.eql(u8, result, "null") and
+            !std.mem.eql(u8, result, "undefined") and
+            !std.mem.eql(u8, result, "0");
+    }
+
+    /// Length of an iterable expression (0 when it has none)
+    pub fn jsLength(self: *Output, data: anytype, scope: anytype, iterable: []const u8) Error!usize {
+        const expression = try std.fmt.allocPrint(self.scratch.allocator(), "({s}).length", .{iterable});
+        const result = self.jsText(data, scope, expression) catch |err| switch (err) {
+            error.EvalFailed => return 0,
+            else => return err,
+        };
+        return std.fmt.parseInt(usize, result, 10) catch 0;
+    }
+
+    /// Bind the variables of one iteration of a JavaScript loop
+    pub fn jsLoopBind(
+        self: *Output,
+        data: anytype,
+        scope: anytype,
+        iterator: []const u8,
+        index: ?[]const u8,
+        iterable: []const u8,
+        i: usize,
+    ) Error!void {
+        const item = try std.fmt.allocPrint(self.scratch.allocator(), "var {s} = ({s})[{d}]", .{ iterator, iterable, i });
+        try self.execJs(data, scope, item);
+        if (index) |name| {
+            try self.execJs(data, scope, try std.fmt.allocPrint(self.scratch.allocator(), "var {s} = {d}", .{ name, i }));
+        }
+    }
+
+    /// Run a statement for its side effects
+    pub fn execJs(self: *Output, data: anytype, scope: anytype, statement: []const u8) Error!void {
+        _ = try self.jsText(data, scope, statement);
+    }
+
+    /// The runtime, with data bound once per render and scope every call
+    fn runtimeFor(self: *Output, data: anytype, scope: anytype) Error!*runtime.JsRuntime {
+        const js = self.js orelse return error.JsRuntimeRequired;
+
+        if (!self.data_bound) {
+            self.data_bound = true;
+            const json = try std.json.Stringify.valueAlloc(self.scratch.allocator(), data, .{});
+            js.setVariablesFromJson(json) catch |err| switch (err) {
+                error.OutOfMemory => return error.OutOfMemory,
+                else => return error.EvalFailed,
+            };
+        }
+
+        inline for (std.meta.fields(@TypeOf(scope))) |field| {
+            const json = try std.json.Stringify.valueAlloc(self.scratch.allocator(), @field(scope, field.name), .{});
+            js.setJson(field.name, json) catch |err| switch (err) {
+                error.OutOfMemory => return error.OutOfMemory,
+                else => return error.EvalFailed,
+            };
+        }
+        return js;
+    }
+};
+
+// ============================================================================
+// Comptime Data Access
+// ============================================================================
+
+/// Whether a dotted path can be read natively from a value of type T
+///
+/// `length` reads the length of strings, slices and arrays, as in JS.
+pub fn has(comptime T: type, comptime path: []const u8) bool {
+    return PathType(T, path) != void;
+}
+
+/// Type of the value at a dotted path of T (void if there is none)
+pub fn PathType(comptime T: type, comptime path: []const u8) type {
+    const dot = std.mem.indexOfScalar(u8, path, '.');
+    const name = if (dot) |d| path[0..d] else path;
+    const Field = FieldType(T, name);
+    if (Field == void) return void;
+    return if (dot) |d| PathType(Field, path[d + 1 ..]) else Field;
+}
+
+fn FieldType(comptime T: type, comptime name: []const u8) type {
+    switch (@typeInfo(T)) {
+        .@"struct" => |info| {
+            inline for (info.fields) |field| {
+                if (std.mem.eql(u8, field.name, name)) return field.type;
+            }
+            return void;
+        },
+        .pointer => |info| {
+            if (info.size == .one and @typeInfo(info.child) != .array) return FieldType(info.child, name);
+            return if (std.mem.eql(u8, name, "length")) usize else void;
+        },
+        .array => return if (std.mem.eql(u8, name, "length")) usize else void,
+        else => return void,
+    }
+}
+
+/// Read the value at a dotted path (check has() first)
+pub fn get(v: anytype, comptime path: []const u8) PathType(@TypeOf(v), path) {
+    const dot = comptime std.mem.indexOfScalar(u8, path, '.');
+    const name = comptime if (dot) |d| path[0..d] else path;
+    const field = if (comptime isList(@TypeOf(v)) and std.mem.eql(u8, name, "length"))
+        v.len
+    else
+        @field(v, name);
+    return if (dot) |d| get(field, path[d + 1 ..]) else field;
+}
+
+/// JavaScript truthiness of a native value
+pub fn truthy(v: anytype) bool {
+    const T = @TypeOf(v);
+    if (comptime isString(T)) return v.len > 0;
+    return switch (@typeInfo(T)) {
+        .bool => v,
+        .int, .comptime_int, .float, .comptime_float => v != 0,
+        .optional => if (v) |inner| truthy(inner) else false,
+        .null => false,
+        else => true, // Arrays and objects, even empty ones
+    };
+}
+
+/// Whether native values of T can drive a `for` loop
+pub fn isList(comptime T: type) bool {
+    return switch (@typeInfo(T)) {
+        .array => true,
+        .pointer => |info| info.size == .slice or
+            (info.size == .one and @typeInfo(info.child) == .array),
+        else => false,
+    };
+}
+
+fn isString(comptime T: type) bool {
+    return switch (@typeInfo(T)) {
+        .pointer => |info| switch (info.size) {
+            .slice => info.child == u8,
+            .one => switch (@typeInfo(info.child)) {
+                .array => |arr| arr.child == u8,
+                else => false,
+            },
+            else => false,
+        },
+        .array => |info| info.child == u8,
+        else => false,
+    };
+}
+
+// ============================================================================
+// Escaping
+// ============================================================================
+
+/// Append text with HTML special characters escaped (same set as the compiler)
+pub fn writeEscaped(out: *std.ArrayList(u8), allocator: std.mem.Allocator, input: []const u8) !void {
+    var start: usize = 0;
+    for (input, 0..) |c, i| {
+        const entity: []const u8 = switch (c) {
+            '&' => "&amp;",
+            '<' => "&lt;",
+            '>' => "&gt;",
+            '"' => "&quot;",
+            '\'' => "&#39;",
+            else => continue,
+        };
+        try out.appendSlice(allocator, input[start..i]);
+        try out.appendSlice(allocator, entity);
+        start = i + 1;
+    }
+    try out.appendSlice(allocator, input[start..]);
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+test "aot - comptime paths" {
+    const Data = struct {
+        title: []const u8,
+        user: struct { name: []const u8, admin: bool },
+        items: []const u32,
+    };
+    const data = Data{ .title = "T", .user = .{ .name = "Ana", .admin = true }, .items = &.{ 1, 2, 3 } };
+
+    try std.testing.expect(has(Data, "user.name"));
+    try std.testing.expect(has(Data, "items.length"));
+    try std.testing.expect(!has(Data, "user.email"));
+    try std.testing.expect(!has(Data, "title.length.x"));
+    try std.testing.expectEqualStrings("Ana", get(data, "user.name"));
+    try std.testing.expectEqual(@as(usize, 3), get(data, "items.length"));
+    try std.testing.expect(truthy(get(data, "user.admin")));
+    try std.testing.expect(!truthy(@as(?u32, null)));
+    try std.testing.expect(isList(@TypeOf(data.items)));
+}
+
+test "aot - output formatting" {
+    var out = Output.init(std.testing.allocator, null);
+    defer out.deinit();
+
+    try out.text("<p>");
+    try out.value(@as([]const u8, "<b>"), true);
+    try out.value(@as(u32, 42), true);
+    try out.value(@as(f64, 1.5), true);
+    try out.value(&[_]u32{ 1, 2 }, true);
+    try out.text("</p>");
+    try std.testing.expectEqualStrings("<p>&lt;b&gt;421.51,2</p>", out.html.items);
+
+    // JavaScript is only needed when an expression falls back to it
+    try std.testing.expectError(error.JsRuntimeRequired, out.evalJs(.{}, .{}, "1 + 1", true));
+}
@@ -6,8 +6,8 @@
 //!
 //! Main components:
 //! - NodeType: Enum of all possible AST node types
-//! - AstNode: The actual tree node with type and data
-//! - NodeData: Union containing type-specific data
+//! - AstNode: The actual tree node with source position and data
+//! - NodeData: Union containing type-specific data (its tag is the node type)
 //! - Attribute: Tag attribute representation
 //!
 //! Example AST for "div.container\n  p Hello":
@@ -77,22 +77,31 @@ pub const NodeType = enum {
 /// AST Node - Core data structure representing a single node in the parse tree
 ///
 /// Every node has:
-/// - type: What kind of node (Tag, Text, etc.)
 /// - line/column: Source location for error reporting
-/// - data: Type-specific data (union based on type)
+/// - data: Type-specific data; the union tag is the node type (see nodeType())
 ///
 /// Nodes are allocated on the heap and form a tree structure through
 /// parent-child relationships in their data fields (e.g., Tag.children).
 ///
+/// Layout: the node is the largest NodeData variant plus 8 bytes. The type
+/// is not stored twice, and positions are u32 (they saturate past 4G lines
+/// or columns). Nodes are still individually allocated and linked by
+/// pointer. There is no struct-of-arrays node store with u32 indices and
+/// an extra-data array yet, so walks are not contiguous.
+///
 /// Memory management:
 /// - Nodes are created with create() which allocates on heap
 /// - They must be freed with deinit() which recursively frees children
 /// - Use ArenaAllocator for automatic cleanup
 pub const AstNode = struct {
-    type: NodeType,        // Type of this node (Tag, Text, etc.)
-    line: usize,           // Source line number (1-indexed) for error messages
-    column: usize,         // Source column number (1-indexed)
-    data: NodeData,        // Type-specific data (union)
+    line: u32,             // Source line number (1-indexed) for error messages
+    column: u32,           // Source column number (1-indexed)
+    data: NodeData,        // Type-specific data (union tagged by NodeType)
+
+    /// Type of this node (Tag, Text, etc.)
+    pub fn nodeType(self: *const AstNode) NodeType {
+        return std.meta.activeTag(self.data);
+    }
 
     /// Create a new AST node on the heap
     ///
@@ -101,7 +110,7 @@ pub const AstNode = struct {
     ///
     /// Parameters:
     /// - allocator: Memory allocator
-    /// - node_type: Type of node to create
+    /// - node_type: Type of node to create (checked against data in debug builds)
     /// - line: Source line number
     /// - column: Source column number
     /// - data: Type-specific data (must match node_type)
@@ -119,11 +128,12 @@ pub const AstNode = struct {
     /// );
     /// ```
     pub fn create(allocator: std.mem.Allocator, node_type: NodeType, line: usize, column: usize, data: NodeData) !*AstNode {
+        std.debug.assert(std.meta.activeTag(data) == node_type);
+
         const node = try allocator.create(AstNode);
         node.* = .{
-            .type = node_type,
-            .line = line,
-            .column = column,
+            .line = std.math.lossyCast(u32, line),
+            .column = std.math.lossyCast(u32, column),
             .data = data,
         };
         return node;
@@ -331,13 +341,12 @@ pub const AstNode = struct {
 
 /// Tagged union containing type-specific data for each node type
 ///
-/// This is a discriminated union where the active field is determined by
-/// the AstNode.type field. Each variant contains a struct with the data
-/// specific to that node type.
+/// This is a discriminated union whose active field is the node type.
+/// Each variant contains a struct with the data specific to that node type.
 ///
 /// Example:
 /// ```zig
-/// if (node.type == .Tag) {
+/// if (node.nodeType() == .Tag) {
 ///     const tag = node.data.Tag;
 ///     std.debug.print("Tag: {s}\n", .{tag.name});
 /// }
@@ -394,6 +403,10 @@ pub const DocumentNode = struct {
 /// - attributes: List of attributes (class, id, href, etc.)
 /// - children: Child nodes (nested tags, text, etc.)
 /// - is_self_closing: True for void elements (img, br, input)
+/// - static_attributes: Attribute markup rendered at parse time, set when
+///   no attribute is an expression (see precomputeAttributes)
+/// - attribute_parts: Prerendered runs of literal attributes and the
+///   expression attributes between them, set when both kinds are present
 ///
 /// Example:
 /// ```zpug
@@ -406,6 +419,60 @@ pub const TagNode = struct {
     attributes: std.ArrayListUnmanaged(Attribute),
     children: std.ArrayListUnmanaged(*AstNode),
     is_self_closing: bool,
+    static_attributes: ?[]const u8 = null,
+    attribute_parts: []const AttributePart = &.{},
+
+    /// Render the literal attributes ahead of time
+    ///
+    /// Consecutive literal attributes become one string of markup
+    /// (` type="email" class="field wide" required`) that the compiler
+    /// writes as is, instead of assembling it attribute by attribute on
+    /// every render. Literal values are stored in output form already.
+    /// When every attribute is literal the markup is static_attributes;
+    /// otherwise attribute_parts alternates markup runs with the expression
+    /// attributes, which are the only ones evaluated at render time. Call
+    /// it again after changing the attributes.
+    ///
+    /// Parameters:
+    /// - allocator: Allocator for the markup (the tree's arena)
+    pub fn precomputeAttributes(self: *TagNode, allocator: std.mem.Allocator) !void {
+        self.static_attributes = null;
+        self.attribute_parts = &.{};
+        if (self.attributes.items.len == 0) return;
+
+        var parts = std.ArrayListUnmanaged(AttributePart){};
+        errdefer parts.deinit(allocator);
+        var markup = std.ArrayListUnmanaged(u8){};
+        defer markup.deinit(allocator);
+
+        for (self.attributes.items, 0..) |attr, i| {
+            if (attr.is_expression) {
+                if (markup.items.len > 0) try parts.append(allocator, .{ .markup = try markup.toOwnedSlice(allocator) });
+                try parts.append(allocator, .{ .expression = @intCast(i) });
+                continue;
+            }
+            try markup.append(allocator, ' ');
+            try markup.appendSlice(allocator, attr.name);
+            if (attr.value) |value| {
+                try markup.appendSlice(allocator, "=\"");
+                try markup.appendSlice(allocator, value);
+                try markup.append(allocator, '"');
+            }
+        }
+
+        if (parts.items.len == 0) {
+            self.static_attributes = try markup.toOwnedSlice(allocator);
+            return;
+        }
+        if (markup.items.len > 0) try parts.append(allocator, .{ .markup = try markup.toOwnedSlice(allocator) });
+        self.attribute_parts = try parts.toOwnedSlice(allocator);
+    }
+};
+
+/// Piece of a tag's attributes with both literal and expression values
+pub const AttributePart = union(enum) {
+    markup: []const u8, // Consecutive literal attributes, in output form
+    expression: u32, // Index of an expression attribute in TagNode.attributes
 };
 
 /// Plain text content node
@@ -538,10 +605,26 @@ pub const CaseNode = struct {
 };
 
 pub const WhenNode = struct {
-    values: std.ArrayListUnmanaged([]const u8),
+    values: std.ArrayListUnmanaged(WhenValue),
     body: std.ArrayListUnmanaged(*AstNode),
 };
 
+/// A literal of a when clause, and how it is compared with the case value
+///
+/// As with JavaScript's ===, a quoted literal only matches a string and a
+/// numeric one only matches a number (`when 1` matches 1.0 but not "1").
+/// Other literals (true, null, names) match the case value's text.
+pub const WhenValue = struct {
+    text: []const u8, // As written; strings without their quotes
+    kind: Kind,
+
+    pub const Kind = enum {
+        string,
+        number,
+        text,
+    };
+};
+
 // ============================================================================
 // Visitor Pattern
 // ============================================================================
@@ -633,7 +716,7 @@ pub fn printAst(node: *AstNode, indent: usize) void {
         std.debug.print("  ", .{});
     }
 
-    std.debug.print("{s} (line {d})\n", .{ @tagName(node.type), node.line });
+    std.debug.print("{s} (line {d})\n", .{ @tagName(node.data), node.line });
 
     switch (node.data) {
         .Document => |*doc| {
@@ -843,8 +926,8 @@ test "ast - create document node" {
         std.testing.allocator.destroy(doc_node);
     }
 
-    try std.testing.expectEqual(NodeType.Document, doc_node.type);
-    try std.testing.expectEqual(@as(usize, 1), doc_node.line);
+    try std.testing.expectEqual(NodeType.Document, doc_node.nodeType());
+    try std.testing.expectEqual(@as(u32, 1), doc_node.line);
 }
 
 test "ast - create tag node" {
@@ -865,7 +948,7 @@ test "ast - create tag node" {
         std.testing.allocator.destroy(tag_node);
     }
 
-    try std.testing.expectEqual(NodeType.Tag, tag_node.type);
+    try std.testing.expectEqual(NodeType.Tag, tag_node.nodeType());
     try std.testing.expectEqualStrings("div", tag_node.data.Tag.name);
 }
 
@@ -885,7 +968,7 @@ test "ast - create text node" {
         std.testing.allocator.destroy(text_node);
     }
 
-    try std.testing.expectEqual(NodeType.Text, text_node.type);
+    try std.testing.expectEqual(NodeType.Text, text_node.nodeType());
     try std.testing.expectEqualStrings("Hello World", text_node.data.Text.content);
 }
 
@@ -924,3 +1007,13 @@ test "ast - visitor pattern" {
     try visitor.visit(doc_node);
     try std.testing.expectEqual(@as(usize, 1), ctx.count);
 }
+
+test "ast - node layout" {
+    // Two u32 positions on top of the payload, no separate type field
+    try std.testing.expectEqual(@sizeOf(NodeData) + 8, @sizeOf(AstNode));
+
+    const node = try AstNode.text(std.testing.allocator, std.math.maxInt(u64), 3, "x");
+    defer std.testing.allocator.destroy(node);
+    try std.testing.expectEqual(@as(u32, std.math.maxInt(u32)), node.line);
+    try std.testing.expectEqual(@as(u32, 3), node.column);
+}
@@ -0,0 +1,392 @@
+//! Bench module - Performance harness for `zig build bench`
+//!
+//! Runs every template of bench/corpus through each pipeline phase
+//! separately, so a regression can be traced to the phase that caused it:
+//!
+//! - tokenize: Tokenizer only (MB/s of template source)
+//! - parse: Tokenizer + Parser (MB/s of source, ns per AST node)
+//! - compile: AST → HTML on a warm runtime, includes and layouts from an
+//!   AST cache (renders/s, ns per AST node)
+//! - render: read-to-HTML cost of a cold CLI run: parse + compile with
+//!   includes parsed again (renders/s, MB/s of HTML)
+//!
+//! Each phase runs `--warmup` untimed iterations, then `--iterations`
+//! timed ones; min, median and mean are reported and throughput is derived
+//! from the median. A table goes to stderr; `--json <file>` (or `-` for
+//! stdout) writes machine-readable results for tracking across versions.
+//!
+//! Usage:
+//! ```
+//! zig build bench
+//! zig build bench -- --iterations 200 --warmup 20 --json bench.json
+//! zig build bench -- --filter each
+//! ```
+//!
+//! Must run from the repository root (the build step does this), since
+//! corpus paths are relative to it.
+
+const std = @import("std");
+const tokenizer = @import("tokenizer.zig");
+const parser = @import("parser.zig");
+const compiler = @import("compiler.zig");
+const runtime = @import("runtime.zig");
+const ast = @import("ast.zig");
+const cache = @import("cache.zig");
+const serve = @import("serve.zig");
+
+/// Benchmarked templates (paths relative to the repository root)
+const corpus = [_]Case{
+    .{ .name = "deep-nesting", .path = "bench/corpus/deep-nesting.zpug" },
+    .{ .name = "big-each", .path = "bench/corpus/big-each.zpug" },
+    .{ .name = "mixins", .path = "bench/corpus/mixins.zpug" },
+    .{ .name = "includes-extends", .path = "bench/corpus/includes-extends.zpug" },
+    .{ .name = "forms", .path = "bench/corpus/forms.zpug" },
+};
+
+/// Rows in the `rows` dataset used by big-each (items gets a tenth)
+const dataset_rows = 1000;
+
+const Case = struct {
+    name: []const u8,
+    path: []const u8,
+};
+
+const Phase = enum { tokenize, parse, compile, render };
+
+const Options = struct {
+    iterations: usize = 100,
+    warmup: usize = 10,
+    json_path: ?[]const u8 = null,
+    filter: ?[]const u8 = null,
+};
+
+/// Timing summary of one phase, in nanoseconds
+const Stats = struct {
+    min_ns: u64,
+    median_ns: u64,
+    mean_ns: u64,
+};
+
+/// Results of one corpus template
+const CaseResult = struct {
+    case: Case,
+    source_bytes: usize,
+    html_bytes: usize,
+    nodes: usize,
+    phases: [4]Stats, // Indexed by Phase
+};
+
+/// Everything a phase needs to run one iteration
+const Run = struct {
+    allocator: std.mem.Allocator,
+    case: Case,
+    source: []const u8,
+    tree: *ast.AstNode,
+    js_runtime: *runtime.JsRuntime,
+    ast_cache: *cache.AstCache,
+
+    fn tokenize(self: *const Run) !void {
+        var tok = try tokenizer.Tokenizer.init(self.allocator, self.source);
+        defer tok.deinit();
+        while ((try tok.next()).type != .Eof) {}
+    }
+
+    fn parse(self: *const Run) !void {
+        var pars = try parser.Parser.init(self.allocator, self.source);
+        defer pars.deinit();
+        _ = try pars.parse();
+    }
+
+    fn compile(self: *const Run) !void {
+        const html = try self.compileTree(self.tree, self.ast_cache);
+        self.allocator.free(html);
+    }
+
+    fn render(self: *const Run) !void {
+        var pars = try parser.Parser.init(self.allocator, self.source);
+        defer pars.deinit();
+        const html = try self.compileTree(try pars.parse(), null);
+        self.allocator.free(html);
+    }
+
+    fn compileTree(self: *const Run, tree: *ast.AstNode, ast_cache: ?*cache.AstCache) ![]const u8 {
+        var comp = try compiler.Compiler.init(self.allocator, self.js_runtime);
+        defer comp.deinit();
+        comp.setBasePath(self.case.path);
+        if (ast_cache) |ast_c| comp.setAstCache(ast_c);
+        return try comp.compile(tree);
+    }
+};
+
+pub fn main() !void {
+    const allocator = std.heap.c_allocator;
+
+    const options = try parseArguments(allocator);
+
+    var js_runtime = try runtime.JsRuntime.init(allocator);
+    defer js_runtime.deinit();
+    try setDataset(allocator, js_runtime);
+
+    var results = std.ArrayList(CaseResult){};
+    defer results.deinit(allocator);
+
+    const samples = try allocator.alloc(u64, options.iterations);
+    defer allocator.free(samples);
+
+    std.debug.print("{s:<18} {s:<9} {s:>12} {s:>12} {s:>14}\n", .{ "template", "phase", "median", "min", "throughput" });
+
+    for (corpus) |case| {
+        if (options.filter) |filter| {
+            if (std.mem.indexOf(u8, case.name, filter) == null) continue;
+        }
+        try results.append(allocator, try benchCase(allocator, case, js_runtime, &options, samples));
+    }
+
+    if (options.json_path) |path| {
+        var out = std.ArrayList(u8){};
+        defer out.deinit(allocator);
+        try writeJson(out.writer(allocator), &options, results.items);
+
+        if (std.mem.eql(u8, path, "-")) {
+            try std.fs.File.stdout().writeAll(out.items);
+        } else {
+            try std.fs.cwd().writeFile(.{ .sub_path = path, .data = out.items });
+            std.debug.print("\nResults written to {s}\n", .{path});
+        }
+    }
+}
+
+fn benchCase(
+    allocator: std.mem.Allocator,
+    case: Case,
+    js_runtime: *runtime.JsRuntime,
+    options: *const Options,
+    samples: []u64,
+) !CaseResult {
+    const source = std.fs.cwd().readFileAlloc(allocator, case.path, 10 * 1024 * 1024) catch |err| {
+        std.debug.print("Error: Cannot read '{s}' (run from the repository root): {}\n", .{ case.path, err });
+        return err;
+    };
+    defer allocator.free(source);
+
+    var pars = try parser.Parser.init(allocator, source);
+    defer pars.deinit();
+    const tree = try pars.parse();
+
+    var ast_cache = cache.AstCache.init(allocator);
+    defer ast_cache.deinit();
+
+    const run = Run{
+        .allocator = allocator,
+        .case = case,
+        .source = source,
+        .tree = tree,
+        .js_runtime = js_runtime,
+        .ast_cache = &ast_cache,
+    };
+
+    // Output size and node count, also checks the template renders
+    const html = try run.compileTree(tree, &ast_cache);
+    const html_bytes = html.len;
+    allocator.free(html);
+
+    var result = CaseResult{
+        .case = case,
+        .source_bytes = source.len,
+        .html_bytes = html_bytes,
+        .nodes = countNodes(tree),
+        .phases = undefined,
+    };
+
+    inline for (std.meta.fields(Phase)) |field| {
+        const phase: Phase = @enumFromInt(field.value);
+        const stats = try measure(&run, @field(Run, field.name), options, samples);
+        result.phases[field.value] = stats;
+        printRow(&result, phase);
+    }
+
+    return result;
+}
+
+/// Time `func` over warmup + iterations runs
+fn measure(run: *const Run, comptime func: anytype, options: *const Options, samples: []u64) !Stats {
+    for (0..options.warmup) |_| try func(run);
+
+    var timer = try std.time.Timer.start();
+    for (samples) |*sample| {
+        timer.reset();
+        try func(run);
+        sample.* = timer.read();
+    }
+
+    std.mem.sort(u64, samples, {}, std.sort.asc(u64));
+
+    var total: u64 = 0;
+    for (samples) |sample| total += sample;
+
+    return .{
+        .min_ns = samples[0],
+        .median_ns = samples[samples.len / 2],
+        .mean_ns = total / samples.len,
+    };
+}
+
+// ============================================================================
+// Derived metrics
+// ============================================================================
+
+fn mbPerSecond(bytes: usize, ns: u64) f64 {
+    if (ns == 0) return 0;
+    return @as(f64, @floatFromInt(bytes)) / @as(f64, @floatFromInt(ns)) * 1e9 / (1024 * 1024);
+}
+
+fn perSecond(ns: u64) f64 {
+    if (ns == 0) return 0;
+    return 1e9 / @as(f64, @floatFromInt(ns));
+}
+
+fn nsPerNode(ns: u64, nodes: usize) f64 {
+    if (nodes == 0) return 0;
+    return @as(f64, @floatFromInt(ns)) / @as(f64, @floatFromInt(nodes));
+}
+
+fn printRow(result: *const CaseResult, phase: Phase) void {
+    const stats = result.phases[@intFromEnum(phase)];
+    const median_us = @as(f64, @floatFromInt(stats.median_ns)) / 1000;
+    const min_us = @as(f64, @floatFromInt(stats.min_ns)) / 1000;
+
+    std.debug.print("{s:<18} {s:<9} {d:>10.1}us {d:>10.1}us ", .{ result.case.name, @tagName(phase), median_us, min_us });
+    switch (phase) {
+        .tokenize, .parse => std.debug.print("{d:>9.1} MB/s\n", .{mbPerSecond(result.source_bytes, stats.median_ns)}),
+        .compile, .render => std.debug.print("{d:>7.0} renders/s\n", .{perSecond(stats.median_ns)}),
+    }
+}
+
+fn countNodes(tree: *ast.AstNode) usize {
+    const Counter = struct {
+        count: usize = 0,
+
+        fn visitNode(context: *anyopaque, _: *ast.AstNode) anyerror!void {
+            const self: *@This() = @ptrCast(@alignCast(context));
+            self.count += 1;
+        }
+    };
+
+    var counter = Counter{};
+    var visitor = ast.Visitor{ .context = &counter, .visitFn = Counter.visitNode };
+    visitor.visit(tree) catch {};
+    return counter.count;
+}
+
+// ============================================================================
+// Dataset and arguments
+// ============================================================================
+
+/// Variables used by the corpus templates
+fn setDataset(allocator: std.mem.Allocator, js_runtime: *runtime.JsRuntime) !void {
+    var json = std.ArrayList(u8){};
+    defer json.deinit(allocator);
+    const w = json.writer(allocator);
+
+    try w.writeAll("{\"title\":\"zig-pug bench\",\"year\":2025,\"rows\":[");
+    for (0..dataset_rows) |i| {
+        if (i > 0) try w.writeByte(',');
+        try w.print("{{\"id\":{d},\"name\":\"Product {d}\",\"price\":{d}.99,\"url\":\"/products/{d}\"}}", .{ i, i, i % 100, i });
+    }
+    try w.writeAll("],\"items\":[");
+    for (0..dataset_rows / 10) |i| {
+        if (i > 0) try w.writeByte(',');
+        try w.print("\"Item {d}\"", .{i});
+    }
+    try w.writeAll("]}");
+
+    try js_runtime.setVariablesFromJson(json.items);
+}
+
+fn parseArguments(allocator: std.mem.Allocator) !Options {
+    var options = Options{};
+
+    var args = try std.process.argsWithAllocator(allocator);
+    defer args.deinit();
+    _ = args.skip();
+
+    while (args.next()) |arg| {
+        if (std.mem.eql(u8, arg, "--iterations")) {
+            options.iterations = try parseCount(args.next(), arg);
+            if (options.iterations == 0) options.iterations = 1;
+        } else if (std.mem.eql(u8, arg, "--warmup")) {
+            options.warmup = try parseCount(args.next(), arg);
+        } else if (std.mem.eql(u8, arg, "--json")) {
+            options.json_path = try allocator.dupe(u8, args.next() orelse usage());
+        } else if (std.mem.eql(u8, arg, "--filter")) {
+            options.filter = try allocator.dupe(u8, args.next() orelse usage());
+        } else {
+            usage();
+        }
+    }
+
+    return options;
+}
+
+fn parseCount(value: ?[]const u8, option: []const u8) !usize {
+    const text = value orelse usage();
+    return std.fmt.parseInt(usize, text, 10) catch {
+        std.debug.print("Error: Invalid {s} value '{s}'\n", .{ option, text });
+        std.process.exit(3);
+    };
+}
+
+fn usage() noreturn {
+    std.debug.print(
+        \\Usage: zig build bench -- [OPTIONS]
+        \\
+        \\  --iterations <n>   Timed iterations per phase (default 100)
+        \\  --warmup <n>       Untimed iterations before timing (default 10)
+        \\  --json <file>      Write results as JSON (- for stdout)
+        \\  --filter <text>    Only templates whose name contains text
+        \\
+    , .{});
+    std.process.exit(3);
+}
+
+// ============================================================================
+// JSON output
+// ============================================================================
+
+fn writeJson(w: anytype, options: *const Options, results: []const CaseResult) !void {
+    try w.print("{{\"iterations\":{d},\"warmup\":{d},\"results\":[", .{ options.iterations, options.warmup });
+
+    for (results, 0..) |result, i| {
+        if (i > 0) try w.writeByte(',');
+        try w.writeAll("{\"template\":");
+        try serve.writeJsonString(w, result.case.name);
+        try w.print(",\"source_bytes\":{d},\"html_bytes\":{d},\"nodes\":{d},\"phases\":{{", .{
+            result.source_bytes,
+            result.html_bytes,
+            result.nodes,
+        });
+
+        inline for (std.meta.fields(Phase), 0..) |field, j| {
+            const stats = result.phases[field.value];
+            const phase: Phase = @enumFromInt(field.value);
+            const bytes = switch (phase) {
+                .tokenize, .parse => result.source_bytes,
+                .compile, .render => result.html_bytes,
+            };
+
+            if (j > 0) try w.writeByte(',');
+            try w.print("\"{s}\":{{\"min_ns\":{d},\"median_ns\":{d},\"mean_ns\":{d}," ++
+                "\"mb_per_s\":{d:.3},\"per_s\":{d:.1},\"ns_per_node\":{d:.1}}}", .{
+                field.name,
+                stats.min_ns,
+                stats.median_ns,
+                stats.mean_ns,
+                mbPerSecond(bytes, stats.median_ns),
+                perSecond(stats.median_ns),
+                nsPerNode(stats.median_ns, result.nodes),
+            });
+        }
+        try w.writeAll("}}");
+    }
+    try w.writeAll("]}\n");
+}
@@ -9,6 +9,7 @@
 //! - Source hash validation to detect template changes
 //! - Cache statistics (hits, misses, hit rate)
 //! - Per-entry invalidation
+//! - AstCache: parsed templates kept in memory for incremental rebuilds
 //!
 //! Example:
 //! ```zig
@@ -31,6 +32,12 @@
 //! ```
 
 const std = @import("std");
+const ast = @import("ast.zig");
+const Parser = @import("parser.zig").Parser;
+const optimizer = @import("optimizer.zig");
+
+/// Maximum size of a template file read by AstCache
+const max_template_size = 10 * 1024 * 1024;
 
 /// Template Cache - Stores compiled HTML for reuse
 ///
@@ -269,6 +276,150 @@ pub const TemplateCache = struct {
     };
 };
 
+/// AST Cache - Keeps parsed templates in memory
+///
+/// Stores the source and parsed AST of each template file, keyed by its
+/// normalized path, so repeated compilations (watch mode, partials shared
+/// by many pages) skip reading and parsing unchanged files.
+///
+/// By default entries are never revalidated: callers that learn about file
+/// changes (e.g. the CLI watcher) call invalidate() for them. Long-lived
+/// users without change notifications (e.g. `zpug --serve`) set
+/// `revalidate` so each load() compares the file's mtime and size first.
+///
+/// Thread-safety: Not thread-safe. Caller must synchronize access.
+///
+/// Example:
+/// ```zig
+/// var ast_cache = AstCache.init(allocator);
+/// defer ast_cache.deinit();
+///
+/// const tmpl = try ast_cache.load("views/header.zpug"); // read + parse
+/// _ = try ast_cache.load("views/header.zpug"); // cached
+/// ast_cache.invalidate("views/header.zpug"); // file changed on disk
+/// ```
+pub const AstCache = struct {
+    allocator: std.mem.Allocator,
+    entries: std.StringHashMap(*ParsedTemplate),
+    hits: usize,
+    misses: usize,
+    revalidate: bool = false, // stat() files on load and reload changed ones
+    defines: ?[]const optimizer.Define = null, // Optimize templates once when parsed (null = as parsed)
+
+    const Self = @This();
+
+    /// A template file with its parsed AST
+    ///
+    /// The parser owns the arena holding the AST nodes, and the nodes
+    /// reference the source, so all three live as long as the entry.
+    pub const ParsedTemplate = struct {
+        source: []const u8,
+        source_hash: u64,
+        mtime: i128,
+        parser: Parser,
+        root: *ast.AstNode,
+    };
+
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return .{
+            .allocator = allocator,
+            .entries = std.StringHashMap(*ParsedTemplate).init(allocator),
+            .hits = 0,
+            .misses = 0,
+        };
+    }
+
+    /// Free all cached templates and their ASTs
+    pub fn deinit(self: *Self) void {
+        var it = self.entries.iterator();
+        while (it.next()) |entry| {
+            self.allocator.free(entry.key_ptr.*);
+            self.destroyTemplate(entry.value_ptr.*);
+        }
+        self.entries.deinit();
+    }
+
+    /// Get the parsed template for a path, reading and parsing it on a miss
+    ///
+    /// Parameters:
+    /// - path: Template file path (normalized before lookup)
+    ///
+    /// Returns: Cached template (owned by the cache)
+    ///
+    /// Errors:
+    /// - TemplateReadFailed: File missing or unreadable
+    /// - TemplateParseFailed: File has syntax errors
+    /// - OutOfMemory
+    pub fn load(self: *Self, path: []const u8) !*ParsedTemplate {
+        const key = try std.fs.path.resolve(self.allocator, &.{path});
+
+        if (self.entries.get(key)) |tmpl| {
+            if (!self.revalidate or isUnchanged(key, tmpl)) {
+                self.allocator.free(key);
+                self.hits += 1;
+                return tmpl;
+            }
+            // Changed on disk: drop the stale entry and parse again
+            const old = self.entries.fetchRemove(key).?;
+            self.allocator.free(old.key);
+            self.destroyTemplate(old.value);
+        }
+        errdefer self.allocator.free(key);
+        self.misses += 1;
+
+        const file = std.fs.cwd().openFile(key, .{}) catch return error.TemplateReadFailed;
+        defer file.close();
+
+        const stat = file.stat() catch return error.TemplateReadFailed;
+        const source = file.readToEndAlloc(self.allocator, max_template_size) catch {
+            return error.TemplateReadFailed;
+        };
+        errdefer self.allocator.free(source);
+
+        const tmpl = try self.allocator.create(ParsedTemplate);
+        errdefer self.allocator.destroy(tmpl);
+
+        tmpl.* = .{
+            .source = source,
+            .source_hash = hashSource(source),
+            .mtime = stat.mtime,
+            .parser = Parser.init(self.allocator, source) catch return error.TemplateParseFailed,
+            .root = undefined,
+        };
+        errdefer tmpl.parser.deinit();
+
+        tmpl.root = tmpl.parser.parse() catch return error.TemplateParseFailed;
+        if (self.defines) |defines| _ = try optimizer.optimize(tmpl.parser.arena.allocator(), tmpl.root, defines);
+
+        try self.entries.put(key, tmpl);
+        return tmpl;
+    }
+
+    /// Drop the cached AST for a path so the next load() re-reads it
+    ///
+    /// Safe to call with paths that are not cached (no-op).
+    pub fn invalidate(self: *Self, path: []const u8) void {
+        const key = std.fs.path.resolve(self.allocator, &.{path}) catch return;
+        defer self.allocator.free(key);
+
+        if (self.entries.fetchRemove(key)) |old| {
+            self.allocator.free(old.key);
+            self.destroyTemplate(old.value);
+        }
+    }
+
+    fn isUnchanged(path: []const u8, tmpl: *const ParsedTemplate) bool {
+        const stat = std.fs.cwd().statFile(path) catch return false;
+        return stat.mtime == tmpl.mtime and stat.size == tmpl.source.len;
+    }
+
+    fn destroyTemplate(self: *Self, tmpl: *ParsedTemplate) void {
+        tmpl.parser.deinit();
+        self.allocator.free(tmpl.source);
+        self.allocator.destroy(tmpl);
+    }
+};
+
 /// Compute hash of template source for cache validation
 ///
 /// Uses Wyhash algorithm for fast, high-quality hashing.
@@ -353,3 +504,30 @@ test "cache - stats" {
     try std.testing.expectEqual(@as(usize, 2), s.hits);
     try std.testing.expectEqual(@as(usize, 1), s.misses);
 }
+
+test "cache - ast cache load and invalidate" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    try tmp.dir.writeFile(.{ .sub_path = "page.zpug", .data = "p Hello" });
+
+    const dir_path = try tmp.dir.realpathAlloc(std.testing.allocator, ".");
+    defer std.testing.allocator.free(dir_path);
+    const path = try std.fs.path.join(std.testing.allocator, &.{ dir_path, "page.zpug" });
+    defer std.testing.allocator.free(path);
+
+    var ast_cache = AstCache.init(std.testing.allocator);
+    defer ast_cache.deinit();
+
+    const first = try ast_cache.load(path);
+    const second = try ast_cache.load(path);
+    try std.testing.expect(first == second);
+    try std.testing.expectEqual(@as(usize, 1), ast_cache.hits);
+    try std.testing.expectEqual(@as(usize, 1), ast_cache.misses);
+
+    ast_cache.invalidate(path);
+    _ = try ast_cache.load(path);
+    try std.testing.expectEqual(@as(usize, 2), ast_cache.misses);
+
+    try std.testing.expectError(error.TemplateReadFailed, ast_cache.load("missing.zpug"));
+}
@@ -1,7 +1,20 @@
 const std = @import("std");
+const builtin = @import("builtin");
 const parser = @import("parser.zig");
 const compiler = @import("compiler.zig");
+const ast = @import("ast.zig");
 const runtime = @import("runtime.zig");
+const cache = @import("cache.zig");
+const watcher = @import("watcher.zig");
+const serve = @import("serve.zig");
+const diagnostics = @import("diagnostics.zig");
+const manifest = @import("manifest.zig");
+const profiling = @import("profiler.zig");
+const alloc_stats = @import("alloc_stats.zig");
+const precompiled = @import("precompiled.zig");
+const codegen = @import("codegen.zig");
+const optimizer = @import("optimizer.zig");
+const analysis = @import("analysis.zig");
 
 const VERSION = "0.3.0";
 
@@ -19,7 +32,20 @@ const CliOptions = struct {
     stdin: bool = false,
     stdout: bool = false,
     force: bool = false,
+    serve: bool = false,
+    jobs: usize = 1, // Worker threads for batch compilation (0 = one per CPU)
+    socket_path: ?[]const u8 = null,
+    each_record: ?[]const u8 = null, // JSON-lines file, one render per line
+    out_pattern: ?[]const u8 = null, // Output path with {field} placeholders
+    profile: bool = false, // Print a render profile after compiling
+    profile_folded: ?[]const u8 = null, // Write folded stacks to this file
+    alloc_stats: bool = false, // Print allocation counts per phase
+    precompile: bool = false, // Write .zpugc files instead of rendering
+    emit_zig: bool = false, // Write Zig render functions instead of rendering
+    deps: bool = false, // Print the variables templates read instead of rendering
+    defines: std.ArrayList(optimizer.Define) = .{}, // --define constants, folded into templates
     allocator: std.mem.Allocator,
+    arena: std.heap.ArenaAllocator, // Values parsed from arguments
 
     /// Modern Zig initialization with default values
     pub fn init(allocator: std.mem.Allocator) CliOptions {
@@ -27,6 +53,7 @@ const CliOptions = struct {
             .input_files = std.ArrayList([]const u8){},
             .variables = std.StringHashMap([]const u8).init(allocator),
             .allocator = allocator,
+            .arena = std.heap.ArenaAllocator.init(allocator),
             // All other fields use their default values
         };
     }
@@ -34,6 +61,8 @@ const CliOptions = struct {
     pub fn deinit(self: *CliOptions) void {
         self.input_files.deinit(self.allocator);
         self.variables.deinit();
+        self.defines.deinit(self.allocator);
+        self.arena.deinit();
     }
 };
 
@@ -55,8 +84,8 @@ fn printHelp() void {
         \\  -h, --help              Show this help message
         \\  -v, --version           Show version information
         \\  -i, --input <file>      Input .pug file (can be used multiple times)
-        \\  -o, --output <path>     Output file or directory
-        \\  -w, --watch             Watch files for changes and recompile
+        \\  -o, --output <path>     Output file or directory (required for directory inputs)
+        \\  -w, --watch             Watch files and their includes, recompile on change (Linux)
         \\  -p, --pretty            Pretty-print with comments (development mode)
         \\  -F, --format            Pretty-print without comments (readable mode)
         \\  -m, --minify            Minify HTML output (production mode)
@@ -65,10 +94,22 @@ fn printHelp() void {
         \\  -s, --silent            Suppress all output except errors
         \\  -V, --verbose           Verbose output with compilation details
         \\  -f, --force             Overwrite output files without asking
+        \\  -j, --jobs <n>          Compile files on n threads (0 = one per CPU core)
+        \\  --serve                 Run as a render daemon (JSON lines on stdin/stdout)
+        \\  --socket <path>         Serve requests on a Unix domain socket (implies --serve)
+        \\  --each-record <file>    Render the template once per line of a JSON-lines file
+        \\  --out-pattern <path>    Output path per record, e.g. 'out/{id}.html' ({#} = line number)
+        \\  --profile               Print the slowest template nodes and expressions after compiling
+        \\  --profile-folded <file> Write folded stacks for flamegraph tools (implies --profile)
+        \\  --alloc-stats           Print allocation counts, bytes and peak per phase
+        \\  --precompile            Write parsed templates as .zpugc files (rendered without parsing)
+        \\  --emit-zig              Write each template as a Zig render function (see ZIG-PACKAGE.md)
+        \\  --deps                  Print the variables each template and its includes read
         \\
         \\VARIABLES:
         \\  --var <key>=<value>     Set template variable (can be used multiple times)
         \\  --vars <file.json>      Load variables from JSON file
+        \\  --define <name>=<value> Constant folded into templates before rendering (also set as a variable)
         \\
         \\EXAMPLES:
         \\  # Compile single file to stdout
@@ -80,6 +121,12 @@ fn printHelp() void {
         \\  # Compile multiple files to directory
         \\  zpug -i *.pug -o dist/
         \\
+        \\  # Build a directory, re-rendering only templates that changed
+        \\  zpug src/ -o dist/
+        \\
+        \\  # Compile many files on all CPU cores
+        \\  zpug -j 0 pages/*.pug -o dist/
+        \\
         \\  # Compile with variables
         \\  zpug template.pug --var name=Alice --var age=25
         \\
@@ -107,6 +154,26 @@ fn printHelp() void {
         \\  # Compile with verbose output
         \\  zpug -V template.pug -o output.html
         \\
+        \\  # Render one page per record of a JSON-lines file on 8 threads
+        \\  zpug email.pug --each-record users.jsonl --out-pattern 'out/{id}.html' -j 8
+        \\
+        \\  # Find the slow parts of a template and draw a flamegraph
+        \\  zpug --profile --profile-folded page.folded page.pug -o page.html
+        \\  flamegraph.pl page.folded > page.svg
+        \\
+        \\  # Precompile templates, then render the precompiled file
+        \\  zpug --precompile pages/*.pug -o build/
+        \\  zpug build/index.zpugc --vars data.json -o index.html
+        \\
+        \\  # Compile a template to Zig, to build into an application
+        \\  zpug --emit-zig views/page.pug -o src/views/page.zig
+        \\
+        \\  # List the data a template needs
+        \\  zpug --deps views/page.pug
+        \\
+        \\  # Render daemon: one JSON request per line, one JSON response per line
+        \\  echo '{"template":"page.pug","data":{"title":"Hi"},"output":"page.html"}' | zpug --serve
+        \\
         \\TEMPLATE VARIABLES:
         \\  Variables can be set via:
         \\  - Command line: --var key=value
@@ -190,6 +257,19 @@ fn parseArguments(allocator: std.mem.Allocator) !CliOptions {
             };
 
             try options.variables.put(key, value);
+        } else if (std.mem.eql(u8, arg, "--define")) {
+            const define_str = args.next() orelse {
+                std.debug.print("Error: --define requires name=value\n", .{});
+                std.process.exit(3);
+            };
+            const eq = std.mem.indexOfScalar(u8, define_str, '=') orelse {
+                std.debug.print("Error: --define format is name=value\n", .{});
+                std.process.exit(3);
+            };
+            try options.defines.append(allocator, .{
+                .name = define_str[0..eq],
+                .value = try optimizer.Value.parse(options.arena.allocator(), define_str[eq + 1 ..]),
+            });
         } else if (std.mem.eql(u8, arg, "--vars")) {
             options.variables_file = args.next() orelse {
                 std.debug.print("Error: --vars requires a JSON file path\n", .{});
@@ -213,6 +293,49 @@ fn parseArguments(allocator: std.mem.Allocator) !CliOptions {
             options.verbose = true;
         } else if (std.mem.eql(u8, arg, "-f") or std.mem.eql(u8, arg, "--force")) {
             options.force = true;
+        } else if (std.mem.eql(u8, arg, "-j") or std.mem.eql(u8, arg, "--jobs")) {
+            const count = args.next() orelse {
+                std.debug.print("Error: --jobs requires a number\n", .{});
+                std.process.exit(3);
+            };
+            options.jobs = std.fmt.parseInt(usize, count, 10) catch {
+                std.debug.print("Error: Invalid --jobs value '{s}'\n", .{count});
+                std.process.exit(3);
+            };
+        } else if (std.mem.eql(u8, arg, "--serve")) {
+            options.serve = true;
+        } else if (std.mem.eql(u8, arg, "--socket")) {
+            options.socket_path = args.next() orelse {
+                std.debug.print("Error: --socket requires a path\n", .{});
+                std.process.exit(3);
+            };
+            options.serve = true;
+        } else if (std.mem.eql(u8, arg, "--each-record")) {
+            options.each_record = args.next() orelse {
+                std.debug.print("Error: --each-record requires a JSON-lines file path\n", .{});
+                std.process.exit(3);
+            };
+        } else if (std.mem.eql(u8, arg, "--out-pattern")) {
+            options.out_pattern = args.next() orelse {
+                std.debug.print("Error: --out-pattern requires a path pattern\n", .{});
+                std.process.exit(3);
+            };
+        } else if (std.mem.eql(u8, arg, "--profile")) {
+            options.profile = true;
+        } else if (std.mem.eql(u8, arg, "--profile-folded")) {
+            options.profile_folded = args.next() orelse {
+                std.debug.print("Error: --profile-folded requires a file path\n", .{});
+                std.process.exit(3);
+            };
+            options.profile = true;
+        } else if (std.mem.eql(u8, arg, "--alloc-stats")) {
+            options.alloc_stats = true;
+        } else if (std.mem.eql(u8, arg, "--precompile")) {
+            options.precompile = true;
+        } else if (std.mem.eql(u8, arg, "--emit-zig")) {
+            options.emit_zig = true;
+        } else if (std.mem.eql(u8, arg, "--deps")) {
+            options.deps = true;
         } else if (std.mem.startsWith(u8, arg, "-")) {
             std.debug.print("Error: Unknown option '{s}'\n", .{arg});
             std.debug.print("Use --help for usage information\n", .{});
@@ -226,27 +349,73 @@ fn parseArguments(allocator: std.mem.Allocator) !CliOptions {
     return options;
 }
 
-fn loadVariablesFromJson(allocator: std.mem.Allocator, filepath: []const u8, js_runtime: *runtime.JsRuntime) !void {
-    const file = try std.fs.cwd().openFile(filepath, .{});
-    defer file.close();
+fn loadVariablesFromJson(filepath: []const u8, js_runtime: *runtime.JsRuntime) !void {
+    const vars_file = try VariablesFile.open(filepath);
+    defer vars_file.close();
 
-    const content = try file.readToEndAlloc(allocator, 1024 * 1024); // Max 1MB
-    defer allocator.free(content);
+    try vars_file.apply(js_runtime);
+}
 
-    // Parse JSON and set variables
-    const parsed = std.json.parseFromSlice(std.json.Value, allocator, content, .{}) catch |err| {
-        std.debug.print("Error parsing JSON file '{s}': {}\n", .{ filepath, err });
-        return err;
-    };
-    defer parsed.deinit();
+/// A --vars file mapped into memory
+///
+/// The file is memory-mapped instead of read into a buffer and applied with
+/// JsRuntime.setVariablesFromJson, which builds the values straight from the
+/// JSON tokens: no size limit, no std.json.Value tree, one pass over the
+/// file. The same mapping can be applied to several runtimes.
+const VariablesFile = struct {
+    path: []const u8,
+    data: []const u8,
+
+    fn open(path: []const u8) !VariablesFile {
+        const file = std.fs.cwd().openFile(path, .{}) catch |err| {
+            std.debug.print("Error: Cannot open variables file '{s}': {}\n", .{ path, err });
+            return err;
+        };
+        defer file.close();
+
+        // Checked on every platform (mmap would also reject a zero length)
+        const size = try file.getEndPos();
+        if (size == 0) {
+            std.debug.print("Error: Variables file '{s}' is empty\n", .{path});
+            return error.InvalidJson;
+        }
+
+        if (comptime builtin.os.tag == .windows) {
+            const data = try file.readToEndAlloc(std.heap.page_allocator, std.math.maxInt(usize));
+            return .{ .path = path, .data = data };
+        }
+
+        const data = try std.posix.mmap(null, size, std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, file.handle, 0);
+        std.posix.madvise(data.ptr, data.len, std.posix.MADV.SEQUENTIAL) catch {};
+        return .{ .path = path, .data = data };
+    }
+
+    fn close(self: VariablesFile) void {
+        if (comptime builtin.os.tag == .windows) {
+            std.heap.page_allocator.free(self.data);
+        } else {
+            std.posix.munmap(@alignCast(self.data));
+        }
+    }
 
-    const root = parsed.value;
-    if (root != .object) {
-        std.debug.print("Error: JSON root must be an object\n", .{});
-        return error.InvalidJson;
+    /// Set every property of the file's root object on a runtime
+    fn apply(self: VariablesFile, js_runtime: *runtime.JsRuntime) !void {
+        js_runtime.setVariablesFromJson(self.data) catch |err| {
+            std.debug.print("Error: Invalid JSON in variables file '{s}' (root must be an object)\n", .{self.path});
+            return err;
+        };
     }
+};
+
+/// Set every property of a JSON object as a template variable
+///
+/// Arrays and objects are handed to the runtime as JSON text, so nested
+/// structures are preserved.
+fn setVariablesFromObject(allocator: std.mem.Allocator, obj: std.json.ObjectMap, js_runtime: *runtime.JsRuntime) !void {
+    var json_text = std.ArrayList(u8){};
+    defer json_text.deinit(allocator);
 
-    var it = root.object.iterator();
+    var it = obj.iterator();
     while (it.next()) |entry| {
         const key = entry.key_ptr.*;
         const value = entry.value_ptr.*;
@@ -256,8 +425,11 @@ fn loadVariablesFromJson(allocator: std.mem.Allocator, filepath: []const u8, js_
             .integer => |num| try js_runtime.setNumber(key, @floatFromInt(num)),
             .float => |num| try js_runtime.setNumber(key, num),
             .bool => |b| try js_runtime.setBool(key, b),
-            .array => |arr| try js_runtime.setArrayFromJson(key, arr.items),
-            .object => |obj| try js_runtime.setObjectFromJson(key, obj),
+            .array, .object => {
+                json_text.clearRetainingCapacity();
+                try serve.writeJsonValue(json_text.writer(allocator), value);
+                try js_runtime.setJson(key, json_text.items);
+            },
             else => {
                 std.debug.print("Warning: Unsupported type for variable '{s}', skipping\n", .{key});
             },
@@ -318,6 +490,42 @@ fn setVariablesFromMap(variables: std.StringHashMap([]const u8), js_runtime: *ru
     }
 }
 
+/// Bind --define constants as variables, for the expressions not folded away
+fn setDefines(options: *const CliOptions, js_runtime: *runtime.JsRuntime) !void {
+    for (options.defines.items) |define| {
+        const json = try define.value.toJson(options.allocator);
+        defer options.allocator.free(json);
+        try js_runtime.setJson(define.name, json);
+    }
+}
+
+/// Fold constants and dead branches of a template parsed by the CLI
+fn optimizeTree(pars: *parser.Parser, tree: *ast.AstNode, options: *const CliOptions) !void {
+    const stats = try optimizer.optimize(pars.arena.allocator(), tree, options.defines.items);
+    if (options.verbose and (stats.folded > 0 or stats.branches > 0)) {
+        diagnostics.print("Optimized: {d} expressions folded, {d} branches resolved\n", .{ stats.folded, stats.branches });
+    }
+}
+
+/// Errors reported by buildFile (diagnostics are printed before returning)
+const BuildError = error{
+    ReadFailed,
+    ParseFailed,
+    CompileFailed,
+    WriteFailed,
+    InvalidRecord,
+    OutOfMemory,
+};
+
+/// Exit code for a build error: 2 for file I/O, 1 for compilation errors
+fn exitCode(err: BuildError) u8 {
+    return switch (err) {
+        error.ReadFailed, error.WriteFailed => 2,
+        else => 1,
+    };
+}
+
+/// Compile a template file and exit the process on failure
 fn compileFile(
     allocator: std.mem.Allocator,
     input_path: []const u8,
@@ -325,108 +533,236 @@ fn compileFile(
     js_runtime: *runtime.JsRuntime,
     options: *const CliOptions,
 ) !void {
+    buildFile(allocator, input_path, output_path, js_runtime, options, null) catch |err| {
+        std.process.exit(exitCode(err));
+    };
+}
+
+/// Compile a template file and write the result
+///
+/// When an AST cache is given, the entry template and its includes are
+/// taken from it instead of being read and parsed again (watch mode).
+fn buildFile(
+    allocator: std.mem.Allocator,
+    input_path: []const u8,
+    output_path: ?[]const u8,
+    js_runtime: *runtime.JsRuntime,
+    options: *const CliOptions,
+    ast_cache: ?*cache.AstCache,
+) BuildError!void {
     if (options.verbose) {
-        std.debug.print("Compiling: {s}\n", .{input_path});
+        diagnostics.print("Compiling: {s}\n", .{input_path});
+    }
+
+    const compile_allocator = phaseAllocator(.compile, allocator);
+
+    // Precompiled templates skip reading the source and parsing
+    if (std.mem.endsWith(u8, input_path, precompiled.file_extension)) {
+        const tmpl = precompiled.Template.load(allocator, input_path) catch |err| {
+            diagnostics.print("Error: Cannot load precompiled template '{s}': {}\n", .{ input_path, err });
+            return if (err == error.InvalidFormat or err == error.UnsupportedVersion) error.ParseFailed else error.ReadFailed;
+        };
+        defer tmpl.deinit();
+        return renderTree(compile_allocator, tmpl.root, input_path, output_path, js_runtime, options, ast_cache);
+    }
+
+    if (ast_cache) |ast_c| {
+        const tmpl = ast_c.load(input_path) catch |err| {
+            diagnostics.print("Error: Cannot load template '{s}': {}\n", .{ input_path, err });
+            return if (err == error.TemplateParseFailed) error.ParseFailed else error.ReadFailed;
+        };
+        return renderTree(compile_allocator, tmpl.root, input_path, output_path, js_runtime, options, ast_c);
     }
 
     // Read input file
     const file = std.fs.cwd().openFile(input_path, .{}) catch |err| {
-        std.debug.print("Error: Cannot open file '{s}': {}\n", .{ input_path, err });
-        std.process.exit(2);
+        diagnostics.print("Error: Cannot open file '{s}': {}\n", .{ input_path, err });
+        return error.ReadFailed;
     };
     defer file.close();
 
     const source = file.readToEndAlloc(allocator, 10 * 1024 * 1024) catch |err| {
-        std.debug.print("Error: Cannot read file '{s}': {}\n", .{ input_path, err });
-        std.process.exit(2);
+        diagnostics.print("Error: Cannot read file '{s}': {}\n", .{ input_path, err });
+        return error.ReadFailed;
     };
     defer allocator.free(source);
 
     if (options.verbose) {
-        std.debug.print("Parsing template ({} bytes)\n", .{source.len});
+        diagnostics.print("Parsing template ({} bytes)\n", .{source.len});
     }
 
     // Parse
-    var pars = parser.Parser.init(allocator, source) catch |err| {
-        std.debug.print("Error: Parser initialization failed: {}\n", .{err});
-        std.process.exit(1);
+    var pars = parser.Parser.initWithTokenizerAllocator(
+        phaseAllocator(.parse, allocator),
+        phaseAllocator(.tokenize, allocator),
+        source,
+    ) catch |err| {
+        diagnostics.print("Error: Parser initialization failed: {}\n", .{err});
+        return error.ParseFailed;
     };
     defer pars.deinit();
 
     const tree = pars.parse() catch |err| {
-        std.debug.print("Error: Parsing failed: {}\n", .{err});
-        std.process.exit(1);
+        diagnostics.print("Error: Parsing failed: {}\n", .{err});
+        return error.ParseFailed;
     };
+    try optimizeTree(&pars, tree, options);
+
+    return renderTree(compile_allocator, tree, input_path, output_path, js_runtime, options, null);
+}
+
+/// Compile a parsed template, apply formatting and write the output
+fn renderTree(
+    allocator: std.mem.Allocator,
+    tree: *ast.AstNode,
+    input_path: []const u8,
+    output_path: ?[]const u8,
+    js_runtime: *runtime.JsRuntime,
+    options: *const CliOptions,
+    ast_cache: ?*cache.AstCache,
+) BuildError!void {
+    const final_html = try renderHtml(allocator, tree, input_path, js_runtime, options, ast_cache);
+    defer allocator.free(final_html);
+
+    if (options.verbose) {
+        diagnostics.print("Output size: {} bytes\n", .{final_html.len});
+    }
+
+    // Write output
+    if (options.stdout or output_path == null) {
+        diagnostics.writeStdout(final_html) catch return error.WriteFailed;
+    } else {
+        const out_path = output_path.?;
+
+        // Check if file exists
+        if (!options.force) {
+            if (std.fs.cwd().access(out_path, .{})) {
+                if (!options.silent) {
+                    diagnostics.print("Warning: File '{s}' already exists, overwriting\n", .{out_path});
+                }
+            } else |_| {}
+        }
+
+        const out_file = std.fs.cwd().createFile(out_path, .{}) catch |err| {
+            diagnostics.print("Error: Cannot create file '{s}': {}\n", .{ out_path, err });
+            return error.WriteFailed;
+        };
+        defer out_file.close();
+
+        out_file.writeAll(final_html) catch |err| {
+            diagnostics.print("Error: Cannot write file '{s}': {}\n", .{ out_path, err });
+            return error.WriteFailed;
+        };
 
+        if (!options.silent) {
+            diagnostics.print("✓ Compiled: {s} -> {s}\n", .{ input_path, out_path });
+        }
+    }
+}
+
+/// Compile a parsed template and apply the formatting options
+///
+/// Returns: Final HTML (caller owns memory)
+fn renderHtml(
+    allocator: std.mem.Allocator,
+    tree: *ast.AstNode,
+    base_path: ?[]const u8,
+    js_runtime: *runtime.JsRuntime,
+    options: *const CliOptions,
+    ast_cache: ?*cache.AstCache,
+) BuildError![]const u8 {
     if (options.verbose) {
-        std.debug.print("Compiling to HTML\n", .{});
+        diagnostics.print("Compiling to HTML\n", .{});
     }
 
     // Compile
     var comp = compiler.Compiler.init(allocator, js_runtime) catch |err| {
-        std.debug.print("Error: Compiler initialization failed: {}\n", .{err});
-        std.process.exit(1);
+        diagnostics.print("Error: Compiler initialization failed: {}\n", .{err});
+        return error.CompileFailed;
     };
     defer comp.deinit();
 
+    // Includes and extends resolve relative to the template's directory
+    if (base_path) |path| comp.setBasePath(path);
+    if (ast_cache) |ast_c| comp.setAstCache(ast_c);
+    comp.setDefines(options.defines.items);
+    if (active_profiler) |prof| comp.setProfiler(prof);
+
     // Include comments only in pretty mode (development)
     // Production (default/minify): strip comments for smaller output
     comp.include_comments = options.pretty;
 
     const html = comp.compile(tree) catch |err| {
-        std.debug.print("Error: Compilation failed: {}\n", .{err});
-        std.process.exit(1);
+        diagnostics.print("Error: Compilation failed: {}\n", .{err});
+        return error.CompileFailed;
     };
-    defer allocator.free(html);
 
     // Check for compilation errors (strict mode)
     if (comp.has_errors) {
-        std.debug.print("\nCompilation failed due to errors. No output generated.\n", .{});
-        std.process.exit(1);
+        allocator.free(html);
+        diagnostics.print("\nCompilation failed due to errors. No output generated.\n", .{});
+        return error.CompileFailed;
     }
 
+    if (!options.minify and !options.pretty and !options.format) return html;
+
     // Apply formatting
-    const final_html = if (options.minify)
-        try minifyHtml(allocator, html)
-    else if (options.pretty or options.format)
-        try prettyPrintHtml(allocator, html)
-    else
-        html;
+    defer allocator.free(html);
+    if (options.minify) return try minifyHtml(allocator, html);
+    return try prettyPrintHtml(allocator, html);
+}
 
-    defer if (options.minify or options.pretty or options.format) allocator.free(final_html);
+/// Profiler attached to every compiler while --profile is active
+var active_profiler: ?*profiling.Profiler = null;
 
-    if (options.verbose) {
-        std.debug.print("Output size: {} bytes\n", .{final_html.len});
-    }
+/// Sites shown in the --profile hot list
+const profile_hot_list_size = 30;
 
-    // Write output
-    if (options.stdout or output_path == null) {
-        const stdout_file = std.fs.File.stdout();
-        try stdout_file.writeAll(final_html);
-    } else {
-        const out_path = output_path.?;
+/// Print the hot list to stderr and write folded stacks if requested
+fn reportProfile(allocator: std.mem.Allocator, prof: *profiling.Profiler, options: *const CliOptions) void {
+    var report = std.ArrayList(u8){};
+    defer report.deinit(allocator);
 
-        // Check if file exists
-        if (!options.force) {
-            if (std.fs.cwd().access(out_path, .{})) {
-                if (!options.silent) {
-                    std.debug.print("Warning: File '{s}' already exists, overwriting\n", .{out_path});
-                }
-            } else |_| {}
-        }
+    prof.writeHotList(report.writer(allocator), profile_hot_list_size) catch |err| {
+        std.debug.print("Error: Cannot build profile report: {}\n", .{err});
+        return;
+    };
+    std.debug.print("\n{s}", .{report.items});
 
-        const out_file = std.fs.cwd().createFile(out_path, .{}) catch |err| {
-            std.debug.print("Error: Cannot create file '{s}': {}\n", .{ out_path, err });
-            std.process.exit(2);
-        };
-        defer out_file.close();
+    const folded_path = options.profile_folded orelse return;
+    report.clearRetainingCapacity();
+    prof.writeFolded(report.writer(allocator)) catch |err| {
+        std.debug.print("Error: Cannot build folded stacks: {}\n", .{err});
+        return;
+    };
+    std.fs.cwd().writeFile(.{ .sub_path = folded_path, .data = report.items }) catch |err| {
+        std.debug.print("Error: Cannot write '{s}': {}\n", .{ folded_path, err });
+        return;
+    };
+    if (!options.silent) {
+        std.debug.print("Folded stacks written to {s}\n", .{folded_path});
+    }
+}
 
-        try out_file.writeAll(final_html);
+/// Allocation counters used while --alloc-stats is active
+var active_alloc_stats: ?*alloc_stats.AllocStats = null;
 
-        if (!options.silent) {
-            std.debug.print("✓ Compiled: {s} -> {s}\n", .{ input_path, out_path });
-        }
-    }
+/// Allocator for a render phase: counted with --alloc-stats, else `fallback`
+fn phaseAllocator(phase: alloc_stats.Phase, fallback: std.mem.Allocator) std.mem.Allocator {
+    if (active_alloc_stats) |stats| return stats.allocator(phase);
+    return fallback;
+}
+
+/// Print the allocation table to stderr
+fn reportAllocStats(allocator: std.mem.Allocator, stats: *const alloc_stats.AllocStats) void {
+    var report = std.ArrayList(u8){};
+    defer report.deinit(allocator);
+
+    stats.writeReport(report.writer(allocator)) catch |err| {
+        std.debug.print("Error: Cannot build allocation report: {}\n", .{err});
+        return;
+    };
+    std.debug.print("\n{s}", .{report.items});
 }
 
 fn minifyHtml(allocator: std.mem.Allocator, html: []const u8) ![]const u8 {
@@ -600,20 +936,29 @@ fn prettyPrintHtml(allocator: std.mem.Allocator, html: []const u8) ![]const u8 {
     return result.toOwnedSlice(allocator);
 }
 
-fn compileFromStdin(allocator: std.mem.Allocator, js_runtime: *runtime.JsRuntime, options: *const CliOptions) !void {
+fn compileFromStdin(base_allocator: std.mem.Allocator, js_runtime: *runtime.JsRuntime, options: *const CliOptions) !void {
     const stdin_file = std.fs.File.stdin();
 
-    const source = try stdin_file.readToEndAlloc(allocator, 10 * 1024 * 1024);
-    defer allocator.free(source);
+    const source = try stdin_file.readToEndAlloc(base_allocator, 10 * 1024 * 1024);
+    defer base_allocator.free(source);
 
     // Parse
-    var pars = try parser.Parser.init(allocator, source);
+    var pars = try parser.Parser.initWithTokenizerAllocator(
+        phaseAllocator(.parse, base_allocator),
+        phaseAllocator(.tokenize, base_allocator),
+        source,
+    );
     defer pars.deinit();
     const tree = try pars.parse();
+    try optimizeTree(&pars, tree, options);
+
+    const allocator = phaseAllocator(.compile, base_allocator);
 
     // Compile
     var comp = try compiler.Compiler.init(allocator, js_runtime);
     defer comp.deinit();
+    comp.setDefines(options.defines.items);
+    if (active_profiler) |prof| comp.setProfiler(prof);
 
     // Include comments only in pretty mode (development)
     comp.include_comments = options.pretty;
@@ -651,22 +996,75 @@ pub fn main() !void {
     defer options.deinit();
 
     // Check for no input
-    if (options.input_files.items.len == 0 and !options.stdin) {
+    if (options.input_files.items.len == 0 and !options.stdin and !options.serve) {
         std.debug.print("Error: No input files specified\n", .{});
         std.debug.print("Use --help for usage information\n", .{});
         std.process.exit(3);
     }
 
+    // Precompiling and code generation only parse, no runtime needed
+    if (options.precompile or options.emit_zig) {
+        try precompileFiles(allocator, &options);
+        return;
+    }
+    if (options.deps) {
+        try printDependencies(allocator, &options);
+        return;
+    }
+
+    // Allocation statistics need their allocators in place before the
+    // runtime exists, so the JavaScript heap is counted too
+    var stats: alloc_stats.AllocStats = undefined;
+    if (options.alloc_stats) {
+        stats = alloc_stats.AllocStats.init(allocator);
+        active_alloc_stats = &stats;
+    }
+    defer active_alloc_stats = null;
+
     // Initialize JavaScript runtime
-    var js_runtime = try runtime.JsRuntime.init(allocator);
+    var js_runtime = if (active_alloc_stats) |s|
+        try runtime.JsRuntime.initWithHeap(s.allocator(.compile), s.allocator(.js_heap))
+    else
+        try runtime.JsRuntime.init(allocator);
     defer js_runtime.deinit();
 
+    // Printed before the runtime is freed, so live bytes show what it holds
+    defer {
+        if (active_alloc_stats) |s| reportAllocStats(allocator, s);
+    }
+
+    // Daemon mode sets variables per request
+    if (options.serve) {
+        try runServe(allocator, js_runtime, &options);
+        return;
+    }
+
+    // Profiling covers every compile of this run (forces a single worker)
+    var prof: profiling.Profiler = undefined;
+    if (options.profile) {
+        prof = try profiling.Profiler.init(allocator);
+        active_profiler = &prof;
+    }
+    defer {
+        if (active_profiler) |p| {
+            reportProfile(allocator, p, &options);
+            p.deinit();
+            active_profiler = null;
+        }
+    }
+
+    // Record mode binds variables per record
+    if (options.each_record) |records_path| {
+        try runRecords(allocator, js_runtime, &options, records_path);
+        return;
+    }
+
     // Load variables from JSON file
     if (options.variables_file) |vars_file| {
         if (options.verbose) {
             std.debug.print("Loading variables from: {s}\n", .{vars_file});
         }
-        try loadVariablesFromJson(allocator, vars_file, js_runtime);
+        try loadVariablesFromJson(vars_file, js_runtime);
     }
 
     // Set variables from command line
@@ -676,6 +1074,7 @@ pub fn main() !void {
         }
         try setVariablesFromMap(options.variables, js_runtime);
     }
+    try setDefines(&options, js_runtime);
 
     // Handle stdin input
     if (options.stdin) {
@@ -683,39 +1082,1167 @@ pub fn main() !void {
         return;
     }
 
-    // Determine output path for single file
-    if (options.input_files.items.len == 1 and options.output_path != null) {
-        const input_file = options.input_files.items[0];
-        const output_file = options.output_path.?;
-        try compileFile(allocator, input_file, output_file, js_runtime, &options);
+    // Determine output path for each input file
+    var jobs = std.ArrayList(Job){};
+    defer {
+        for (jobs.items) |job| {
+            if (job.owns_input) allocator.free(job.input_path);
+            if (job.owns_output) allocator.free(job.output_path.?);
+        }
+        jobs.deinit(allocator);
+    }
+
+    // Directory inputs are built incrementally using a manifest
+    var incremental = false;
+
+    for (options.input_files.items) |input_file| {
+        if (isDirectory(input_file)) {
+            const out_dir = options.output_path orelse {
+                std.debug.print("Error: Directory input '{s}' requires --output <dir>\n", .{input_file});
+                std.process.exit(3);
+            };
+            try collectTemplates(allocator, input_file, out_dir, &jobs);
+            incremental = true;
+        } else if (options.input_files.items.len == 1 and options.output_path != null) {
+            try jobs.append(allocator, .{
+                .input_path = input_file,
+                .output_path = options.output_path,
+            });
+        } else {
+            // Multiple files - output to directory or stdout
+            const output_file = if (options.output_path) |out_dir| blk: {
+                // Extract filename and change extension to .html
+                var basename = std.fs.path.basename(input_file);
+
+                // Remove .pug extension if present
+                if (std.mem.endsWith(u8, basename, ".pug")) {
+                    basename = basename[0 .. basename.len - 4];
+                }
+
+                const html_name = try std.fmt.allocPrint(allocator, "{s}/{s}.html", .{ out_dir, basename });
+                break :blk html_name;
+            } else null;
+
+            try jobs.append(allocator, .{
+                .input_path = input_file,
+                .output_path = output_file,
+                .owns_output = output_file != null,
+            });
+        }
+    }
+
+    if (options.watch) {
+        if (comptime builtin.os.tag == .linux) {
+            try watchAndRebuild(allocator, js_runtime, &options, jobs.items);
+        } else {
+            std.debug.print("Error: Watch mode requires Linux (inotify)\n", .{});
+            std.process.exit(3);
+        }
+        return;
+    }
+
+    if (incremental) {
+        try buildIncremental(allocator, js_runtime, &options, jobs.items);
+        return;
+    }
+
+    const worker_count = workerCount(&options);
+
+    if (worker_count > 1 and jobs.items.len > 1) {
+        const errors = try allocator.alloc(?BuildError, jobs.items.len);
+        defer allocator.free(errors);
+        try compileParallel(allocator, &options, jobs.items, @min(worker_count, jobs.items.len), errors);
+        if (firstError(errors)) |err| std.process.exit(exitCode(err));
         return;
     }
 
-    // Multiple files - output to directory or stdout
+    for (jobs.items) |job| {
+        try compileFile(allocator, job.input_path, job.output_path, js_runtime, &options);
+    }
+}
+
+// ============================================================================
+// Template Data (--deps)
+// ============================================================================
+
+/// Print the variables each input template reads from its data
+///
+/// The first line of a template lists everything it and the files it
+/// includes or extends read; the lines below break that down per file and
+/// per mixin:
+///
+///   views/page.pug: currency items site user
+///     views/page.pug: currency items user
+///       mixin card: title
+///     views/header.pug: site
+fn printDependencies(allocator: std.mem.Allocator, options: *const CliOptions) !void {
+    if (options.stdin) {
+        std.debug.print("Error: --deps needs input files, not --stdin\n", .{});
+        std.process.exit(3);
+    }
+
+    // Files shared by several entries are parsed once
+    var ast_cache = cache.AstCache.init(allocator);
+    defer ast_cache.deinit();
+    ast_cache.defines = options.defines.items;
+
+    var graph = watcher.DependencyGraph.init(allocator);
+    defer graph.deinit();
+
+    var text = std.ArrayList(u8){};
+    defer text.deinit(allocator);
+    const w = text.writer(allocator);
+
     for (options.input_files.items) |input_file| {
-        const output_file = if (options.output_path) |out_dir| blk: {
-            // Extract filename and change extension to .html
-            var basename = std.fs.path.basename(input_file);
+        if (isDirectory(input_file)) {
+            std.debug.print("Error: --deps does not accept directories ('{s}')\n", .{input_file});
+            std.process.exit(3);
+        }
+
+        _ = ast_cache.load(input_file) catch |err| {
+            diagnostics.print("Error: Cannot load '{s}': {}\n", .{ input_file, err });
+            std.process.exit(if (err == error.TemplateReadFailed) 2 else 1);
+        };
+        try graph.scan(input_file, &ast_cache);
+
+        const entry_path = try std.fs.path.resolve(allocator, &.{input_file});
+        defer allocator.free(entry_path);
+
+        var files = std.ArrayList([]const u8){};
+        defer files.deinit(allocator);
+        try files.append(allocator, entry_path);
+        try files.appendSlice(allocator, graph.dependencies(entry_path));
+
+        // Names point into the cached trees
+        var all = std.StringArrayHashMapUnmanaged(void){};
+        defer all.deinit(allocator);
+        var details = std.ArrayList(u8){};
+        defer details.deinit(allocator);
+        const dw = details.writer(allocator);
+
+        for (files.items) |path| {
+            const tmpl = ast_cache.load(path) catch {
+                try dw.print("  {s}: (cannot load)\n", .{path});
+                continue;
+            };
+            var deps = try analysis.dependencies(allocator, tmpl.root);
+            defer deps.deinit(allocator);
+
+            for (deps.variables) |name| try all.put(allocator, name, {});
+            try dw.print("  {s}:", .{path});
+            try writeNames(dw, deps.variables);
+            for (deps.mixins) |mixin| {
+                try dw.print("    mixin {s}:", .{mixin.name});
+                try writeNames(dw, mixin.variables);
+            }
+        }
 
-            // Remove .pug extension if present
-            if (std.mem.endsWith(u8, basename, ".pug")) {
-                basename = basename[0 .. basename.len - 4];
+        const names = try allocator.dupe([]const u8, all.keys());
+        defer allocator.free(names);
+        std.mem.sort([]const u8, names, {}, struct {
+            fn lessThan(_: void, a: []const u8, b: []const u8) bool {
+                return std.mem.lessThan(u8, a, b);
             }
+        }.lessThan);
+
+        try w.print("{s}:", .{input_file});
+        try writeNames(w, names);
+        try w.writeAll(details.items);
+    }
+
+    try std.fs.File.stdout().writeAll(text.items);
+}
+
+fn writeNames(w: anytype, names: []const []const u8) !void {
+    for (names) |name| try w.print(" {s}", .{name});
+    try w.writeByte('\n');
+}
 
-            const html_name = try std.fmt.allocPrint(allocator, "{s}/{s}.html", .{ out_dir, basename });
-            break :blk html_name;
-        } else null;
+// ============================================================================
+// Precompilation (--precompile, --emit-zig)
+// ============================================================================
 
-        defer if (output_file) |of| allocator.free(of);
+/// Write a .zpugc file (or with --emit-zig a .zig file) for each input template
+///
+/// With a single input, -o names the output file; with several it is a
+/// directory. Without -o each output is written next to its template.
+fn precompileFiles(allocator: std.mem.Allocator, options: *const CliOptions) !void {
+    const flag = if (options.emit_zig) "--emit-zig" else "--precompile";
+    const extension = if (options.emit_zig) ".zig" else precompiled.file_extension;
 
-        try compileFile(allocator, input_file, output_file, js_runtime, &options);
+    if (options.stdin) {
+        std.debug.print("Error: {s} needs input files, not --stdin\n", .{flag});
+        std.process.exit(3);
     }
 
-    if (options.watch) {
-        if (!options.silent) {
-            std.debug.print("\nWatching for file changes... (Ctrl+C to stop)\n", .{});
+    const single = options.input_files.items.len == 1;
+    for (options.input_files.items) |input_file| {
+        if (isDirectory(input_file)) {
+            std.debug.print("Error: {s} does not accept directories ('{s}')\n", .{ flag, input_file });
+            std.process.exit(3);
+        }
+
+        // Input path without its .pug/.zpug extension
+        var stem = input_file;
+        for ([_][]const u8{ ".pug", ".zpug" }) |ext| {
+            if (std.mem.endsWith(u8, stem, ext)) {
+                stem = stem[0 .. stem.len - ext.len];
+                break;
+            }
         }
-        // TODO: Implement file watching
-        std.debug.print("Watch mode not yet implemented\n", .{});
+
+        const output_file = if (single and options.output_path != null)
+            try allocator.dupe(u8, options.output_path.?)
+        else if (options.output_path) |out_dir|
+            try std.fmt.allocPrint(allocator, "{s}/{s}{s}", .{ out_dir, std.fs.path.basename(stem), extension })
+        else
+            try std.fmt.allocPrint(allocator, "{s}{s}", .{ stem, extension });
+        defer allocator.free(output_file);
+
+        precompileFile(allocator, input_file, output_file, options) catch |err| {
+            std.process.exit(exitCode(err));
+        };
+    }
+}
+
+/// Parse a template and write its precompiled form or generated Zig
+fn precompileFile(
+    allocator: std.mem.Allocator,
+    input_path: []const u8,
+    output_path: []const u8,
+    options: *const CliOptions,
+) BuildError!void {
+    const source = std.fs.cwd().readFileAlloc(allocator, input_path, 10 * 1024 * 1024) catch |err| {
+        diagnostics.print("Error: Cannot read file '{s}': {}\n", .{ input_path, err });
+        return error.ReadFailed;
+    };
+    defer allocator.free(source);
+
+    var pars = parser.Parser.init(allocator, source) catch |err| {
+        diagnostics.print("Error: Parser initialization failed: {}\n", .{err});
+        return error.ParseFailed;
+    };
+    defer pars.deinit();
+
+    const tree = pars.parse() catch |err| {
+        diagnostics.print("Error: Parsing '{s}' failed: {}\n", .{ input_path, err });
+        return error.ParseFailed;
+    };
+    try optimizeTree(&pars, tree, options);
+
+    const bytes = if (options.emit_zig)
+        codegen.generate(allocator, tree, .{ .path = input_path, .comments = options.pretty }) catch |err| {
+            diagnostics.print("Error: Cannot generate Zig for '{s}': {}\n", .{ input_path, err });
+            return if (err == error.OutOfMemory) error.OutOfMemory else error.CompileFailed;
+        }
+    else
+        precompiled.serialize(allocator, tree, source) catch |err| {
+            diagnostics.print("Error: Cannot precompile '{s}': {}\n", .{ input_path, err });
+            return if (err == error.OutOfMemory) error.OutOfMemory else error.CompileFailed;
+        };
+    defer allocator.free(bytes);
+
+    std.fs.cwd().writeFile(.{ .sub_path = output_path, .data = bytes }) catch |err| {
+        diagnostics.print("Error: Cannot write file '{s}': {}\n", .{ output_path, err });
+        return error.WriteFailed;
+    };
+
+    if (!options.silent) {
+        diagnostics.print("✓ {s}: {s} -> {s}\n", .{ if (options.emit_zig) "Generated" else "Precompiled", input_path, output_path });
+    }
+}
+
+/// Number of worker threads requested with -j (0 = one per CPU core)
+fn workerCount(options: *const CliOptions) usize {
+    if (options.profile or options.alloc_stats) return 1; // Profiler and counters are single-threaded
+    if (options.jobs == 0) return std.Thread.getCpuCount() catch 1;
+    return options.jobs;
+}
+
+fn isDirectory(path: []const u8) bool {
+    var dir = std.fs.cwd().openDir(path, .{}) catch return false;
+    dir.close();
+    return true;
+}
+
+// ============================================================================
+// Incremental Directory Builds
+// ============================================================================
+
+/// Add a job for every template under `dir_path`
+///
+/// Templates are *.pug and *.zpug files; files and directories whose name
+/// starts with `_` are partials and layouts (only included or extended),
+/// so they get no output of their own. `src/blog/post.pug` becomes
+/// `<out_dir>/blog/post.html`. Jobs are sorted by path so builds and
+/// reports are deterministic.
+fn collectTemplates(
+    allocator: std.mem.Allocator,
+    dir_path: []const u8,
+    out_dir: []const u8,
+    jobs: *std.ArrayList(Job),
+) !void {
+    var dir = std.fs.cwd().openDir(dir_path, .{ .iterate = true }) catch |err| {
+        std.debug.print("Error: Cannot open directory '{s}': {}\n", .{ dir_path, err });
+        std.process.exit(2);
+    };
+    defer dir.close();
+
+    var rel_paths = std.ArrayList([]const u8){};
+    defer {
+        for (rel_paths.items) |rel| allocator.free(rel);
+        rel_paths.deinit(allocator);
+    }
+
+    var walker = try dir.walk(allocator);
+    defer walker.deinit();
+
+    while (try walker.next()) |entry| {
+        if (entry.kind != .file) continue;
+
+        const ext = std.fs.path.extension(entry.basename);
+        if (!std.mem.eql(u8, ext, ".pug") and !std.mem.eql(u8, ext, ".zpug")) continue;
+        if (isPartialPath(entry.path)) continue;
+
+        const rel = try allocator.dupe(u8, entry.path);
+        errdefer allocator.free(rel);
+        try rel_paths.append(allocator, rel);
+    }
+
+    std.mem.sort([]const u8, rel_paths.items, {}, struct {
+        fn lessThan(_: void, a: []const u8, b: []const u8) bool {
+            return std.mem.lessThan(u8, a, b);
+        }
+    }.lessThan);
+
+    for (rel_paths.items) |rel| {
+        const input_path = try std.fs.path.join(allocator, &.{ dir_path, rel });
+        errdefer allocator.free(input_path);
+
+        const stem = rel[0 .. rel.len - std.fs.path.extension(rel).len];
+        const output_path = try std.fmt.allocPrint(allocator, "{s}/{s}.html", .{ out_dir, stem });
+        errdefer allocator.free(output_path);
+
+        try jobs.append(allocator, .{
+            .input_path = input_path,
+            .output_path = output_path,
+            .owns_input = true,
+            .owns_output = true,
+        });
+    }
+}
+
+fn isPartialPath(rel_path: []const u8) bool {
+    var it = std.mem.tokenizeScalar(u8, rel_path, std.fs.path.sep);
+    while (it.next()) |component| {
+        if (component[0] == '_') return true;
+    }
+    return false;
+}
+
+/// Build directory jobs, skipping outputs whose inputs did not change
+///
+/// The manifest in the output directory records the content hash of each
+/// template and of its include/extends dependencies, plus hashes of the
+/// --vars file and of the options that affect the output. Unchanged
+/// templates are detected by hashing files only; the rest are compiled
+/// (in parallel with -j) and recorded. --force rebuilds everything.
+fn buildIncremental(
+    allocator: std.mem.Allocator,
+    js_runtime: *runtime.JsRuntime,
+    options: *const CliOptions,
+    jobs: []const Job,
+) !void {
+    const out_dir = options.output_path.?;
+    const manifest_path = try std.fs.path.join(allocator, &.{ out_dir, manifest.file_name });
+    defer allocator.free(manifest_path);
+
+    var build_manifest = try manifest.Manifest.load(allocator, manifest_path);
+    defer build_manifest.deinit();
+    build_manifest.setInputs(variablesHash(options), try optionsHash(options));
+
+    var stale = std.ArrayList(Job){};
+    defer stale.deinit(allocator);
+    for (jobs) |job| {
+        if (options.force or !try build_manifest.isUpToDate(job.input_path, job.output_path.?)) {
+            try stale.append(allocator, job);
+        }
+    }
+
+    if (options.verbose) {
+        std.debug.print("{d} of {d} templates changed\n", .{ stale.items.len, jobs.len });
+    }
+
+    if (stale.items.len == 0) {
+        if (!options.silent) {
+            std.debug.print("✓ Up to date: {d} templates\n", .{jobs.len});
+        }
+        return;
+    }
+
+    for (stale.items) |job| {
+        if (std.fs.path.dirname(job.output_path.?)) |dir| {
+            std.fs.cwd().makePath(dir) catch |err| {
+                std.debug.print("Error: Cannot create directory '{s}': {}\n", .{ dir, err });
+                std.process.exit(2);
+            };
+        }
+    }
+
+    const errors = try allocator.alloc(?BuildError, stale.items.len);
+    defer allocator.free(errors);
+    @memset(errors, null);
+
+    // Templates parsed during the build are reused for dependency scanning
+    var ast_cache = cache.AstCache.init(allocator);
+    ast_cache.defines = options.defines.items;
+    defer ast_cache.deinit();
+
+    const worker_count = @min(workerCount(options), stale.items.len);
+    if (worker_count > 1) {
+        try compileParallel(allocator, options, stale.items, worker_count, errors);
+    } else {
+        for (stale.items, errors) |job, *err| {
+            buildFile(allocator, job.input_path, job.output_path, js_runtime, options, &ast_cache) catch |e| {
+                err.* = e;
+            };
+        }
+    }
+
+    var graph = watcher.DependencyGraph.init(allocator);
+    defer graph.deinit();
+
+    for (stale.items, errors) |job, err| {
+        if (err != null) {
+            build_manifest.remove(job.input_path);
+            continue;
+        }
+
+        try graph.scan(job.input_path, &ast_cache);
+        const key = try std.fs.path.resolve(allocator, &.{job.input_path});
+        defer allocator.free(key);
+        try build_manifest.record(job.input_path, job.output_path.?, graph.dependencies(key));
+    }
+
+    build_manifest.save(manifest_path) catch |err| {
+        std.debug.print("Warning: Cannot write manifest '{s}': {}\n", .{ manifest_path, err });
+    };
+
+    if (firstError(errors)) |err| std.process.exit(exitCode(err));
+}
+
+/// Hash of the --vars file contents (0 without one)
+fn variablesHash(options: *const CliOptions) u64 {
+    const path = options.variables_file orelse return 0;
+    const vars_file = VariablesFile.open(path) catch std.process.exit(2);
+    defer vars_file.close();
+    return cache.hashSource(vars_file.data);
+}
+
+/// Hash of the options that change the generated HTML
+///
+/// Defines are part of it: they are folded into the tree, so changing one
+/// must rebuild every output.
+fn optionsHash(options: *const CliOptions) !u64 {
+    var hasher = std.hash.Wyhash.init(0);
+    hasher.update(&[_]u8{ @intFromBool(options.pretty), @intFromBool(options.format), @intFromBool(options.minify) });
+
+    var it = options.variables.iterator();
+    while (it.next()) |entry| {
+        hasher.update(entry.key_ptr.*);
+        hasher.update("=");
+        hasher.update(entry.value_ptr.*);
+        hasher.update("\n");
+    }
+
+    for (options.defines.items) |define| {
+        const json = try define.value.toJson(options.allocator);
+        defer options.allocator.free(json);
+        hasher.update(define.name);
+        hasher.update(":");
+        hasher.update(@tagName(define.value));
+        hasher.update("=");
+        hasher.update(json);
+        hasher.update("\n");
+    }
+    return hasher.final();
+}
+
+// ============================================================================
+// Parallel Batch Compilation
+// ============================================================================
+
+/// Outcome of one job, filled in by whichever worker compiled it
+const JobResult = struct {
+    log: std.ArrayList(u8) = .{}, // Captured diagnostics
+    stdout: std.ArrayList(u8) = .{}, // Captured HTML bound for stdout
+    err: ?BuildError = null,
+};
+
+/// State shared by all batch workers
+const Batch = struct {
+    allocator: std.mem.Allocator,
+    options: *const CliOptions,
+    jobs: []const Job,
+    results: []JobResult,
+    next_job: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+};
+
+/// Compile jobs on `worker_count` threads, one JavaScript runtime each
+///
+/// Workers pull the next job index from a shared atomic counter, so fast
+/// workers keep taking files while a slow one is busy with a large page.
+/// Diagnostics and stdout output are captured per job and printed in input
+/// order after all workers finish, so reports don't depend on scheduling.
+///
+/// Parameters:
+/// - errors: Receives the outcome of each job (null = compiled)
+fn compileParallel(
+    allocator: std.mem.Allocator,
+    options: *const CliOptions,
+    jobs: []const Job,
+    worker_count: usize,
+    errors: []?BuildError,
+) !void {
+    if (options.verbose) {
+        std.debug.print("Compiling {d} files on {d} threads\n", .{ jobs.len, worker_count });
+    }
+
+    // Each worker gets its own runtime with the same variables and defines
+    var base_vars: ?VariablesFile = null;
+    defer if (base_vars) |vars| vars.close();
+    if (options.variables_file) |vars_file| {
+        base_vars = try VariablesFile.open(vars_file);
+    }
+
+    const runtimes = try allocator.alloc(*runtime.JsRuntime, worker_count);
+    defer allocator.free(runtimes);
+    var created: usize = 0;
+    defer for (runtimes[0..created]) |rt| rt.deinit();
+
+    for (runtimes) |*rt| {
+        rt.* = try runtime.JsRuntime.init(allocator);
+        created += 1;
+        if (base_vars) |vars| try vars.apply(rt.*);
+        try setVariablesFromMap(options.variables, rt.*);
+        try setDefines(options, rt.*);
+    }
+
+    const results = try allocator.alloc(JobResult, jobs.len);
+    defer {
+        for (results) |*result| {
+            result.log.deinit(allocator);
+            result.stdout.deinit(allocator);
+        }
+        allocator.free(results);
+    }
+    @memset(results, .{});
+
+    var batch = Batch{
+        .allocator = allocator,
+        .options = options,
+        .jobs = jobs,
+        .results = results,
+    };
+
+    // The calling thread works too, using the first runtime
+    const threads = try allocator.alloc(std.Thread, worker_count - 1);
+    defer allocator.free(threads);
+    var spawned: usize = 0;
+    for (threads, runtimes[1..]) |*thread, rt| {
+        thread.* = std.Thread.spawn(.{}, batchWorker, .{ &batch, rt }) catch break;
+        spawned += 1;
+    }
+    batchWorker(&batch, runtimes[0]);
+    for (threads[0..spawned]) |thread| thread.join();
+
+    // Report in input order
+    for (results, errors) |result, *err| {
+        if (result.log.items.len > 0) std.debug.print("{s}", .{result.log.items});
+        if (result.stdout.items.len > 0) try std.fs.File.stdout().writeAll(result.stdout.items);
+        err.* = result.err;
+    }
+}
+
+/// First error in input order, which decides the exit code of a batch
+fn firstError(errors: []const ?BuildError) ?BuildError {
+    for (errors) |err| {
+        if (err != null) return err;
+    }
+    return null;
+}
+
+fn batchWorker(batch: *Batch, js_runtime: *runtime.JsRuntime) void {
+    while (true) {
+        const index = batch.next_job.fetchAdd(1, .monotonic);
+        if (index >= batch.jobs.len) return;
+
+        const job = batch.jobs[index];
+        const result = &batch.results[index];
+
+        diagnostics.capture(batch.allocator, &result.log, &result.stdout);
+        defer diagnostics.release();
+
+        buildFile(batch.allocator, job.input_path, job.output_path, js_runtime, batch.options, null) catch |err| {
+            result.err = err;
+        };
+    }
+}
+
+// ============================================================================
+// Serve Mode
+// ============================================================================
+
+/// State kept across requests in --serve mode
+///
+/// Parsed templates stay in the AST cache (revalidated by mtime, since a
+/// daemon gets no change notifications) and the JavaScript runtime stays
+/// warm; only its variables are reset between requests.
+const ServeSession = struct {
+    allocator: std.mem.Allocator,
+    js_runtime: *runtime.JsRuntime,
+    options: *const CliOptions,
+    ast_cache: cache.AstCache,
+    base_vars: ?VariablesFile,
+
+    fn handle(context: *anyopaque, arena: std.mem.Allocator, request: *const serve.Request) serve.Response {
+        const self: *ServeSession = @ptrCast(@alignCast(context));
+        return self.render(arena, request) catch |err| .{ .failure = switch (err) {
+            error.CompileFailed => "compilation failed (details on stderr)",
+            error.ParseFailed => "parsing failed",
+            error.WriteFailed => "cannot write output file",
+            else => @errorName(err),
+        } };
+    }
+
+    fn render(self: *ServeSession, arena: std.mem.Allocator, request: *const serve.Request) !serve.Response {
+        // Fresh variable scope: startup variables, then this request's data
+        self.js_runtime.reset();
+        if (self.base_vars) |vars| {
+            try vars.apply(self.js_runtime);
+        }
+        try setVariablesFromMap(self.options.variables, self.js_runtime);
+        try setDefines(self.options, self.js_runtime);
+        if (request.data) |data| {
+            try setVariablesFromObject(arena, data, self.js_runtime);
+        }
+
+        const html = if (request.template) |path| blk: {
+            const tmpl = self.ast_cache.load(path) catch |err| {
+                return .{ .failure = try std.fmt.allocPrint(arena, "cannot load template '{s}': {s}", .{ path, @errorName(err) }) };
+            };
+            break :blk try renderHtml(arena, tmpl.root, path, self.js_runtime, self.options, &self.ast_cache);
+        } else blk: {
+            var pars = parser.Parser.init(arena, request.source.?) catch return error.ParseFailed;
+            defer pars.deinit();
+            const tree = pars.parse() catch return error.ParseFailed;
+            try optimizeTree(&pars, tree, self.options);
+            break :blk try renderHtml(arena, tree, null, self.js_runtime, self.options, &self.ast_cache);
+        };
+
+        const out_path = request.output orelse return .{ .html = html };
+
+        if (std.fs.path.dirname(out_path)) |dir| {
+            std.fs.cwd().makePath(dir) catch return error.WriteFailed;
+        }
+        std.fs.cwd().writeFile(.{ .sub_path = out_path, .data = html }) catch return error.WriteFailed;
+        return .{ .written = html.len };
+    }
+};
+
+/// Run the render daemon on stdio or a Unix socket until input ends
+fn runServe(allocator: std.mem.Allocator, js_runtime: *runtime.JsRuntime, options: *const CliOptions) !void {
+    var session = ServeSession{
+        .allocator = allocator,
+        .js_runtime = js_runtime,
+        .options = options,
+        .ast_cache = cache.AstCache.init(allocator),
+        .base_vars = null,
+    };
+    session.ast_cache.revalidate = true;
+    session.ast_cache.defines = options.defines.items;
+    defer session.ast_cache.deinit();
+
+    if (options.variables_file) |vars_file| {
+        session.base_vars = try VariablesFile.open(vars_file);
+    }
+    defer if (session.base_vars) |vars| vars.close();
+
+    const handler = serve.Handler{
+        .context = &session,
+        .handleFn = ServeSession.handle,
+    };
+
+    if (options.socket_path) |path| {
+        if (!options.silent) {
+            std.debug.print("zpug serving on {s}\n", .{path});
+        }
+        try serve.serveSocket(allocator, path, handler);
+    } else {
+        try serve.serveStdio(allocator, handler);
+    }
+}
+
+// ============================================================================
+// Record Mode (--each-record)
+// ============================================================================
+
+/// Records read and rendered together; bounds memory for huge inputs
+const record_chunk_size = 1024;
+
+/// One line of the --each-record file
+const Record = struct {
+    number: usize, // 1-based line number
+    json: []const u8,
+};
+
+/// Per-thread state: runtime, parsed templates and scratch memory
+const RecordWorker = struct {
+    js_runtime: *runtime.JsRuntime,
+    ast_cache: cache.AstCache,
+    arena: std.heap.ArenaAllocator,
+};
+
+/// State shared by the workers rendering one chunk of records
+const RecordBatch = struct {
+    options: *const CliOptions,
+    template_path: []const u8,
+    out_pattern: []const u8,
+    base_vars: ?VariablesFile,
+    records: []const Record,
+    results: []JobResult,
+    next_record: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+};
+
+/// Render one template for every record of a JSON-lines file
+///
+/// The template (and its includes) is parsed once per worker and kept in
+/// the worker's AST cache. Records are streamed in chunks; for each one the
+/// worker's runtime is reset, --vars/--var values are bound, then the
+/// record's fields, and the HTML is written to the --out-pattern path.
+/// With -j, each chunk is spread over the workers; messages are still
+/// printed in record order.
+fn runRecords(
+    allocator: std.mem.Allocator,
+    js_runtime: *runtime.JsRuntime,
+    options: *const CliOptions,
+    records_path: []const u8,
+) !void {
+    if (options.input_files.items.len != 1) {
+        std.debug.print("Error: --each-record requires exactly one template\n", .{});
+        std.process.exit(3);
+    }
+    const out_pattern = options.out_pattern orelse {
+        std.debug.print("Error: --each-record requires --out-pattern\n", .{});
+        std.process.exit(3);
+    };
+
+    const records_file = std.fs.cwd().openFile(records_path, .{}) catch |err| {
+        std.debug.print("Error: Cannot open file '{s}': {}\n", .{ records_path, err });
+        std.process.exit(2);
+    };
+    defer records_file.close();
+
+    var base_vars: ?VariablesFile = null;
+    defer if (base_vars) |vars| vars.close();
+    if (options.variables_file) |vars_file| {
+        base_vars = try VariablesFile.open(vars_file);
+    }
+
+    // The first worker uses the main runtime
+    const workers = try allocator.alloc(RecordWorker, @max(workerCount(options), 1));
+    defer allocator.free(workers);
+    var created: usize = 0;
+    defer {
+        for (workers[0..created], 0..) |*worker, i| {
+            worker.ast_cache.deinit();
+            worker.arena.deinit();
+            if (i > 0) worker.js_runtime.deinit();
+        }
+    }
+
+    for (workers, 0..) |*worker, i| {
+        worker.* = .{
+            .js_runtime = if (i == 0) js_runtime else try runtime.JsRuntime.init(allocator),
+            .ast_cache = cache.AstCache.init(allocator),
+            .arena = std.heap.ArenaAllocator.init(allocator),
+        };
+        worker.ast_cache.defines = options.defines.items;
+        created += 1;
+    }
+
+    var reader = serve.LineReader{ .allocator = allocator, .file = records_file };
+    defer reader.deinit();
+
+    var chunk_arena = std.heap.ArenaAllocator.init(allocator);
+    defer chunk_arena.deinit();
+
+    var records = std.ArrayList(Record){};
+    defer records.deinit(allocator);
+
+    const results = try allocator.alloc(JobResult, record_chunk_size);
+    @memset(results, .{});
+    defer {
+        for (results) |*result| {
+            result.log.deinit(allocator);
+            result.stdout.deinit(allocator);
+        }
+        allocator.free(results);
+    }
+
+    var line_number: usize = 0;
+    var rendered: usize = 0;
+    var first_error: ?BuildError = null;
+
+    while (true) {
+        _ = chunk_arena.reset(.retain_capacity);
+        records.clearRetainingCapacity();
+
+        while (records.items.len < record_chunk_size) {
+            const line = try reader.next() orelse break;
+            line_number += 1;
+            if (std.mem.trim(u8, line, " \t\r").len == 0) continue;
+            try records.append(allocator, .{
+                .number = line_number,
+                .json = try chunk_arena.allocator().dupe(u8, line),
+            });
+        }
+        if (records.items.len == 0) break;
+
+        for (results[0..records.items.len]) |*result| {
+            result.log.clearRetainingCapacity();
+            result.err = null;
+        }
+
+        var batch = RecordBatch{
+            .options = options,
+            .template_path = options.input_files.items[0],
+            .out_pattern = out_pattern,
+            .base_vars = base_vars,
+            .records = records.items,
+            .results = results[0..records.items.len],
+        };
+
+        const thread_count = @min(workers.len, records.items.len);
+        const threads = try allocator.alloc(std.Thread, thread_count - 1);
+        defer allocator.free(threads);
+        var spawned: usize = 0;
+        for (threads, workers[1..thread_count]) |*thread, *worker| {
+            thread.* = std.Thread.spawn(.{}, recordWorker, .{ allocator, &batch, worker }) catch break;
+            spawned += 1;
+        }
+        recordWorker(allocator, &batch, &workers[0]);
+        for (threads[0..spawned]) |thread| thread.join();
+
+        for (batch.results) |result| {
+            if (result.log.items.len > 0) std.debug.print("{s}", .{result.log.items});
+            if (result.err) |err| {
+                if (first_error == null) first_error = err;
+            } else {
+                rendered += 1;
+            }
+        }
+    }
+
+    if (!options.silent) {
+        std.debug.print("✓ Rendered {d} records from {s}\n", .{ rendered, records_path });
+    }
+    if (first_error) |err| std.process.exit(exitCode(err));
+}
+
+fn recordWorker(allocator: std.mem.Allocator, batch: *RecordBatch, worker: *RecordWorker) void {
+    while (true) {
+        const index = batch.next_record.fetchAdd(1, .monotonic);
+        if (index >= batch.records.len) return;
+
+        const result = &batch.results[index];
+        diagnostics.capture(allocator, &result.log, &result.stdout);
+        defer diagnostics.release();
+
+        defer _ = worker.arena.reset(.retain_capacity);
+        renderRecord(batch, worker, batch.records[index]) catch |err| {
+            result.err = err;
+        };
+    }
+}
+
+fn renderRecord(batch: *const RecordBatch, worker: *RecordWorker, record: Record) BuildError!void {
+    const arena = worker.arena.allocator();
+    const options = batch.options;
+
+    const value = std.json.parseFromSliceLeaky(std.json.Value, arena, record.json, .{}) catch {
+        diagnostics.print("Error: record {d}: invalid JSON\n", .{record.number});
+        return error.InvalidRecord;
+    };
+    if (value != .object) {
+        diagnostics.print("Error: record {d}: must be a JSON object\n", .{record.number});
+        return error.InvalidRecord;
+    }
+
+    const out_path = try expandOutPattern(arena, batch.out_pattern, value.object, record.number);
+
+    // Fresh variable scope: --vars, then --var, then the record
+    worker.js_runtime.reset();
+    bindRecordVariables(worker.js_runtime, batch.base_vars, options, record.json) catch {
+        diagnostics.print("Error: record {d}: cannot set variables\n", .{record.number});
+        return error.InvalidRecord;
+    };
+
+    const tmpl = worker.ast_cache.load(batch.template_path) catch |err| {
+        diagnostics.print("Error: Cannot load template '{s}': {}\n", .{ batch.template_path, err });
+        return if (err == error.TemplateParseFailed) error.ParseFailed else error.ReadFailed;
+    };
+
+    const html = renderHtml(arena, tmpl.root, batch.template_path, worker.js_runtime, options, &worker.ast_cache) catch |err| {
+        diagnostics.print("Error: record {d}: compilation failed\n", .{record.number});
+        return err;
+    };
+
+    if (std.fs.path.dirname(out_path)) |dir| {
+        std.fs.cwd().makePath(dir) catch |err| {
+            diagnostics.print("Error: Cannot create directory '{s}': {}\n", .{ dir, err });
+            return error.WriteFailed;
+        };
+    }
+    std.fs.cwd().writeFile(.{ .sub_path = out_path, .data = html }) catch |err| {
+        diagnostics.print("Error: Cannot write file '{s}': {}\n", .{ out_path, err });
+        return error.WriteFailed;
+    };
+
+    if (options.verbose) {
+        diagnostics.print("✓ Record {d} -> {s}\n", .{ record.number, out_path });
+    }
+}
+
+fn bindRecordVariables(
+    js_runtime: *runtime.JsRuntime,
+    base_vars: ?VariablesFile,
+    options: *const CliOptions,
+    record_json: []const u8,
+) !void {
+    if (base_vars) |vars| try vars.apply(js_runtime);
+    try setVariablesFromMap(options.variables, js_runtime);
+    try setDefines(options, js_runtime);
+    try js_runtime.setVariablesFromJson(record_json);
+}
+
+/// Build a record's output path from --out-pattern
+///
+/// `{field}` is replaced by the record's top-level field (string, number
+/// or boolean) and `{#}` by the record's line number. Path separators in
+/// field values are replaced by `_`, so a record cannot write outside the
+/// directory the pattern points to.
+fn expandOutPattern(
+    arena: std.mem.Allocator,
+    pattern: []const u8,
+    record: std.json.ObjectMap,
+    number: usize,
+) BuildError![]const u8 {
+    var out = std.ArrayList(u8){};
+    const w = out.writer(arena);
+
+    var rest = pattern;
+    while (std.mem.indexOfScalar(u8, rest, '{')) |open| {
+        const close = std.mem.indexOfScalarPos(u8, rest, open, '}') orelse break;
+        try w.writeAll(rest[0..open]);
+
+        const name = rest[open + 1 .. close];
+        rest = rest[close + 1 ..];
+
+        if (std.mem.eql(u8, name, "#")) {
+            try w.print("{d}", .{number});
+            continue;
+        }
+
+        const start = out.items.len;
+        switch (record.get(name) orelse .null) {
+            .string => |str| try w.writeAll(str),
+            .integer => |n| try w.print("{d}", .{n}),
+            .float => |n| try w.print("{d}", .{n}),
+            .number_string => |n| try w.writeAll(n),
+            .bool => |b| try w.writeAll(if (b) "true" else "false"),
+            else => {
+                diagnostics.print("Error: record {d}: no usable field '{s}' for --out-pattern\n", .{ number, name });
+                return error.InvalidRecord;
+            },
+        }
+
+        const value = out.items[start..];
+        for (value) |*c| {
+            if (c.* == '/' or c.* == '\\') c.* = '_';
+        }
+        if (value.len == 0 or std.mem.eql(u8, value, ".") or std.mem.eql(u8, value, "..")) {
+            diagnostics.print("Error: record {d}: field '{s}' is not a valid file name\n", .{ number, name });
+            return error.InvalidRecord;
+        }
+    }
+    try w.writeAll(rest);
+
+    return out.items;
+}
+
+/// One input template and where its HTML goes (null = stdout)
+const Job = struct {
+    input_path: []const u8,
+    output_path: ?[]const u8,
+    owns_input: bool = false,
+    owns_output: bool = false,
+};
+
+/// Watch mode: compile everything once, then recompile on changes
+///
+/// Parsed templates are kept in an AstCache and every entry's transitive
+/// include/extends dependencies are tracked, so a change recompiles only
+/// the entries that depend on the changed file, and only the changed files
+/// are parsed again. Editing the --vars file reloads it and rebuilds all.
+fn watchAndRebuild(
+    allocator: std.mem.Allocator,
+    js_runtime: *runtime.JsRuntime,
+    options: *const CliOptions,
+    jobs: []const Job,
+) !void {
+    // Rebuilds overwrite their own previous output without warnings
+    var watch_options = options.*;
+    watch_options.force = true;
+
+    var ast_cache = cache.AstCache.init(allocator);
+    ast_cache.defines = options.defines.items;
+    defer ast_cache.deinit();
+
+    var graph = watcher.DependencyGraph.init(allocator);
+    defer graph.deinit();
+
+    var file_watcher = watcher.Watcher.init(allocator) catch |err| {
+        std.debug.print("Error: Cannot initialize inotify: {}\n", .{err});
+        std.process.exit(2);
+    };
+    defer file_watcher.deinit();
+
+    // Normalized entry paths, used to match change notifications
+    const entry_paths = try allocator.alloc([]const u8, jobs.len);
+    var resolved: usize = 0;
+    defer {
+        for (entry_paths[0..resolved]) |path| allocator.free(path);
+        allocator.free(entry_paths);
+    }
+    for (jobs, 0..) |job, i| {
+        entry_paths[i] = try std.fs.path.resolve(allocator, &.{job.input_path});
+        resolved += 1;
+    }
+
+    const vars_path: ?[]const u8 = if (options.variables_file) |vars_file|
+        try std.fs.path.resolve(allocator, &.{vars_file})
+    else
+        null;
+    defer if (vars_path) |path| allocator.free(path);
+    if (vars_path) |path| file_watcher.watchFile(path) catch {};
+
+    // Initial build
+    for (jobs, 0..) |job, i| {
+        buildFile(allocator, job.input_path, job.output_path, js_runtime, &watch_options, &ast_cache) catch {};
+        try rescanDependencies(&graph, &file_watcher, &ast_cache, entry_paths[i]);
+    }
+
+    if (!options.silent) {
+        std.debug.print("\nWatching for file changes... (Ctrl+C to stop)\n", .{});
+    }
+
+    var changed = std.ArrayList([]const u8){};
+    defer changed.deinit(allocator);
+
+    while (true) {
+        for (changed.items) |path| allocator.free(path);
+        changed.clearRetainingCapacity();
+
+        try file_watcher.waitForChanges(&changed);
+
+        var vars_changed = false;
+        for (changed.items) |path| {
+            ast_cache.invalidate(path);
+            if (vars_path) |vp| {
+                if (std.mem.eql(u8, path, vp)) vars_changed = true;
+            }
+        }
+
+        if (vars_changed) {
+            if (options.verbose) {
+                std.debug.print("Reloading variables from: {s}\n", .{options.variables_file.?});
+            }
+            loadVariablesFromJson(options.variables_file.?, js_runtime) catch {};
+            setVariablesFromMap(options.variables, js_runtime) catch {};
+            setDefines(options, js_runtime) catch {};
+        }
+
+        var rebuilt: usize = 0;
+        for (jobs, 0..) |job, i| {
+            const affected = vars_changed or for (changed.items) |path| {
+                if (graph.dependsOn(entry_paths[i], path)) break true;
+            } else false;
+            if (!affected) continue;
+
+            buildFile(allocator, job.input_path, job.output_path, js_runtime, &watch_options, &ast_cache) catch {};
+            try rescanDependencies(&graph, &file_watcher, &ast_cache, entry_paths[i]);
+            rebuilt += 1;
+        }
+
+        if (options.verbose and rebuilt > 0) {
+            std.debug.print("Rebuilt {d} of {d} templates (AST cache: {d} hits, {d} misses)\n", .{
+                rebuilt,
+                jobs.len,
+                ast_cache.hits,
+                ast_cache.misses,
+            });
+        }
+    }
+}
+
+/// Refresh an entry's dependency set and watch any new directories
+fn rescanDependencies(
+    graph: *watcher.DependencyGraph,
+    file_watcher: *watcher.Watcher,
+    ast_cache: *cache.AstCache,
+    entry_path: []const u8,
+) !void {
+    try graph.scan(entry_path, ast_cache);
+
+    file_watcher.watchFile(entry_path) catch {};
+    for (graph.dependencies(entry_path)) |dep| {
+        // Directory may not exist yet; it is picked up on a later rescan
+        file_watcher.watchFile(dep) catch {};
+    }
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+test "cli - records do not see each other's variables" {
+    const allocator = std.testing.allocator;
+
+    var options = CliOptions.init(allocator);
+    defer options.deinit();
+
+    var pars = try parser.Parser.init(allocator,
+        \\if typeof nickname !== 'undefined'
+        \\  - var label = nickname
+        \\p= name + ':' + (typeof label === 'undefined' ? '-' : label)
+    );
+    defer pars.deinit();
+    const tree = try pars.parse();
+
+    const js_runtime = try runtime.JsRuntime.init(allocator);
+    defer js_runtime.deinit();
+
+    // Only the first record has a nickname; the second must not get it
+    const records = [_][2][]const u8{
+        .{ "{\"name\": \"ada\", \"nickname\": \"countess\"}", "<p>ada:countess</p>" },
+        .{ "{\"name\": \"alan\"}", "<p>alan:-</p>" },
+    };
+    for (records) |record| {
+        js_runtime.reset();
+        try bindRecordVariables(js_runtime, null, &options, record[0]);
+        const html = try renderHtml(allocator, tree, null, js_runtime, &options, null);
+        defer allocator.free(html);
+        try std.testing.expectEqualStrings(record[1], html);
     }
 }
@@ -0,0 +1,705 @@
+//! Code generator - Compiles a template AST to Zig source
+//!
+//! Output of `zpug --emit-zig`: a Zig file with one generic function,
+//! `render(o: *aot.Output, data: anytype) !void`, producing the same HTML
+//! as the Compiler. Runtime helpers live in aot.zig.
+//!
+//! Mapping:
+//! - Static markup (tags, literal attributes, text) is merged into as few
+//!   string literals as possible
+//! - `#{path}`, `= path`, attribute and condition paths (`user.name`)
+//!   become comptime-checked field accesses on `data`, falling back to
+//!   JavaScript when the data type has no such field
+//! - `each x in path` over a slice or array becomes a native `for`
+//! - Any other expression is evaluated through aot.Output's JsRuntime
+//! - include/extends are resolved and inlined at generation time; mixin
+//!   calls are inlined with their parameters bound in JavaScript
+//!
+//! Example:
+//! ```zig
+//! const source = try codegen.generate(allocator, tree, .{ .path = "views/page.pug" });
+//! defer allocator.free(source);
+//! try std.fs.cwd().writeFile(.{ .sub_path = "page.zig", .data = source });
+//! ```
+
+const std = @import("std");
+const ast = @import("ast.zig");
+const Parser = @import("parser.zig").Parser;
+const Compiler = @import("compiler.zig").Compiler;
+const diagnostics = @import("diagnostics.zig");
+
+/// Generation options
+pub const Options = struct {
+    path: ?[]const u8 = null, // Template file; include/extends are relative to it
+    module_name: []const u8 = "zig_pug", // Import name of the zig-pug module
+    comments: bool = false, // Keep buffered comments (like --pretty)
+};
+
+pub const GenerateError = error{
+    OutOfMemory,
+    IncludeFileNotFound,
+    IncludeParseError,
+    MixinNotFound,
+    MixinTooDeep,
+};
+
+/// Mixins nested deeper than this are assumed to recurse forever
+const max_mixin_depth = 32;
+
+/// Generate the Zig source of a template
+///
+/// Parameters:
+/// - root: Root node returned by Parser.parse()
+/// - options: Source path and output settings
+///
+/// Returns: Zig source (caller owns memory)
+pub fn generate(allocator: std.mem.Allocator, root: *ast.AstNode, options: Options) GenerateError![]u8 {
+    var gen = Generator{
+        .allocator = allocator,
+        .arena = std.heap.ArenaAllocator.init(allocator),
+        .options = options,
+        .mixins = std.StringHashMap(*ast.AstNode).init(allocator),
+        .child_blocks = std.StringHashMap(std.ArrayListUnmanaged(*ast.AstNode)).init(allocator),
+    };
+    defer gen.deinit();
+
+    gen.indent = 1;
+    try gen.node(root);
+    try gen.flush();
+
+    var out = std.ArrayList(u8){};
+    errdefer out.deinit(allocator);
+    const w = out.writer(allocator);
+
+    try w.print("//! Generated by zpug --emit-zig from {s}. Do not edit.\n\n", .{options.path orelse "<stdin>"});
+    try w.print("const std = @import(\"std\");\nconst aot = @import(\"{s}\").aot;\n\n", .{options.module_name});
+    try w.writeAll(
+        \\/// Render the template into `o`
+        \\///
+        \\/// Paths the template reads are taken from the fields of `data` when
+        \\/// its type has them; other expressions run on o.js.
+        \\pub fn render(o: *aot.Output, data: anytype) !void {
+        \\
+    );
+    if (!gen.o_used) try w.writeAll("    _ = o;\n");
+    if (!gen.data_used) try w.writeAll("    _ = data;\n");
+    try w.writeAll(gen.body.items);
+    try w.writeAll("}\n");
+
+    return out.toOwnedSlice(allocator);
+}
+
+/// A variable visible to the expressions of a loop or mixin body
+const ScopeVar = struct {
+    name: []const u8, // JavaScript name
+    native: ?[]const u8, // Zig local holding the value, null if bound in JS only
+    used: bool = false,
+};
+
+const Generator = struct {
+    allocator: std.mem.Allocator,
+    arena: std.heap.ArenaAllocator, // Generated names, included sources
+    options: Options,
+    body: std.ArrayList(u8) = .{}, // Statements of render()
+    pending: std.ArrayList(u8) = .{}, // Static markup not yet emitted
+    indent: usize = 0,
+    next_id: usize = 0,
+    scope: std.ArrayList(ScopeVar) = .{},
+    mixins: std.StringHashMap(*ast.AstNode),
+    child_blocks: std.StringHashMap(std.ArrayListUnmanaged(*ast.AstNode)),
+    parsers: std.ArrayList(*Parser) = .{}, // Trees of included files
+    mixin_depth: usize = 0,
+    o_used: bool = false,
+    data_used: bool = false,
+
+    fn deinit(self: *Generator) void {
+        for (self.parsers.items) |p| p.deinit();
+        self.parsers.deinit(self.allocator);
+        self.body.deinit(self.allocator);
+        self.pending.deinit(self.allocator);
+        self.scope.deinit(self.allocator);
+        self.mixins.deinit();
+        self.child_blocks.deinit();
+        self.arena.deinit();
+    }
+
+    // ========================================================================
+    // Emitting
+    // ========================================================================
+
+    /// Queue static markup, merged with neighbouring markup
+    fn static(self: *Generator, bytes: []const u8) !void {
+        try self.pending.appendSlice(self.allocator, bytes);
+    }
+
+    /// Emit the queued markup as a single o.text() call
+    fn flush(self: *Generator) !void {
+        if (self.pending.items.len == 0) return;
+        try self.beginLine();
+        try self.body.appendSlice(self.allocator, "try o.text(");
+        try writeString(self.body.writer(self.allocator), self.pending.items);
+        try self.body.appendSlice(self.allocator, ");\n");
+        self.pending.clearRetainingCapacity();
+        self.o_used = true;
+    }
+
+    /// Emit one statement line (after any queued markup)
+    fn line(self: *Generator, comptime fmt: []const u8, args: anytype) !void {
+        try self.flush();
+        try self.beginLine();
+        try self.body.writer(self.allocator).print(fmt ++ "\n", args);
+    }
+
+    fn beginLine(self: *Generator) !void {
+        try self.body.appendNTimes(self.allocator, ' ', self.indent * 4);
+    }
+
+    /// A fresh Zig identifier derived from a template name
+    fn local(self: *Generator, name: []const u8) ![]const u8 {
+        self.next_id += 1;
+        return std.fmt.allocPrint(self.arena.allocator(), "@\"{s}_{d}\"", .{ name, self.next_id });
+    }
+
+    /// Zig literal of a string, in the arena
+    fn quoted(self: *Generator, bytes: []const u8) ![]const u8 {
+        var out = std.ArrayList(u8){};
+        try writeString(out.writer(self.arena.allocator()), bytes);
+        return out.items;
+    }
+
+    // ========================================================================
+    // Expressions
+    // ========================================================================
+
+    /// `.{ .name = local, ... }` of the native variables in scope
+    fn scopeLiteral(self: *Generator) ![]const u8 {
+        self.data_used = true; // Every JS fallback passes data too
+        self.o_used = true;
+
+        var out = std.ArrayList(u8){};
+        const w = out.writer(self.arena.allocator());
+        try w.writeAll(".{");
+        var first = true;
+        for (self.scope.items, 0..) |*v, i| {
+            const native = v.native orelse continue;
+            // Only the innermost variable of a name is visible
+            if (self.lookupIndex(v.name) != i) continue;
+            v.used = true;
+            try w.print("{s} .@\"{s}\" = {s}", .{ if (first) "" else ",", v.name, native });
+            first = false;
+        }
+        try w.writeAll(if (first) "}" else " }");
+        return out.items;
+    }
+
+    fn lookupIndex(self: *Generator, name: []const u8) ?usize {
+        var i = self.scope.items.len;
+        while (i > 0) {
+            i -= 1;
+            if (std.mem.eql(u8, self.scope.items[i].name, name)) return i;
+        }
+        return null;
+    }
+
+    /// Native access to a simple path: the Zig value it starts from and
+    /// the rest of the path, or null when it must run in JavaScript
+    fn nativeBase(self: *Generator, path: Path) ?struct { base: []const u8, rest: []const u8 } {
+        if (self.lookupIndex(path.root)) |i| {
+            const v = &self.scope.items[i];
+            const native = v.native orelse return null;
+            v.used = true;
+            return .{ .base = native, .rest = path.rest };
+        }
+        self.data_used = true;
+        return .{ .base = "data", .rest = path.full };
+    }
+
+    /// Emit the value of an expression into the output
+    fn value(self: *Generator, expression: []const u8, escape: bool) !void {
+        const expr = std.mem.trim(u8, expression, " \t");
+        const js = try self.quoted(expr);
+        if (Path.parse(expr)) |path| {
+            if (self.nativeBase(path)) |n| {
+                if (n.rest.len == 0) {
+                    try self.line("try o.value({s}, {});", .{ n.base, escape });
+                } else {
+                    try self.line("if (comptime aot.has(@TypeOf({s}), \"{s}\")) try o.value(aot.get({s}, \"{s}\"), {}) else try o.evalJs(data, {s}, {s}, {});", .{
+                        n.base, n.rest, n.base, n.rest, escape, try self.scopeLiteral(), js, escape,
+                    });
+                }
+                self.o_used = true;
+                return;
+            }
+        }
+        try self.line("try o.evalJs(data, {s}, {s}, {});", .{ try self.scopeLiteral(), js, escape });
+    }
+
+    /// Zig bool expression for a condition
+    fn condition(self: *Generator, expression: []const u8) ![]const u8 {
+        var expr = std.mem.trim(u8, expression, " \t");
+        if (std.mem.eql(u8, expr, "true") or std.mem.eql(u8, expr, "false")) return expr;
+
+        const negate = expr.len > 1 and expr[0] == '!' and Path.parse(expr[1..]) != null;
+        if (negate) expr = expr[1..];
+        const prefix = if (negate) "!" else "";
+
+        const a = self.arena.allocator();
+        if (Path.parse(expr)) |path| {
+            if (self.nativeBase(path)) |n| {
+                if (n.rest.len == 0) return std.fmt.allocPrint(a, "{s}aot.truthy({s})", .{ prefix, n.base });
+                return std.fmt.allocPrint(a, "{s}(if (comptime aot.has(@TypeOf({s}), \"{s}\")) aot.truthy(aot.get({s}, \"{s}\")) else try o.jsTruthy(data, {s}, {s}))", .{
+                    prefix, n.base, n.rest, n.base, n.rest, try self.scopeLiteral(), try self.quoted(expr),
+                });
+            }
+        }
+        return std.fmt.allocPrint(a, "{s}(try o.jsTruthy(data, {s}, {s}))", .{ prefix, try self.scopeLiteral(), try self.quoted(expr) });
+    }
+
+    /// Zig []const u8 expression for the string form of an expression
+    fn textOf(self: *Generator, expression: []const u8) ![]const u8 {
+        const expr = std.mem.trim(u8, expression, " \t");
+        const a = self.arena.allocator();
+        if (Path.parse(expr)) |path| {
+            if (self.nativeBase(path)) |n| {
+                self.o_used = true;
+                if (n.rest.len == 0) return std.fmt.allocPrint(a, "try o.textOf({s})", .{n.base});
+                return std.fmt.allocPrint(a, "if (comptime aot.has(@TypeOf({s}), \"{s}\")) try o.textOf(aot.get({s}, \"{s}\")) else try o.jsText(data, {s}, {s})", .{
+                    n.base, n.rest, n.base, n.rest, try self.scopeLiteral(), try self.quoted(expr),
+                });
+            }
+        }
+        return std.fmt.allocPrint(a, "try o.jsText(data, {s}, {s})", .{ try self.scopeLiteral(), try self.quoted(expr) });
+    }
+
+    // ========================================================================
+    // Nodes
+    // ========================================================================
+
+    fn nodes(self: *Generator, list: []const *ast.AstNode) GenerateError!void {
+        for (list) |child| try self.node(child);
+    }
+
+    fn node(self: *Generator, n: *ast.AstNode) GenerateError!void {
+        switch (n.data) {
+            .Document => try self.document(n),
+            .Tag => try self.tag(n),
+            .Text => |text| try self.static(text.content),
+            .Interpolation => |interp| try self.value(interp.expression, !interp.is_unescaped),
+            .Code => |code| try self.code(code),
+            .Comment => |comment| {
+                if (comment.is_buffered and self.options.comments) {
+                    try self.static("<!--");
+                    try self.static(try replaceAll(self.arena.allocator(), comment.content, "--", "- -"));
+                    try self.static("-->");
+                }
+            },
+            .Conditional => try self.conditional(n),
+            .Loop => try self.loop(n),
+            .MixinDef => |mixin| try self.mixins.put(mixin.name, n),
+            .MixinCall => try self.mixinCall(n),
+            .Include => |include| {
+                const included = try self.loadFile(include.path, "include");
+                try self.node(included);
+            },
+            .Block => |*block| {
+                const body = self.child_blocks.get(block.name) orelse block.body;
+                try self.nodes(body.items);
+            },
+            .Extends => {}, // Handled by document()
+            .Case => try self.case(n),
+            .When => {}, // Handled by case()
+        }
+    }
+
+    /// Same order as Compiler.compileDocument: mixins, blocks and extends
+    /// first, then the body (or the parent's body)
+    fn document(self: *Generator, n: *ast.AstNode) GenerateError!void {
+        const doc = &n.data.Document;
+        if (doc.doctype) |doctype| {
+            try self.static("<!DOCTYPE ");
+            try self.static(doctype);
+            try self.static(">");
+        }
+
+        var extends_path: ?[]const u8 = null;
+        for (doc.children.items) |child| {
+            switch (child.data) {
+                .MixinDef => |mixin| try self.mixins.put(mixin.name, child),
+                .Extends => |ext| extends_path = ext.path,
+                .Block => |block| try self.child_blocks.put(block.name, block.body),
+                else => {},
+            }
+        }
+
+        if (extends_path) |path| {
+            try self.node(try self.loadFile(path, "extends"));
+            return;
+        }
+
+        for (doc.children.items) |child| {
+            switch (child.data) {
+                .MixinDef, .Extends, .Block => {},
+                else => try self.node(child),
+            }
+        }
+    }
+
+    fn tag(self: *Generator, n: *ast.AstNode) GenerateError!void {
+        const t = &n.data.Tag;
+        if (t.name.len == 0) return self.nodes(t.children.items);
+
+        try self.static("<");
+        try self.static(t.name);
+        for (t.attributes.items) |attr| {
+            try self.static(" ");
+            try self.static(attr.name);
+            const attr_value = attr.value orelse continue;
+            try self.static("=\"");
+            if (attr.is_expression) {
+                try self.value(attr_value, !attr.is_unescaped);
+            } else {
+                try self.static(attr_value);
+            }
+            try self.static("\"");
+        }
+        try self.static(">");
+
+        if (Compiler.isVoidElement(t.name) or t.is_self_closing) return;
+
+        try self.nodes(t.children.items);
+        try self.static("</");
+        try self.static(t.name);
+        try self.static(">");
+    }
+
+    fn code(self: *Generator, c: ast.CodeNode) GenerateError!void {
+        if (c.is_buffered) return self.value(c.code, !c.is_unescaped);
+
+        try self.line("try o.execJs(data, {s}, {s});", .{ try self.scopeLiteral(), try self.quoted(c.code) });
+
+        // `- var x = ...` declares a JavaScript variable for what follows
+        var it = std.mem.tokenizeAny(u8, c.code, " \t=;");
+        const keyword = it.next() orelse return;
+        if (std.mem.eql(u8, keyword, "var") or std.mem.eql(u8, keyword, "let") or std.mem.eql(u8, keyword, "const")) {
+            if (it.next()) |name| try self.scope.append(self.allocator, .{ .name = name, .native = null });
+        }
+    }
+
+    fn conditional(self: *Generator, n: *ast.AstNode) GenerateError!void {
+        const cond = &n.data.Conditional;
+        const test_expr = try self.condition(cond.condition);
+        if (cond.is_unless) {
+            try self.line("if (!({s})) {{", .{test_expr});
+        } else {
+            try self.line("if ({s}) {{", .{test_expr});
+        }
+        try self.block(cond.then_branch.items);
+        if (cond.else_branch) |*else_branch| {
+            try self.line("}} else {{", .{});
+            try self.block(else_branch.items);
+        }
+        try self.line("}}", .{});
+    }
+
+    /// Emit nodes one level deeper; variables they declare end with them
+    fn block(self: *Generator, list: []const *ast.AstNode) GenerateError!void {
+        const scope_len = self.scope.items.len;
+        defer self.scope.shrinkRetainingCapacity(scope_len);
+
+        self.indent += 1;
+        defer self.indent -= 1;
+        try self.nodes(list);
+        try self.flush();
+    }
+
+    fn loop(self: *Generator, n: *ast.AstNode) GenerateError!void {
+        const l = &n.data.Loop;
+        const iterable = std.mem.trim(u8, l.iterable, " \t");
+
+        if (Path.parse(iterable)) |path| {
+            if (self.nativeBase(path)) |base| {
+                const native_path = if (base.rest.len == 0) null else base.rest;
+                const list_type = if (native_path) |p|
+                    try std.fmt.allocPrint(self.arena.allocator(), "aot.PathType(@TypeOf({s}), \"{s}\")", .{ base.base, p })
+                else
+                    try std.fmt.allocPrint(self.arena.allocator(), "@TypeOf({s})", .{base.base});
+                const has = if (native_path) |p|
+                    try std.fmt.allocPrint(self.arena.allocator(), "aot.has(@TypeOf({s}), \"{s}\") and ", .{ base.base, p })
+                else
+                    "";
+
+                // Native when the data type has a slice or array there
+                try self.line("if (comptime {s}aot.isList({s})) {{", .{ has, list_type });
+                self.indent += 1;
+                try self.nativeLoop(l, base.base, native_path);
+                self.indent -= 1;
+                try self.line("}} else {{", .{});
+                self.indent += 1;
+                try self.jsLoop(l, iterable);
+                self.indent -= 1;
+                try self.line("}}", .{});
+                return;
+            }
+        }
+        try self.jsLoop(l, iterable);
+    }
+
+    fn nativeLoop(self: *Generator, l: *const ast.LoopNode, base: []const u8, path: ?[]const u8) GenerateError!void {
+        const list = try self.local("list");
+        if (path) |p| {
+            try self.line("const {s} = aot.get({s}, \"{s}\");", .{ list, base, p });
+        } else {
+            try self.line("const {s} = {s};", .{ list, base });
+        }
+
+        try self.line("if ({s}.len == 0) {{", .{list});
+        if (l.else_branch) |*else_branch| try self.block(else_branch.items);
+        try self.line("}}", .{});
+
+        const item = try self.local(l.iterator);
+        const index = if (l.index) |name| try self.local(name) else null;
+        if (index) |i| {
+            try self.line("for ({s}, 0..) |{s}, {s}| {{", .{ list, item, i });
+        } else {
+            try self.line("for ({s}) |{s}| {{", .{ list, item });
+        }
+
+        const scope_len = self.scope.items.len;
+        try self.scope.append(self.allocator, .{ .name = l.iterator, .native = item });
+        if (l.index) |name| try self.scope.append(self.allocator, .{ .name = name, .native = index });
+
+        self.indent += 1;
+        try self.nodes(l.body.items);
+        try self.flush();
+        // Captures the body never reads must still be discarded
+        for (self.scope.items[scope_len..]) |v| {
+            const native = v.native orelse continue;
+            if (!v.used) try self.line("_ = {s};", .{native});
+        }
+        self.indent -= 1;
+        self.scope.shrinkRetainingCapacity(scope_len);
+        try self.line("}}", .{});
+    }
+
+    fn jsLoop(self: *Generator, l: *const ast.LoopNode, iterable: []const u8) GenerateError!void {
+        const len = try self.local("len");
+        const iterable_js = try self.quoted(iterable);
+        try self.line("const {s} = try o.jsLength(data, {s}, {s});", .{ len, try self.scopeLiteral(), iterable_js });
+
+        try self.line("if ({s} == 0) {{", .{len});
+        if (l.else_branch) |*else_branch| try self.block(else_branch.items);
+        try self.line("}}", .{});
+
+        const i = try self.local("i");
+        try self.line("for (0..{s}) |{s}| {{", .{ len, i });
+
+        const scope_len = self.scope.items.len;
+        self.indent += 1;
+        const index_js = if (l.index) |name| try self.quoted(name) else "null";
+        try self.line("try o.jsLoopBind(data, {s}, {s}, {s}, {s}, {s});", .{ try self.scopeLiteral(), try self.quoted(l.iterator), index_js, iterable_js, i });
+        try self.scope.append(self.allocator, .{ .name = l.iterator, .native = null });
+        if (l.index) |name| try self.scope.append(self.allocator, .{ .name = name, .native = null });
+        try self.nodes(l.body.items);
+        try self.flush();
+        self.indent -= 1;
+        self.scope.shrinkRetainingCapacity(scope_len);
+        try self.line("}}", .{});
+    }
+
+    fn case(self: *Generator, n: *ast.AstNode) GenerateError!void {
+        const c = &n.data.Case;
+        if (c.cases.items.len == 0) {
+            if (c.default) |*default| try self.nodes(default.items);
+            return;
+        }
+
+        const subject = try self.local("case");
+        try self.line("{{", .{});
+        self.indent += 1;
+        try self.line("const {s} = {s};", .{ subject, try self.textOf(c.expression) });
+
+        for (c.cases.items, 0..) |when_node, i| {
+            const when = &when_node.data.When;
+            var test_expr = std.ArrayList(u8){};
+            const w = test_expr.writer(self.arena.allocator());
+            for (when.values.items, 0..) |v, j| {
+                if (j > 0) try w.writeAll(" or ");
+                try w.print("std.mem.eql(u8, {s}, ", .{subject});
+                try writeString(w, v.text);
+                try w.writeAll(")");
+            }
+            if (when.values.items.len == 0) try w.writeAll("false");
+
+            try self.line("{s}if ({s}) {{", .{ if (i == 0) "" else "} else ", test_expr.items });
+            try self.block(when.body.items);
+        }
+        if (c.default) |*default| {
+            try self.line("}} else {{", .{});
+            try self.block(default.items);
+        }
+        try self.line("}}", .{});
+
+        self.indent -= 1;
+        try self.line("}}", .{});
+    }
+
+    fn mixinCall(self: *Generator, n: *ast.AstNode) GenerateError!void {
+        const call = &n.data.MixinCall;
+        const mixin_node = self.mixins.get(call.name) orelse {
+            diagnostics.print("Mixin '{s}' not found\n", .{call.name});
+            return error.MixinNotFound;
+        };
+        const def = &mixin_node.data.MixinDef;
+
+        if (self.mixin_depth >= max_mixin_depth) {
+            diagnostics.print("Error: Mixin '{s}' nested more than {d} levels (recursive?)\n", .{ call.name, max_mixin_depth });
+            return error.MixinTooDeep;
+        }
+        self.mixin_depth += 1;
+        defer self.mixin_depth -= 1;
+
+        // Parameters are bound the way the Compiler binds them
+        const a = self.arena.allocator();
+        for (def.params.items, 0..) |param, i| {
+            const arg = if (i < call.args.items.len) call.args.items[i] else "undefined";
+            const stmt = try std.fmt.allocPrint(a, "var {s} = {s}", .{ param, arg });
+            try self.line("try o.execJs(data, {s}, {s});", .{ try self.scopeLiteral(), try self.quoted(stmt) });
+        }
+        if (def.rest_param) |rest| {
+            const start = @min(def.params.items.len, call.args.items.len);
+            const stmt = try std.fmt.allocPrint(a, "var {s} = [{s}]", .{ rest, try std.mem.join(a, ", ", call.args.items[start..]) });
+            try self.line("try o.execJs(data, {s}, {s});", .{ try self.scopeLiteral(), try self.quoted(stmt) });
+        }
+
+        const scope_len = self.scope.items.len;
+        defer self.scope.shrinkRetainingCapacity(scope_len);
+        for (def.params.items) |param| try self.scope.append(self.allocator, .{ .name = param, .native = null });
+        if (def.rest_param) |rest| try self.scope.append(self.allocator, .{ .name = rest, .native = null });
+
+        try self.nodes(def.body.items);
+    }
+
+    /// Read and parse an include/extends target, relative to the template
+    fn loadFile(self: *Generator, path: []const u8, kind: []const u8) GenerateError!*ast.AstNode {
+        const a = self.arena.allocator();
+        const full_path = if (self.options.path) |base|
+            try std.fs.path.join(a, &.{ std.fs.path.dirname(base) orelse ".", path })
+        else
+            path;
+
+        const source = std.fs.cwd().readFileAlloc(a, full_path, 1024 * 1024) catch |err| {
+            diagnostics.print("Error reading {s} file '{s}': {}\n", .{ kind, full_path, err });
+            return error.IncludeFileNotFound;
+        };
+
+        const parser = try a.create(Parser);
+        parser.* = Parser.init(self.allocator, source) catch return error.IncludeParseError;
+        try self.parsers.append(self.allocator, parser);
+
+        return parser.parse() catch |err| {
+            diagnostics.print("Error parsing {s} file '{s}': {}\n", .{ kind, full_path, err });
+            return error.IncludeParseError;
+        };
+    }
+};
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+/// A JavaScript identifier path such as `user.address.city`
+const Path = struct {
+    full: []const u8,
+    root: []const u8,
+    rest: []const u8, // After the first dot, empty for a bare identifier
+
+    const reserved = std.StaticStringMap(void).initComptime(.{
+        .{"true"},  .{"false"},  .{"null"},       .{"undefined"}, .{"this"},
+        .{"new"},   .{"typeof"}, .{"void"},       .{"delete"},    .{"in"},
+        .{"NaN"},   .{"Infinity"}, .{"instanceof"}, .{"function"},
+    });
+
+    fn parse(expr: []const u8) ?Path {
+        if (expr.len == 0) return null;
+        var it = std.mem.splitScalar(u8, expr, '.');
+        while (it.next()) |segment| {
+            if (!isIdentifier(segment) or reserved.has(segment)) return null;
+        }
+        const dot = std.mem.indexOfScalar(u8, expr, '.');
+        return .{
+            .full = expr,
+            .root = if (dot) |d| expr[0..d] else expr,
+            .rest = if (dot) |d| expr[d + 1 ..] else "",
+        };
+    }
+
+    fn isIdentifier(segment: []const u8) bool {
+        if (segment.len == 0 or std.ascii.isDigit(segment[0])) return false;
+        for (segment) |c| {
+            if (!std.ascii.isAlphanumeric(c) and c != '_' and c != '$') return false;
+        }
+        return true;
+    }
+};
+
+/// Write bytes as a Zig string literal
+fn writeString(w: anytype, bytes: []const u8) !void {
+    const utf8 = std.unicode.utf8ValidateSlice(bytes);
+    try w.writeByte('"');
+    for (bytes) |c| {
+        switch (c) {
+            '\\' => try w.writeAll("\\\\"),
+            '"' => try w.writeAll("\\\""),
+            '\n' => try w.writeAll("\\n"),
+            '\r' => try w.writeAll("\\r"),
+            '\t' => try w.writeAll("\\t"),
+            0x00...0x08, 0x0b, 0x0c, 0x0e...0x1f, 0x7f => try w.print("\\x{x:0>2}", .{c}),
+            0x80...0xff => if (utf8) try w.writeByte(c) else try w.print("\\x{x:0>2}", .{c}),
+            else => try w.writeByte(c),
+        }
+    }
+    try w.writeByte('"');
+}
+
+fn replaceAll(allocator: std.mem.Allocator, input: []const u8, needle: []const u8, replacement: []const u8) ![]const u8 {
+    if (std.mem.indexOf(u8, input, needle) == null) return input;
+    return std.mem.replaceOwned(u8, allocator, input, needle, replacement);
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+fn generateFrom(source: []const u8) ![]u8 {
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+    return generate(std.testing.allocator, try parser.parse(), .{ .path = "page.pug" });
+}
+
+test "codegen - static markup is merged" {
+    const out = try generateFrom("div.box(title=\"x\")\n  p Hello\n  br");
+    defer std.testing.allocator.free(out);
+
+    try std.testing.expect(std.mem.indexOf(u8, out, "try o.text(\"<div class=\\\"box\\\" title=\\\"x\\\"><p>Hello</p><br></div>\");") != null);
+    try std.testing.expect(std.mem.indexOf(u8, out, "_ = data;") != null);
+}
+
+test "codegen - paths are native, other expressions use JavaScript" {
+    const out = try generateFrom("p= user.name\np= items.join(', ')\nif admin\n  p Admin");
+    defer std.testing.allocator.free(out);
+
+    try std.testing.expect(std.mem.indexOf(u8, out, "aot.has(@TypeOf(data), \"user.name\")") != null);
+    try std.testing.expect(std.mem.indexOf(u8, out, "try o.evalJs(data, .{}, \"items.join(', ')\", true);") != null);
+    try std.testing.expect(std.mem.indexOf(u8, out, "aot.truthy(aot.get(data, \"admin\"))") != null);
+}
+
+test "codegen - loops over data become native for loops" {
+    const out = try generateFrom("ul\n  each item, i in items\n    li= item.label");
+    defer std.testing.allocator.free(out);
+
+    try std.testing.expect(std.mem.indexOf(u8, out, "if (comptime aot.has(@TypeOf(data), \"items\") and aot.isList(") != null);
+    try std.testing.expect(std.mem.indexOf(u8, out, "for (@\"list_1\", 0..) |@\"item_2\", @\"i_3\"| {") != null);
+    try std.testing.expect(std.mem.indexOf(u8, out, "aot.get(@\"item_2\", \"label\")") != null);
+    // The index is unused in the native body
+    try std.testing.expect(std.mem.indexOf(u8, out, "_ = @\"i_3\";") != null);
+}
@@ -35,6 +35,9 @@
 //! - Pretty-print mode with indentation
 //! - Comment inclusion control
 //! - Template caching
+//! - Optional render profiling (per node and per expression)
+//! - Loop-invariant expressions evaluated once per loop (see analysis.zig)
+//! - case/when dispatch through sorted, typed tables of the when values
 //!
 //! Output modes:
 //! - Standard: Minified HTML (no indentation, no comments)
@@ -42,9 +45,13 @@
 //! - Format: Indented HTML without comments (--format flag)
 
 const std = @import("std");
+const diagnostics = @import("diagnostics.zig");
 const ast = @import("ast.zig");
 const runtime = @import("runtime.zig");
 const cache = @import("cache.zig");
+const profiling = @import("profiler.zig");
+const optimizer = @import("optimizer.zig");
+const analysis = @import("analysis.zig");
 const Parser = @import("parser.zig").Parser;
 
 /// Errors that can occur during compilation
@@ -70,6 +77,19 @@ pub const CompilerError = error{
     ExtendsParseError,
 };
 
+/// Lookup of include/extends targets by resolved path
+///
+/// Returns the parsed tree of the template at `path` (base path directory
+/// joined with the path as written), or null if there is none.
+pub const TemplateResolver = struct {
+    context: *anyopaque,
+    resolveFn: *const fn (*anyopaque, []const u8) ?*ast.AstNode,
+
+    pub fn resolve(self: TemplateResolver, path: []const u8) ?*ast.AstNode {
+        return self.resolveFn(self.context, path);
+    }
+};
+
 /// Compiler - Generates HTML from AST
 ///
 /// Stateful code generator that walks AST and outputs HTML.
@@ -84,9 +104,19 @@ pub const CompilerError = error{
 /// - mixins: Map of mixin name → definition node
 /// - base_path: Directory path for resolving relative includes
 /// - template_cache: Optional cache for compiled includes
+/// - ast_cache: Optional cache of parsed include/extends files
+/// - resolver: Optional source of include/extends trees (no file access)
 /// - child_blocks: Blocks defined in child template (for extends)
 /// - include_comments: Whether to emit HTML comments
 /// - has_errors: Whether any errors occurred (strict mode)
+/// - profiler: Optional profiler recording node and expression timings
+/// - scratch_arenas: Arenas for short-lived allocations (render, then one per loop level)
+/// - size_hint: Expected output size, reserved before rendering
+/// - hoisted: Values of loop-invariant expressions of the loops being run
+/// - loop_invariants: Invariant expressions of each loop body (this render)
+/// - case_tables: Sorted when values of each case (this render)
+/// - mixin_purity: Which mixins render only their arguments (this render)
+/// - mixin_memo: HTML of pure mixin calls by mixin and arguments (per template, bounded)
 ///
 /// Usage:
 /// ```zig
@@ -106,12 +136,40 @@ pub const Compiler = struct {
     mixins: std.StringHashMap(*ast.AstNode), // Store mixin definitions
     base_path: ?[]const u8, // Base path for resolving includes
     template_cache: ?*cache.TemplateCache, // Optional template cache
+    ast_cache: ?*cache.AstCache, // Optional cache of parsed include/extends files
+    resolver: ?TemplateResolver, // Optional source of include/extends trees
+    defines: ?[]const optimizer.Define, // Optimize include/extends files parsed here (null = as parsed)
     child_blocks: std.StringHashMap(std.ArrayListUnmanaged(*ast.AstNode)), // Blocks from child template
     include_comments: bool, // Include HTML comments in output (true for --pretty, false for production)
     has_errors: bool, // Track if any compilation errors occurred (for strict mode)
+    profiler: ?*profiling.Profiler, // Optional render profiler (--profile)
+    scratch_arenas: std.ArrayListUnmanaged(*std.heap.ArenaAllocator), // [0] = render, [n] = loop nesting level n
+    scratch_depth: usize, // Index of the arena in use
+    size_hint: usize, // Output bytes to reserve up front (last render size by default)
+    hoisted: std.AutoHashMapUnmanaged(usize, Hoisted), // Expression address → value computed before its loop
+    hoisted_keys: std.ArrayListUnmanaged(usize), // hoisted keys in insertion order (removed as loops end)
+    loop_invariants: std.AutoHashMapUnmanaged(*const ast.AstNode, []const []const u8), // Loop node → invariant expressions
+    case_tables: std.AutoHashMapUnmanaged(*const ast.AstNode, CaseTable), // Case node → when value lookup
+    mixin_purity: std.AutoHashMapUnmanaged(*const ast.AstNode, bool), // Mixin definition → output depends only on arguments
+    mixin_memo: std.StringHashMapUnmanaged([]const u8), // Pure mixin call key → rendered HTML
+    memo_arena: std.heap.ArenaAllocator, // mixin_memo keys and values
+    memo_bytes: usize, // Size of the mixin_memo keys and values
+    memo_template: ?u64, // Template whose memo is kept across renders (null = cleared after each)
+    memo_volatile: bool, // This render parsed an include or layout it does not keep
 
     const Self = @This();
 
+    /// Most pure mixin calls remembered per template, and their total size
+    const max_memo_entries = 1024;
+    const max_memo_bytes = 1024 * 1024;
+
+    /// Value of a hoisted expression (keyed by address; length tells apart
+    /// expressions that start at the same byte)
+    const Hoisted = struct {
+        len: usize,
+        value: runtime.EvalResult,
+    };
+
     /// Initialize compiler with JavaScript runtime
     ///
     /// Parameters:
@@ -130,6 +188,7 @@ pub const Compiler = struct {
     /// ```
     pub fn init(allocator: std.mem.Allocator, js_runtime: *runtime.JsRuntime) !*Self {
         const compiler = try allocator.create(Self);
+        errdefer allocator.destroy(compiler);
         compiler.* = .{
             .allocator = allocator,
             .runtime = js_runtime,
@@ -141,8 +200,26 @@ pub const Compiler = struct {
             .mixins = std.StringHashMap(*ast.AstNode).init(allocator),
             .base_path = null,
             .template_cache = null,
+            .ast_cache = null,
+            .resolver = null,
+            .defines = null,
+            .profiler = null,
+            .scratch_arenas = .{},
+            .scratch_depth = 0,
+            .size_hint = 0,
+            .hoisted = .{},
+            .hoisted_keys = .{},
+            .loop_invariants = .{},
+            .case_tables = .{},
+            .mixin_purity = .{},
+            .mixin_memo = .{},
+            .memo_arena = std.heap.ArenaAllocator.init(allocator),
+            .memo_bytes = 0,
+            .memo_template = null,
+            .memo_volatile = false,
             .child_blocks = std.StringHashMap(std.ArrayListUnmanaged(*ast.AstNode)).init(allocator),
         };
+        try compiler.addScratchArena(); // Render-level arena
         return compiler;
     }
 
@@ -168,13 +245,138 @@ pub const Compiler = struct {
         self.template_cache = template_cache;
     }
 
+    /// Set AST cache for include and extends files
+    ///
+    /// Parsed files are taken from the cache instead of being read and
+    /// parsed on every compilation. Used by watch mode, where only the
+    /// files that changed on disk are invalidated between rebuilds.
+    ///
+    /// Parameters:
+    /// - ast_cache: Cache instance to use
+    pub fn setAstCache(self: *Self, ast_cache: *cache.AstCache) void {
+        self.ast_cache = ast_cache;
+    }
+
+    /// Resolve include and extends paths without touching the filesystem
+    ///
+    /// Takes precedence over the AST cache. Used by embedded templates,
+    /// which carry every template of the set inside the binary.
+    ///
+    /// Parameters:
+    /// - resolver: Lookup from resolved path to parsed tree
+    pub fn setResolver(self: *Self, resolver: TemplateResolver) void {
+        self.resolver = resolver;
+    }
+
+    /// Run the optimizer on include and extends files parsed by the compiler
+    ///
+    /// The entry tree is optimized by the caller (see optimizer.optimize);
+    /// this covers the files the compiler reads itself. Trees from the AST
+    /// cache are optimized by the cache (AstCache.defines).
+    ///
+    /// Parameters:
+    /// - defines: Build-time constants (may be empty)
+    pub fn setDefines(self: *Self, defines: []const optimizer.Define) void {
+        self.defines = defines;
+    }
+
+    /// Enable render profiling
+    ///
+    /// Every compiled node and evaluated expression is timed and recorded
+    /// in the profiler, attributed to its template file and line. Profiling
+    /// adds timer calls around each node, so leave it off for production.
+    ///
+    /// Parameters:
+    /// - prof: Profiler to record into (may be shared by several compiles)
+    pub fn setProfiler(self: *Self, prof: *profiling.Profiler) void {
+        self.profiler = prof;
+    }
+
+    /// Set the expected output size
+    ///
+    /// The output buffer is grown to this size before rendering, so a good
+    /// estimate (such as the last render size of the same template) avoids
+    /// every growth reallocation. After each render the hint becomes that
+    /// render's size.
+    ///
+    /// Parameters:
+    /// - bytes: Expected HTML size in bytes
+    pub fn setSizeHint(self: *Self, bytes: usize) void {
+        self.size_hint = bytes;
+    }
+
+    /// Keep the memo of pure mixin calls across renders of one template
+    ///
+    /// By default the HTML of pure mixin calls is forgotten after every
+    /// render. With an id, it is kept while later renders are given the
+    /// same id and the same tree, so repeated calls are copied from earlier
+    /// renders too, up to max_memo_entries and max_memo_bytes for the
+    /// template. Another id (or null) starts over. A render that parses an
+    /// include or layout from disk still forgets its memo, since those
+    /// trees are freed when the render ends.
+    ///
+    /// Parameters:
+    /// - id: Identifies the tree and the files it reaches (for example a
+    ///   hash of the source), or null to keep nothing
+    pub fn setTemplateId(self: *Self, id: ?u64) void {
+        const same = id != null and self.memo_template != null and id.? == self.memo_template.?;
+        if (!same) self.clearMixinMemo();
+        self.memo_template = id;
+    }
+
+    /// Clear per-render state so the compiler can be reused
+    ///
+    /// Mixins, child blocks, the output and the scratch arenas are cleared
+    /// but keep their capacity; settings (pretty, base path, caches,
+    /// profiler) are kept. Call it between templates: registered mixins
+    /// point into the previous template's AST. The mixin memo is only kept
+    /// for the template set with setTemplateId().
+    ///
+    /// Example:
+    /// ```zig
+    /// for (documents) |document| {
+    ///     compiler.reset();
+    ///     const html = try compiler.render(document);
+    ///     try out.writeAll(html);
+    /// }
+    /// ```
+    pub fn reset(self: *Self) void {
+        self.output.clearRetainingCapacity();
+        self.mixins.clearRetainingCapacity();
+        self.child_blocks.clearRetainingCapacity();
+        self.indent_level = 0;
+        self.has_errors = false;
+        self.scratch_depth = 0;
+        self.hoisted.clearRetainingCapacity();
+        self.hoisted_keys.clearRetainingCapacity();
+        self.loop_invariants.clearRetainingCapacity();
+        self.case_tables.clearRetainingCapacity();
+        self.mixin_purity.clearRetainingCapacity();
+        if (self.memo_template == null) self.clearMixinMemo();
+        for (self.scratch_arenas.items) |arena| {
+            _ = arena.reset(.retain_capacity);
+        }
+    }
+
     /// Free compiler resources
     ///
-    /// Cleans up output buffer, mixin map, and block map.
+    /// Cleans up output buffer, mixin map, block map and scratch arenas.
     pub fn deinit(self: *Self) void {
         self.output.deinit(self.allocator);
         self.mixins.deinit();
         self.child_blocks.deinit();
+        self.hoisted.deinit(self.allocator);
+        self.hoisted_keys.deinit(self.allocator);
+        self.loop_invariants.deinit(self.allocator);
+        self.case_tables.deinit(self.allocator);
+        self.mixin_purity.deinit(self.allocator);
+        self.mixin_memo.deinit(self.allocator);
+        self.memo_arena.deinit();
+        for (self.scratch_arenas.items) |arena| {
+            arena.deinit();
+            self.allocator.destroy(arena);
+        }
+        self.scratch_arenas.deinit(self.allocator);
         self.allocator.destroy(self);
     }
 
@@ -198,21 +400,95 @@ pub const Compiler = struct {
     /// This method compiles the entire AST and returns the result as an owned slice.
     /// The caller is responsible for freeing the returned memory.
     pub fn compile(self: *Self, node: *ast.AstNode) ![]const u8 {
-        try self.compileNode(node);
+        _ = try self.render(node);
         return try self.output.toOwnedSlice(self.allocator);
     }
 
+    /// Compile AST document into the compiler's own output buffer
+    ///
+    /// Like compile(), but the buffer is kept, so a reused compiler renders
+    /// without allocating output memory once it has reached its size.
+    ///
+    /// Parameters:
+    /// - node: Root AST node (usually Document)
+    ///
+    /// Returns: HTML owned by the compiler, valid until the next reset(),
+    /// render(), compile() or deinit()
+    pub fn render(self: *Self, node: *ast.AstNode) ![]const u8 {
+        const name = self.base_path orelse "<template>";
+        try self.enterFrame(.template, name, name);
+        defer self.leaveFrame();
+
+        // Everything transient from this render goes at once
+        defer _ = self.scratch_arenas.items[0].reset(.retain_capacity);
+        defer self.loop_invariants.clearRetainingCapacity(); // Allocated in scratch_arenas[0]
+        defer self.case_tables.clearRetainingCapacity(); // Also in scratch_arenas[0]
+        defer self.mixin_purity.clearRetainingCapacity(); // Keyed by node, analyzed per render
+        defer if (self.memo_template == null or self.memo_volatile) self.clearMixinMemo();
+        self.memo_volatile = false;
+
+        self.output.clearRetainingCapacity();
+        try self.output.ensureTotalCapacity(self.allocator, self.size_hint);
+
+        try self.compileNode(node);
+        self.size_hint = self.output.items.len;
+        return self.output.items;
+    }
+
+    // ========================================================================
+    // Scratch Memory
+    // ========================================================================
+
+    /// Allocator for memory that only lives while a node is being compiled
+    ///
+    /// Expression copies, eval results, escaped strings and generated
+    /// variable bindings come from an arena instead of self.allocator, so
+    /// they are never freed one by one: the render-level arena is reset
+    /// when compile() returns, and each loop level has its own arena that
+    /// is reset after every iteration.
+    fn scratch(self: *Self) std.mem.Allocator {
+        return self.scratch_arenas.items[self.scratch_depth].allocator();
+    }
+
+    /// Switch to the arena of the next loop level (created on first use)
+    fn pushScratch(self: *Self) !*std.heap.ArenaAllocator {
+        const depth = self.scratch_depth + 1;
+        if (depth == self.scratch_arenas.items.len) try self.addScratchArena();
+        self.scratch_depth = depth;
+        return self.scratch_arenas.items[depth];
+    }
+
+    fn popScratch(self: *Self) void {
+        self.scratch_depth -= 1;
+    }
+
+    fn addScratchArena(self: *Self) !void {
+        const arena = try self.allocator.create(std.heap.ArenaAllocator);
+        errdefer self.allocator.destroy(arena);
+        arena.* = std.heap.ArenaAllocator.init(self.allocator);
+        try self.scratch_arenas.append(self.allocator, arena);
+    }
+
     /// Helper to get a writer for the output buffer
     /// This allows for more efficient writing operations
     inline fn writer(self: *Self) std.ArrayList(u8).Writer {
         return self.output.writer(self.allocator);
     }
 
+    /// Compile a node, timing it when profiling is enabled
+    fn compileNode(self: *Self, node: *ast.AstNode) anyerror!void {
+        const prof = self.profiler orelse return self.dispatchNode(node);
+
+        try prof.begin();
+        defer prof.endNode(node.line, @tagName(node.data));
+        return self.dispatchNode(node);
+    }
+
     /// Dispatch compilation to appropriate function based on node type
     ///
     /// Central dispatcher that routes each AST node type to its
     /// corresponding compile function.
-    fn compileNode(self: *Self, node: *ast.AstNode) anyerror!void {
+    fn dispatchNode(self: *Self, node: *ast.AstNode) anyerror!void {
         switch (node.data) {
             .Document => try self.compileDocument(node),
             .Tag => try self.compileTag(node),
@@ -232,6 +508,70 @@ pub const Compiler = struct {
         }
     }
 
+    /// Evaluate a JavaScript expression, timing it when profiling is enabled
+    ///
+    /// Parameters:
+    /// - line: Line of the node the expression belongs to
+    /// - expression: JavaScript source to evaluate
+    ///
+    /// Returns: String result (in scratch memory)
+    fn eval(self: *Self, line: usize, expression: []const u8) ![]const u8 {
+        return (try self.evalResult(line, expression)).text;
+    }
+
+    /// Evaluate a template expression, keeping the type of its result
+    fn evalResult(self: *Self, line: usize, expression: []const u8) !runtime.EvalResult {
+        if (self.hoisted.count() > 0) {
+            if (self.hoisted.get(@intFromPtr(expression.ptr))) |h| {
+                if (h.len == expression.len) return h.value;
+            }
+        }
+        return self.evalTemplate(line, "eval", expression);
+    }
+
+    /// Evaluate an expression of the template (its compiled script is kept
+    /// by the runtime), recording it in the profiler as `kind`
+    fn evalTemplate(self: *Self, line: usize, kind: []const u8, expression: []const u8) !runtime.EvalResult {
+        const prof = self.profiler orelse return self.runtime.evalResultAlloc(self.scratch(), expression);
+
+        try prof.begin();
+        defer prof.endExpression(line, kind, expression);
+        return self.runtime.evalResultAlloc(self.scratch(), expression);
+    }
+
+    /// Evaluate an expression, recording it in the profiler under a label
+    ///
+    /// Generated statements (loop variable bindings) differ per iteration,
+    /// so they are recorded under a stable label instead, and compiled on
+    /// every use rather than kept by the runtime.
+    fn evalLabeled(self: *Self, line: usize, kind: []const u8, label: []const u8, expression: []const u8) ![]const u8 {
+        const prof = self.profiler orelse return self.runtime.evalAlloc(self.scratch(), expression);
+
+        try prof.begin();
+        defer prof.endExpression(line, kind, label);
+        return self.runtime.evalAlloc(self.scratch(), expression);
+    }
+
+    /// Bind a mixin call's arguments (profiled as one "bind" site per call)
+    fn pushFrame(self: *Self, line: usize, call: *const ast.MixinCallNode, mixin_def: *const ast.MixinDefNode) !runtime.JsRuntime.Frame {
+        if (self.profiler) |prof| try prof.begin();
+        defer if (self.profiler) |prof| prof.endExpression(line, "bind", call.name);
+
+        return self.runtime.pushFrame(self.scratch(), mixin_def.params.items, mixin_def.rest_param, call.args.items) catch |err| {
+            if (err == error.StackOverflow) diagnostics.print("Mixin '{s}' nested too deeply\n", .{call.name});
+            return err;
+        };
+    }
+
+    /// Enter a template call frame in the profiler (no-op when not profiling)
+    fn enterFrame(self: *Self, kind: profiling.FrameKind, name: []const u8, file: ?[]const u8) !void {
+        if (self.profiler) |prof| try prof.enterFrame(kind, name, file);
+    }
+
+    fn leaveFrame(self: *Self) void {
+        if (self.profiler) |prof| prof.leaveFrame();
+    }
+
     // ========================================================================
     // Document Compilation
     // ========================================================================
@@ -256,14 +596,15 @@ pub const Compiler = struct {
         // First pass: register all mixins and check for extends
         var extends_path: ?[]const u8 = null;
         for (doc.children.items) |child| {
-            if (child.type == .MixinDef) {
-                try self.registerMixin(child);
-            } else if (child.type == .Extends) {
-                extends_path = child.data.Extends.path;
-            } else if (child.type == .Block) {
-                // Collect blocks from child template
-                const block_data = &child.data.Block;
-                try self.child_blocks.put(block_data.name, block_data.body);
+            switch (child.data) {
+                .MixinDef => try self.registerMixin(child),
+                .Extends => |ext| extends_path = ext.path,
+                .Block => |*block_data| {
+                    // Collect blocks from child template
+                    try self.child_blocks.put(block_data.name, block_data.body);
+                    if (self.profiler) |prof| try prof.define(.block, block_data.name);
+                },
+                else => {},
             }
         }
 
@@ -275,8 +616,9 @@ pub const Compiler = struct {
 
         // No extends: compile everything else normally
         for (doc.children.items) |child| {
-            if (child.type != .MixinDef and child.type != .Extends and child.type != .Block) {
-                try self.compileNode(child);
+            switch (child.data) {
+                .MixinDef, .Extends, .Block => {},
+                else => try self.compileNode(child),
             }
         }
     }
@@ -299,28 +641,57 @@ pub const Compiler = struct {
         };
         defer self.allocator.free(full_path);
 
-        // Read parent file
+        try self.enterFrame(.extends, full_path, full_path);
+        defer self.leaveFrame();
+
+        if (self.resolver) |resolver| {
+            const parent = resolver.resolve(full_path) orelse {
+                diagnostics.print("Error: extends file '{s}' is not a known template\n", .{full_path});
+                return error.ExtendsFileNotFound;
+            };
+            try self.compileNode(parent);
+            return;
+        }
+
+        // Reuse the parsed parent from the AST cache when available
+        if (self.ast_cache) |ast_cache| {
+            const parent = ast_cache.load(full_path) catch |err| {
+                diagnostics.print("Error loading extends file '{s}': {}\n", .{ full_path, err });
+                return switch (err) {
+                    error.TemplateParseFailed => error.ExtendsParseError,
+                    error.OutOfMemory => error.OutOfMemory,
+                    else => error.ExtendsFileNotFound,
+                };
+            };
+            try self.compileNode(parent.root);
+            return;
+        }
+
+        // Read parent file (its tree is freed below, so its mixins can't be
+        // remembered past this render)
+        self.memo_volatile = true;
         const file_content = std.fs.cwd().readFileAlloc(
             self.allocator,
             full_path,
             1024 * 1024, // 1MB max
         ) catch |err| {
-            std.debug.print("Error reading extends file '{s}': {}\n", .{ full_path, err });
+            diagnostics.print("Error reading extends file '{s}': {}\n", .{ full_path, err });
             return error.ExtendsFileNotFound;
         };
         defer self.allocator.free(file_content);
 
         // Parse parent template
         var parser = Parser.init(self.allocator, file_content) catch |err| {
-            std.debug.print("Error parsing extends file '{s}': {}\n", .{ full_path, err });
+            diagnostics.print("Error parsing extends file '{s}': {}\n", .{ full_path, err });
             return error.ExtendsParseError;
         };
         defer parser.deinit();
 
         const parent_ast = parser.parse() catch |err| {
-            std.debug.print("Error parsing extends file '{s}': {}\n", .{ full_path, err });
+            diagnostics.print("Error parsing extends file '{s}': {}\n", .{ full_path, err });
             return error.ExtendsParseError;
         };
+        if (self.defines) |defines| _ = try optimizer.optimize(parser.arena.allocator(), parent_ast, defines);
 
         // Compile parent template (blocks will be substituted via child_blocks)
         try self.compileNode(parent_ast);
@@ -335,12 +706,19 @@ pub const Compiler = struct {
 
         // Check if child template has overridden this block
         if (self.child_blocks.get(block.name)) |child_body| {
-            // Render child block content
+            // Render child block content (attributed to the child template)
+            const file = if (self.profiler) |prof| prof.definitionFile(.block, block.name) else null;
+            try self.enterFrame(.block, block.name, file);
+            defer self.leaveFrame();
+
             for (child_body.items) |child| {
                 try self.compileNode(child);
             }
         } else {
             // Render default block content
+            try self.enterFrame(.block, block.name, null);
+            defer self.leaveFrame();
+
             for (block.body.items) |child| {
                 try self.compileNode(child);
             }
@@ -373,9 +751,18 @@ pub const Compiler = struct {
         // Opening tag - use print for better performance
         try w.print("<{s}", .{tag.name});
 
-        // Attributes
-        if (tag.attributes.items.len > 0) {
-            try self.compileAttributes(&tag.attributes);
+        // Attributes (literal ones prerendered by the parser)
+        if (tag.static_attributes) |markup| {
+            try w.writeAll(markup);
+        } else if (tag.attribute_parts.len > 0) {
+            for (tag.attribute_parts) |part| {
+                switch (part) {
+                    .markup => |markup| try w.writeAll(markup),
+                    .expression => |index| try self.compileAttribute(node.line, tag.attributes.items[index]),
+                }
+            }
+        } else {
+            for (tag.attributes.items) |attr| try self.compileAttribute(node.line, attr);
         }
 
         try w.writeByte('>');
@@ -395,45 +782,39 @@ pub const Compiler = struct {
         try w.print("</{s}>", .{tag.name});
     }
 
-    fn compileAttributes(self: *Self, attributes: *const std.ArrayListUnmanaged(ast.Attribute)) !void {
+    fn compileAttribute(self: *Self, line: usize, attr: ast.Attribute) !void {
         const w = self.writer();
 
-        for (attributes.items) |attr| {
-            // Use print for better performance
-            try w.print(" {s}", .{attr.name});
-
-            if (attr.value) |value| {
-                try w.writeAll("=\"");
-
-                // Evaluate expression if needed
-                if (attr.is_expression) {
-                    const result = self.runtime.eval(value) catch |err| {
-                        self.has_errors = true;
-                        std.debug.print("Error: Failed to evaluate attribute expression\n", .{});
-                        std.debug.print("  Attribute: {s}={s}\n", .{ attr.name, value });
-                        std.debug.print("  Error: {}\n", .{err});
-                        std.debug.print("  Hint: Make sure the variable '{s}' is defined\n", .{value});
-                        // Skip attribute on error (strict mode)
-                        try w.writeByte('"');
-                        continue;
-                    };
-                    defer self.allocator.free(result);
-
-                    // Escape the result if not unescaped
-                    if (attr.is_unescaped) {
-                        try w.writeAll(result);
-                    } else {
-                        const escaped = try self.escapeHtml(result);
-                        defer self.allocator.free(escaped);
-                        try w.writeAll(escaped);
-                    }
-                } else {
-                    try w.writeAll(value);
-                }
-
+        // Use print for better performance
+        try w.print(" {s}", .{attr.name});
+
+        const value = attr.value orelse return;
+        try w.writeAll("=\"");
+
+        // Evaluate expression if needed
+        if (attr.is_expression) {
+            const result = self.eval(line, value) catch |err| {
+                self.has_errors = true;
+                diagnostics.print("Error: Failed to evaluate attribute expression\n", .{});
+                diagnostics.print("  Attribute: {s}={s}\n", .{ attr.name, value });
+                diagnostics.print("  Error: {}\n", .{err});
+                diagnostics.print("  Hint: Make sure the variable '{s}' is defined\n", .{value});
+                // Skip attribute on error (strict mode)
                 try w.writeByte('"');
+                return;
+            };
+
+            // Escape the result if not unescaped
+            if (attr.is_unescaped) {
+                try w.writeAll(result);
+            } else {
+                try w.writeAll(try self.escapeHtml(result));
             }
+        } else {
+            try w.writeAll(value);
         }
+
+        try w.writeByte('"');
     }
 
     /// HTML void elements that don't have closing tags.
@@ -445,7 +826,7 @@ pub const Compiler = struct {
         .{"track"}, .{"wbr"},
     });
 
-    fn isVoidElement(tag_name: []const u8) bool {
+    pub fn isVoidElement(tag_name: []const u8) bool {
         return void_elements.has(tag_name);
     }
 
@@ -467,25 +848,22 @@ pub const Compiler = struct {
         const interp = &node.data.Interpolation;
 
         // Evaluate the JavaScript expression using runtime
-        const result = self.runtime.eval(interp.expression) catch |err| {
+        const result = self.eval(node.line, interp.expression) catch |err| {
             self.has_errors = true;
-            std.debug.print("Error: Failed to evaluate interpolation at line {d}\n", .{node.line});
-            std.debug.print("  Expression: #{{{s}}}\n", .{interp.expression});
-            std.debug.print("  Error: {}\n", .{err});
-            std.debug.print("  Hint: Check that all variables used in the expression are defined\n", .{});
+            diagnostics.print("Error: Failed to evaluate interpolation at line {d}\n", .{node.line});
+            diagnostics.print("  Expression: #{{{s}}}\n", .{interp.expression});
+            diagnostics.print("  Error: {}\n", .{err});
+            diagnostics.print("  Hint: Check that all variables used in the expression are defined\n", .{});
             // Don't generate output on error (strict mode)
             return;
         };
-        defer self.allocator.free(result);
 
         // Apply HTML escaping unless explicitly unescaped
         const w = self.writer();
         if (interp.is_unescaped) {
             try w.writeAll(result);
         } else {
-            const escaped = try self.escapeHtml(result);
-            defer self.allocator.free(escaped);
-            try w.writeAll(escaped);
+            try w.writeAll(try self.escapeHtml(result));
         }
     }
 
@@ -499,14 +877,13 @@ pub const Compiler = struct {
         const code = &node.data.Code;
 
         // Evaluate the code
-        const result = self.runtime.eval(code.code) catch |err| {
+        const result = self.eval(node.line, code.code) catch |err| {
             self.has_errors = true;
-            std.debug.print("Error: Failed to execute code at line {d}\n", .{node.line});
-            std.debug.print("  Code: {s}\n", .{code.code});
-            std.debug.print("  Error: {}\n", .{err});
+            diagnostics.print("Error: Failed to execute code at line {d}\n", .{node.line});
+            diagnostics.print("  Code: {s}\n", .{code.code});
+            diagnostics.print("  Error: {}\n", .{err});
             return;
         };
-        defer self.allocator.free(result);
 
         // If buffered, output the result
         if (code.is_buffered) {
@@ -515,9 +892,7 @@ pub const Compiler = struct {
             if (code.is_unescaped) {
                 try w.writeAll(result);
             } else {
-                const escaped = try self.escapeHtml(result);
-                defer self.allocator.free(escaped);
-                try w.writeAll(escaped);
+                try w.writeAll(try self.escapeHtml(result));
             }
         }
         // If unbuffered, we just executed it but don't output
@@ -525,6 +900,9 @@ pub const Compiler = struct {
 
     /// Escape HTML special characters to prevent XSS attacks
     /// Optimized version that pre-calculates size to avoid reallocations
+    ///
+    /// Returns the input itself when nothing needs escaping, otherwise an
+    /// escaped copy in scratch memory.
     fn escapeHtml(self: *Self, input: []const u8) ![]const u8 {
         // Helper to get escape sequence length
         const escapeLen = struct {
@@ -549,15 +927,14 @@ pub const Compiler = struct {
             final_size += len;
         }
 
-        // If no escaping needed, return a copy of the input
+        // If no escaping needed, the input can be written as is
         if (!needs_escaping) {
-            return try self.allocator.dupe(u8, input);
+            return input;
         }
 
         // Allocate exact size needed (no reallocations)
         var result = std.ArrayList(u8){};
-        errdefer result.deinit(self.allocator);
-        try result.ensureTotalCapacity(self.allocator, final_size);
+        try result.ensureTotalCapacity(self.scratch(), final_size);
 
         // Second pass: build escaped string - modern Zig switch
         for (input) |c| {
@@ -571,7 +948,7 @@ pub const Compiler = struct {
             }
         }
 
-        return try result.toOwnedSlice(self.allocator);
+        return result.items;
     }
 
     // ========================================================================
@@ -588,9 +965,7 @@ pub const Compiler = struct {
             try w.writeAll("<!--");
             // Escape comment content to prevent injection attacks
             // Replace "--" with "- -" to prevent premature comment closing
-            const escaped = try self.escapeComment(comment.content);
-            defer self.allocator.free(escaped);
-            try w.writeAll(escaped);
+            try w.writeAll(try self.escapeComment(comment.content));
             try w.writeAll("-->");
         }
         // Production mode (include_comments=false): comments are stripped
@@ -599,30 +974,33 @@ pub const Compiler = struct {
 
     /// Escape HTML comment content to prevent XSS/injection attacks
     /// Replaces "--" with "- -" to prevent premature comment closing
+    ///
+    /// Returns the input itself when it has no "--", otherwise an escaped
+    /// copy in scratch memory.
     fn escapeComment(self: *Self, input: []const u8) ![]const u8 {
         // Check if escaping is needed - modern Zig idiom
         const needs_escaping = std.mem.indexOf(u8, input, "--") != null;
 
         if (!needs_escaping) {
-            return try self.allocator.dupe(u8, input);
+            return input;
         }
 
         // Escape "--" sequences
+        const scratch_allocator = self.scratch();
         var result = std.ArrayList(u8){};
-        errdefer result.deinit(self.allocator);
 
         var i: usize = 0;
         while (i < input.len) {
             if (i + 1 < input.len and input[i] == '-' and input[i + 1] == '-') {
-                try result.appendSlice(self.allocator, "- -");
+                try result.appendSlice(scratch_allocator, "- -");
                 i += 2;
             } else {
-                try result.append(self.allocator, input[i]);
+                try result.append(scratch_allocator, input[i]);
                 i += 1;
             }
         }
 
-        return try result.toOwnedSlice(self.allocator);
+        return result.items;
     }
 
     // ========================================================================
@@ -633,14 +1011,13 @@ pub const Compiler = struct {
         const cond = &node.data.Conditional;
 
         // Evaluate condition using runtime
-        const result = self.runtime.eval(cond.condition) catch |err| {
+        const result = self.eval(node.line, cond.condition) catch |err| {
             self.has_errors = true;
-            std.debug.print("Error: Failed to evaluate conditional at line {d}\n", .{node.line});
-            std.debug.print("  Condition: {s}\n", .{cond.condition});
-            std.debug.print("  Error: {}\n", .{err});
+            diagnostics.print("Error: Failed to evaluate conditional at line {d}\n", .{node.line});
+            diagnostics.print("  Condition: {s}\n", .{cond.condition});
+            diagnostics.print("  Error: {}\n", .{err});
             return;
         };
-        defer self.allocator.free(result);
 
         // Check if result is truthy
         const is_true = !std.mem.eql(u8, result, "false") and
@@ -672,22 +1049,20 @@ pub const Compiler = struct {
         const loop = &node.data.Loop;
 
         // Get the iterable value from runtime
-        const iterable_result = self.runtime.eval(loop.iterable) catch |err| {
+        _ = self.eval(node.line, loop.iterable) catch |err| {
             self.has_errors = true;
-            std.debug.print("Error: Failed to evaluate loop iterable at line {d}\n", .{node.line});
-            std.debug.print("  Iterable: {s}\n", .{loop.iterable});
-            std.debug.print("  Error: {}\n", .{err});
-            std.debug.print("  Hint: Make sure the array variable is defined\n", .{});
+            diagnostics.print("Error: Failed to evaluate loop iterable at line {d}\n", .{node.line});
+            diagnostics.print("  Iterable: {s}\n", .{loop.iterable});
+            diagnostics.print("  Error: {}\n", .{err});
+            diagnostics.print("  Hint: Make sure the array variable is defined\n", .{});
             return;
         };
-        defer self.allocator.free(iterable_result);
 
         // Check if it's an array by looking for array notation or getting length
         // We'll use JavaScript to iterate
-        const length_expr = try std.fmt.allocPrint(self.allocator, "({s}).length", .{loop.iterable});
-        defer self.allocator.free(length_expr);
+        const length_expr = try std.fmt.allocPrint(self.scratch(), "({s}).length", .{loop.iterable});
 
-        const length_str = self.runtime.eval(length_expr) catch {
+        const length_str = self.eval(node.line, length_expr) catch {
             // Not an array or no length, try else branch
             if (loop.else_branch) |*else_branch| {
                 for (else_branch.items) |child| {
@@ -696,7 +1071,6 @@ pub const Compiler = struct {
             }
             return;
         };
-        defer self.allocator.free(length_str);
 
         const length = std.fmt.parseInt(usize, length_str, 10) catch {
             // Invalid length, try else branch
@@ -718,31 +1092,41 @@ pub const Compiler = struct {
             return;
         }
 
+        // Expressions that are the same in every iteration are evaluated
+        // here, once, into the enclosing arena
+        const hoisted_from = self.hoisted_keys.items.len;
+        defer self.unhoist(hoisted_from);
+        if (length > 1 and !loop.is_while) try self.hoistInvariants(node);
+
+        // Each iteration's transient memory is dropped before the next one
+        const frame = try self.pushScratch();
+        defer self.popScratch();
+
         // Iterate over array - modern Zig range syntax
         for (0..length) |i| {
+            _ = frame.reset(.retain_capacity);
+
             // Set iterator variable: item = array[i]
             const set_item_expr = try std.fmt.allocPrint(
-                self.allocator,
+                self.scratch(),
                 "var {s} = ({s})[{d}]",
                 .{ loop.iterator, loop.iterable, i },
             );
-            defer self.allocator.free(set_item_expr);
 
-            _ = self.runtime.eval(set_item_expr) catch |err| {
-                std.debug.print("Error setting loop variable: {}\n", .{err});
+            _ = self.evalLabeled(node.line, "bind", loop.iterator, set_item_expr) catch |err| {
+                diagnostics.print("Error setting loop variable: {}\n", .{err});
                 continue;
             };
 
             // Set index variable if specified
             if (loop.index) |index_name| {
                 const set_index_expr = try std.fmt.allocPrint(
-                    self.allocator,
+                    self.scratch(),
                     "var {s} = {d}",
                     .{ index_name, i },
                 );
-                defer self.allocator.free(set_index_expr);
 
-                _ = self.runtime.eval(set_index_expr) catch {};
+                _ = self.evalLabeled(node.line, "bind", index_name, set_index_expr) catch {};
             }
 
             // Compile loop body
@@ -752,6 +1136,34 @@ pub const Compiler = struct {
         }
     }
 
+    /// Evaluate the loop-invariant expressions of a loop body ahead of it
+    ///
+    /// The results are returned by eval() for those expressions until the
+    /// loop ends (unhoist). Expressions that fail are left alone, so the
+    /// error is reported where the expression is used, as without hoisting.
+    fn hoistInvariants(self: *Self, node: *ast.AstNode) !void {
+        const invariants = self.loop_invariants.get(node) orelse blk: {
+            const found = try analysis.loopInvariants(self.scratch_arenas.items[0].allocator(), node, &self.mixins);
+            try self.loop_invariants.put(self.allocator, node, found);
+            break :blk found;
+        };
+
+        for (invariants) |expression| {
+            const key = @intFromPtr(expression.ptr);
+            if (self.hoisted.contains(key)) continue; // Already hoisted by an enclosing loop
+
+            const value = self.evalTemplate(node.line, "hoist", expression) catch continue;
+            try self.hoisted.put(self.allocator, key, .{ .len = expression.len, .value = value });
+            try self.hoisted_keys.append(self.allocator, key);
+        }
+    }
+
+    /// Forget the expressions hoisted since hoisted_keys had `from` items
+    fn unhoist(self: *Self, from: usize) void {
+        for (self.hoisted_keys.items[from..]) |key| _ = self.hoisted.remove(key);
+        self.hoisted_keys.shrinkRetainingCapacity(from);
+    }
+
     // ========================================================================
     // Include Compilation
     // ========================================================================
@@ -769,13 +1181,41 @@ pub const Compiler = struct {
         };
         defer self.allocator.free(full_path);
 
-        // Read file content
+        try self.enterFrame(.include, full_path, full_path);
+        defer self.leaveFrame();
+
+        if (self.resolver) |resolver| {
+            const included = resolver.resolve(full_path) orelse {
+                diagnostics.print("Error: include file '{s}' is not a known template\n", .{full_path});
+                return error.IncludeFileNotFound;
+            };
+            try self.compileNode(included);
+            return;
+        }
+
+        // Reuse the parsed include from the AST cache when available
+        if (self.ast_cache) |ast_cache| {
+            const included = ast_cache.load(full_path) catch |err| {
+                diagnostics.print("Error loading include file '{s}': {}\n", .{ full_path, err });
+                return switch (err) {
+                    error.TemplateParseFailed => error.IncludeParseError,
+                    error.OutOfMemory => error.OutOfMemory,
+                    else => error.IncludeFileNotFound,
+                };
+            };
+            try self.compileNode(included.root);
+            return;
+        }
+
+        // Read file content (its tree is freed below, so its mixins can't be
+        // remembered past this render)
+        self.memo_volatile = true;
         const file_content = std.fs.cwd().readFileAlloc(
             self.allocator,
             full_path,
             1024 * 1024, // 1MB max
         ) catch |err| {
-            std.debug.print("Error reading include file '{s}': {}\n", .{ full_path, err });
+            diagnostics.print("Error reading include file '{s}': {}\n", .{ full_path, err });
             return error.IncludeFileNotFound;
         };
         defer self.allocator.free(file_content);
@@ -791,15 +1231,16 @@ pub const Compiler = struct {
 
         // Parse the included file
         var parser = Parser.init(self.allocator, file_content) catch |err| {
-            std.debug.print("Error parsing include file '{s}': {}\n", .{ full_path, err });
+            diagnostics.print("Error parsing include file '{s}': {}\n", .{ full_path, err });
             return error.IncludeParseError;
         };
         defer parser.deinit();
 
         const included_ast = parser.parse() catch |err| {
-            std.debug.print("Error parsing include file '{s}': {}\n", .{ full_path, err });
+            diagnostics.print("Error parsing include file '{s}': {}\n", .{ full_path, err });
             return error.IncludeParseError;
         };
+        if (self.defines) |defines| _ = try optimizer.optimize(parser.arena.allocator(), included_ast, defines);
 
         // Compile the included AST
         // Save current output position to extract just the include
@@ -824,38 +1265,27 @@ pub const Compiler = struct {
         const case_node = &node.data.Case;
 
         // Evaluate the case expression
-        const case_value = self.runtime.eval(case_node.expression) catch |err| {
+        const case_value = self.evalResult(node.line, case_node.expression) catch |err| {
             self.has_errors = true;
-            std.debug.print("Runtime error evaluating case '{s}': {}\n", .{ case_node.expression, err });
+            diagnostics.print("Runtime error evaluating case '{s}': {}\n", .{ case_node.expression, err });
             return;
         };
-        defer self.allocator.free(case_value);
-
-        // Check each when clause
-        for (case_node.cases.items) |when_node| {
-            const when = &when_node.data.When;
 
-            var matched = false;
-            for (when.values.items) |value| {
-                if (std.mem.eql(u8, case_value, value)) {
-                    matched = true;
-                    break;
-                }
-            }
-
-            if (matched) {
-                for (when.body.items) |child| {
-                    try self.compileNode(child);
-                }
-                return; // Exit after first match
-            }
-        }
+        // Find the first when clause with a matching value
+        const table = self.case_tables.get(node) orelse blk: {
+            const built = try CaseTable.init(self.scratch_arenas.items[0].allocator(), case_node);
+            try self.case_tables.put(self.allocator, node, built);
+            break :blk built;
+        };
+        const body = if (table.find(case_value)) |clause|
+            case_node.cases.items[clause].data.When.body.items
+        else if (case_node.default) |default_body|
+            default_body.items
+        else
+            return;
 
-        // No match found, execute default if exists
-        if (case_node.default) |*default_body| {
-            for (default_body.items) |child| {
-                try self.compileNode(child);
-            }
+        for (body) |child| {
+            try self.compileNode(child);
         }
     }
 
@@ -866,6 +1296,7 @@ pub const Compiler = struct {
     fn registerMixin(self: *Self, node: *ast.AstNode) !void {
         const mixin = &node.data.MixinDef;
         try self.mixins.put(mixin.name, node);
+        if (self.profiler) |prof| try prof.define(.mixin, mixin.name);
     }
 
     fn compileMixinCall(self: *Self, node: *ast.AstNode) !void {
@@ -873,72 +1304,186 @@ pub const Compiler = struct {
 
         // Find mixin definition
         const mixin_node = self.mixins.get(call.name) orelse {
-            std.debug.print("Mixin '{s}' not found\n", .{call.name});
+            diagnostics.print("Mixin '{s}' not found\n", .{call.name});
             return error.MixinNotFound;
         };
 
         const mixin_def = &mixin_node.data.MixinDef;
 
-        // Bind parameters to arguments in runtime context
-        for (mixin_def.params.items, 0..) |param, i| {
-            if (i < call.args.items.len) {
-                // Evaluate the argument and set as variable
-                const arg_value = call.args.items[i];
-                const set_var_expr = try std.fmt.allocPrint(
-                    self.allocator,
-                    "var {s} = {s}",
-                    .{ param, arg_value },
-                );
-                defer self.allocator.free(set_var_expr);
+        // Evaluate the arguments once and bind their values in a call frame;
+        // the parameters get their previous values back when the call ends
+        const frame = try self.pushFrame(node.line, call, mixin_def);
+        defer self.runtime.popFrame(frame);
+
+        // Pure mixins called again with equal arguments reuse their HTML
+        const memo_key = if (call.body == null and try self.isPureMixin(mixin_node))
+            try self.memoKey(mixin_node, frame)
+        else
+            null;
+        if (memo_key) |key| {
+            if (self.mixin_memo.get(key)) |html| {
+                try self.output.appendSlice(self.allocator, html);
+                return;
+            }
+        }
 
-                _ = self.runtime.eval(set_var_expr) catch |err| {
-                    std.debug.print("Error setting mixin parameter '{s}': {}\n", .{ param, err });
-                };
-            } else {
-                // Set undefined for missing arguments
-                const set_undefined_expr = try std.fmt.allocPrint(
-                    self.allocator,
-                    "var {s} = undefined",
-                    .{param},
-                );
-                defer self.allocator.free(set_undefined_expr);
+        const start = self.output.items.len;
+        try self.compileMixinBody(call.name, mixin_def);
+        if (memo_key) |key| {
+            if (!self.has_errors) try self.memoize(key, self.output.items[start..]);
+        }
+    }
 
-                _ = self.runtime.eval(set_undefined_expr) catch {};
-            }
+    /// Compile a mixin body (attributed to the file defining the mixin)
+    fn compileMixinBody(self: *Self, name: []const u8, mixin_def: *const ast.MixinDefNode) !void {
+        const file = if (self.profiler) |prof| prof.definitionFile(.mixin, name) else null;
+        try self.enterFrame(.mixin, name, file);
+        defer self.leaveFrame();
+
+        for (mixin_def.body.items) |child| {
+            try self.compileNode(child);
         }
+    }
 
-        // Handle rest parameter if present
-        if (mixin_def.rest_param) |rest_param| {
-            // Create array from remaining arguments
-            var rest_args = std.ArrayList(u8){};
-            defer rest_args.deinit(self.allocator);
+    /// Whether a mixin renders nothing but its arguments (analyzed once per render)
+    fn isPureMixin(self: *Self, mixin_node: *ast.AstNode) !bool {
+        if (self.mixin_purity.get(mixin_node)) |known| return known;
+        const pure = try analysis.isPureMixin(self.allocator, mixin_node, &self.mixins);
+        try self.mixin_purity.put(self.allocator, mixin_node, pure);
+        return pure;
+    }
 
-            try rest_args.appendSlice(self.allocator, "var ");
-            try rest_args.appendSlice(self.allocator, rest_param);
-            try rest_args.appendSlice(self.allocator, " = [");
+    /// Memo key of a call: mixin, indentation (pretty mode) and argument values
+    fn memoKey(self: *Self, mixin_node: *ast.AstNode, frame: runtime.JsRuntime.Frame) !?[]const u8 {
+        const args = try self.runtime.frameKey(self.scratch(), frame) orelse return null;
+        const indent = if (self.pretty) self.indent_level else 0;
+        const name = mixin_node.data.MixinDef.name;
+        return try std.fmt.allocPrint(self.scratch(), "{x}:{s}:{d}:{s}", .{ @intFromPtr(mixin_node), name, indent, args });
+    }
+
+    /// Keep the HTML of a pure mixin call, unless the memo is full
+    ///
+    /// The caps hold for the whole memo, which may span several renders of
+    /// one template (see setTemplateId).
+    fn memoize(self: *Self, key: []const u8, html: []const u8) !void {
+        if (self.mixin_memo.count() >= max_memo_entries) return;
+        if (self.memo_bytes + key.len + html.len > max_memo_bytes) return;
+
+        const arena = self.memo_arena.allocator();
+        try self.mixin_memo.put(self.allocator, try arena.dupe(u8, key), try arena.dupe(u8, html));
+        self.memo_bytes += key.len + html.len;
+    }
+
+    /// Forget the HTML of pure mixin calls
+    fn clearMixinMemo(self: *Self) void {
+        self.mixin_memo.clearRetainingCapacity();
+        _ = self.memo_arena.reset(.retain_capacity);
+        self.memo_bytes = 0;
+    }
+};
+
+// ============================================================================
+// Case Tables
+// ============================================================================
 
-            const start_idx = mixin_def.params.items.len;
-            for (call.args.items[start_idx..], 0..) |arg, j| {
-                if (j > 0) {
-                    try rest_args.appendSlice(self.allocator, ", ");
+/// The when values of a case, sorted for lookup by the case value
+///
+/// Each kind of value has its own table: quoted literals match strings,
+/// numeric literals match numbers (by value, so `when 1.0` matches 1), and
+/// other literals match the value's text. A case value is found by binary
+/// search in the tables that apply to it, and the first clause that lists
+/// it wins, as with a scan of the clauses in order.
+const CaseTable = struct {
+    strings: []const TextEntry, // Quoted literals
+    numbers: []const NumberEntry, // Numeric literals
+    texts: []const TextEntry, // Other literals (true, null, names)
+
+    const TextEntry = struct {
+        text: []const u8,
+        clause: usize, // Index of the when clause
+    };
+
+    const NumberEntry = struct {
+        number: f64,
+        clause: usize,
+    };
+
+    /// Build the tables of a case (memory from an arena)
+    fn init(allocator: std.mem.Allocator, case_node: *const ast.CaseNode) !CaseTable {
+        var strings = std.ArrayList(TextEntry){};
+        var numbers = std.ArrayList(NumberEntry){};
+        var texts = std.ArrayList(TextEntry){};
+
+        for (case_node.cases.items, 0..) |when_node, clause| {
+            for (when_node.data.When.values.items) |value| {
+                const entry = TextEntry{ .text = value.text, .clause = clause };
+                switch (value.kind) {
+                    .string => try strings.append(allocator, entry),
+                    .number => if (std.fmt.parseFloat(f64, value.text)) |number| {
+                        try numbers.append(allocator, .{ .number = number, .clause = clause });
+                    } else |_| {
+                        try texts.append(allocator, entry);
+                    },
+                    .text => try texts.append(allocator, entry),
                 }
-                try rest_args.appendSlice(self.allocator, arg);
             }
+        }
 
-            try rest_args.appendSlice(self.allocator, "]");
+        std.mem.sort(TextEntry, strings.items, {}, textLessThan);
+        std.mem.sort(NumberEntry, numbers.items, {}, numberLessThan);
+        std.mem.sort(TextEntry, texts.items, {}, textLessThan);
+        return .{ .strings = strings.items, .numbers = numbers.items, .texts = texts.items };
+    }
 
-            const rest_expr = try rest_args.toOwnedSlice(self.allocator);
-            defer self.allocator.free(rest_expr);
+    /// Index of the clause selected by a case value (null = default)
+    fn find(self: CaseTable, value: runtime.EvalResult) ?usize {
+        const typed = switch (value.kind) {
+            .string => findText(self.strings, value.text),
+            .number => findNumber(self.numbers, value.number),
+            .other => null,
+        };
+        const untyped = findText(self.texts, value.text);
 
-            _ = self.runtime.eval(rest_expr) catch |err| {
-                std.debug.print("Error setting rest parameter '{s}': {}\n", .{ rest_param, err });
-            };
+        if (typed == null) return untyped;
+        if (untyped == null) return typed;
+        return @min(typed.?, untyped.?);
+    }
+
+    /// Clause of the first entry with this text (entries sorted by text, then clause)
+    fn findText(entries: []const TextEntry, text: []const u8) ?usize {
+        var low: usize = 0;
+        var high = entries.len;
+        while (low < high) {
+            const mid = low + (high - low) / 2;
+            if (std.mem.lessThan(u8, entries[mid].text, text)) low = mid + 1 else high = mid;
         }
+        if (low < entries.len and std.mem.eql(u8, entries[low].text, text)) return entries[low].clause;
+        return null;
+    }
 
-        // Compile the mixin body
-        for (mixin_def.body.items) |child| {
-            try self.compileNode(child);
+    /// Clause of the first entry with this number (NaN matches nothing)
+    fn findNumber(entries: []const NumberEntry, number: f64) ?usize {
+        var low: usize = 0;
+        var high = entries.len;
+        while (low < high) {
+            const mid = low + (high - low) / 2;
+            if (entries[mid].number < number) low = mid + 1 else high = mid;
         }
+        if (low < entries.len and entries[low].number == number) return entries[low].clause;
+        return null;
+    }
+
+    fn textLessThan(_: void, a: TextEntry, b: TextEntry) bool {
+        return switch (std.mem.order(u8, a.text, b.text)) {
+            .lt => true,
+            .gt => false,
+            .eq => a.clause < b.clause,
+        };
+    }
+
+    fn numberLessThan(_: void, a: NumberEntry, b: NumberEntry) bool {
+        if (a.number != b.number) return a.number < b.number;
+        return a.clause < b.clause;
     }
 };
 
@@ -1029,7 +1574,7 @@ test "compiler - interpolation" {
     const html = try compiler.compile(tree);
     defer std.testing.allocator.free(html);
 
-    try std.testing.expectEqualStrings("<p>HelloJohn</p>", html);
+    try std.testing.expectEqualStrings("<p>Hello John</p>", html);
 }
 
 test "compiler - conditional true" {
@@ -1053,7 +1598,7 @@ test "compiler - conditional true" {
     const html = try compiler.compile(tree);
     defer std.testing.allocator.free(html);
 
-    try std.testing.expectEqualStrings("<p>Welcome back ! </p>", html);
+    try std.testing.expectEqualStrings("<p>Welcome back!</p>", html);
 }
 
 test "compiler - conditional false" {
@@ -1079,7 +1624,7 @@ test "compiler - conditional false" {
     const html = try compiler.compile(tree);
     defer std.testing.allocator.free(html);
 
-    try std.testing.expectEqualStrings("<p>Please log in </p>", html);
+    try std.testing.expectEqualStrings("<p>Please log in</p>", html);
 }
 
 test "compiler - mixin call" {
@@ -1102,7 +1647,7 @@ test "compiler - mixin call" {
     const html = try compiler.compile(tree);
     defer std.testing.allocator.free(html);
 
-    try std.testing.expectEqualStrings("<p>Hello !</p>", html);
+    try std.testing.expectEqualStrings("<p>Hello!</p>", html);
 }
 
 test "compiler - html escaping" {
@@ -1268,7 +1813,7 @@ test "compiler - unbuffered code" {
     const html = try compiler.compile(tree);
     defer std.testing.allocator.free(html);
 
-    try std.testing.expectEqualStrings("<p>Sum :30</p>", html);
+    try std.testing.expectEqualStrings("<p>Sum: 30</p>", html);
 }
 
 test "compiler - multiple classes" {
@@ -1290,6 +1835,32 @@ test "compiler - multiple classes" {
     try std.testing.expectEqualStrings("<div class=\"box highlight\">Content</div>", html);
 }
 
+test "compiler - class shorthand merges with class attributes" {
+    const source =
+        \\div.box(class="big" title="Box") Content
+        \\a.btn(class=kind href="/") Go
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+
+    var js_runtime = try runtime.JsRuntime.init(std.testing.allocator);
+    defer js_runtime.deinit();
+    try js_runtime.setString("kind", "primary");
+
+    var compiler = try Compiler.init(std.testing.allocator, js_runtime);
+    defer compiler.deinit();
+
+    const html = try compiler.compile(tree);
+    defer std.testing.allocator.free(html);
+
+    try std.testing.expectEqualStrings(
+        "<div class=\"box big\" title=\"Box\">Content</div><a class=\"btn primary\" href=\"/\">Go</a>",
+        html,
+    );
+}
+
 test "compiler - mixin with arguments" {
     const source =
         \\mixin greet(name)
@@ -1310,7 +1881,160 @@ test "compiler - mixin with arguments" {
     const html = try compiler.compile(tree);
     defer std.testing.allocator.free(html);
 
-    try std.testing.expectEqualStrings("<p>Hello ,World</p>", html);
+    try std.testing.expectEqualStrings("<p>Hello, World</p>", html);
+}
+
+test "compiler - mixin arguments are bound per call" {
+    const source =
+        \\mixin card(name, ...tags)
+        \\  p #{name}:#{tags.length}
+        \\+card("A", "x", "y")
+        \\+card(name)
+        \\p #{name}
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+
+    var js_runtime = try runtime.JsRuntime.init(std.testing.allocator);
+    defer js_runtime.deinit();
+    try js_runtime.setString("name", "page");
+
+    var compiler = try Compiler.init(std.testing.allocator, js_runtime);
+    defer compiler.deinit();
+
+    const html = try compiler.compile(tree);
+    defer std.testing.allocator.free(html);
+
+    // The second call reads the global before binding; after the calls the
+    // global is back and the rest parameter is gone
+    try std.testing.expectEqualStrings("<p>A:2</p><p>page:0</p><p>page</p>", html);
+
+    const tags = try js_runtime.eval("typeof tags");
+    defer std.testing.allocator.free(tags);
+    try std.testing.expectEqualStrings("undefined", tags);
+}
+
+test "compiler - pure mixin calls with equal arguments reuse their HTML" {
+    const source =
+        \\mixin icon(name)
+        \\  i(class=name)
+        \\each item in items
+        \\  +icon(item.icon)
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+
+    var js_runtime = try runtime.JsRuntime.init(std.testing.allocator);
+    defer js_runtime.deinit();
+    try js_runtime.setJson("items", "[{\"icon\":\"star\"},{\"icon\":\"home\"},{\"icon\":\"star\"},{\"icon\":\"star\"}]");
+
+    var prof = try profiling.Profiler.init(std.testing.allocator);
+    defer prof.deinit();
+
+    var compiler = try Compiler.init(std.testing.allocator, js_runtime);
+    defer compiler.deinit();
+    compiler.setProfiler(&prof);
+
+    const html = try compiler.compile(tree);
+    defer std.testing.allocator.free(html);
+
+    try std.testing.expectEqualStrings(
+        "<i class=\"star\"></i><i class=\"home\"></i><i class=\"star\"></i><i class=\"star\"></i>",
+        html,
+    );
+
+    // The body ran once per distinct argument
+    var it = prof.sites.iterator();
+    var body_calls: u64 = 0;
+    while (it.next()) |entry| {
+        const site = entry.key_ptr.*;
+        if (std.mem.eql(u8, site.kind, "eval") and std.mem.eql(u8, site.text, "name")) {
+            body_calls += entry.value_ptr.calls;
+        }
+    }
+    try std.testing.expectEqual(@as(u64, 2), body_calls);
+}
+
+test "compiler - mixin memo is kept across renders of one template" {
+    const source =
+        \\mixin badge(n)
+        \\  b= n
+        \\+badge(1)
+        \\+badge(2)
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+
+    var js_runtime = try runtime.JsRuntime.init(std.testing.allocator);
+    defer js_runtime.deinit();
+
+    var compiler = try Compiler.init(std.testing.allocator, js_runtime);
+    defer compiler.deinit();
+
+    // Without a template id the memo goes with the render
+    try std.testing.expectEqualStrings("<b>1</b><b>2</b>", try compiler.render(tree));
+    try std.testing.expectEqual(@as(usize, 0), compiler.mixin_memo.count());
+
+    compiler.reset();
+    compiler.setTemplateId(1);
+    try std.testing.expectEqualStrings("<b>1</b><b>2</b>", try compiler.render(tree));
+    try std.testing.expectEqual(@as(usize, 2), compiler.mixin_memo.count());
+    const bytes = compiler.memo_bytes;
+
+    // Same template: the calls are copied, the caps count both renders
+    compiler.reset();
+    compiler.setTemplateId(1);
+    try std.testing.expectEqualStrings("<b>1</b><b>2</b>", try compiler.render(tree));
+    try std.testing.expectEqual(@as(usize, 2), compiler.mixin_memo.count());
+    try std.testing.expectEqual(bytes, compiler.memo_bytes);
+
+    // Another template starts over
+    compiler.reset();
+    compiler.setTemplateId(2);
+    try std.testing.expectEqual(@as(usize, 0), compiler.mixin_memo.count());
+    try std.testing.expectEqual(@as(usize, 0), compiler.memo_bytes);
+}
+
+test "compiler - case dispatches on typed when values" {
+    const source =
+        \\each code in codes
+        \\  case code
+        \\    when 200, 204
+        \\      i ok
+        \\    when "404"
+        \\      i text
+        \\    when 404, -1
+        \\      i missing
+        \\    when null
+        \\      i none
+        \\    default
+        \\      i other
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+
+    var js_runtime = try runtime.JsRuntime.init(std.testing.allocator);
+    defer js_runtime.deinit();
+    try js_runtime.setJson("codes", "[204, 404, \"404\", 404.0, -1, null, \"200\"]");
+
+    var compiler = try Compiler.init(std.testing.allocator, js_runtime);
+    defer compiler.deinit();
+
+    const html = try compiler.compile(tree);
+    defer std.testing.allocator.free(html);
+
+    try std.testing.expectEqualStrings(
+        "<i>ok</i><i>missing</i><i>text</i><i>missing</i><i>missing</i><i>none</i><i>other</i>",
+        html,
+    );
 }
 
 test "compiler - comment escaping" {
@@ -1359,3 +2083,237 @@ test "compiler - doctype html" {
     try std.testing.expect(std.mem.startsWith(u8, html, "<!DOCTYPE html>"));
     try std.testing.expect(std.mem.indexOf(u8, html, "<html>") != null);
 }
+
+test "compiler - loop iterations reuse a scratch arena" {
+    const source =
+        \\ul
+        \\  each item in items
+        \\    li= item
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+
+    var js_runtime = try runtime.JsRuntime.init(std.testing.allocator);
+    defer js_runtime.deinit();
+    try js_runtime.setJson("items", "[\"<a>\", \"b\", \"c\"]");
+
+    var compiler = try Compiler.init(std.testing.allocator, js_runtime);
+    defer compiler.deinit();
+
+    const html = try compiler.compile(tree);
+    defer std.testing.allocator.free(html);
+
+    try std.testing.expectEqualStrings("<ul><li>&lt;a&gt;</li><li>b</li><li>c</li></ul>", html);
+
+    // One arena for the render plus one for the loop level, both reset
+    try std.testing.expectEqual(@as(usize, 2), compiler.scratch_arenas.items.len);
+    try std.testing.expectEqual(@as(usize, 0), compiler.scratch_depth);
+}
+
+test "compiler - loop-invariant expressions are evaluated once per loop" {
+    const source =
+        \\ul
+        \\  each item, i in items
+        \\    - var n = i + 1
+        \\    li(class=theme)= n + '. ' + item + ' ' + currency
+        \\    if currency
+        \\      span= currency
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+
+    var js_runtime = try runtime.JsRuntime.init(std.testing.allocator);
+    defer js_runtime.deinit();
+    try js_runtime.setJson("items", "[\"a\", \"b\", \"c\"]");
+    try js_runtime.setJson("theme", "\"row\"");
+    try js_runtime.setJson("currency", "\"EUR\"");
+
+    var prof = try profiling.Profiler.init(std.testing.allocator);
+    defer prof.deinit();
+
+    var compiler = try Compiler.init(std.testing.allocator, js_runtime);
+    defer compiler.deinit();
+    compiler.setProfiler(&prof);
+
+    const html = try compiler.compile(tree);
+    defer std.testing.allocator.free(html);
+
+    try std.testing.expectEqualStrings(
+        "<ul><li class=\"row\">1. a EUR</li><span>EUR</span><li class=\"row\">2. b EUR</li><span>EUR</span><li class=\"row\">3. c EUR</li><span>EUR</span></ul>",
+        html,
+    );
+
+    // class=theme and the if condition run once; the span (conditional) and
+    // the li text (reads n) run per iteration
+    var it = prof.sites.iterator();
+    while (it.next()) |entry| {
+        const site = entry.key_ptr.*;
+        const calls = entry.value_ptr.calls;
+        if (std.mem.eql(u8, site.text, "theme")) try std.testing.expectEqualStrings("hoist", site.kind);
+        if (std.mem.eql(u8, site.kind, "hoist")) try std.testing.expectEqual(@as(u64, 1), calls);
+        if (std.mem.eql(u8, site.kind, "eval") and std.mem.eql(u8, site.text, "currency")) {
+            try std.testing.expectEqual(@as(u64, 3), calls); // span= currency
+        }
+    }
+    try std.testing.expectEqual(@as(usize, 0), compiler.hoisted.count());
+}
+
+test "compiler - calls in buffered code keep loop expressions per iteration" {
+    const source =
+        \\each item in items
+        \\  p= counter.bump()
+        \\  span= counter.n
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+
+    var js_runtime = try runtime.JsRuntime.init(std.testing.allocator);
+    defer js_runtime.deinit();
+    try js_runtime.setJson("items", "[1, 2]");
+    const defined = try js_runtime.eval("var counter = { n: 0, bump: function () { this.n++; return 'x'; } }");
+    std.testing.allocator.free(defined);
+
+    var compiler = try Compiler.init(std.testing.allocator, js_runtime);
+    defer compiler.deinit();
+
+    const html = try compiler.compile(tree);
+    defer std.testing.allocator.free(html);
+
+    try std.testing.expectEqualStrings("<p>x</p><span>1</span><p>x</p><span>2</span>", html);
+}
+
+test "compiler - renders after a runtime reset do not see earlier variables" {
+    const source =
+        \\if reveal
+        \\  - var secret = 'classified'
+        \\each item in items
+        \\  i= item
+        \\p= (typeof secret === 'undefined' ? 'none' : secret) + (typeof item === 'undefined' ? '' : item)
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+
+    var js_runtime = try runtime.JsRuntime.init(std.testing.allocator);
+    defer js_runtime.deinit();
+
+    var compiler = try Compiler.init(std.testing.allocator, js_runtime);
+    defer compiler.deinit();
+
+    try js_runtime.setBool("reveal", true);
+    try js_runtime.setJson("items", "[\"a\"]");
+    try std.testing.expectEqualStrings("<i>a</i><p>classifieda</p>", try compiler.render(tree));
+
+    // Same runtime, next request: neither the var nor the loop variable
+    js_runtime.reset();
+    compiler.reset();
+    try js_runtime.setBool("reveal", false);
+    try js_runtime.setJson("items", "[]");
+    try std.testing.expectEqualStrings("<p>none</p>", try compiler.render(tree));
+}
+
+test "compiler - tags mixing literal and expression attributes" {
+    const source =
+        \\form
+        \\  input(type="text" name="q" value=q autocomplete="off")
+        \\  a(href=url data-x="1")= label
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+
+    var js_runtime = try runtime.JsRuntime.init(std.testing.allocator);
+    defer js_runtime.deinit();
+    try js_runtime.setString("q", "a&b");
+    try js_runtime.setString("url", "/next");
+    try js_runtime.setString("label", "Next");
+
+    var compiler = try Compiler.init(std.testing.allocator, js_runtime);
+    defer compiler.deinit();
+
+    const html = try compiler.compile(tree);
+    defer std.testing.allocator.free(html);
+
+    try std.testing.expectEqualStrings(
+        "<form><input type=\"text\" name=\"q\" value=\"a&amp;b\" autocomplete=\"off\"><a href=\"/next\" data-x=\"1\">Next</a></form>",
+        html,
+    );
+}
+
+test "compiler - profiler records nodes, expressions and mixin frames" {
+    const source =
+        \\mixin greet(name)
+        \\  p Hello, #{name}
+        \\+greet("World")
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+
+    var js_runtime = try runtime.JsRuntime.init(std.testing.allocator);
+    defer js_runtime.deinit();
+
+    var prof = try profiling.Profiler.init(std.testing.allocator);
+    defer prof.deinit();
+
+    var compiler = try Compiler.init(std.testing.allocator, js_runtime);
+    defer compiler.deinit();
+    compiler.setBasePath("page.pug");
+    compiler.setProfiler(&prof);
+
+    const html = try compiler.compile(tree);
+    defer std.testing.allocator.free(html);
+
+    // Profiling does not change the output
+    try std.testing.expectEqualStrings("<p>Hello, World</p>", html);
+
+    // The interpolation inside the mixin is attributed to the template file
+    var it = prof.sites.iterator();
+    var interp_calls: u64 = 0;
+    while (it.next()) |entry| {
+        const site = entry.key_ptr.*;
+        if (std.mem.eql(u8, site.kind, "eval") and std.mem.eql(u8, site.text, "name")) {
+            try std.testing.expectEqualStrings("page.pug", site.file);
+            interp_calls += entry.value_ptr.calls;
+        }
+    }
+    try std.testing.expectEqual(@as(u64, 1), interp_calls);
+
+    var folded = std.ArrayList(u8){};
+    defer folded.deinit(std.testing.allocator);
+    try prof.writeFolded(folded.writer(std.testing.allocator));
+    try std.testing.expect(std.mem.indexOf(u8, folded.items, "page.pug;mixin greet ") != null);
+}
+
+test "compiler - reset and render reuse the output buffer" {
+    var parser = try Parser.init(std.testing.allocator, "mixin item(x)\n  li= x\nul\n  +item('a')\n  +item('b')");
+    defer parser.deinit();
+    const tree = try parser.parse();
+
+    var js_runtime = try runtime.JsRuntime.init(std.testing.allocator);
+    defer js_runtime.deinit();
+
+    var compiler = try Compiler.init(std.testing.allocator, js_runtime);
+    defer compiler.deinit();
+
+    const first = try compiler.render(tree);
+    try std.testing.expectEqualStrings("<ul><li>a</li><li>b</li></ul>", first);
+    try std.testing.expectEqual(first.len, compiler.size_hint);
+    const buffer = compiler.output.items.ptr;
+
+    // Second render starts presized and writes into the same buffer
+    compiler.reset();
+    try std.testing.expectEqual(@as(usize, 0), compiler.mixins.count());
+    const second = try compiler.render(tree);
+    try std.testing.expectEqualStrings("<ul><li>a</li><li>b</li></ul>", second);
+    try std.testing.expectEqual(buffer, second.ptr);
+}
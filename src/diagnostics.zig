@@ -0,0 +1,78 @@
+//! Diagnostics module - Routing of error messages and stdout output
+//!
+//! Compilation errors are normally printed straight to stderr. When files
+//! are compiled in parallel (`zpug -j N`) that would interleave messages
+//! from different files, so a worker thread can capture the messages (and
+//! any HTML bound for stdout) of the file it is compiling into buffers
+//! that the CLI prints in input order once all files are done.
+//!
+//! Capture is per thread; threads that never call capture() print directly.
+//!
+//! Example:
+//! ```zig
+//! var log = std.ArrayList(u8){};
+//! var out = std.ArrayList(u8){};
+//! diagnostics.capture(allocator, &log, &out);
+//! defer diagnostics.release();
+//!
+//! diagnostics.print("Error at line {d}\n", .{line}); // appended to log
+//! ```
+
+const std = @import("std");
+
+const Capture = struct {
+    allocator: std.mem.Allocator,
+    log: *std.ArrayList(u8),
+    stdout: *std.ArrayList(u8),
+};
+
+threadlocal var active: ?Capture = null;
+
+/// Print a diagnostic message (stderr, or the current thread's capture)
+pub fn print(comptime fmt: []const u8, args: anytype) void {
+    if (active) |c| {
+        c.log.writer(c.allocator).print(fmt, args) catch {};
+        return;
+    }
+    std.debug.print(fmt, args);
+}
+
+/// Write program output (stdout, or the current thread's capture)
+pub fn writeStdout(bytes: []const u8) !void {
+    if (active) |c| {
+        try c.stdout.appendSlice(c.allocator, bytes);
+        return;
+    }
+    try std.fs.File.stdout().writeAll(bytes);
+}
+
+/// Redirect this thread's diagnostics and stdout output into buffers
+pub fn capture(allocator: std.mem.Allocator, log: *std.ArrayList(u8), stdout: *std.ArrayList(u8)) void {
+    active = .{ .allocator = allocator, .log = log, .stdout = stdout };
+}
+
+/// Stop capturing on this thread
+pub fn release() void {
+    active = null;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+test "diagnostics - capture and release" {
+    const allocator = std.testing.allocator;
+
+    var log = std.ArrayList(u8){};
+    defer log.deinit(allocator);
+    var out = std.ArrayList(u8){};
+    defer out.deinit(allocator);
+
+    capture(allocator, &log, &out);
+    print("Error at line {d}\n", .{3});
+    try writeStdout("<p>");
+    release();
+
+    try std.testing.expectEqualStrings("Error at line 3\n", log.items);
+    try std.testing.expectEqualStrings("<p>", out.items);
+}
@@ -0,0 +1,181 @@
+//! Embed tool - Generates a Zig module of precompiled templates
+//!
+//! Run by the `addTemplates` helper in build.zig, never by hand:
+//!
+//! ```
+//! zpug-embed <output-dir> <templates-dir>
+//! ```
+//!
+//! Every `.pug`/`.zpug` file under the templates directory is parsed and
+//! serialized to a `.zpugc` file in the output directory, and
+//! `templates.zig` is written next to them. That module embeds each file
+//! with @embedFile and exposes the set as `zig_pug.EmbeddedTemplates`,
+//! keyed by path relative to the templates directory without extension
+//! (`views/blog/post.pug` -> `"blog/post"`).
+//!
+//! Only the parser is needed here, so the tool builds without mujs.
+
+const std = @import("std");
+const parser = @import("parser.zig");
+const precompiled = @import("precompiled.zig");
+
+/// Template file extensions picked up from the templates directory
+pub const extensions = [_][]const u8{ ".pug", ".zpug" };
+
+/// Name of a template: normalized path without its extension
+///
+/// Used both for the generated keys and for include/extends lookups, so
+/// "blog/../partials/header.pug" and "partials/header" are the same
+/// template.
+///
+/// Returns: Name (caller owns memory)
+pub fn templateName(allocator: std.mem.Allocator, path: []const u8) ![]u8 {
+    const resolved = try std.fs.path.resolvePosix(allocator, &.{path});
+    var name = resolved;
+    for (extensions) |ext| {
+        if (std.mem.endsWith(u8, name, ext)) {
+            name = name[0 .. name.len - ext.len];
+            break;
+        }
+    }
+    if (name.len == resolved.len) return resolved;
+    defer allocator.free(resolved);
+    return allocator.dupe(u8, name);
+}
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+
+    if (args.len != 3) {
+        std.debug.print("Usage: zpug-embed <output-dir> <templates-dir>\n", .{});
+        std.process.exit(3);
+    }
+
+    var out_dir = try std.fs.cwd().makeOpenPath(args[1], .{});
+    defer out_dir.close();
+
+    var templates_dir = std.fs.cwd().openDir(args[2], .{ .iterate = true }) catch |err| {
+        std.debug.print("Error: Cannot open templates directory '{s}': {}\n", .{ args[2], err });
+        std.process.exit(2);
+    };
+    defer templates_dir.close();
+
+    generate(allocator, templates_dir, out_dir) catch |err| switch (err) {
+        error.ParseFailed => std.process.exit(1),
+        else => return err,
+    };
+}
+
+/// A template found in the templates directory
+const Found = struct {
+    name: []const u8,
+    path: []const u8, // Relative to the templates directory
+};
+
+/// Write a .zpugc file per template and the templates.zig module
+fn generate(allocator: std.mem.Allocator, templates_dir: std.fs.Dir, out_dir: std.fs.Dir) !void {
+    var arena_state = std.heap.ArenaAllocator.init(allocator);
+    defer arena_state.deinit();
+    const arena = arena_state.allocator();
+
+    var found = std.ArrayList(Found){};
+
+    var walker = try templates_dir.walk(allocator);
+    defer walker.deinit();
+    while (try walker.next()) |entry| {
+        if (entry.kind != .file) continue;
+        for (extensions) |ext| {
+            if (!std.mem.endsWith(u8, entry.path, ext)) continue;
+
+            // Keys always use forward slashes
+            const path = try arena.dupe(u8, entry.path);
+            std.mem.replaceScalar(u8, path, '\\', '/');
+            try found.append(arena, .{ .name = try templateName(arena, path), .path = try arena.dupe(u8, entry.path) });
+            break;
+        }
+    }
+
+    // Sorted so the generated table can be binary searched
+    std.mem.sort(Found, found.items, {}, struct {
+        fn lessThan(_: void, a: Found, b: Found) bool {
+            return std.mem.lessThan(u8, a.name, b.name);
+        }
+    }.lessThan);
+
+    var module = std.ArrayList(u8){};
+    const w = module.writer(arena);
+    try w.writeAll(
+        \\//! Generated by zig-pug (build.zig addTemplates). Do not edit.
+        \\
+        \\const std = @import("std");
+        \\const zig_pug = @import("zig_pug");
+        \\
+        \\/// Every template of the set, by name
+        \\pub const templates = zig_pug.EmbeddedTemplates{ .entries = &.{
+        \\
+    );
+
+    for (found.items, 0..) |tmpl, i| {
+        const source = try templates_dir.readFileAlloc(arena, tmpl.path, 10 * 1024 * 1024);
+
+        var pars = try parser.Parser.init(allocator, source);
+        defer pars.deinit();
+        const tree = pars.parse() catch |err| {
+            std.debug.print("Error: Parsing '{s}' failed: {}\n", .{ tmpl.path, err });
+            return error.ParseFailed;
+        };
+
+        const bytes = try precompiled.serialize(allocator, tree, source);
+        defer allocator.free(bytes);
+
+        const file_name = try std.fmt.allocPrint(arena, "{d}{s}", .{ i, precompiled.file_extension });
+        try out_dir.writeFile(.{ .sub_path = file_name, .data = bytes });
+
+        try w.writeAll("    .{ .name = \"");
+        for (tmpl.name) |c| {
+            if (c == '"' or c == '\\') try w.writeByte('\\');
+            try w.writeByte(c);
+        }
+        try w.print("\", .bytes = @embedFile(\"{s}\") }},\n", .{file_name});
+    }
+
+    try w.writeAll(
+        \\} };
+        \\
+        \\/// Render a template once (see zig_pug.EmbeddedTemplates.render)
+        \\pub fn render(allocator: std.mem.Allocator, name: []const u8, data: anytype) ![]u8 {
+        \\    return templates.render(allocator, name, data);
+        \\}
+        \\
+        \\/// Renderer reusing one runtime and compiler across renders
+        \\pub fn renderer(allocator: std.mem.Allocator) !zig_pug.EmbeddedRenderer {
+        \\    return zig_pug.EmbeddedRenderer.init(allocator, &templates);
+        \\}
+        \\
+    );
+
+    try out_dir.writeFile(.{ .sub_path = "templates.zig", .data = module.items });
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+test "embed - template names" {
+    const cases = [_][2][]const u8{
+        .{ "home.pug", "home" },
+        .{ "blog/post.zpug", "blog/post" },
+        .{ "blog/../partials/header", "partials/header" },
+        .{ "./layout.pug", "layout" },
+    };
+    for (cases) |case| {
+        const name = try templateName(std.testing.allocator, case[0]);
+        defer std.testing.allocator.free(name);
+        try std.testing.expectEqualStrings(case[1], name);
+    }
+}
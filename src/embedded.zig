@@ -0,0 +1,214 @@
+//! Embedded templates - Precompiled templates compiled into the binary
+//!
+//! The `addTemplates` helper in build.zig turns a directory of templates
+//! into a module of precompiled `.zpugc` files embedded with @embedFile
+//! (see embed.zig). This module renders them: templates are decoded on
+//! first use, and include/extends resolve to other templates of the set,
+//! so rendering never reads a file or parses source.
+//!
+//! Example (build.zig of an application):
+//! ```zig
+//! const zig_pug = b.dependency("zig_pug", .{ .target = target, .optimize = optimize });
+//! const templates = @import("zig_pug").addTemplates(b, zig_pug, .{ .root_dir = b.path("views") });
+//! exe.root_module.addImport("templates", templates);
+//! ```
+//!
+//! Application:
+//! ```zig
+//! const templates = @import("templates");
+//!
+//! const html = try templates.render(allocator, "home", .{ .title = "Home" });
+//! defer allocator.free(html);
+//!
+//! // Many renders: keep one runtime and compiler
+//! var renderer = try templates.renderer(allocator);
+//! defer renderer.deinit();
+//! const page = try renderer.render("blog/post", post); // valid until the next render
+//! ```
+
+const std = @import("std");
+const ast = @import("ast.zig");
+const compiler = @import("compiler.zig");
+const runtime = @import("runtime.zig");
+const precompiled = @import("precompiled.zig");
+const embed = @import("embed.zig");
+const diagnostics = @import("diagnostics.zig");
+
+/// One embedded template
+pub const Entry = struct {
+    name: []const u8, // Path relative to the templates directory, no extension
+    bytes: []const u8, // Serialized template (.zpugc)
+};
+
+/// A set of embedded templates, as generated by addTemplates
+pub const Templates = struct {
+    entries: []const Entry, // Sorted by name
+
+    /// Serialized template for a name, or null if not in the set
+    pub fn get(self: *const Templates, name: []const u8) ?*const Entry {
+        const index = std.sort.binarySearch(Entry, self.entries, name, compareName) orelse return null;
+        return &self.entries[index];
+    }
+
+    fn compareName(name: []const u8, entry: Entry) std.math.Order {
+        return std.mem.order(u8, name, entry.name);
+    }
+
+    /// Render a template once
+    ///
+    /// Creates a runtime for this render only; use a Renderer for many.
+    ///
+    /// Parameters:
+    /// - name: Template name (e.g. "blog/post")
+    /// - data: Struct whose fields become template variables (or null)
+    ///
+    /// Returns: HTML (caller owns memory)
+    pub fn render(self: *const Templates, allocator: std.mem.Allocator, name: []const u8, data: anytype) ![]u8 {
+        var renderer = try Renderer.init(allocator, self);
+        defer renderer.deinit();
+        return allocator.dupe(u8, try renderer.render(name, data));
+    }
+};
+
+/// Renders embedded templates with one runtime and compiler
+///
+/// Decoded templates are kept for the renderer's lifetime. Must not be
+/// moved while rendering (the compiler resolves includes through it).
+pub const Renderer = struct {
+    allocator: std.mem.Allocator,
+    templates: *const Templates,
+    runtime: *runtime.JsRuntime,
+    compiler: *compiler.Compiler,
+    loaded: std.StringHashMapUnmanaged(*precompiled.Template) = .{}, // Decoded on first use, by name
+
+    pub fn init(allocator: std.mem.Allocator, templates: *const Templates) !Renderer {
+        const rt = try runtime.JsRuntime.init(allocator);
+        errdefer rt.deinit();
+
+        return .{
+            .allocator = allocator,
+            .templates = templates,
+            .runtime = rt,
+            .compiler = try compiler.Compiler.init(allocator, rt),
+        };
+    }
+
+    pub fn deinit(self: *Renderer) void {
+        var it = self.loaded.valueIterator();
+        while (it.next()) |tmpl| tmpl.*.deinit();
+        self.loaded.deinit(self.allocator);
+        self.compiler.deinit();
+        self.runtime.deinit();
+    }
+
+    /// Render a template with the fields of `data` as variables
+    ///
+    /// Variables from the previous render are removed first.
+    ///
+    /// Returns: HTML owned by the renderer, valid until the next render
+    ///
+    /// Errors:
+    /// - TemplateNotFound: No template with that name in the set
+    pub fn render(self: *Renderer, name: []const u8, data: anytype) ![]const u8 {
+        const entry = self.templates.get(name) orelse return error.TemplateNotFound;
+        const tmpl = try self.load(entry);
+
+        self.runtime.reset();
+        if (@TypeOf(data) != @TypeOf(null)) {
+            const json = try std.json.Stringify.valueAlloc(self.allocator, data, .{});
+            defer self.allocator.free(json);
+            try self.runtime.setVariablesFromJson(json);
+        }
+
+        self.compiler.reset();
+        self.compiler.setTemplateId(std.hash.Wyhash.hash(0, entry.name)); // Trees live as long as the renderer
+        self.compiler.base_path = entry.name; // Includes are relative to the template
+        self.compiler.setResolver(.{ .context = self, .resolveFn = resolve });
+        return self.compiler.render(tmpl.root);
+    }
+
+    fn load(self: *Renderer, entry: *const Entry) !*precompiled.Template {
+        const gop = try self.loaded.getOrPut(self.allocator, entry.name);
+        if (!gop.found_existing) {
+            gop.value_ptr.* = precompiled.Template.fromBytes(self.allocator, entry.bytes) catch |err| {
+                self.loaded.removeByPtr(gop.key_ptr);
+                return err;
+            };
+        }
+        return gop.value_ptr.*;
+    }
+
+    /// compiler.TemplateResolver callback for include/extends paths
+    fn resolve(context: *anyopaque, path: []const u8) ?*ast.AstNode {
+        const self: *Renderer = @ptrCast(@alignCast(context));
+
+        const name = embed.templateName(self.allocator, path) catch return null;
+        defer self.allocator.free(name);
+
+        const entry = self.templates.get(name) orelse return null;
+        const tmpl = self.load(entry) catch |err| {
+            diagnostics.print("Error: Cannot load embedded template '{s}': {}\n", .{ entry.name, err });
+            return null;
+        };
+        return tmpl.root;
+    }
+};
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+test "embedded - render with includes" {
+    const Parser = @import("parser.zig").Parser;
+    const allocator = std.testing.allocator;
+
+    const sources = [_][2][]const u8{
+        .{ "pages/home", "div\n  include ../partials/header\n  p= title" },
+        .{ "partials/header", "h1 Site" },
+    };
+
+    var entries: [sources.len]Entry = undefined;
+    var bytes: [sources.len][]u8 = undefined;
+    for (sources, 0..) |source, i| {
+        var pars = try Parser.init(allocator, source[1]);
+        defer pars.deinit();
+        bytes[i] = try precompiled.serialize(allocator, try pars.parse(), source[1]);
+        entries[i] = .{ .name = source[0], .bytes = bytes[i] };
+    }
+    defer for (bytes) |b| allocator.free(b);
+
+    const templates = Templates{ .entries = &entries };
+    try std.testing.expect(templates.get("pages/missing") == null);
+
+    const html = try templates.render(allocator, "pages/home", .{ .title = "Home" });
+    defer allocator.free(html);
+    try std.testing.expectEqualStrings("<div><h1>Site</h1><p>Home</p></div>", html);
+
+    var renderer = try Renderer.init(allocator, &templates);
+    defer renderer.deinit();
+    try std.testing.expectEqualStrings("<h1>Site</h1>", try renderer.render("partials/header", null));
+    try std.testing.expectError(error.TemplateNotFound, renderer.render("nope", null));
+}
+
+test "embedded - renders do not see earlier variables" {
+    const Parser = @import("parser.zig").Parser;
+    const allocator = std.testing.allocator;
+
+    const source =
+        \\if reveal
+        \\  - var secret = 'classified'
+        \\p= typeof secret === 'undefined' ? 'none' : secret
+    ;
+    var pars = try Parser.init(allocator, source);
+    defer pars.deinit();
+    const bytes = try precompiled.serialize(allocator, try pars.parse(), source);
+    defer allocator.free(bytes);
+
+    const entries = [_]Entry{.{ .name = "pages/secret", .bytes = bytes }};
+    const templates = Templates{ .entries = &entries };
+
+    var renderer = try Renderer.init(allocator, &templates);
+    defer renderer.deinit();
+    try std.testing.expectEqualStrings("<p>classified</p>", try renderer.render("pages/secret", .{ .reveal = true }));
+    try std.testing.expectEqualStrings("<p>none</p>", try renderer.render("pages/secret", .{ .reveal = false }));
+}
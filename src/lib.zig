@@ -8,6 +8,10 @@ const compiler = @import("compiler.zig");
 const runtime = @import("runtime.zig");
 const ast = @import("ast.zig");
 const cache_mod = @import("cache.zig");
+const profiler_mod = @import("profiler.zig");
+const alloc_stats = @import("alloc_stats.zig");
+const precompiled = @import("precompiled.zig");
+const embedded = @import("embedded.zig");
 
 // Export all modules for Zig users
 pub const Tokenizer = tokenizer.Tokenizer;
@@ -18,6 +22,21 @@ pub const JsValue = runtime.JsValue;
 pub const AstNode = ast.AstNode;
 pub const TemplateCache = cache_mod.TemplateCache;
 pub const hashSource = cache_mod.hashSource;
+pub const Profiler = profiler_mod.Profiler;
+pub const AllocStats = alloc_stats.AllocStats;
+pub const PrecompiledTemplate = precompiled.Template;
+pub const EmbeddedTemplates = embedded.Templates;
+pub const EmbeddedRenderer = embedded.Renderer;
+
+// Constant folding and dead-branch elimination (zpug --define)
+pub const optimizer = @import("optimizer.zig");
+
+// Free-variable analysis of templates (data contracts, loop invariants)
+pub const analysis = @import("analysis.zig");
+
+// Ahead-of-time compilation to Zig (zpug --emit-zig)
+pub const aot = @import("aot.zig");
+pub const codegen = @import("codegen.zig");
 
 // Helper functions
 pub const jsValueFromString = runtime.jsValueFromString;
@@ -31,6 +50,7 @@ pub const jsValueFromBool = runtime.jsValueFromBool;
 // Opaque context handles for C API
 pub const ZigPugContext = opaque {};
 pub const ZigPugRuntime = opaque {};
+pub const ZigPugTemplate = opaque {};
 
 /// Initialize a new zig-pug context
 /// Returns: Context handle or null on error
@@ -44,6 +64,22 @@ export fn zigpug_init() ?*ZigPugContext {
     return @ptrCast(ctx);
 }
 
+/// Initialize a context that counts its allocations per phase
+///
+/// Same as zigpug_init, but every allocation made by the tokenizer, the
+/// parser, the compiler and the JavaScript heap is counted. Read the
+/// counters with zigpug_alloc_stats.
+/// Returns: Context handle or null on error
+export fn zigpug_init_with_alloc_stats() ?*ZigPugContext {
+    const allocator = std.heap.c_allocator;
+    const ctx = allocator.create(Context) catch return null;
+    ctx.* = Context.initWithStats(allocator) catch {
+        allocator.destroy(ctx);
+        return null;
+    };
+    return @ptrCast(ctx);
+}
+
 /// Free a zig-pug context
 export fn zigpug_free(ctx: ?*ZigPugContext) void {
     if (ctx) |c| {
@@ -62,15 +98,114 @@ export fn zigpug_compile(ctx: ?*ZigPugContext, pug_source: [*:0]const u8) ?[*:0]
     const html = context.compile(source) catch return null;
 
     // Allocate null-terminated string for C
-    const result = context.allocator.dupeZ(u8, html) catch {
-        context.allocator.free(html);
-        return null;
-    };
-    context.allocator.free(html);
+    const result = context.allocator.dupeZ(u8, html) catch return null;
 
     return result.ptr;
 }
 
+/// Compile a Pug template into a caller-provided buffer
+///
+/// Intended for FFI callers (e.g. bun:ffi) that want to avoid a C string
+/// allocation and a copy per render. The source does not need to be
+/// null-terminated.
+///
+/// Returns: Length of the generated HTML in bytes, or -1 on error.
+/// If the returned length is greater than out_cap nothing is written and
+/// the caller should retry with a buffer of at least that size.
+export fn zigpug_compile_into(
+    ctx: ?*ZigPugContext,
+    pug_source: [*]const u8,
+    source_len: usize,
+    out: ?[*]u8,
+    out_cap: usize,
+) i64 {
+    const context: *Context = @ptrCast(@alignCast(ctx orelse return -1));
+
+    const html = context.compile(pug_source[0..source_len]) catch return -1;
+
+    if (html.len <= out_cap) {
+        if (out) |dest| @memcpy(dest[0..html.len], html);
+    }
+
+    return @intCast(html.len);
+}
+
+/// Copy the HTML of the last compile into a caller-provided buffer
+///
+/// For retrying a zigpug_compile_into call whose buffer was too small: the
+/// HTML it rendered is still held by the context, so copying it avoids
+/// rendering the template a second time (and running its code twice).
+///
+/// Returns: Length of the HTML in bytes, or -1 if the last compile failed
+/// (or there was none). If the length is greater than out_cap nothing is
+/// written.
+export fn zigpug_copy_output(ctx: ?*ZigPugContext, out: ?[*]u8, out_cap: usize) i64 {
+    const context: *Context = @ptrCast(@alignCast(ctx orelse return -1));
+    const html = context.output orelse return -1;
+
+    if (html.len <= out_cap) {
+        if (out) |dest| @memcpy(dest[0..html.len], html);
+    }
+
+    return @intCast(html.len);
+}
+
+/// List the variables a template reads from its data
+///
+/// Free variables of the template and of the mixins it defines (see
+/// analysis.dependencies). Bindings set only these before rendering
+/// instead of the whole data object. Included and extended files are not
+/// scanned, so a template that uses them has no complete list: null tells
+/// the caller to set the whole data object.
+/// Returns: Names separated by '\n' (must be freed with zigpug_free_string),
+/// or null if the template does not parse or includes or extends a file
+export fn zigpug_variables(pug_source: [*:0]const u8) ?[*:0]u8 {
+    const allocator = std.heap.c_allocator;
+
+    var pars = parser.Parser.init(allocator, std.mem.span(pug_source)) catch return null;
+    defer pars.deinit();
+    const tree = pars.parse() catch return null;
+
+    var deps = analysis.dependencies(allocator, tree) catch return null;
+    defer deps.deinit(allocator);
+    if (deps.includes.len > 0) return null;
+
+    const names = std.mem.joinZ(allocator, "\n", deps.variables) catch return null;
+    return names.ptr;
+}
+
+/// Load a precompiled template (.zpugc) written by `zpug --precompile`
+///
+/// The file is mapped into memory and its node tree rebuilt without
+/// tokenizing or parsing. Includes and extends are resolved relative to
+/// the .zpugc file when rendering. The template is independent of any
+/// context and can be rendered by several of them.
+/// Returns: Template handle or null if the file is missing or invalid
+export fn zigpug_template_load(path: [*:0]const u8) ?*ZigPugTemplate {
+    const tmpl = precompiled.Template.load(std.heap.c_allocator, std.mem.span(path)) catch return null;
+    return @ptrCast(tmpl);
+}
+
+/// Render a precompiled template with the context's variables
+/// Returns: Allocated HTML string (must be freed with zigpug_free_string)
+export fn zigpug_template_render(ctx: ?*ZigPugContext, tmpl: ?*ZigPugTemplate) ?[*:0]u8 {
+    const context: *Context = @ptrCast(@alignCast(ctx orelse return null));
+    const template: *precompiled.Template = @ptrCast(@alignCast(tmpl orelse return null));
+
+    const html = context.renderTemplate(template) catch return null;
+
+    const result = context.allocator.dupeZ(u8, html) catch return null;
+    return result.ptr;
+}
+
+/// Free a template returned by zigpug_template_load
+export fn zigpug_template_free(tmpl: ?*ZigPugTemplate) void {
+    if (tmpl) |t| {
+        const template: *precompiled.Template = @ptrCast(@alignCast(t));
+        template.deinit();
+    }
+}
+
 /// Set a string variable in the context
 export fn zigpug_set_string(ctx: ?*ZigPugContext, key: [*:0]const u8, value: [*:0]const u8) bool {
     const context: *Context = @ptrCast(@alignCast(ctx orelse return false));
@@ -123,6 +258,67 @@ export fn zigpug_set_bool(ctx: ?*ZigPugContext, key: [*:0]const u8, value: bool)
     return true;
 }
 
+/// Set several variables at once from a packed binary buffer
+///
+/// Lets FFI callers transfer a whole data object in one call instead of
+/// one call per key. Layout (all integers little-endian):
+///
+///   u32 count
+///   count x { u8 tag, u32 key_len, key bytes, value }
+///
+/// where value depends on tag:
+///   1 = string: u32 len, UTF-8 bytes
+///   2 = number: f64
+///   3 = bool:   u8 (0 or 1)
+///   4 = JSON:   u32 len, JSON text (arrays and objects)
+///
+/// Returns: true on success, false on malformed data or runtime error
+export fn zigpug_set_packed(ctx: ?*ZigPugContext, data: ?[*]const u8, len: usize) bool {
+    const context: *Context = @ptrCast(@alignCast(ctx orelse return false));
+    const bytes = (data orelse return len == 0)[0..len];
+
+    context.setPacked(bytes) catch return false;
+    return true;
+}
+
+/// Allocation counters of one phase (see zigpug_alloc_stats)
+pub const ZigPugAllocCounters = extern struct {
+    allocations: u64, // Successful allocations
+    frees: u64, // Frees
+    bytes: u64, // Total bytes allocated
+    live: u64, // Bytes currently allocated
+    peak: u64, // Highest live bytes
+};
+
+/// Read the allocation counters of a phase
+///
+/// Phases: 0 = tokenize, 1 = parse, 2 = compile, 3 = JavaScript heap.
+/// Returns: false if the context was not created with
+/// zigpug_init_with_alloc_stats or the phase is out of range
+export fn zigpug_alloc_stats(ctx: ?*ZigPugContext, phase: c_int, out: ?*ZigPugAllocCounters) bool {
+    const context: *Context = @ptrCast(@alignCast(ctx orelse return false));
+    const stats = context.stats orelse return false;
+    const phase_tag = std.meta.intToEnum(alloc_stats.Phase, phase) catch return false;
+
+    const c = stats.get(phase_tag);
+    (out orelse return false).* = .{
+        .allocations = c.allocations,
+        .frees = c.frees,
+        .bytes = c.bytes,
+        .live = c.live,
+        .peak = c.peak,
+    };
+    return true;
+}
+
+/// Zero the allocation counters (live bytes become the new peak)
+///
+/// Call before a render to measure that render alone.
+export fn zigpug_alloc_stats_reset(ctx: ?*ZigPugContext) void {
+    const context: *Context = @ptrCast(@alignCast(ctx orelse return));
+    if (context.stats) |stats| stats.reset();
+}
+
 /// Free a string returned by zig-pug
 export fn zigpug_free_string(str: ?[*:0]u8) void {
     if (str) |s| {
@@ -143,31 +339,141 @@ export fn zigpug_version() [*:0]const u8 {
 const Context = struct {
     allocator: std.mem.Allocator,
     runtime: *runtime.JsRuntime,
+    stats: ?*alloc_stats.AllocStats = null, // Set by zigpug_init_with_alloc_stats
+    compiler: *compiler.Compiler, // Reused across renders, reset in between
+    size_hints: std.AutoHashMapUnmanaged(u64, usize) = .{}, // Last HTML size per source hash
+    output: ?[]const u8 = null, // HTML of the last successful compile (in the compiler's buffer)
+
+    /// Templates whose output size is remembered before the table is cleared
+    const max_size_hints = 1024;
 
     fn init(allocator: std.mem.Allocator) !Context {
         const rt = try runtime.JsRuntime.init(allocator);
+        errdefer rt.deinit();
+
         return Context{
             .allocator = allocator,
             .runtime = rt,
+            .compiler = try compiler.Compiler.init(allocator, rt),
+        };
+    }
+
+    fn initWithStats(allocator: std.mem.Allocator) !Context {
+        // Heap-allocated so the phase allocators keep a stable address
+        const stats = try allocator.create(alloc_stats.AllocStats);
+        errdefer allocator.destroy(stats);
+        stats.* = alloc_stats.AllocStats.init(allocator);
+
+        const rt = try runtime.JsRuntime.initWithHeap(stats.allocator(.compile), stats.allocator(.js_heap));
+        errdefer rt.deinit();
+
+        return Context{
+            .allocator = allocator,
+            .runtime = rt,
+            .stats = stats,
+            .compiler = try compiler.Compiler.init(stats.allocator(.compile), rt),
         };
     }
 
     fn deinit(self: *Context) void {
+        self.compiler.deinit();
+        self.size_hints.deinit(self.allocator);
         self.runtime.deinit();
+        if (self.stats) |stats| self.allocator.destroy(stats);
+    }
+
+    /// Allocator for a phase (counted when the context has statistics)
+    fn phaseAllocator(self: *Context, phase: alloc_stats.Phase) std.mem.Allocator {
+        if (self.stats) |stats| return stats.allocator(phase);
+        return self.allocator;
     }
 
+    /// Returns: HTML owned by the context, valid until the next compile
     fn compile(self: *Context, source: []const u8) ![]const u8 {
+        self.output = null;
+
         // Parse
-        var pars = try parser.Parser.init(self.allocator, source);
+        var pars = try parser.Parser.initWithTokenizerAllocator(
+            self.phaseAllocator(.parse),
+            self.phaseAllocator(.tokenize),
+            source,
+        );
         defer pars.deinit();
 
         const tree = try pars.parse();
 
-        // Compile
-        var comp = try compiler.Compiler.init(self.allocator, self.runtime);
-        defer comp.deinit();
+        return self.render(tree, cache_mod.hashSource(source), null, false);
+    }
+
+    /// Returns: HTML owned by the context, valid until the next compile
+    fn renderTemplate(self: *Context, tmpl: *const precompiled.Template) ![]const u8 {
+        return self.render(tmpl.root, tmpl.source_hash, tmpl.path, true);
+    }
+
+    /// Compile a tree, presizing the output from the last render of the
+    /// same source
+    ///
+    /// A tree that outlives the render (`kept`) also keeps its pure mixin
+    /// memo until another template is rendered.
+    fn render(self: *Context, tree: *ast.AstNode, hash: u64, base_path: ?[]const u8, kept: bool) ![]const u8 {
+        self.output = null;
+        self.compiler.reset();
+        self.compiler.setTemplateId(if (kept) hash else null);
+        self.compiler.base_path = base_path;
+        self.compiler.setSizeHint(self.size_hints.get(hash) orelse 0);
+
+        const html = try self.compiler.render(tree);
+
+        if (self.size_hints.count() >= max_size_hints) self.size_hints.clearRetainingCapacity();
+        self.size_hints.put(self.allocator, hash, html.len) catch {};
+
+        self.output = html;
+        return html;
+    }
+
+    fn setPacked(self: *Context, bytes: []const u8) !void {
+        var reader = PackedReader{ .bytes = bytes };
+        const count = try reader.int(u32);
+
+        var i: u32 = 0;
+        while (i < count) : (i += 1) {
+            const tag = try reader.int(u8);
+            const key = try reader.slice(try reader.int(u32));
+
+            switch (tag) {
+                packed_string => try self.runtime.setString(key, try reader.slice(try reader.int(u32))),
+                packed_number => try self.runtime.setNumber(key, @bitCast(try reader.int(u64))),
+                packed_bool => try self.runtime.setBool(key, (try reader.int(u8)) != 0),
+                packed_json => try self.runtime.setJson(key, try reader.slice(try reader.int(u32))),
+                else => return error.InvalidPackedData,
+            }
+        }
+    }
+};
+
+// Tags used by zigpug_set_packed
+const packed_string: u8 = 1;
+const packed_number: u8 = 2;
+const packed_bool: u8 = 3;
+const packed_json: u8 = 4;
+
+const PackedReader = struct {
+    bytes: []const u8,
+    pos: usize = 0,
+
+    fn int(self: *PackedReader, comptime T: type) !T {
+        const size = @sizeOf(T);
+        if (self.bytes.len - self.pos < size) return error.InvalidPackedData;
+        const value = std.mem.readInt(T, self.bytes[self.pos..][0..size], .little);
+        self.pos += size;
+        return value;
+    }
 
-        return try comp.compile(tree);
+    fn slice(self: *PackedReader, len: u32) ![]const u8 {
+        if (self.bytes.len - self.pos < len) return error.InvalidPackedData;
+        const result = self.bytes[self.pos .. self.pos + len];
+        self.pos += len;
+        return result;
     }
 };
 
@@ -191,10 +497,160 @@ test "lib - C API basic usage" {
 
     if (html) |h| {
         const result = std.mem.span(h);
-        try std.testing.expectEqualStrings("<p>HelloWorld</p>", result);
+        try std.testing.expectEqualStrings("<p>Hello World</p>", result);
     }
 }
 
+test "lib - packed variables and compile into buffer" {
+    const ctx = zigpug_init();
+    defer zigpug_free(ctx);
+
+    // { name: "Ana", age: 30, admin: true }
+    var data = std.ArrayList(u8){};
+    defer data.deinit(std.testing.allocator);
+    const w = data.writer(std.testing.allocator);
+    try w.writeInt(u32, 3, .little);
+    try w.writeByte(packed_string);
+    try w.writeInt(u32, 4, .little);
+    try w.writeAll("name");
+    try w.writeInt(u32, 3, .little);
+    try w.writeAll("Ana");
+    try w.writeByte(packed_number);
+    try w.writeInt(u32, 3, .little);
+    try w.writeAll("age");
+    try w.writeInt(u64, @bitCast(@as(f64, 30)), .little);
+    try w.writeByte(packed_bool);
+    try w.writeInt(u32, 5, .little);
+    try w.writeAll("admin");
+    try w.writeByte(1);
+
+    try std.testing.expect(zigpug_set_packed(ctx, data.items.ptr, data.items.len));
+
+    const source = "p #{name + age}";
+    var out: [64]u8 = undefined;
+    const len = zigpug_compile_into(ctx, source.ptr, source.len, &out, out.len);
+    try std.testing.expect(len > 0);
+    try std.testing.expectEqualStrings("<p>Ana30</p>", out[0..@intCast(len)]);
+
+    // Too small: reports the required size without writing
+    var tiny: [4]u8 = undefined;
+    try std.testing.expectEqual(len, zigpug_compile_into(ctx, source.ptr, source.len, &tiny, tiny.len));
+
+    // Truncated data is rejected
+    try std.testing.expect(!zigpug_set_packed(ctx, data.items.ptr, data.items.len - 1));
+}
+
+test "lib - a too small buffer does not render twice" {
+    const ctx = zigpug_init();
+    defer zigpug_free(ctx);
+    const context: *Context = @ptrCast(@alignCast(ctx.?));
+
+    const declared = try context.runtime.eval("var counter = { n: 0 }");
+    std.testing.allocator.free(declared);
+
+    const source = "- counter.n++\np= 'run ' + counter.n";
+    var tiny: [4]u8 = undefined;
+    const len = zigpug_compile_into(ctx, source.ptr, source.len, &tiny, tiny.len);
+    try std.testing.expect(len > @as(i64, tiny.len));
+
+    // The retry copies the HTML already rendered
+    var out: [64]u8 = undefined;
+    try std.testing.expectEqual(len, zigpug_copy_output(ctx, &out, out.len));
+    try std.testing.expectEqualStrings("<p>run 1</p>", out[0..@intCast(len)]);
+
+    const runs = try context.runtime.eval("counter.n");
+    defer std.testing.allocator.free(runs);
+    try std.testing.expectEqualStrings("1", runs);
+
+    // Nothing to copy after a failed compile
+    const bad = "p= (";
+    try std.testing.expectEqual(@as(i64, -1), zigpug_compile_into(ctx, bad.ptr, bad.len, &out, out.len));
+    try std.testing.expectEqual(@as(i64, -1), zigpug_copy_output(ctx, &out, out.len));
+}
+
+test "lib - repeated compiles reuse the compiler" {
+    const ctx = zigpug_init();
+    defer zigpug_free(ctx);
+    const context: *Context = @ptrCast(@alignCast(ctx.?));
+
+    try std.testing.expect(zigpug_set_string(ctx, "name", "World"));
+
+    const first = try context.compile("ul\n  li= name\n  li= name");
+    try std.testing.expectEqualStrings("<ul><li>World</li><li>World</li></ul>", first);
+    const capacity = context.compiler.output.capacity;
+
+    // Same template: presized from the last render, no growth
+    const second = try context.compile("ul\n  li= name\n  li= name");
+    try std.testing.expectEqualStrings("<ul><li>World</li><li>World</li></ul>", second);
+    try std.testing.expectEqual(capacity, context.compiler.output.capacity);
+
+    // A different template starts from a clean compiler
+    try std.testing.expectEqualStrings("<p>World</p>", try context.compile("p= name"));
+}
+
+test "lib - variables a template reads" {
+    const names = zigpug_variables("p #{user.name} #{count}");
+    defer zigpug_free_string(names);
+    try std.testing.expectEqualStrings("count\nuser", std.mem.span(names.?));
+
+    // Partials and layouts are not scanned: the caller binds everything
+    try std.testing.expect(zigpug_variables("include header.pug\np= title") == null);
+    try std.testing.expect(zigpug_variables("extends layout.pug\nblock content\n  p= title") == null);
+}
+
+test "lib - precompiled templates" {
+    const ctx = zigpug_init();
+    defer zigpug_free(ctx);
+    const context: *Context = @ptrCast(@alignCast(ctx.?));
+
+    try std.testing.expect(zigpug_set_string(ctx, "name", "World"));
+
+    const source = "ul\n  li Hello #{name}\n  li= name.length";
+    var pars = try parser.Parser.init(std.testing.allocator, source);
+    defer pars.deinit();
+    const bytes = try precompiled.serialize(std.testing.allocator, try pars.parse(), source);
+    defer std.testing.allocator.free(bytes);
+
+    const tmpl = try precompiled.Template.fromBytes(std.testing.allocator, bytes);
+    defer tmpl.deinit();
+
+    // Same output as compiling the source
+    const expected = try std.testing.allocator.dupe(u8, try context.compile(source));
+    defer std.testing.allocator.free(expected);
+    try std.testing.expectEqualStrings("<ul><li>Hello World</li><li>5</li></ul>", expected);
+    try std.testing.expectEqualStrings(expected, try context.renderTemplate(tmpl));
+
+    try std.testing.expect(zigpug_template_load("does-not-exist.zpugc") == null);
+}
+
+test "lib - allocation statistics per phase" {
+    const ctx = zigpug_init_with_alloc_stats();
+    defer zigpug_free(ctx);
+    try std.testing.expect(ctx != null);
+
+    try std.testing.expect(zigpug_set_string(ctx, "name", "World"));
+    zigpug_alloc_stats_reset(ctx);
+
+    const html = zigpug_compile(ctx, "p Hello #{name}");
+    defer zigpug_free_string(html);
+    try std.testing.expect(html != null);
+
+    var counters: ZigPugAllocCounters = undefined;
+    try std.testing.expect(zigpug_alloc_stats(ctx, 1, &counters)); // parse
+    try std.testing.expect(counters.allocations > 0);
+    try std.testing.expect(zigpug_alloc_stats(ctx, 2, &counters)); // compile
+    try std.testing.expect(counters.allocations > 0);
+    try std.testing.expect(counters.peak > 0);
+    try std.testing.expect(zigpug_alloc_stats(ctx, 3, &counters)); // JS heap
+    try std.testing.expect(counters.allocations > 0);
+    try std.testing.expect(!zigpug_alloc_stats(ctx, 4, &counters));
+
+    // Contexts without statistics report nothing
+    const plain = zigpug_init();
+    defer zigpug_free(plain);
+    try std.testing.expect(!zigpug_alloc_stats(plain, 0, &counters));
+}
+
 test "lib - version" {
     const version = zigpug_version();
     const ver_str = std.mem.span(version);
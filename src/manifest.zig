@@ -0,0 +1,360 @@
+//! Manifest module - Build manifest for incremental directory builds
+//!
+//! `zpug src/ -o dist/` records what every output was built from in
+//! `dist/.zpug-manifest.json`:
+//!
+//! - the content hash of each entry template
+//! - the content hash of every file it pulls in through include/extends
+//! - the hash of the --vars file and of the formatting options
+//!
+//! On the next run an output is rebuilt only if one of those hashes
+//! changed (or the output file is gone), so an unchanged tree is checked
+//! by hashing files, without parsing or rendering anything.
+//!
+//! Format:
+//! ```json
+//! {
+//!   "version": 1,
+//!   "vars": "8c3f0d2a91b4e7f6",
+//!   "options": "0000000000000000",
+//!   "templates": {
+//!     "src/index.pug": {
+//!       "output": "dist/index.html",
+//!       "hash": "1f0e9a...",
+//!       "deps": {"src/layout.pug": "77ab20...", "src/missing.pug": null}
+//!     }
+//!   }
+//! }
+//! ```
+//! Hashes are cache.hashSource (Wyhash) values in hex. A null dependency
+//! hash records a file that did not exist, so creating it triggers a build.
+
+const std = @import("std");
+const cache = @import("cache.zig");
+const serve = @import("serve.zig");
+
+/// Manifest file name, stored in the output directory
+pub const file_name = ".zpug-manifest.json";
+
+/// Bumped whenever the format or the meaning of the hashes changes
+const format_version = 1;
+
+/// Largest file hashed (same limit as template reads)
+const max_file_size = 10 * 1024 * 1024;
+
+/// What one output was built from
+pub const Entry = struct {
+    output: []const u8,
+    hash: u64,
+    deps: []const Dep,
+};
+
+/// A dependency and its content hash (null = file did not exist)
+pub const Dep = struct {
+    path: []const u8,
+    hash: ?u64,
+};
+
+/// Build manifest of an output directory
+///
+/// All strings live in an internal arena, released by deinit().
+///
+/// Usage:
+/// ```zig
+/// var m = try Manifest.load(allocator, "dist/.zpug-manifest.json");
+/// defer m.deinit();
+///
+/// m.setInputs(vars_hash, options_hash);
+/// if (!try m.isUpToDate("src/index.pug", "dist/index.html")) {
+///     // compile, then:
+///     try m.record("src/index.pug", "dist/index.html", deps);
+/// }
+/// try m.save("dist/.zpug-manifest.json");
+/// ```
+pub const Manifest = struct {
+    arena: std.heap.ArenaAllocator,
+    vars_hash: u64 = 0,
+    options_hash: u64 = 0,
+    entries: std.StringHashMapUnmanaged(Entry) = .{},
+    file_hashes: std.StringHashMapUnmanaged(?u64) = .{}, // Current hashes, computed once per run
+
+    const Self = @This();
+
+    /// Create an empty manifest
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return .{ .arena = std.heap.ArenaAllocator.init(allocator) };
+    }
+
+    pub fn deinit(self: *Self) void {
+        self.arena.deinit();
+    }
+
+    /// Load a manifest file
+    ///
+    /// A missing, unreadable or malformed manifest (or one written by a
+    /// different format version) yields an empty manifest, which simply
+    /// rebuilds everything.
+    ///
+    /// Returns: Loaded manifest (only OutOfMemory is reported as an error)
+    pub fn load(allocator: std.mem.Allocator, path: []const u8) !Self {
+        var self = Self.init(allocator);
+        errdefer self.deinit();
+
+        const arena = self.arena.allocator();
+        const bytes = std.fs.cwd().readFileAlloc(arena, path, max_file_size) catch |err| switch (err) {
+            error.OutOfMemory => return err,
+            else => return self,
+        };
+
+        const root = std.json.parseFromSliceLeaky(std.json.Value, arena, bytes, .{}) catch |err| switch (err) {
+            error.OutOfMemory => return err,
+            else => return self,
+        };
+
+        self.parse(root) catch |err| switch (err) {
+            error.OutOfMemory => return err,
+            else => self.entries.clearRetainingCapacity(),
+        };
+        return self;
+    }
+
+    fn parse(self: *Self, root: std.json.Value) !void {
+        const arena = self.arena.allocator();
+
+        if (root != .object) return error.InvalidManifest;
+        const version = root.object.get("version") orelse return error.InvalidManifest;
+        if (version != .integer or version.integer != format_version) return error.InvalidManifest;
+
+        self.vars_hash = try parseHash(root.object.get("vars"));
+        self.options_hash = try parseHash(root.object.get("options"));
+
+        const templates = root.object.get("templates") orelse return error.InvalidManifest;
+        if (templates != .object) return error.InvalidManifest;
+
+        var it = templates.object.iterator();
+        while (it.next()) |item| {
+            const fields = switch (item.value_ptr.*) {
+                .object => |obj| obj,
+                else => return error.InvalidManifest,
+            };
+            const output = fields.get("output") orelse return error.InvalidManifest;
+            if (output != .string) return error.InvalidManifest;
+            const deps_value = fields.get("deps") orelse return error.InvalidManifest;
+            if (deps_value != .object) return error.InvalidManifest;
+
+            const deps = try arena.alloc(Dep, deps_value.object.count());
+            var dep_it = deps_value.object.iterator();
+            var i: usize = 0;
+            while (dep_it.next()) |dep| : (i += 1) {
+                deps[i] = .{
+                    .path = dep.key_ptr.*,
+                    .hash = if (dep.value_ptr.* == .null) null else try parseHash(dep.value_ptr.*),
+                };
+            }
+
+            try self.entries.put(arena, item.key_ptr.*, .{
+                .output = output.string,
+                .hash = try parseHash(fields.get("hash")),
+                .deps = deps,
+            });
+        }
+    }
+
+    fn parseHash(value: ?std.json.Value) !u64 {
+        const v = value orelse return error.InvalidManifest;
+        if (v != .string) return error.InvalidManifest;
+        return std.fmt.parseInt(u64, v.string, 16) catch error.InvalidManifest;
+    }
+
+    /// Set the hashes of the variables and options used for this build
+    ///
+    /// If they differ from the ones recorded, every entry is dropped, since
+    /// any output may depend on them.
+    pub fn setInputs(self: *Self, vars_hash: u64, options_hash: u64) void {
+        if (self.vars_hash != vars_hash or self.options_hash != options_hash) {
+            self.entries.clearRetainingCapacity();
+        }
+        self.vars_hash = vars_hash;
+        self.options_hash = options_hash;
+    }
+
+    /// Check whether an output can be skipped
+    ///
+    /// True if the output exists, was built from `input_path`, and neither
+    /// the template nor any of its recorded dependencies changed.
+    pub fn isUpToDate(self: *Self, input_path: []const u8, output_path: []const u8) !bool {
+        const entry = self.entries.get(input_path) orelse return false;
+        if (!std.mem.eql(u8, entry.output, output_path)) return false;
+
+        std.fs.cwd().access(output_path, .{}) catch return false;
+
+        if (try self.fileHash(input_path) != entry.hash) return false;
+        for (entry.deps) |dep| {
+            if (try self.fileHash(dep.path) != dep.hash) return false;
+        }
+        return true;
+    }
+
+    /// Record a successful build of `input_path`
+    ///
+    /// Parameters:
+    /// - input_path: Entry template
+    /// - output_path: Written HTML file
+    /// - dep_paths: Transitive include/extends dependencies of the entry
+    pub fn record(self: *Self, input_path: []const u8, output_path: []const u8, dep_paths: []const []const u8) !void {
+        const arena = self.arena.allocator();
+
+        const hash = try self.fileHash(input_path) orelse {
+            // Deleted right after being compiled; rebuild next time
+            self.remove(input_path);
+            return;
+        };
+
+        const deps = try arena.alloc(Dep, dep_paths.len);
+        for (deps, dep_paths) |*dep, path| {
+            dep.* = .{ .path = try arena.dupe(u8, path), .hash = try self.fileHash(path) };
+        }
+
+        const key = if (self.entries.getKey(input_path)) |existing| existing else try arena.dupe(u8, input_path);
+        try self.entries.put(arena, key, .{
+            .output = try arena.dupe(u8, output_path),
+            .hash = hash,
+            .deps = deps,
+        });
+    }
+
+    /// Forget an entry (e.g. after a failed build)
+    pub fn remove(self: *Self, input_path: []const u8) void {
+        _ = self.entries.remove(input_path);
+    }
+
+    /// Write the manifest, replacing the file atomically
+    pub fn save(self: *const Self, path: []const u8) !void {
+        var out = std.ArrayList(u8){};
+        const allocator = self.arena.child_allocator;
+        defer out.deinit(allocator);
+        const w = out.writer(allocator);
+
+        try w.print("{{\n  \"version\": {d},\n  \"vars\": \"{x:0>16}\",\n  \"options\": \"{x:0>16}\",\n  \"templates\": {{", .{
+            format_version,
+            self.vars_hash,
+            self.options_hash,
+        });
+
+        // Sorted so unchanged builds produce identical files
+        const keys = try allocator.alloc([]const u8, self.entries.count());
+        defer allocator.free(keys);
+        var key_it = self.entries.keyIterator();
+        var n: usize = 0;
+        while (key_it.next()) |key| : (n += 1) keys[n] = key.*;
+        std.mem.sort([]const u8, keys, {}, lessThan);
+
+        for (keys, 0..) |key, i| {
+            const entry = self.entries.get(key).?;
+            try w.writeAll(if (i == 0) "\n    " else ",\n    ");
+            try serve.writeJsonString(w, key);
+            try w.writeAll(": {\"output\": ");
+            try serve.writeJsonString(w, entry.output);
+            try w.print(", \"hash\": \"{x:0>16}\", \"deps\": {{", .{entry.hash});
+            for (entry.deps, 0..) |dep, j| {
+                if (j > 0) try w.writeAll(", ");
+                try serve.writeJsonString(w, dep.path);
+                if (dep.hash) |hash| {
+                    try w.print(": \"{x:0>16}\"", .{hash});
+                } else {
+                    try w.writeAll(": null");
+                }
+            }
+            try w.writeAll("}}");
+        }
+        try w.writeAll(if (keys.len == 0) "}\n}\n" else "\n  }\n}\n");
+
+        const tmp_path = try std.fmt.allocPrint(allocator, "{s}.tmp", .{path});
+        defer allocator.free(tmp_path);
+        try std.fs.cwd().writeFile(.{ .sub_path = tmp_path, .data = out.items });
+        try std.fs.cwd().rename(tmp_path, path);
+    }
+
+    /// Current content hash of a file (null if it cannot be read)
+    fn fileHash(self: *Self, path: []const u8) !?u64 {
+        if (self.file_hashes.get(path)) |hash| return hash;
+
+        const arena = self.arena.allocator();
+        const allocator = self.arena.child_allocator;
+
+        const hash: ?u64 = blk: {
+            const source = std.fs.cwd().readFileAlloc(allocator, path, max_file_size) catch |err| switch (err) {
+                error.OutOfMemory => return err,
+                else => break :blk null,
+            };
+            defer allocator.free(source);
+            break :blk cache.hashSource(source);
+        };
+
+        try self.file_hashes.put(arena, try arena.dupe(u8, path), hash);
+        return hash;
+    }
+
+    fn lessThan(_: void, a: []const u8, b: []const u8) bool {
+        return std.mem.lessThan(u8, a, b);
+    }
+};
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+test "manifest - skip unchanged and detect dependency changes" {
+    const allocator = std.testing.allocator;
+
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    try tmp.dir.writeFile(.{ .sub_path = "page.pug", .data = "include nav.pug\n" });
+    try tmp.dir.writeFile(.{ .sub_path = "nav.pug", .data = "nav Menu\n" });
+    try tmp.dir.writeFile(.{ .sub_path = "page.html", .data = "<nav>Menu</nav>" });
+
+    const dir_path = try tmp.dir.realpathAlloc(allocator, ".");
+    defer allocator.free(dir_path);
+    const page = try std.fs.path.join(allocator, &.{ dir_path, "page.pug" });
+    defer allocator.free(page);
+    const nav = try std.fs.path.join(allocator, &.{ dir_path, "nav.pug" });
+    defer allocator.free(nav);
+    const html = try std.fs.path.join(allocator, &.{ dir_path, "page.html" });
+    defer allocator.free(html);
+    const path = try std.fs.path.join(allocator, &.{ dir_path, file_name });
+    defer allocator.free(path);
+
+    {
+        var m = try Manifest.load(allocator, path);
+        defer m.deinit();
+        m.setInputs(1, 2);
+        try std.testing.expect(!try m.isUpToDate(page, html));
+        try m.record(page, html, &.{nav});
+        try m.save(path);
+    }
+
+    {
+        var m = try Manifest.load(allocator, path);
+        defer m.deinit();
+        m.setInputs(1, 2);
+        try std.testing.expect(try m.isUpToDate(page, html));
+    }
+
+    // Changing a dependency invalidates the entry
+    try tmp.dir.writeFile(.{ .sub_path = "nav.pug", .data = "nav Home\n" });
+    {
+        var m = try Manifest.load(allocator, path);
+        defer m.deinit();
+        m.setInputs(1, 2);
+        try std.testing.expect(!try m.isUpToDate(page, html));
+    }
+
+    // Different variables invalidate everything
+    {
+        var m = try Manifest.load(allocator, path);
+        defer m.deinit();
+        m.setInputs(3, 2);
+        try std.testing.expectEqual(@as(u32, 0), m.entries.count());
+    }
+}
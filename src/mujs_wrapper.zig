@@ -1,6 +1,7 @@
 /// Wrapper de Zig para la API de mujs (lightweight JavaScript interpreter)
 /// mujs documentation: https://mujs.com/reference.html
 const std = @import("std");
+const diagnostics = @import("diagnostics.zig");
 
 // Opaque type para el estado de mujs
 pub const MuJsState = opaque {};
@@ -12,7 +13,10 @@ pub const CFunction = *const fn (*MuJsState) callconv(.C) void;
 // State management
 // ============================================================================
 
-pub extern fn js_newstate(alloc: ?*anyopaque, actx: ?*anyopaque, flags: c_int) ?*MuJsState;
+/// Heap callback: realloc(ptr, size), or free(ptr) when size is 0
+pub const JsAlloc = *const fn (actx: ?*anyopaque, ptr: ?*anyopaque, size: c_int) callconv(.C) ?*anyopaque;
+
+pub extern fn js_newstate(alloc: ?JsAlloc, actx: ?*anyopaque, flags: c_int) ?*MuJsState;
 pub extern fn js_freestate(J: ?*MuJsState) void;
 pub extern fn js_gc(J: ?*MuJsState, report: c_int) void;
 
@@ -34,6 +38,7 @@ pub extern fn js_pcall(J: ?*MuJsState, n: c_int) c_int;
 pub extern fn js_gettop(J: ?*MuJsState) c_int;
 pub extern fn js_pop(J: ?*MuJsState, n: c_int) void;
 pub extern fn js_copy(J: ?*MuJsState, idx: c_int) void;
+pub extern fn js_remove(J: ?*MuJsState, idx: c_int) void;
 
 // ============================================================================
 // Push values onto stack
@@ -44,7 +49,10 @@ pub extern fn js_pushnull(J: ?*MuJsState) void;
 pub extern fn js_pushboolean(J: ?*MuJsState, v: c_int) void;
 pub extern fn js_pushnumber(J: ?*MuJsState, v: f64) void;
 pub extern fn js_pushstring(J: ?*MuJsState, s: [*:0]const u8) void;
+pub extern fn js_pushlstring(J: ?*MuJsState, s: [*]const u8, n: c_int) void;
+pub extern fn js_pushglobal(J: ?*MuJsState) void;
 pub extern fn js_newobject(J: ?*MuJsState) void;
+pub extern fn js_newarray(J: ?*MuJsState) void;
 pub extern fn js_newcfunction(J: ?*MuJsState, fun: CFunction, name: [*:0]const u8, length: c_int) void;
 
 // ============================================================================
@@ -72,6 +80,11 @@ pub extern fn js_isstring(J: ?*MuJsState, idx: c_int) c_int;
 
 pub extern fn js_getglobal(J: ?*MuJsState, name: [*:0]const u8) void;
 pub extern fn js_setglobal(J: ?*MuJsState, name: [*:0]const u8) void;
+pub extern fn js_delglobal(J: ?*MuJsState, name: [*:0]const u8) void;
+
+// Registry: a hidden object for values kept by the host
+pub extern fn js_getregistry(J: ?*MuJsState, name: [*:0]const u8) void;
+pub extern fn js_setregistry(J: ?*MuJsState, name: [*:0]const u8) void;
 
 // ============================================================================
 // Object property access
@@ -79,33 +92,269 @@ pub extern fn js_setglobal(J: ?*MuJsState, name: [*:0]const u8) void;
 
 pub extern fn js_getproperty(J: ?*MuJsState, idx: c_int, name: [*:0]const u8) void;
 pub extern fn js_setproperty(J: ?*MuJsState, idx: c_int, name: [*:0]const u8) void;
+pub extern fn js_delproperty(J: ?*MuJsState, idx: c_int, name: [*:0]const u8) void;
+/// Pushes the property's value and returns 1 when the object has it
+pub extern fn js_hasproperty(J: ?*MuJsState, idx: c_int, name: [*:0]const u8) c_int;
+pub extern fn js_setindex(J: ?*MuJsState, idx: c_int, i: c_int) void;
+
+// Iterate own enumerable property names of the object at idx
+pub extern fn js_pushiterator(J: ?*MuJsState, idx: c_int, own: c_int) void;
+pub extern fn js_nextiterator(J: ?*MuJsState, idx: c_int) ?[*:0]const u8;
+
+// ============================================================================
+// Streaming JSON to mujs values
+// ============================================================================
+
+/// Deepest array/object nesting accepted from JSON (bounded by the mujs stack)
+const max_json_depth = 64;
+
+pub const JsonError = std.json.Scanner.NextError || error{
+    InvalidJson, // Not an object at the root, or a number mujs can't take
+    JsonTooDeep, // Nesting deeper than max_json_depth
+};
+
+/// Builds mujs values from std.json.Scanner tokens
+const JsonBuilder = struct {
+    state: *MuJsState,
+    allocator: std.mem.Allocator,
+    scanner: *std.json.Scanner,
+    base_top: c_int = 0, // Stack height before building
+    keys: std.ArrayList(u8) = .{}, // Null-terminated keys of the open objects
+    text: std.ArrayList(u8) = .{}, // Pieces of a string split by escapes
+
+    fn deinit(self: *JsonBuilder) void {
+        self.keys.deinit(self.allocator);
+        self.text.deinit(self.allocator);
+    }
+
+    fn globals(self: *JsonBuilder) JsonError!void {
+        self.base_top = js_gettop(self.state);
+        if (try self.scanner.next() != .object_begin) return error.InvalidJson;
+
+        while (true) {
+            const token = try self.scanner.next();
+            if (token == .object_end) break;
+
+            const key = try self.pushKey(token);
+            try self.pushValue(try self.scanner.next(), 0);
+            js_setglobal(self.state, self.keyAt(key));
+            self.keys.shrinkRetainingCapacity(key);
+        }
+
+        if (try self.scanner.next() != .end_of_document) return error.InvalidJson;
+    }
+
+    fn pushValue(self: *JsonBuilder, token: std.json.Token, depth: usize) JsonError!void {
+        switch (token) {
+            .object_begin => {
+                if (depth >= max_json_depth) return error.JsonTooDeep;
+                js_newobject(self.state);
+                while (true) {
+                    const key_token = try self.scanner.next();
+                    if (key_token == .object_end) break;
+
+                    const key = try self.pushKey(key_token);
+                    try self.pushValue(try self.scanner.next(), depth + 1);
+                    js_setproperty(self.state, -2, self.keyAt(key));
+                    self.keys.shrinkRetainingCapacity(key);
+                }
+            },
+            .array_begin => {
+                if (depth >= max_json_depth) return error.JsonTooDeep;
+                js_newarray(self.state);
+                var index: c_int = 0;
+                while (true) {
+                    const item = try self.scanner.next();
+                    if (item == .array_end) break;
+
+                    try self.pushValue(item, depth + 1);
+                    js_setindex(self.state, -2, index);
+                    index += 1;
+                }
+            },
+            .true => js_pushboolean(self.state, 1),
+            .false => js_pushboolean(self.state, 0),
+            .null => js_pushnull(self.state),
+            .number, .partial_number => {
+                const text = try self.tokenText(token);
+                const value = std.fmt.parseFloat(f64, text) catch return error.InvalidJson;
+                js_pushnumber(self.state, value);
+            },
+            .string,
+            .partial_string,
+            .partial_string_escaped_1,
+            .partial_string_escaped_2,
+            .partial_string_escaped_3,
+            .partial_string_escaped_4,
+            => {
+                const text = try self.tokenText(token);
+                const len = std.math.cast(c_int, text.len) orelse return error.InvalidJson;
+                js_pushlstring(self.state, text.ptr, len);
+            },
+            else => return error.InvalidJson,
+        }
+    }
+
+    /// Copy an object key (null-terminated) and return its offset in keys
+    ///
+    /// Keys of nested objects are stacked after it and removed again before
+    /// the key is used, so it is always the last one when its value is set.
+    fn pushKey(self: *JsonBuilder, token: std.json.Token) JsonError!usize {
+        const start = self.keys.items.len;
+        try self.keys.appendSlice(self.allocator, try self.tokenText(token));
+        try self.keys.append(self.allocator, 0);
+        return start;
+    }
+
+    fn keyAt(self: *const JsonBuilder, start: usize) [*:0]const u8 {
+        return self.keys.items[start .. self.keys.items.len - 1 :0].ptr;
+    }
+
+    /// Full text of a string or number, joining the pieces the scanner
+    /// returns around escape sequences (valid until the next call)
+    fn tokenText(self: *JsonBuilder, first: std.json.Token) JsonError![]const u8 {
+        self.text.clearRetainingCapacity();
+        var token = first;
+        while (true) {
+            switch (token) {
+                .string, .number => |last| {
+                    if (self.text.items.len == 0) return last;
+                    try self.text.appendSlice(self.allocator, last);
+                    return self.text.items;
+                },
+                .partial_string, .partial_number => |piece| try self.text.appendSlice(self.allocator, piece),
+                .partial_string_escaped_1 => |piece| try self.text.appendSlice(self.allocator, &piece),
+                .partial_string_escaped_2 => |piece| try self.text.appendSlice(self.allocator, &piece),
+                .partial_string_escaped_3 => |piece| try self.text.appendSlice(self.allocator, &piece),
+                .partial_string_escaped_4 => |piece| try self.text.appendSlice(self.allocator, &piece),
+                else => return error.InvalidJson,
+            }
+            token = try self.scanner.next();
+        }
+    }
+};
 
 // ============================================================================
 // High-level Zig wrapper for mujs
 // ============================================================================
 
+/// Result of an expression, with enough of its type for typed comparisons
+pub const EvalResult = struct {
+    text: []const u8, // String(value), as templates render it
+    kind: Kind,
+    number: f64 = 0, // The value, when kind is .number
+
+    pub const Kind = enum {
+        string,
+        number,
+        other, // Booleans, null, undefined, objects
+    };
+};
+
 pub const JsRuntime = struct {
     state: *MuJsState,
     allocator: std.mem.Allocator,
+    heap: ?std.mem.Allocator, // Allocator backing the mujs heap (null = libc)
+    compiled: usize, // Scripts kept in the registry by evalCachedAlloc
 
     const Self = @This();
 
+    /// Most expressions kept compiled in the registry
+    const max_compiled = 4096;
+
+    /// Registry key prefix, so expressions never collide with other entries
+    /// (or with keys such as __proto__)
+    const compiled_prefix = "expr:";
+
+    /// Most stack slots call frames may hold; JS_STACKSIZE is 4096 and the
+    /// rest is left to the expressions evaluated inside the frames
+    const frame_stack_limit = 2048;
+
+    /// Registry key of the function behind frameKey()
+    const frame_key_fn = "frameKey";
+
+    /// Registry key of the function behind reset()
+    const reset_fn = "reset";
+
+    /// Called with the global object when the runtime is created: records
+    /// the builtins and returns the function that reset() calls. Globals
+    /// that are not builtins are deleted, or set to undefined when they
+    /// cannot be (`var` declarations are non-configurable); builtins that
+    /// were replaced get their original value back.
+    const reset_source =
+        \\(function (global) {
+        \\  var names = Object.getOwnPropertyNames;
+        \\  var has = Object.prototype.hasOwnProperty;
+        \\  var builtins = {};
+        \\  var list = names(global);
+        \\  for (var i = 0; i < list.length; i++) builtins[list[i]] = global[list[i]];
+        \\  return function () {
+        \\    var list = names(global);
+        \\    for (var i = 0; i < list.length; i++) {
+        \\      var name = list[i];
+        \\      if (has.call(builtins, name)) {
+        \\        if (global[name] !== builtins[name]) global[name] = builtins[name];
+        \\      } else if (!(delete global[name])) {
+        \\        global[name] = undefined;
+        \\      }
+        \\    }
+        \\  };
+        \\})
+    ;
+
+    /// Serializes argument values so that different values never give the
+    /// same text: strings, numbers and undefined are tagged, and values
+    /// that are not plain data (functions, dates, class instances) or are
+    /// cyclic throw
+    const frame_key_source =
+        \\(function (values) {
+        \\  return JSON.stringify(values, function (key, value) {
+        \\    var raw = this[key];
+        \\    switch (typeof raw) {
+        \\    case 'string': return 's' + raw;
+        \\    case 'number': return 'n' + raw;
+        \\    case 'undefined': return 'u';
+        \\    case 'function': throw 0;
+        \\    case 'object':
+        \\      if (raw !== null && !Array.isArray(raw) && Object.getPrototypeOf(raw) !== Object.prototype) throw 0;
+        \\    }
+        \\    return value;
+        \\  });
+        \\})
+    ;
+
     /// Initialize a new JavaScript runtime using mujs
     pub fn init(allocator: std.mem.Allocator) !*Self {
+        return initWithHeap(allocator, null);
+    }
+
+    /// Initialize a runtime whose mujs heap is allocated from `heap`
+    ///
+    /// Used to count JavaScript heap allocations (--alloc-stats). Without a
+    /// heap allocator mujs uses libc realloc/free.
+    pub fn initWithHeap(allocator: std.mem.Allocator, heap: ?std.mem.Allocator) !*Self {
         const runtime = try allocator.create(Self);
         errdefer allocator.destroy(runtime);
 
-        const state = js_newstate(null, null, 0) orelse {
+        // The callback context points into the runtime, so set heap first
+        runtime.heap = heap;
+        const state = (if (heap != null)
+            js_newstate(heapAlloc, &runtime.heap, 0)
+        else
+            js_newstate(null, null, 0)) orelse {
             return error.InitFailed;
         };
 
         runtime.* = .{
             .state = state,
             .allocator = allocator,
+            .heap = heap,
+            .compiled = 0,
         };
 
         // Setup basic console.log functionality
         try runtime.setupConsole();
+        try runtime.setupReset();
 
         return runtime;
     }
@@ -116,6 +365,35 @@ pub const JsRuntime = struct {
         self.allocator.destroy(self);
     }
 
+    /// Bytes in front of each heap block, holding the block's size
+    const heap_header = 16;
+
+    /// mujs heap callback backed by a Zig allocator
+    fn heapAlloc(actx: ?*anyopaque, ptr: ?*anyopaque, size: c_int) callconv(.C) ?*anyopaque {
+        const heap: *const ?std.mem.Allocator = @ptrCast(@alignCast(actx.?));
+        const allocator = heap.*.?;
+
+        const old: ?[]align(heap_header) u8 = if (ptr) |p| blk: {
+            const base: [*]align(heap_header) u8 = @ptrFromInt(@intFromPtr(p) - heap_header);
+            const len = @as(*const usize, @ptrCast(base)).*;
+            break :blk base[0 .. heap_header + len];
+        } else null;
+
+        if (size <= 0) {
+            if (old) |block| allocator.free(block);
+            return null;
+        }
+
+        const len: usize = @intCast(size);
+        const block = if (old) |block|
+            allocator.realloc(block, heap_header + len) catch return null
+        else
+            allocator.alignedAlloc(u8, std.mem.Alignment.fromByteUnits(heap_header), heap_header + len) catch return null;
+
+        @as(*usize, @ptrCast(block.ptr)).* = len;
+        return block.ptr + heap_header;
+    }
+
     /// Setup console object with log function
     fn setupConsole(self: *Self) !void {
         // Create a simple console.log stub (no-op for now)
@@ -131,35 +409,234 @@ pub const JsRuntime = struct {
         js_pop(self.state, 1); // Pop result
     }
 
+    /// Record the globals that exist now (builtins and console) for reset()
+    fn setupReset(self: *Self) !void {
+        self.pushResult(self.allocator, reset_source, false) catch |err| switch (err) {
+            error.OutOfMemory => return err,
+            else => return error.InitFailed,
+        };
+        js_pushundefined(self.state);
+        js_pushglobal(self.state);
+        if (js_pcall(self.state, 1) != 0) {
+            js_pop(self.state, 1); // Pop error message
+            return error.InitFailed;
+        }
+        js_setregistry(self.state, reset_fn);
+    }
+
     /// Evaluate a JavaScript expression and return the result as a string
     pub fn eval(self: *Self, expr: []const u8) ![]const u8 {
-        // Create null-terminated string for the expression
-        const expr_z = try self.allocator.dupeZ(u8, expr);
-        defer self.allocator.free(expr_z);
+        return self.evalAlloc(self.allocator, expr);
+    }
 
-        // Load and compile the code
-        if (js_ploadstring(self.state, "[eval]", expr_z) != 0) {
-            const err_msg = js_trystring(self.state, -1, "unknown compile error");
-            std.debug.print("mujs compile error: {s}\n", .{err_msg});
-            js_pop(self.state, 1);
-            return error.CompileError;
+    /// Evaluate an expression, allocating the copies from `allocator`
+    ///
+    /// The compiler passes its per-render scratch arena, so the expression
+    /// and result copies are never freed one by one.
+    pub fn evalAlloc(self: *Self, allocator: std.mem.Allocator, expr: []const u8) ![]const u8 {
+        try self.pushResult(allocator, expr, false);
+        return self.popString(allocator);
+    }
+
+    /// Evaluate an expression, compiling it only the first time it is seen
+    ///
+    /// The compiled script is kept in the registry under the expression
+    /// text, so template expressions evaluated again (mixin and loop bodies)
+    /// skip the parser. Generated statements that differ on every call
+    /// should use evalAlloc() instead; past max_compiled entries this
+    /// behaves like evalAlloc().
+    pub fn evalCachedAlloc(self: *Self, allocator: std.mem.Allocator, expr: []const u8) ![]const u8 {
+        try self.pushResult(allocator, expr, true);
+        return self.popString(allocator);
+    }
+
+    /// Evaluate an expression (compiled once, as evalCachedAlloc), keeping its type
+    pub fn evalResultAlloc(self: *Self, allocator: std.mem.Allocator, expr: []const u8) !EvalResult {
+        try self.pushResult(allocator, expr, true);
+        const kind: EvalResult.Kind = if (js_isnumber(self.state, -1) != 0)
+            .number
+        else if (js_isstring(self.state, -1) != 0)
+            .string
+        else
+            .other;
+        const number = if (kind == .number) js_tonumber(self.state, -1) else 0;
+        return .{ .text = try self.popString(allocator), .kind = kind, .number = number };
+    }
+
+    /// Run an expression and leave its result on the stack
+    fn pushResult(self: *Self, allocator: std.mem.Allocator, expr: []const u8, cache: bool) !void {
+        const key = try std.mem.concatWithSentinel(allocator, u8, &.{ compiled_prefix, expr }, 0);
+        defer allocator.free(key);
+
+        if (cache) {
+            js_getregistry(self.state, key);
+            if (js_isundefined(self.state, -1) != 0) {
+                js_pop(self.state, 1);
+                try self.load(key[compiled_prefix.len..]);
+                if (self.compiled < max_compiled) {
+                    js_copy(self.state, -1);
+                    js_setregistry(self.state, key); // Pops the copy
+                    self.compiled += 1;
+                }
+            }
+        } else {
+            try self.load(key[compiled_prefix.len..]);
         }
 
         // Call with no arguments (pushundefined is 'this')
         js_pushundefined(self.state);
         if (js_pcall(self.state, 0) != 0) {
             const err_msg = js_trystring(self.state, -1, "unknown runtime error");
-            std.debug.print("mujs runtime error in '{s}': {s}\n", .{ expr, err_msg });
+            diagnostics.print("mujs runtime error in '{s}': {s}\n", .{ expr, err_msg });
             js_pop(self.state, 1);
             return error.RuntimeError;
         }
+    }
+
+    /// Compile an expression and push the resulting script
+    fn load(self: *Self, source: [:0]const u8) !void {
+        if (js_ploadstring(self.state, "[eval]", source) != 0) {
+            const err_msg = js_trystring(self.state, -1, "unknown compile error");
+            diagnostics.print("mujs compile error: {s}\n", .{err_msg});
+            js_pop(self.state, 1);
+            return error.CompileError;
+        }
+    }
 
-        // Get the result as string
+    /// Pop the value on top of the stack as a string
+    fn popString(self: *Self, allocator: std.mem.Allocator) ![]const u8 {
+        defer js_pop(self.state, 1);
         const result_cstr = js_tostring(self.state, -1);
-        const result = try self.allocator.dupe(u8, std.mem.span(result_cstr));
-        js_pop(self.state, 1);
+        return allocator.dupe(u8, std.mem.span(result_cstr));
+    }
+
+    /// A global name bound by pushFrame()
+    pub const Binding = struct {
+        name: [:0]const u8,
+        existed: bool, // Whether the name was a global before the call
+    };
+
+    /// Names bound for one call, and where their values sit on the stack
+    ///
+    /// The stack holds the argument values from `base`, followed by the
+    /// values the names had before the call.
+    pub const Frame = struct {
+        base: c_int,
+        bindings: []const Binding,
+    };
+
+    /// Bind call arguments to parameter names until popFrame()
+    ///
+    /// Every argument is evaluated once, in the caller's scope, before any
+    /// name is bound; the values are assigned directly, without generating
+    /// JavaScript source. Arguments that fail to evaluate are undefined.
+    /// Missing arguments are undefined and the rest parameter (if any) gets
+    /// an array of the remaining ones. The previous values of the names are
+    /// kept on the stack, so nested and recursive calls each see their own
+    /// arguments and nothing is left in the global scope afterwards.
+    ///
+    /// Parameters:
+    /// - allocator: Allocator for the frame (an arena, it is never freed)
+    /// - params: Parameter names
+    /// - rest: Rest parameter name, if any
+    /// - args: Argument expressions
+    pub fn pushFrame(
+        self: *Self,
+        allocator: std.mem.Allocator,
+        params: []const []const u8,
+        rest: ?[]const u8,
+        args: []const []const u8,
+    ) !Frame {
+        const base = js_gettop(self.state);
+        const count = params.len + @intFromBool(rest != null);
+        if (base + 2 * @as(c_int, @intCast(count)) + 1 > frame_stack_limit) return error.StackOverflow;
+        errdefer js_pop(self.state, js_gettop(self.state) - base);
+
+        for (params, 0..) |_, i| {
+            if (i < args.len) try self.pushArgument(allocator, args[i]) else js_pushundefined(self.state);
+        }
+        if (rest != null) {
+            js_newarray(self.state);
+            for (args[@min(params.len, args.len)..], 0..) |arg, i| {
+                try self.pushArgument(allocator, arg);
+                js_setindex(self.state, -2, @intCast(i)); // Pops the value
+            }
+        }
+
+        // Save the current values, then bind the arguments
+        const bindings = try allocator.alloc(Binding, count);
+        for (bindings, 0..) |*binding, i| {
+            binding.name = try allocator.dupeZ(u8, if (i < params.len) params[i] else rest.?);
+            js_pushglobal(self.state);
+            binding.existed = js_hasproperty(self.state, -1, binding.name) != 0;
+            if (!binding.existed) js_pushundefined(self.state);
+            js_remove(self.state, -2); // Drop the global object
+        }
+        for (bindings, 0..) |binding, i| {
+            js_copy(self.state, base + @as(c_int, @intCast(i)));
+            js_setglobal(self.state, binding.name);
+        }
+
+        return .{ .base = base, .bindings = bindings };
+    }
 
-        return result;
+    /// Restore the names bound by pushFrame() and drop the frame's values
+    pub fn popFrame(self: *Self, frame: Frame) void {
+        const saved = frame.base + @as(c_int, @intCast(frame.bindings.len));
+
+        // In reverse, so a name bound twice gets its oldest value back
+        var i = frame.bindings.len;
+        while (i > 0) {
+            i -= 1;
+            const binding = frame.bindings[i];
+            if (binding.existed) {
+                js_copy(self.state, saved + @as(c_int, @intCast(i)));
+                js_setglobal(self.state, binding.name);
+            } else {
+                js_delglobal(self.state, binding.name);
+            }
+        }
+        js_pop(self.state, js_gettop(self.state) - frame.base);
+    }
+
+    /// Text identifying the argument values of a frame
+    ///
+    /// Equal keys mean equal values: primitives of the same type and value,
+    /// and plain objects and arrays with equal contents. Returns null when
+    /// an argument is not plain data (a function, a date, an object with a
+    /// prototype of its own) or is cyclic.
+    pub fn frameKey(self: *Self, allocator: std.mem.Allocator, frame: Frame) !?[]const u8 {
+        js_getregistry(self.state, frame_key_fn);
+        if (js_isundefined(self.state, -1) != 0) {
+            js_pop(self.state, 1);
+            self.pushResult(allocator, frame_key_source, false) catch |err| switch (err) {
+                error.OutOfMemory => return err,
+                error.CompileError, error.RuntimeError => return null,
+            };
+            js_copy(self.state, -1);
+            js_setregistry(self.state, frame_key_fn); // Pops the copy
+        }
+
+        // Stack: function, this, [arguments...]
+        js_pushundefined(self.state);
+        js_newarray(self.state);
+        for (0..frame.bindings.len) |i| {
+            js_copy(self.state, frame.base + @as(c_int, @intCast(i)));
+            js_setindex(self.state, -2, @intCast(i)); // Pops the copy
+        }
+        if (js_pcall(self.state, 1) != 0) {
+            js_pop(self.state, 1); // Pop the exception
+            return null;
+        }
+        return try self.popString(allocator);
+    }
+
+    /// Push the value of an argument (undefined when it fails)
+    fn pushArgument(self: *Self, allocator: std.mem.Allocator, arg: []const u8) !void {
+        self.pushResult(allocator, arg, true) catch |err| switch (err) {
+            error.OutOfMemory => return err,
+            error.CompileError, error.RuntimeError => js_pushundefined(self.state),
+        };
     }
 
     /// Set a string variable in the global scope
@@ -296,7 +773,7 @@ pub const JsRuntime = struct {
         defer self.allocator.free(code);
 
         _ = self.eval(code) catch |err| {
-            std.debug.print("Error setting array '{s}': {}\n", .{ key, err });
+            diagnostics.print("Error setting array '{s}': {}\n", .{ key, err });
             return err;
         };
     }
@@ -374,11 +851,76 @@ pub const JsRuntime = struct {
         defer self.allocator.free(code);
 
         _ = self.eval(code) catch |err| {
-            std.debug.print("Error setting object '{s}': {}\n", .{ key, err });
+            diagnostics.print("Error setting object '{s}': {}\n", .{ key, err });
             return err;
         };
     }
 
+    /// Set a global variable from JSON text (any JSON value, nested included)
+    ///
+    /// Uses the interpreter's own JSON.parse, so no JavaScript source is
+    /// generated and the value keeps its full structure.
+    pub fn setJson(self: *Self, key: []const u8, json: []const u8) !void {
+        const key_z = try self.allocator.dupeZ(u8, key);
+        defer self.allocator.free(key_z);
+
+        if (json.len > std.math.maxInt(c_int)) return error.RuntimeError;
+
+        // Stack: JSON, JSON.parse, this=JSON, text
+        js_getglobal(self.state, "JSON");
+        js_getproperty(self.state, -1, "parse");
+        js_copy(self.state, -2);
+        js_pushlstring(self.state, json.ptr, @intCast(json.len));
+
+        if (js_pcall(self.state, 1) != 0) {
+            const err_msg = js_trystring(self.state, -1, "unknown JSON error");
+            diagnostics.print("mujs JSON error for '{s}': {s}\n", .{ key, err_msg });
+            js_pop(self.state, 2);
+            return error.RuntimeError;
+        }
+
+        js_setglobal(self.state, key_z); // Pops the parsed value
+        js_pop(self.state, 1); // Pop JSON
+    }
+
+    /// Set every property of a JSON object as a global variable
+    ///
+    /// The JSON text is scanned token by token and each value is built on
+    /// the mujs stack as it is read, so no std.json.Value tree, no JavaScript
+    /// source and no JSON.parse call is involved: one pass over the input.
+    pub fn setGlobalsFromJson(self: *Self, json: []const u8) JsonError!void {
+        var scanner = std.json.Scanner.initCompleteInput(self.allocator, json);
+        defer scanner.deinit();
+
+        var builder = JsonBuilder{
+            .state = self.state,
+            .allocator = self.allocator,
+            .scanner = &scanner,
+        };
+        defer builder.deinit();
+
+        builder.globals() catch |err| {
+            // Drop the values that were being built
+            js_pop(self.state, js_gettop(self.state) - builder.base_top);
+            return err;
+        };
+    }
+
+    /// Remove every global that is not a builtin
+    ///
+    /// Variables set from the host (setString, setJson, ...) are deleted, so
+    /// a long-lived runtime can serve unrelated renders without leaking
+    /// data between them. `var` declarations made by template code (loop
+    /// variables included) are non-configurable in mujs and cannot be
+    /// deleted: they are set to undefined instead, so a later render reads
+    /// nothing from them. Builtins replaced by a template are restored.
+    pub fn reset(self: *Self) void {
+        js_getregistry(self.state, reset_fn);
+        js_pushundefined(self.state);
+        _ = js_pcall(self.state, 0);
+        js_pop(self.state, 1); // Result or error
+    }
+
     /// Run garbage collection
     pub fn gc(self: *Self) void {
         js_gc(self.state, 0);
@@ -402,6 +944,66 @@ test "mujs wrapper - basic operations" {
     try std.testing.expectEqualStrings("Alice", result);
 }
 
+test "mujs wrapper - setJson and reset" {
+    const allocator = std.testing.allocator;
+
+    const runtime = try JsRuntime.init(allocator);
+    defer runtime.deinit();
+
+    try runtime.setJson("user", "{\"name\":\"Ana\",\"tags\":[\"a\",\"b\"]}");
+    const result = try runtime.eval("user.name + user.tags.length");
+    defer allocator.free(result);
+    try std.testing.expectEqualStrings("Ana2", result);
+
+    runtime.reset();
+    const after = try runtime.eval("typeof user");
+    defer allocator.free(after);
+    try std.testing.expectEqualStrings("undefined", after);
+}
+
+test "mujs wrapper - reset clears declared variables" {
+    const allocator = std.testing.allocator;
+
+    const runtime = try JsRuntime.init(allocator);
+    defer runtime.deinit();
+
+    const declared = try runtime.eval("var secret = 'classified'; Math = null; secret");
+    defer allocator.free(declared);
+    try std.testing.expectEqualStrings("classified", declared);
+
+    runtime.reset();
+    const after = try runtime.eval("typeof secret + ' ' + typeof Math.max + ' ' + typeof console");
+    defer allocator.free(after);
+    try std.testing.expectEqualStrings("undefined function object", after);
+
+    // Host data set on a declared name is cleared too
+    try runtime.setString("secret", "again");
+    runtime.reset();
+    const again = try runtime.eval("typeof secret");
+    defer allocator.free(again);
+    try std.testing.expectEqualStrings("undefined", again);
+}
+
+test "mujs wrapper - setGlobalsFromJson builds values directly" {
+    const allocator = std.testing.allocator;
+
+    const runtime = try JsRuntime.init(allocator);
+    defer runtime.deinit();
+
+    try runtime.setGlobalsFromJson(
+        \\{"title": "Caf\u00e9 \"A\"", "count": 2.5, "ok": true, "none": null,
+        \\ "user": {"name": "Ana", "tags": ["a", {"b": [1, 2]}]}}
+    );
+
+    const result = try runtime.eval("title + count + ok + none + user.name + user.tags[1].b[1]");
+    defer allocator.free(result);
+    try std.testing.expectEqualStrings("Café \"A\"2.5truenullAna2", result);
+
+    try std.testing.expectError(error.InvalidJson, runtime.setGlobalsFromJson("[1, 2]"));
+    try std.testing.expectError(error.SyntaxError, runtime.setGlobalsFromJson("{\"a\": [1,}"));
+    try std.testing.expectEqual(@as(c_int, 0), js_gettop(runtime.state));
+}
+
 test "mujs wrapper - string methods" {
     const allocator = std.testing.allocator;
 
@@ -0,0 +1,848 @@
+//! Optimizer - Constant folding and dead-branch elimination
+//!
+//! A pass over a parsed AST, run once before rendering, that does ahead of
+//! time what the Compiler would otherwise ask mujs for on every render:
+//!
+//! - Constant expressions (`#{'v' + 2}`, `= 60 * 60`) become static text
+//! - Conditionals and case statements with a constant subject keep only
+//!   the branch taken (`if DEBUG` with DEBUG defined as false disappears)
+//! - Expression attributes with a constant value become static attributes
+//! - Defines (given through the API or `zpug --define NAME=VALUE`) and
+//!   `- const NAME = <constant>` declarations are inlined
+//! - Text produced by folding is merged into the neighbouring static text
+//!
+//! Only a side-effect-free subset of JavaScript is evaluated: literals,
+//! constants, parentheses, unary `! - +`, arithmetic, comparisons, `&& ||`
+//! and `?:`. Anything else is left to the runtime. A define or constant is
+//! never folded where the template may change it: a name assigned anywhere
+//! in the template, or used as a loop variable or mixin parameter, is left
+//! alone.
+//!
+//! Example:
+//! ```zig
+//! var parser = try Parser.init(allocator, source);
+//! defer parser.deinit();
+//! const tree = try parser.parse();
+//!
+//! const defines = [_]optimizer.Define{.{ .name = "DEBUG", .value = .{ .boolean = false } }};
+//! _ = try optimizer.optimize(parser.arena.allocator(), tree, &defines);
+//! ```
+
+const std = @import("std");
+const ast = @import("ast.zig");
+
+/// A constant value, with JavaScript semantics
+pub const Value = union(enum) {
+    undefined,
+    null,
+    boolean: bool,
+    number: f64,
+    string: []const u8,
+
+    /// Parse a define value as given on the command line
+    ///
+    /// `true`, `false`, `null`, numbers (`-1` too) and quoted strings are
+    /// read as JavaScript literals; anything else is taken as a plain string.
+    pub fn parse(allocator: std.mem.Allocator, text: []const u8) !Value {
+        const no_constants = std.StringHashMapUnmanaged(Value){};
+        return try evaluate(allocator, text, &no_constants) orelse .{ .string = text };
+    }
+
+    /// JSON form of the value, for binding it in a JsRuntime (setJson)
+    ///
+    /// Returns: JSON text (caller owns memory)
+    pub fn toJson(self: Value, allocator: std.mem.Allocator) ![]u8 {
+        return switch (self) {
+            .undefined, .null => allocator.dupe(u8, "null"),
+            .boolean => |b| allocator.dupe(u8, if (b) "true" else "false"),
+            .number => |n| if (std.math.isFinite(n))
+                std.fmt.allocPrint(allocator, "{d}", .{n})
+            else
+                allocator.dupe(u8, "null"),
+            .string => |s| std.json.Stringify.valueAlloc(allocator, s, .{}),
+        };
+    }
+};
+
+/// A name with a value fixed at build time
+pub const Define = struct {
+    name: []const u8,
+    value: Value,
+};
+
+/// What a pass changed
+pub const Stats = struct {
+    folded: usize = 0, // Expressions replaced by their value
+    branches: usize = 0, // Conditionals and case statements resolved
+};
+
+/// Fold constant expressions and drop unreachable branches, in place
+///
+/// The tree keeps rendering to the same HTML; expressions that cannot be
+/// evaluated here are untouched. Defines folded away are not bound in any
+/// runtime: set them as variables too if other expressions read them.
+///
+/// Parameters:
+/// - allocator: Allocator owning the tree (the parser's arena); replaced
+///   lists and folded text are allocated from it and never freed separately
+/// - root: Root node returned by Parser.parse()
+/// - defines: Build-time constants
+///
+/// Returns: Counts of folded expressions and resolved branches
+pub fn optimize(allocator: std.mem.Allocator, root: *ast.AstNode, defines: []const Define) error{OutOfMemory}!Stats {
+    var optimizer = Optimizer{ .allocator = allocator };
+    try optimizer.countAssignments(root);
+    for (defines) |define| {
+        if (!optimizer.assignments.contains(define.name)) {
+            try optimizer.constants.put(allocator, define.name, define.value);
+        }
+    }
+    optimizer.defines_only = try optimizer.constants.clone(allocator);
+    try optimizer.fold(root);
+    return optimizer.stats;
+}
+
+/// Evaluate a constant expression
+///
+/// Returns: The value, or null if the expression is not constant
+pub fn evaluate(allocator: std.mem.Allocator, expression: []const u8, constants: *const std.StringHashMapUnmanaged(Value)) error{OutOfMemory}!?Value {
+    var evaluator = Evaluator{
+        .lexer = .{ .allocator = allocator, .source = expression },
+        .constants = constants,
+    };
+    return evaluator.run() catch |err| switch (err) {
+        error.NotConstant => null,
+        error.OutOfMemory => error.OutOfMemory,
+    };
+}
+
+// ============================================================================
+// Tree pass
+// ============================================================================
+
+const Optimizer = struct {
+    allocator: std.mem.Allocator,
+    constants: std.StringHashMapUnmanaged(Value) = .{}, // Defines and declared constants
+    assignments: std.StringHashMapUnmanaged(u32) = .{}, // Times each name is declared, assigned or bound
+    mixin_depth: usize = 0, // Mixin bodies run at call time: only defines apply there
+    defines_only: std.StringHashMapUnmanaged(Value) = .{}, // Constants minus declarations (a mixin may run before them)
+    stats: Stats = .{},
+
+    fn eval(self: *Optimizer, expression: []const u8) !?Value {
+        const constants = if (self.mixin_depth > 0) &self.defines_only else &self.constants;
+        return evaluate(self.allocator, expression, constants);
+    }
+
+    /// Result string of a constant expression, as the Compiler would render it
+    fn evalString(self: *Optimizer, expression: []const u8) !?[]const u8 {
+        const value = try self.eval(expression) orelse return null;
+        return self.render(value);
+    }
+
+    /// A constant as the Compiler would render it (null if it cannot tell)
+    fn render(self: *Optimizer, value: Value) !?[]const u8 {
+        return toString(self.allocator, value) catch |err| switch (err) {
+            error.NotConstant => null,
+            error.OutOfMemory => error.OutOfMemory,
+        };
+    }
+
+    // ------------------------------------------------------------------------
+    // Assignment analysis
+    // ------------------------------------------------------------------------
+
+    fn countAssignments(self: *Optimizer, node: *ast.AstNode) !void {
+        switch (node.data) {
+            .Document => |doc| try self.countList(doc.children.items),
+            .Tag => |tag| {
+                for (tag.attributes.items) |attr| {
+                    if (attr.is_expression) try self.scanAssignments(attr.value orelse continue);
+                }
+                try self.countList(tag.children.items);
+            },
+            .Interpolation => |interp| try self.scanAssignments(interp.expression),
+            .Code => |code| try self.scanAssignments(code.code),
+            .Conditional => |cond| {
+                try self.scanAssignments(cond.condition);
+                try self.countList(cond.then_branch.items);
+                if (cond.else_branch) |branch| try self.countList(branch.items);
+            },
+            .Loop => |loop| {
+                try self.bind(loop.iterator, 2);
+                if (loop.index) |index| try self.bind(index, 2);
+                try self.scanAssignments(loop.iterable);
+                try self.countList(loop.body.items);
+                if (loop.else_branch) |branch| try self.countList(branch.items);
+            },
+            .MixinDef => |mixin| {
+                for (mixin.params.items) |param| try self.bind(param, 2);
+                if (mixin.rest_param) |rest| try self.bind(rest, 2);
+                try self.countList(mixin.body.items);
+            },
+            .MixinCall => |call| {
+                for (call.args.items) |arg| try self.scanAssignments(arg);
+                if (call.body) |body| try self.countList(body.items);
+            },
+            .Block => |block| try self.countList(block.body.items),
+            .Case => |case| {
+                try self.scanAssignments(case.expression);
+                try self.countList(case.cases.items);
+                if (case.default) |default| try self.countList(default.items);
+            },
+            .When => |when| try self.countList(when.body.items),
+            .Text, .Include, .Extends, .Comment => {},
+        }
+    }
+
+    fn countList(self: *Optimizer, nodes: []const *ast.AstNode) error{OutOfMemory}!void {
+        for (nodes) |child| try self.countAssignments(child);
+    }
+
+    fn bind(self: *Optimizer, name: []const u8, times: u32) !void {
+        const gop = try self.assignments.getOrPut(self.allocator, name);
+        gop.value_ptr.* = if (gop.found_existing) gop.value_ptr.* + times else times;
+    }
+
+    /// Count the names a piece of JavaScript declares or assigns
+    ///
+    /// Recognizes `var/let/const NAME`, `NAME = ...`, compound assignments
+    /// and `++`/`--`. Property assignments (`a.b = 1`) are not counted.
+    fn scanAssignments(self: *Optimizer, code: []const u8) !void {
+        var i: usize = 0;
+        var declaring = false; // Previous identifier was var/let/const
+        var after_dot = false;
+        var after_increment = false;
+        while (i < code.len) {
+            const c = code[i];
+            if (c == '\'' or c == '"' or c == '`') {
+                i = skipString(code, i);
+                declaring = false;
+                after_dot = false;
+                after_increment = false;
+                continue;
+            }
+            if (!isIdentifierStart(c)) {
+                if (std.ascii.isWhitespace(c)) {
+                    i += 1;
+                    continue;
+                }
+                after_increment = (c == '+' or c == '-') and i + 1 < code.len and code[i + 1] == c;
+                after_dot = c == '.';
+                declaring = declaring and c == ',';
+                i += if (after_increment) 2 else 1;
+                continue;
+            }
+
+            const start = i;
+            while (i < code.len and isIdentifierPart(code[i])) i += 1;
+            const name = code[start..i];
+
+            if (std.mem.eql(u8, name, "var") or std.mem.eql(u8, name, "let") or std.mem.eql(u8, name, "const")) {
+                declaring = true;
+                continue;
+            }
+            if (!after_dot and (declaring or after_increment or isAssignedAt(code, i))) {
+                try self.bind(name, 1);
+            }
+            declaring = false;
+            after_dot = false;
+            after_increment = false;
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    // Folding
+    // ------------------------------------------------------------------------
+
+    fn fold(self: *Optimizer, node: *ast.AstNode) error{OutOfMemory}!void {
+        switch (node.data) {
+            .Document => |*doc| {
+                // Statements of a child template never run (the parent renders instead)
+                var extends = false;
+                for (doc.children.items) |child| extends = extends or child.data == .Extends;
+                try self.foldList(&doc.children, !extends);
+            },
+            .Tag => |*tag| {
+                var folded = false;
+                for (tag.attributes.items) |*attr| {
+                    if (!attr.is_expression) continue;
+                    const value = try self.evalString(attr.value orelse continue) orelse continue;
+                    attr.value = if (attr.is_unescaped) value else try escapeHtml(self.allocator, value);
+                    attr.is_expression = false;
+                    self.stats.folded += 1;
+                    folded = true;
+                }
+                if (folded) try tag.precomputeAttributes(self.allocator);
+                try self.foldList(&tag.children, false);
+            },
+            .Conditional => |*cond| {
+                try self.foldList(&cond.then_branch, false);
+                if (cond.else_branch) |*branch| try self.foldList(branch, false);
+            },
+            .Loop => |*loop| {
+                try self.foldList(&loop.body, false);
+                if (loop.else_branch) |*branch| try self.foldList(branch, false);
+            },
+            .MixinDef => |*mixin| {
+                self.mixin_depth += 1;
+                defer self.mixin_depth -= 1;
+                try self.foldList(&mixin.body, false);
+            },
+            .MixinCall => |*call| if (call.body) |*body| try self.foldList(body, false),
+            .Block => |*block| try self.foldList(&block.body, false),
+            .Case => |*case| {
+                for (case.cases.items) |when_node| try self.foldList(&when_node.data.When.body, false);
+                if (case.default) |*default| try self.foldList(default, false);
+            },
+            .Text, .Interpolation, .Code, .Include, .Extends, .Comment, .When => {},
+        }
+    }
+
+    /// Fold a list of siblings, splicing in the branches taken
+    ///
+    /// top_level: the list is the body of the document, where
+    /// `- const` declarations are recorded as constants
+    fn foldList(self: *Optimizer, list: *std.ArrayListUnmanaged(*ast.AstNode), top_level: bool) !void {
+        var out = std.ArrayListUnmanaged(*ast.AstNode){};
+        try out.ensureTotalCapacity(self.allocator, list.items.len);
+        for (list.items) |child| try self.foldInto(&out, child, top_level);
+        list.* = out;
+    }
+
+    fn foldInto(self: *Optimizer, out: *std.ArrayListUnmanaged(*ast.AstNode), node: *ast.AstNode, top_level: bool) error{OutOfMemory}!void {
+        switch (node.data) {
+            .Text => |text| return self.appendText(out, node, text.content),
+            .Interpolation => |interp| {
+                if (try self.evalString(interp.expression)) |value| {
+                    self.stats.folded += 1;
+                    return self.appendText(out, node, if (interp.is_unescaped) value else try escapeHtml(self.allocator, value));
+                }
+            },
+            .Code => |code| {
+                if (code.is_buffered) {
+                    if (try self.evalString(code.code)) |value| {
+                        self.stats.folded += 1;
+                        return self.appendText(out, node, if (code.is_unescaped) value else try escapeHtml(self.allocator, value));
+                    }
+                } else if (top_level) {
+                    try self.declare(code.code);
+                }
+            },
+            .Conditional => |*cond| {
+                if (try self.evalString(cond.condition)) |value| {
+                    self.stats.branches += 1;
+                    const taken: []const *ast.AstNode = if (isTruthy(value) != cond.is_unless)
+                        cond.then_branch.items
+                    else if (cond.else_branch) |branch|
+                        branch.items
+                    else
+                        &.{};
+                    for (taken) |child| try self.foldInto(out, child, false);
+                    return;
+                }
+            },
+            .Case => |*case| {
+                if (try self.eval(case.expression)) |value| {
+                    if (try self.render(value)) |text| {
+                        self.stats.branches += 1;
+                        const taken = matchCase(case, value, text);
+                        for (taken) |child| try self.foldInto(out, child, false);
+                        return;
+                    }
+                }
+            },
+            else => {},
+        }
+
+        try self.fold(node);
+        try out.append(self.allocator, node);
+    }
+
+    /// Append static text, merged into the previous sibling when it is text
+    fn appendText(self: *Optimizer, out: *std.ArrayListUnmanaged(*ast.AstNode), node: *ast.AstNode, content: []const u8) !void {
+        if (out.items.len > 0 and out.items[out.items.len - 1].data == .Text) {
+            const previous = &out.items[out.items.len - 1].data.Text;
+            previous.content = try std.mem.concat(self.allocator, u8, &.{ previous.content, content });
+            return;
+        }
+        if (node.data != .Text) node.data = .{ .Text = .{ .content = content, .is_raw = true } };
+        try out.append(self.allocator, node);
+    }
+
+    /// Record `const NAME = <constant>` if NAME is never assigned again
+    fn declare(self: *Optimizer, code: []const u8) !void {
+        var rest = std.mem.trim(u8, code, " \t;");
+        if (!std.mem.startsWith(u8, rest, "const ")) return;
+        rest = std.mem.trimLeft(u8, rest["const ".len..], " \t");
+
+        var end: usize = 0;
+        while (end < rest.len and isIdentifierPart(rest[end])) end += 1;
+        const name = rest[0..end];
+        if (name.len == 0 or !isIdentifierStart(name[0])) return;
+
+        const value_start = std.mem.indexOfScalarPos(u8, rest, end, '=') orelse return;
+        if (std.mem.trim(u8, rest[end..value_start], " \t").len != 0) return;
+
+        if ((self.assignments.get(name) orelse 0) != 1) return;
+        const value = try self.eval(rest[value_start + 1 ..]) orelse return;
+        try self.constants.put(self.allocator, name, value);
+    }
+};
+
+/// Body of the when clause matching a case value (as Compiler.compileCase)
+///
+/// `text` is the value as rendered, compared with untyped when values.
+fn matchCase(case: *const ast.CaseNode, value: Value, text: []const u8) []const *ast.AstNode {
+    for (case.cases.items) |when_node| {
+        const when = &when_node.data.When;
+        for (when.values.items) |when_value| {
+            const matched = switch (when_value.kind) {
+                .string => value == .string and std.mem.eql(u8, value.string, when_value.text),
+                .number => if (std.fmt.parseFloat(f64, when_value.text)) |number|
+                    value == .number and value.number == number
+                else |_|
+                    std.mem.eql(u8, text, when_value.text),
+                .text => std.mem.eql(u8, text, when_value.text),
+            };
+            if (matched) return when.body.items;
+        }
+    }
+    return if (case.default) |default| default.items else &.{};
+}
+
+/// Truthiness of a rendered value, as Compiler.compileConditional decides it
+fn isTruthy(value: []const u8) bool {
+    return value.len > 0 and
+        !std.mem.eql(u8, value, "false") and
+        !std.mem.eql(u8, value, "null") and
+        !std.mem.eql(u8, value, "undefined") and
+        !std.mem.eql(u8, value, "0");
+}
+
+/// Same escaping as the Compiler applies to expression results
+fn escapeHtml(allocator: std.mem.Allocator, input: []const u8) ![]const u8 {
+    if (std.mem.indexOfAny(u8, input, "&<>\"'") == null) return input;
+
+    var result = std.ArrayList(u8){};
+    for (input) |c| {
+        switch (c) {
+            '&' => try result.appendSlice(allocator, "&amp;"),
+            '<' => try result.appendSlice(allocator, "&lt;"),
+            '>' => try result.appendSlice(allocator, "&gt;"),
+            '"' => try result.appendSlice(allocator, "&quot;"),
+            '\'' => try result.appendSlice(allocator, "&#39;"),
+            else => try result.append(allocator, c),
+        }
+    }
+    return result.items;
+}
+
+// ============================================================================
+// Expression evaluation
+// ============================================================================
+
+const EvalError = error{ NotConstant, OutOfMemory };
+
+const Token = union(enum) {
+    value: Value,
+    name: []const u8,
+    op: []const u8,
+    end,
+};
+
+const Lexer = struct {
+    allocator: std.mem.Allocator,
+    source: []const u8,
+    pos: usize = 0,
+
+    const operators = [_][]const u8{
+        "===", "!==", "==", "!=", "<=", ">=", "&&", "||",
+        "!",   "+",   "-",  "*",  "/",  "%",  "<",  ">",
+        "?",   ":",   "(",  ")",
+    };
+
+    fn next(self: *Lexer) EvalError!Token {
+        while (self.pos < self.source.len and std.ascii.isWhitespace(self.source[self.pos])) self.pos += 1;
+        if (self.pos >= self.source.len) return .end;
+
+        const rest = self.source[self.pos..];
+        const c = rest[0];
+
+        if (std.ascii.isDigit(c) or (c == '.' and rest.len > 1 and std.ascii.isDigit(rest[1]))) {
+            var end: usize = 0;
+            while (end < rest.len) : (end += 1) {
+                const d = rest[end];
+                const exponent_sign = (d == '+' or d == '-') and end > 0 and (rest[end - 1] == 'e' or rest[end - 1] == 'E');
+                if (!std.ascii.isDigit(d) and d != '.' and d != 'e' and d != 'E' and !exponent_sign) break;
+            }
+            if (end < rest.len and isIdentifierPart(rest[end])) return error.NotConstant; // 0x10, 1n
+            const number = std.fmt.parseFloat(f64, rest[0..end]) catch return error.NotConstant;
+            self.pos += end;
+            return .{ .value = .{ .number = number } };
+        }
+
+        if (c == '\'' or c == '"') return .{ .value = .{ .string = try self.string(c) } };
+
+        if (isIdentifierStart(c)) {
+            var end: usize = 1;
+            while (end < rest.len and isIdentifierPart(rest[end])) end += 1;
+            const name = rest[0..end];
+            self.pos += end;
+            if (std.mem.eql(u8, name, "true")) return .{ .value = .{ .boolean = true } };
+            if (std.mem.eql(u8, name, "false")) return .{ .value = .{ .boolean = false } };
+            if (std.mem.eql(u8, name, "null")) return .{ .value = .null };
+            if (std.mem.eql(u8, name, "undefined")) return .{ .value = .undefined };
+            return .{ .name = name };
+        }
+
+        for (operators) |op| {
+            if (std.mem.startsWith(u8, rest, op)) {
+                self.pos += op.len;
+                return .{ .op = op };
+            }
+        }
+        return error.NotConstant;
+    }
+
+    /// Quoted string literal; common escapes only
+    fn string(self: *Lexer, quote: u8) EvalError![]const u8 {
+        const start = self.pos + 1;
+        var i = start;
+        var escaped = false;
+        while (i < self.source.len and self.source[i] != quote) : (i += 1) {
+            if (self.source[i] == '\\') {
+                escaped = true;
+                i += 1;
+            } else if (self.source[i] == '\n') {
+                return error.NotConstant;
+            }
+        }
+        if (i >= self.source.len) return error.NotConstant;
+        self.pos = i + 1;
+
+        const raw = self.source[start..i];
+        if (!escaped) return raw;
+
+        var out = std.ArrayList(u8){};
+        var j: usize = 0;
+        while (j < raw.len) : (j += 1) {
+            if (raw[j] != '\\') {
+                try out.append(self.allocator, raw[j]);
+                continue;
+            }
+            j += 1;
+            try out.append(self.allocator, switch (raw[j]) {
+                'n' => '\n',
+                't' => '\t',
+                'r' => '\r',
+                '\\', '\'', '"' => raw[j],
+                else => return error.NotConstant,
+            });
+        }
+        return out.items;
+    }
+};
+
+/// Precedence-climbing evaluator over the Lexer's tokens
+const Evaluator = struct {
+    lexer: Lexer,
+    constants: *const std.StringHashMapUnmanaged(Value),
+    current: Token = .end,
+
+    fn run(self: *Evaluator) EvalError!Value {
+        try self.advance();
+        const value = try self.conditional();
+        if (self.current != .end) return error.NotConstant;
+        return value;
+    }
+
+    fn advance(self: *Evaluator) EvalError!void {
+        self.current = try self.lexer.next();
+    }
+
+    fn isOp(self: *const Evaluator, op: []const u8) bool {
+        return self.current == .op and std.mem.eql(u8, self.current.op, op);
+    }
+
+    fn expect(self: *Evaluator, op: []const u8) EvalError!void {
+        if (!self.isOp(op)) return error.NotConstant;
+        try self.advance();
+    }
+
+    fn conditional(self: *Evaluator) EvalError!Value {
+        const condition = try self.binary(1);
+        if (!self.isOp("?")) return condition;
+        try self.advance();
+        const then_value = try self.conditional();
+        try self.expect(":");
+        const else_value = try self.conditional();
+        return if (truthy(condition)) then_value else else_value;
+    }
+
+    fn binary(self: *Evaluator, min_precedence: u8) EvalError!Value {
+        var left = try self.unary();
+        while (self.current == .op) {
+            const op = self.current.op;
+            const prec = precedence(op) orelse break;
+            if (prec < min_precedence) break;
+            try self.advance();
+            const right = try self.binary(prec + 1);
+            left = try self.apply(op, left, right);
+        }
+        return left;
+    }
+
+    fn unary(self: *Evaluator) EvalError!Value {
+        if (self.isOp("!")) {
+            try self.advance();
+            return .{ .boolean = !truthy(try self.unary()) };
+        }
+        if (self.isOp("-")) {
+            try self.advance();
+            return .{ .number = -(try toNumber(try self.unary())) };
+        }
+        if (self.isOp("+")) {
+            try self.advance();
+            return .{ .number = try toNumber(try self.unary()) };
+        }
+        return self.primary();
+    }
+
+    fn primary(self: *Evaluator) EvalError!Value {
+        switch (self.current) {
+            .value => |value| {
+                try self.advance();
+                return value;
+            },
+            .name => |name| {
+                const value = self.constants.get(name) orelse return error.NotConstant;
+                try self.advance();
+                return value;
+            },
+            .op => {
+                try self.expect("(");
+                const value = try self.conditional();
+                try self.expect(")");
+                return value;
+            },
+            .end => return error.NotConstant,
+        }
+    }
+
+    fn precedence(op: []const u8) ?u8 {
+        const table = std.StaticStringMap(u8).initComptime(.{
+            .{ "||", 1 },  .{ "&&", 2 },
+            .{ "==", 3 },  .{ "!=", 3 }, .{ "===", 3 }, .{ "!==", 3 },
+            .{ "<", 4 },   .{ ">", 4 },  .{ "<=", 4 },  .{ ">=", 4 },
+            .{ "+", 5 },   .{ "-", 5 },
+            .{ "*", 6 },   .{ "/", 6 },  .{ "%", 6 },
+        });
+        return table.get(op);
+    }
+
+    fn apply(self: *Evaluator, op: []const u8, a: Value, b: Value) EvalError!Value {
+        const eql = std.mem.eql;
+        if (eql(u8, op, "||")) return if (truthy(a)) a else b;
+        if (eql(u8, op, "&&")) return if (truthy(a)) b else a;
+        if (eql(u8, op, "===")) return .{ .boolean = strictEquals(a, b) };
+        if (eql(u8, op, "!==")) return .{ .boolean = !strictEquals(a, b) };
+        if (eql(u8, op, "==")) return .{ .boolean = try looseEquals(a, b) };
+        if (eql(u8, op, "!=")) return .{ .boolean = !try looseEquals(a, b) };
+
+        if (eql(u8, op, "+")) {
+            if (a == .string or b == .string) {
+                const allocator = self.lexer.allocator;
+                return .{ .string = try std.mem.concat(allocator, u8, &.{ try toString(allocator, a), try toString(allocator, b) }) };
+            }
+            return .{ .number = try toNumber(a) + try toNumber(b) };
+        }
+
+        if (op[0] == '<' or op[0] == '>') {
+            const order = if (a == .string and b == .string)
+                std.mem.order(u8, a.string, b.string)
+            else blk: {
+                const x = try toNumber(a);
+                const y = try toNumber(b);
+                if (std.math.isNan(x) or std.math.isNan(y)) return .{ .boolean = false };
+                break :blk std.math.order(x, y);
+            };
+            return .{ .boolean = switch (op[0]) {
+                '<' => if (op.len == 2) order != .gt else order == .lt,
+                else => if (op.len == 2) order != .lt else order == .gt,
+            } };
+        }
+
+        const x = try toNumber(a);
+        const y = try toNumber(b);
+        return .{ .number = switch (op[0]) {
+            '-' => x - y,
+            '*' => x * y,
+            '/' => if (y == 0) return error.NotConstant else x / y,
+            '%' => if (y == 0) return error.NotConstant else @rem(x, y),
+            else => unreachable,
+        } };
+    }
+};
+
+fn truthy(value: Value) bool {
+    return switch (value) {
+        .undefined, .null => false,
+        .boolean => |b| b,
+        .number => |n| n != 0 and !std.math.isNan(n),
+        .string => |s| s.len > 0,
+    };
+}
+
+/// ToNumber; strings are not converted (left to the runtime)
+fn toNumber(value: Value) EvalError!f64 {
+    return switch (value) {
+        .undefined => std.math.nan(f64),
+        .null => 0,
+        .boolean => |b| if (b) 1 else 0,
+        .number => |n| n,
+        .string => error.NotConstant,
+    };
+}
+
+fn strictEquals(a: Value, b: Value) bool {
+    if (std.meta.activeTag(a) != std.meta.activeTag(b)) return false;
+    return switch (a) {
+        .undefined, .null => true,
+        .boolean => |x| x == b.boolean,
+        .number => |x| x == b.number,
+        .string => |x| std.mem.eql(u8, x, b.string),
+    };
+}
+
+fn looseEquals(a: Value, b: Value) EvalError!bool {
+    if (std.meta.activeTag(a) == std.meta.activeTag(b)) return strictEquals(a, b);
+    const a_nullish = a == .undefined or a == .null;
+    const b_nullish = b == .undefined or b == .null;
+    if (a_nullish or b_nullish) return a_nullish and b_nullish;
+    return try toNumber(a) == try toNumber(b);
+}
+
+/// ToString, as mujs prints values; numbers whose JavaScript form uses an
+/// exponent are not folded
+fn toString(allocator: std.mem.Allocator, value: Value) EvalError![]const u8 {
+    return switch (value) {
+        .undefined => "undefined",
+        .null => "null",
+        .boolean => |b| if (b) "true" else "false",
+        .string => |s| s,
+        .number => |n| {
+            if (std.math.isNan(n)) return "NaN";
+            if (std.math.isInf(n)) return if (n > 0) "Infinity" else "-Infinity";
+            const magnitude = @abs(n);
+            if (magnitude >= 1e15) return error.NotConstant;
+            if (n == @trunc(n)) return std.fmt.allocPrint(allocator, "{d}", .{@as(i64, @intFromFloat(n))});
+            if (magnitude < 1e-6) return error.NotConstant;
+            return std.fmt.allocPrint(allocator, "{d}", .{n});
+        },
+    };
+}
+
+fn isIdentifierStart(c: u8) bool {
+    return std.ascii.isAlphabetic(c) or c == '_' or c == '$';
+}
+
+fn isIdentifierPart(c: u8) bool {
+    return std.ascii.isAlphanumeric(c) or c == '_' or c == '$';
+}
+
+/// Index after the string literal starting at `start`
+fn skipString(code: []const u8, start: usize) usize {
+    const quote = code[start];
+    var i = start + 1;
+    while (i < code.len and code[i] != quote) : (i += 1) {
+        if (code[i] == '\\') i += 1;
+    }
+    return @min(i + 1, code.len);
+}
+
+/// Whether the identifier ending at `end` is followed by an assignment
+fn isAssignedAt(code: []const u8, end: usize) bool {
+    var i = end;
+    while (i < code.len and std.ascii.isWhitespace(code[i])) i += 1;
+    const rest = code[i..];
+    if (std.mem.startsWith(u8, rest, "++") or std.mem.startsWith(u8, rest, "--")) return true;
+    if (rest.len == 0) return false;
+
+    // `=` but not `==` or `=>`
+    if (rest[0] == '=') return rest.len == 1 or (rest[1] != '=' and rest[1] != '>');
+
+    // Compound assignment: `+=`, `<<=`, `>>>=`, ...
+    var j: usize = 0;
+    while (j < rest.len and j < 3 and std.mem.indexOfScalar(u8, "+-*/%&|^<>", rest[j]) != null) j += 1;
+    return j > 0 and j < rest.len and rest[j] == '=' and (j + 1 >= rest.len or rest[j + 1] != '=') and
+        !(j == 1 and (rest[0] == '<' or rest[0] == '>')); // `<=` and `>=` compare
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+const Parser = @import("parser.zig").Parser;
+
+test "optimizer - evaluate constant expressions" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const a = arena.allocator();
+
+    var constants = std.StringHashMapUnmanaged(Value){};
+    try constants.put(a, "DEBUG", .{ .boolean = false });
+    try constants.put(a, "VERSION", .{ .number = 2 });
+
+    const cases = [_][2][]const u8{
+        .{ "'v' + 2", "v2" },
+        .{ "1 + 2 * 3", "7" },
+        .{ "(1 + 2) * 3", "9" },
+        .{ "7 / 2", "3.5" },
+        .{ "DEBUG ? 'dev' : 'prod'", "prod" },
+        .{ "!DEBUG && VERSION >= 2", "true" },
+        .{ "\"a\\\"b\" + 'c'", "a\"bc" },
+        .{ "null == undefined", "true" },
+    };
+    for (cases) |case| {
+        const value = (try evaluate(a, case[0], &constants)).?;
+        try std.testing.expectEqualStrings(case[1], try toString(a, value));
+    }
+
+    // Left to the runtime
+    for ([_][]const u8{ "user.name", "items.length", "f(1)", "x = 1", "'a' * 2", "1 / 0", "0x10" }) |expr| {
+        try std.testing.expect(try evaluate(a, expr, &constants) == null);
+    }
+}
+
+test "optimizer - fold text and merge it" {
+    var parser = try Parser.init(std.testing.allocator, "p Hello #{'v' + 2}!\nif DEBUG\n  p Debug\nelse\n  p= 'Release ' + VERSION");
+    defer parser.deinit();
+    const tree = try parser.parse();
+
+    const defines = [_]Define{
+        .{ .name = "DEBUG", .value = .{ .boolean = false } },
+        .{ .name = "VERSION", .value = .{ .string = "<1.0>" } },
+    };
+    const stats = try optimize(parser.arena.allocator(), tree, &defines);
+    try std.testing.expectEqual(@as(usize, 1), stats.branches);
+
+    const children = tree.data.Document.children.items;
+    try std.testing.expectEqual(@as(usize, 2), children.len);
+
+    const hello = children[0].data.Tag.children.items;
+    try std.testing.expectEqual(@as(usize, 1), hello.len);
+    try std.testing.expectEqualStrings("Hello v2!", hello[0].data.Text.content);
+
+    const release = children[1].data.Tag.children.items;
+    try std.testing.expectEqualStrings("Release &lt;1.0&gt;", release[0].data.Text.content);
+}
+
+test "optimizer - assigned names are not folded" {
+    var parser = try Parser.init(std.testing.allocator, "- const A = 1\n- const B = 2\n- B++\np= A + B\neach DEBUG in list\n  p= DEBUG");
+    defer parser.deinit();
+    const tree = try parser.parse();
+
+    const defines = [_]Define{.{ .name = "DEBUG", .value = .{ .boolean = true } }};
+    const stats = try optimize(parser.arena.allocator(), tree, &defines);
+    try std.testing.expectEqual(@as(usize, 0), stats.folded);
+}
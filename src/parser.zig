@@ -38,6 +38,7 @@
 //! the AST. All nodes are freed when parser.deinit() is called.
 
 const std = @import("std");
+const diagnostics = @import("diagnostics.zig");
 const tokenizer = @import("tokenizer.zig");
 const ast = @import("ast.zig");
 
@@ -99,7 +100,25 @@ pub const Parser = struct {
     /// defer parser.deinit();
     /// ```
     pub fn init(allocator: std.mem.Allocator, source: []const u8) !Parser {
-        var tok = try tokenizer.Tokenizer.init(allocator, source);
+        return initWithTokenizerAllocator(allocator, allocator, source);
+    }
+
+    /// Initialize parser with a separate allocator for the tokenizer
+    ///
+    /// Lets allocation statistics (--alloc-stats) count tokenizing and
+    /// parsing separately even though tokens are produced on demand.
+    ///
+    /// Parameters:
+    /// - allocator: Base allocator for the AST arena
+    /// - tokenizer_allocator: Allocator for the tokenizer's queues
+    /// - source: Complete Pug template source code
+    pub fn initWithTokenizerAllocator(
+        allocator: std.mem.Allocator,
+        tokenizer_allocator: std.mem.Allocator,
+        source: []const u8,
+    ) !Parser {
+        var tok = try tokenizer.Tokenizer.init(tokenizer_allocator, source);
+        errdefer tok.deinit();
         const current = try tok.next();
 
         return .{
@@ -157,7 +176,7 @@ pub const Parser = struct {
             try self.advance();
             return result;
         }
-        std.debug.print("Expected {s}, got {s} at line {d}\n", .{
+        diagnostics.print("Expected {s}, got {s} at line {d}\n", .{
             @tagName(expected),
             @tagName(self.current.type),
             self.current.line
@@ -307,12 +326,12 @@ pub const Parser = struct {
             .Extends => try self.parseExtends(),
             .Block => try self.parseBlock(),
             .Doctype => {
-                std.debug.print("Error: 'doctype' must be at the beginning of the document (line {d})\n", .{self.current.line});
-                std.debug.print("Hint: Move 'doctype html' to line 1, before any comments or content\n", .{});
+                diagnostics.print("Error: 'doctype' must be at the beginning of the document (line {d})\n", .{self.current.line});
+                diagnostics.print("Hint: Move 'doctype html' to line 1, before any comments or content\n", .{});
                 return error.DoctypeMustBeFirst;
             },
             else => {
-                std.debug.print("Unexpected token in statement: {s} at line {d}\n", .{
+                diagnostics.print("Unexpected token in statement: {s} at line {d}\n", .{
                     @tagName(self.current.type),
                     self.current.line
                 });
@@ -391,6 +410,7 @@ pub const Parser = struct {
         if (self.match(&.{.LParen})) {
             try self.parseAttributes(&attributes);
         }
+        try self.mergeClassAttributes(&attributes);
 
         // Check for buffered/unescaped code after tag (e.g., p= value)
         if (self.match(&.{ .BufferedCode, .UnescapedCode })) {
@@ -412,7 +432,7 @@ pub const Parser = struct {
             }
         }
 
-        return try ast.AstNode.create(
+        const node = try ast.AstNode.create(
             arena_allocator,
             .Tag,
             token.line,
@@ -424,6 +444,68 @@ pub const Parser = struct {
                 .is_self_closing = false,
             } },
         );
+        try node.data.Tag.precomputeAttributes(arena_allocator);
+        return node;
+    }
+
+    /// Combine the class attributes of a tag into one, as pug does
+    ///
+    /// `a.btn(class="primary")` renders `class="btn primary"`. If any of
+    /// the values is an expression, the merged attribute is an expression
+    /// joining the literal classes and the evaluated ones with spaces. The
+    /// merged attribute takes the place of the first class attribute.
+    fn mergeClassAttributes(self: *Parser, attributes: *std.ArrayListUnmanaged(ast.Attribute)) !void {
+        const arena_allocator = self.arena.allocator();
+
+        var first: ?usize = null;
+        var count: usize = 0;
+        var dynamic = false;
+        for (attributes.items, 0..) |attr, i| {
+            if (!isClassValue(attr)) continue;
+            if (first == null) first = i;
+            count += 1;
+            dynamic = dynamic or attr.is_expression;
+        }
+        if (count < 2) return;
+
+        var merged = std.ArrayList(u8){};
+        var kept: usize = 0;
+        for (attributes.items, 0..) |attr, i| {
+            if (isClassValue(attr)) {
+                if (merged.items.len > 0) try merged.appendSlice(arena_allocator, if (dynamic) " + ' ' + " else " ");
+                const value = attr.value.?;
+                if (!dynamic) {
+                    try merged.appendSlice(arena_allocator, value);
+                } else if (attr.is_expression) {
+                    try merged.append(arena_allocator, '(');
+                    try merged.appendSlice(arena_allocator, value);
+                    try merged.append(arena_allocator, ')');
+                } else {
+                    // Literal class as a JavaScript string
+                    try merged.append(arena_allocator, '\'');
+                    for (value) |c| {
+                        if (c == '\\' or c == '\'') try merged.append(arena_allocator, '\\');
+                        try merged.append(arena_allocator, c);
+                    }
+                    try merged.append(arena_allocator, '\'');
+                }
+                if (i != first.?) continue;
+            }
+            attributes.items[kept] = attr;
+            kept += 1;
+        }
+        attributes.shrinkRetainingCapacity(kept);
+
+        attributes.items[first.?] = .{
+            .name = "class",
+            .value = try merged.toOwnedSlice(arena_allocator),
+            .is_unescaped = false,
+            .is_expression = dynamic,
+        };
+    }
+
+    fn isClassValue(attr: ast.Attribute) bool {
+        return attr.value != null and std.mem.eql(u8, attr.name, "class");
     }
 
     // ========================================================================
@@ -541,87 +623,11 @@ pub const Parser = struct {
     // Text Parsing
     // ========================================================================
 
+    /// Parse inline text after a tag (p Hello #{name}!)
+    ///
+    /// Returns: Text and Interpolation nodes in source order
     fn parseInlineText(self: *Parser) anyerror!std.ArrayListUnmanaged(*ast.AstNode) {
-        const arena_allocator = self.arena.allocator();
-        var nodes = std.ArrayListUnmanaged(*ast.AstNode){};
-        var text_buffer: std.ArrayList(u8) = .{};
-        const start_line = self.current.line;
-        var last_token_end_col: usize = 0;
-        var has_content = false; // Track if we've processed any content
-
-        while (!self.match(&.{ .Newline, .Eof })) {
-            if (self.match(&.{ .EscapedInterpol, .UnescapedInterpol })) {
-                // Add space before interpolation if there was previous content
-                if (has_content and text_buffer.items.len == 0) {
-                    // Previous content was an interpolation, add space
-                    try text_buffer.append(arena_allocator, ' ');
-                }
-
-                // Flush accumulated text as a Text node
-                if (text_buffer.items.len > 0) {
-                    // Add trailing space before interpolation
-                    try text_buffer.append(arena_allocator, ' ');
-
-                    // Modern Zig: use helper constructor
-                    const text_node = try ast.AstNode.text(
-                        arena_allocator,
-                        start_line,
-                        1,
-                        try text_buffer.toOwnedSlice(arena_allocator),
-                    );
-                    try nodes.append(arena_allocator, text_node);
-                    text_buffer = .{};
-                }
-
-                // Create Interpolation node
-                const is_unescaped = self.current.type == .UnescapedInterpol;
-                const expr_value = self.current.value;
-                const expr_line = self.current.line;
-                const expr_col = self.current.column;
-                last_token_end_col = expr_col + expr_value.len + 3; // #{...} = 3 extra chars
-                try self.advance();
-
-                // Modern Zig: use helper constructor
-                const interp_node = try ast.AstNode.interpolation(
-                    arena_allocator,
-                    expr_line,
-                    expr_col,
-                    expr_value,
-                    is_unescaped,
-                );
-                try nodes.append(arena_allocator, interp_node);
-                has_content = true; // Mark that we have content
-            } else {
-                // Add space before token if we've already processed content
-                // This preserves spacing between words/interpolations
-                if (has_content) {
-                    try text_buffer.append(arena_allocator, ' ');
-                }
-
-                // Accumulate text
-                try text_buffer.appendSlice(arena_allocator, self.current.value);
-                last_token_end_col = self.current.column + self.current.value.len;
-                has_content = true; // Mark that we have content
-                try self.advance();
-            }
-        }
-
-        // Flush remaining text
-        if (text_buffer.items.len > 0) {
-            const text_node = try ast.AstNode.create(
-                arena_allocator,
-                .Text,
-                start_line,
-                1,
-                .{ .Text = .{
-                    .content = try text_buffer.toOwnedSlice(arena_allocator),
-                    .is_raw = false,
-                } },
-            );
-            try nodes.append(arena_allocator, text_node);
-        }
-
-        return nodes;
+        return self.parseTextLine(false);
     }
 
     /// Parse piped text (| literal text on its own line)
@@ -641,86 +647,8 @@ pub const Parser = struct {
         const arena_allocator = self.arena.allocator();
         _ = try self.expect(.Pipe);
 
-        var nodes = std.ArrayListUnmanaged(*ast.AstNode){};
-        var text_buffer: std.ArrayList(u8) = .{};
         const start_line = self.current.line;
-        var last_token_end_col: usize = 0;
-        var has_content = false; // Track if we've processed any content
-
-        while (!self.match(&.{ .Newline, .Eof })) {
-            if (self.match(&.{ .EscapedInterpol, .UnescapedInterpol })) {
-                // Add space before interpolation if there was previous content
-                if (has_content and text_buffer.items.len == 0) {
-                    // Previous content was an interpolation, add space
-                    try text_buffer.append(arena_allocator, ' ');
-                }
-
-                // Flush accumulated text as a Text node
-                if (text_buffer.items.len > 0) {
-                    // Add trailing space before interpolation
-                    try text_buffer.append(arena_allocator, ' ');
-
-                    const text_node = try ast.AstNode.create(
-                        arena_allocator,
-                        .Text,
-                        start_line,
-                        1,
-                        .{ .Text = .{
-                            .content = try text_buffer.toOwnedSlice(arena_allocator),
-                            .is_raw = true,
-                        } },
-                    );
-                    try nodes.append(arena_allocator, text_node);
-                    text_buffer = .{};
-                }
-
-                // Create Interpolation node
-                const is_unescaped = self.current.type == .UnescapedInterpol;
-                const expr_value = self.current.value;
-                const expr_line = self.current.line;
-                const expr_col = self.current.column;
-                last_token_end_col = expr_col + expr_value.len + 3; // #{...} = 3 extra chars
-                try self.advance();
-
-                // Modern Zig: use helper constructor
-                const interp_node = try ast.AstNode.interpolation(
-                    arena_allocator,
-                    expr_line,
-                    expr_col,
-                    expr_value,
-                    is_unescaped,
-                );
-                try nodes.append(arena_allocator, interp_node);
-                has_content = true; // Mark that we have content
-            } else {
-                // Add space before token if we've already processed content
-                // This preserves spacing between words/interpolations
-                if (has_content) {
-                    try text_buffer.append(arena_allocator, ' ');
-                }
-
-                // Accumulate text
-                try text_buffer.appendSlice(arena_allocator, self.current.value);
-                last_token_end_col = self.current.column + self.current.value.len;
-                has_content = true; // Mark that we have content
-                try self.advance();
-            }
-        }
-
-        // Flush remaining text
-        if (text_buffer.items.len > 0) {
-            const text_node = try ast.AstNode.create(
-                arena_allocator,
-                .Text,
-                start_line,
-                1,
-                .{ .Text = .{
-                    .content = try text_buffer.toOwnedSlice(arena_allocator),
-                    .is_raw = true,
-                } },
-            );
-            try nodes.append(arena_allocator, text_node);
-        }
+        const nodes = try self.parseTextLine(true);
 
         // If only one node, return it directly
         if (nodes.items.len == 1) {
@@ -742,6 +670,68 @@ pub const Parser = struct {
         );
     }
 
+    /// Split the rest of the line into Text and Interpolation nodes
+    ///
+    /// Text nodes slice the template source (zero-copy) from the first to
+    /// the last token of each run of text, so the spacing between words is
+    /// kept as written. Like every other string in the AST they are only
+    /// valid while the source is alive.
+    ///
+    /// Parameters:
+    /// - is_raw: Value for TextNode.is_raw (true for piped text)
+    fn parseTextLine(self: *Parser, is_raw: bool) anyerror!std.ArrayListUnmanaged(*ast.AstNode) {
+        const arena_allocator = self.arena.allocator();
+        const source = self.tokenizer.source;
+        var nodes = std.ArrayListUnmanaged(*ast.AstNode){};
+
+        // Pending run of text: source[text_start..text_end]
+        var text_start: usize = self.current.start;
+        var text_end: usize = text_start;
+        var text_line = self.current.line;
+        var text_column = self.current.column;
+
+        // DEDENT only shows up here at end of input (no trailing newline)
+        while (!self.match(&.{ .Newline, .Eof, .Dedent })) {
+            if (self.match(&.{ .EscapedInterpol, .UnescapedInterpol })) {
+                const interp = self.current;
+
+                // Text up to the interpolation, including the space before it
+                if (interp.start > text_start) {
+                    const text_node = try ast.AstNode.text(arena_allocator, text_line, text_column, source[text_start..interp.start]);
+                    text_node.data.Text.is_raw = is_raw;
+                    try nodes.append(arena_allocator, text_node);
+                }
+
+                const interp_node = try ast.AstNode.interpolation(
+                    arena_allocator,
+                    interp.line,
+                    interp.column,
+                    interp.value,
+                    interp.type == .UnescapedInterpol,
+                );
+                try nodes.append(arena_allocator, interp_node);
+
+                // Text resumes right after the closing brace
+                text_start = interp.end;
+                text_end = interp.end;
+                text_line = interp.line;
+                text_column = interp.column + (interp.end - interp.start);
+            } else {
+                text_end = self.current.end;
+            }
+            try self.advance();
+        }
+
+        // Flush remaining text
+        if (text_end > text_start) {
+            const text_node = try ast.AstNode.text(arena_allocator, text_line, text_column, source[text_start..text_end]);
+            text_node.data.Text.is_raw = is_raw;
+            try nodes.append(arena_allocator, text_node);
+        }
+
+        return nodes;
+    }
+
     // ========================================================================
     // Children Parsing
     // ========================================================================
@@ -1086,16 +1076,24 @@ pub const Parser = struct {
                     try self.advance(); // consume 'when'
 
                     // Parse when values (comma separated)
-                    var values = std.ArrayListUnmanaged([]const u8){};
+                    var values = std.ArrayListUnmanaged(ast.WhenValue){};
                     var current_value: std.ArrayList(u8) = .{};
+                    var kind: ast.WhenValue.Kind = .text; // Of the value's tokens so far
 
                     while (!self.match(&.{ .Newline, .Eof })) {
                         if (self.match(&.{.Comma})) {
-                            try values.append(arena_allocator, try current_value.toOwnedSlice(arena_allocator));
+                            try values.append(arena_allocator, .{
+                                .text = try current_value.toOwnedSlice(arena_allocator),
+                                .kind = kind,
+                            });
                             current_value = .{};
+                            kind = .text;
                             try self.advance();
                         } else {
-                            if (current_value.items.len > 0) {
+                            kind = whenValueKind(current_value.items, self.current);
+                            // A number's sign is kept next to it (-1)
+                            const signed = kind == .number and std.mem.eql(u8, current_value.items, "-");
+                            if (current_value.items.len > 0 and !signed) {
                                 try current_value.append(arena_allocator, ' ');
                             }
                             try current_value.appendSlice(arena_allocator, self.current.value);
@@ -1103,7 +1101,10 @@ pub const Parser = struct {
                         }
                     }
                     if (current_value.items.len > 0) {
-                        try values.append(arena_allocator, try current_value.toOwnedSlice(arena_allocator));
+                        try values.append(arena_allocator, .{
+                            .text = try current_value.toOwnedSlice(arena_allocator),
+                            .kind = kind,
+                        });
                     }
 
                     // Parse when block
@@ -1167,6 +1168,20 @@ pub const Parser = struct {
         );
     }
 
+    /// Kind of a when value after one more token
+    ///
+    /// A value that is a single string or number token (a number may have a
+    /// minus sign) is compared by type; anything else is compared as text.
+    fn whenValueKind(text: []const u8, token: tokenizer.Token) ast.WhenValue.Kind {
+        if (std.mem.eql(u8, text, "-") and token.type == .Number) return .number;
+        if (text.len > 0) return .text;
+        return switch (token.type) {
+            .String => .string,
+            .Number => .number,
+            else => .text,
+        };
+    }
+
     // ========================================================================
     // Mixin Definition Parsing
     // ========================================================================
@@ -1352,8 +1367,6 @@ pub const Parser = struct {
         const start_line = self.current.line;
         try self.advance(); // consume 'include'
 
-        // Parse file path
-        var path: std.ArrayList(u8) = .{};
         var filter: ?[]const u8 = null;
 
         // Check for filter (e.g., include:markdown file.md)
@@ -1366,13 +1379,7 @@ pub const Parser = struct {
         }
 
         // Parse path (rest of the line)
-        while (!self.match(&.{ .Newline, .Eof })) {
-            if (path.items.len > 0) {
-                try path.append(arena_allocator, ' ');
-            }
-            try path.appendSlice(arena_allocator, self.current.value);
-            try self.advance();
-        }
+        const path = try self.parsePath();
 
         return try ast.AstNode.create(
             arena_allocator,
@@ -1380,12 +1387,27 @@ pub const Parser = struct {
             start_line,
             1,
             .{ .Include = .{
-                .path = try path.toOwnedSlice(arena_allocator),
+                .path = path,
                 .filter = filter,
             } },
         );
     }
 
+    /// Parse the rest of the line as a file path
+    ///
+    /// Returns the source slice from the first token to the end of the
+    /// last one, so paths like `../partials/header.pug` are kept verbatim
+    /// whatever tokens their characters happen to form.
+    fn parsePath(self: *Parser) ![]const u8 {
+        const start = self.current.start;
+        var end = start;
+        while (!self.match(&.{ .Newline, .Eof })) {
+            end = self.current.end;
+            try self.advance();
+        }
+        return std.mem.trim(u8, self.tokenizer.source[start..end], " \t");
+    }
+
     // ========================================================================
     // Extends Parsing
     // ========================================================================
@@ -1401,14 +1423,7 @@ pub const Parser = struct {
         try self.advance(); // consume 'extends'
 
         // Parse parent template path
-        var path: std.ArrayList(u8) = .{};
-        while (!self.match(&.{ .Newline, .Eof })) {
-            if (path.items.len > 0) {
-                try path.append(arena_allocator, ' ');
-            }
-            try path.appendSlice(arena_allocator, self.current.value);
-            try self.advance();
-        }
+        const path = try self.parsePath();
 
         return try ast.AstNode.create(
             arena_allocator,
@@ -1416,7 +1431,7 @@ pub const Parser = struct {
             start_line,
             1,
             .{ .Extends = .{
-                .path = try path.toOwnedSlice(arena_allocator),
+                .path = path,
             } },
         );
     }
@@ -1487,11 +1502,11 @@ test "parser - simple tag" {
     defer parser.deinit();
 
     const tree = try parser.parse();
-    try std.testing.expectEqual(ast.NodeType.Document, tree.type);
+    try std.testing.expectEqual(ast.NodeType.Document, tree.nodeType());
     try std.testing.expectEqual(@as(usize, 1), tree.data.Document.children.items.len);
 
     const tag = tree.data.Document.children.items[0];
-    try std.testing.expectEqual(ast.NodeType.Tag, tag.type);
+    try std.testing.expectEqual(ast.NodeType.Tag, tag.nodeType());
     try std.testing.expectEqualStrings("div", tag.data.Tag.name);
 }
 
@@ -1508,6 +1523,46 @@ test "parser - tag with class" {
     try std.testing.expectEqualStrings("container", tag.data.Tag.attributes.items[0].value.?);
 }
 
+test "parser - class attributes are merged and literal attributes prerendered" {
+    var parser = try Parser.init(std.testing.allocator,
+        \\input.field#email(type="email" class="wide" required)
+        \\a.btn(class=kind href=url)
+    );
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+    const input = tree.data.Document.children.items[0].data.Tag;
+    const link = tree.data.Document.children.items[1].data.Tag;
+
+    try std.testing.expectEqual(@as(usize, 4), input.attributes.items.len);
+    try std.testing.expectEqualStrings(" id=\"email\" class=\"field wide\" type=\"email\" required", input.static_attributes.?);
+
+    // An expression class makes the merged class an expression
+    try std.testing.expectEqual(@as(usize, 2), link.attributes.items.len);
+    try std.testing.expectEqualStrings("'btn' + ' ' + (kind)", link.attributes.items[0].value.?);
+    try std.testing.expect(link.attributes.items[0].is_expression);
+    try std.testing.expect(link.static_attributes == null);
+    try std.testing.expectEqual(@as(usize, 2), link.attribute_parts.len);
+    try std.testing.expectEqual(@as(u32, 0), link.attribute_parts[0].expression);
+    try std.testing.expectEqual(@as(u32, 1), link.attribute_parts[1].expression);
+}
+
+test "parser - literal attributes around expressions are prerendered in runs" {
+    var parser = try Parser.init(std.testing.allocator,
+        \\input(type="text" name="q" value=q autocomplete="off")
+    );
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+    const input = tree.data.Document.children.items[0].data.Tag;
+
+    try std.testing.expect(input.static_attributes == null);
+    try std.testing.expectEqual(@as(usize, 3), input.attribute_parts.len);
+    try std.testing.expectEqualStrings(" type=\"text\" name=\"q\"", input.attribute_parts[0].markup);
+    try std.testing.expectEqual(@as(u32, 2), input.attribute_parts[1].expression);
+    try std.testing.expectEqualStrings(" autocomplete=\"off\"", input.attribute_parts[2].markup);
+}
+
 test "parser - tag with id" {
     var parser = try Parser.init(std.testing.allocator, "div#main");
     defer parser.deinit();
@@ -1545,7 +1600,7 @@ test "parser - tag with text" {
     try std.testing.expectEqual(@as(usize, 1), tag.data.Tag.children.items.len);
 
     const text = tag.data.Tag.children.items[0];
-    try std.testing.expectEqual(ast.NodeType.Text, text.type);
+    try std.testing.expectEqual(ast.NodeType.Text, text.nodeType());
     try std.testing.expectEqualStrings("Hello World", text.data.Text.content);
 }
 
@@ -1564,7 +1619,7 @@ test "parser - nested tags" {
     try std.testing.expectEqual(@as(usize, 1), div.data.Tag.children.items.len);
 
     const p = div.data.Tag.children.items[0];
-    try std.testing.expectEqual(ast.NodeType.Tag, p.type);
+    try std.testing.expectEqual(ast.NodeType.Tag, p.nodeType());
     try std.testing.expectEqualStrings("p", p.data.Tag.name);
 }
 
@@ -1575,7 +1630,7 @@ test "parser - comment" {
     const tree = try parser.parse();
     const comment = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Comment, comment.type);
+    try std.testing.expectEqual(ast.NodeType.Comment, comment.nodeType());
     try std.testing.expectEqualStrings("This is a comment", comment.data.Comment.content);
     try std.testing.expect(comment.data.Comment.is_buffered);
 }
@@ -1591,7 +1646,7 @@ test "parser - conditional (if)" {
     const tree = try parser.parse();
     const conditional = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Conditional, conditional.type);
+    try std.testing.expectEqual(ast.NodeType.Conditional, conditional.nodeType());
     try std.testing.expectEqualStrings("user", conditional.data.Conditional.condition);
     try std.testing.expect(!conditional.data.Conditional.is_unless);
     try std.testing.expectEqual(@as(usize, 1), conditional.data.Conditional.then_branch.items.len);
@@ -1608,7 +1663,7 @@ test "parser - conditional (unless)" {
     const tree = try parser.parse();
     const conditional = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Conditional, conditional.type);
+    try std.testing.expectEqual(ast.NodeType.Conditional, conditional.nodeType());
     try std.testing.expectEqualStrings("loggedIn", conditional.data.Conditional.condition);
     try std.testing.expect(conditional.data.Conditional.is_unless);
 }
@@ -1626,7 +1681,7 @@ test "parser - conditional with else" {
     const tree = try parser.parse();
     const conditional = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Conditional, conditional.type);
+    try std.testing.expectEqual(ast.NodeType.Conditional, conditional.nodeType());
     try std.testing.expect(conditional.data.Conditional.else_branch != null);
     try std.testing.expectEqual(@as(usize, 1), conditional.data.Conditional.else_branch.?.items.len);
 }
@@ -1642,7 +1697,7 @@ test "parser - loop (each)" {
     const tree = try parser.parse();
     const loop = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Loop, loop.type);
+    try std.testing.expectEqual(ast.NodeType.Loop, loop.nodeType());
     try std.testing.expect(!loop.data.Loop.is_while);
     try std.testing.expectEqual(@as(usize, 1), loop.data.Loop.body.items.len);
 }
@@ -1658,7 +1713,7 @@ test "parser - loop (while)" {
     const tree = try parser.parse();
     const loop = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Loop, loop.type);
+    try std.testing.expectEqual(ast.NodeType.Loop, loop.nodeType());
     try std.testing.expect(loop.data.Loop.is_while);
 }
 
@@ -1678,20 +1733,47 @@ test "parser - case statement" {
     const tree = try parser.parse();
     const case_node = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Case, case_node.type);
+    try std.testing.expectEqual(ast.NodeType.Case, case_node.nodeType());
     try std.testing.expectEqualStrings("fruit", case_node.data.Case.expression);
     try std.testing.expectEqual(@as(usize, 2), case_node.data.Case.cases.items.len);
     try std.testing.expect(case_node.data.Case.default != null);
 
     // Check first when node
     const when1 = case_node.data.Case.cases.items[0];
-    try std.testing.expectEqual(ast.NodeType.When, when1.type);
+    try std.testing.expectEqual(ast.NodeType.When, when1.nodeType());
     try std.testing.expectEqual(@as(usize, 1), when1.data.When.values.items.len);
 
     // Check second when node
     const when2 = case_node.data.Case.cases.items[1];
-    try std.testing.expectEqual(ast.NodeType.When, when2.type);
+    try std.testing.expectEqual(ast.NodeType.When, when2.nodeType());
     try std.testing.expectEqual(@as(usize, 2), when2.data.When.values.items.len);
+    try std.testing.expectEqualStrings("lemon", when2.data.When.values.items[1].text);
+    try std.testing.expectEqual(ast.WhenValue.Kind.string, when2.data.When.values.items[1].kind);
+}
+
+test "parser - when value kinds" {
+    const source =
+        \\case code
+        \\  when 404, -1, "1", ok
+        \\    p Match
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+    const values = tree.data.Document.children.items[0].data.Case.cases.items[0].data.When.values.items;
+
+    const expected = [_]ast.WhenValue{
+        .{ .text = "404", .kind = .number },
+        .{ .text = "-1", .kind = .number },
+        .{ .text = "1", .kind = .string },
+        .{ .text = "ok", .kind = .text },
+    };
+    try std.testing.expectEqual(expected.len, values.len);
+    for (expected, values) |want, value| {
+        try std.testing.expectEqualStrings(want.text, value.text);
+        try std.testing.expectEqual(want.kind, value.kind);
+    }
 }
 
 test "parser - attributes with values" {
@@ -1702,7 +1784,7 @@ test "parser - attributes with values" {
     const tree = try parser.parse();
     const tag = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Tag, tag.type);
+    try std.testing.expectEqual(ast.NodeType.Tag, tag.nodeType());
     try std.testing.expectEqualStrings("a", tag.data.Tag.name);
     try std.testing.expectEqual(@as(usize, 2), tag.data.Tag.attributes.items.len);
 
@@ -1751,7 +1833,7 @@ test "parser - multiline attributes" {
     const tree = try parser.parse();
     const tag = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Tag, tag.type);
+    try std.testing.expectEqual(ast.NodeType.Tag, tag.nodeType());
     try std.testing.expectEqual(@as(usize, 2), tag.data.Tag.attributes.items.len);
 
     const attr1 = tag.data.Tag.attributes.items[0];
@@ -1787,7 +1869,7 @@ test "parser - mixin definition" {
     const tree = try parser.parse();
     const mixin_def = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.MixinDef, mixin_def.type);
+    try std.testing.expectEqual(ast.NodeType.MixinDef, mixin_def.nodeType());
     try std.testing.expectEqualStrings("greeting", mixin_def.data.MixinDef.name);
     try std.testing.expectEqual(@as(usize, 1), mixin_def.data.MixinDef.params.items.len);
     try std.testing.expectEqualStrings("name", mixin_def.data.MixinDef.params.items[0]);
@@ -1805,7 +1887,7 @@ test "parser - mixin definition with rest param" {
     const tree = try parser.parse();
     const mixin_def = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.MixinDef, mixin_def.type);
+    try std.testing.expectEqual(ast.NodeType.MixinDef, mixin_def.nodeType());
     try std.testing.expectEqualStrings("list", mixin_def.data.MixinDef.name);
     try std.testing.expect(mixin_def.data.MixinDef.rest_param != null);
     try std.testing.expectEqualStrings("items", mixin_def.data.MixinDef.rest_param.?);
@@ -1821,7 +1903,7 @@ test "parser - mixin call" {
     const tree = try parser.parse();
     const mixin_call = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.MixinCall, mixin_call.type);
+    try std.testing.expectEqual(ast.NodeType.MixinCall, mixin_call.nodeType());
     try std.testing.expectEqualStrings("greeting", mixin_call.data.MixinCall.name);
     try std.testing.expectEqual(@as(usize, 1), mixin_call.data.MixinCall.args.items.len);
 }
@@ -1837,7 +1919,7 @@ test "parser - mixin call with block" {
     const tree = try parser.parse();
     const mixin_call = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.MixinCall, mixin_call.type);
+    try std.testing.expectEqual(ast.NodeType.MixinCall, mixin_call.nodeType());
     try std.testing.expect(mixin_call.data.MixinCall.body != null);
     try std.testing.expectEqual(@as(usize, 1), mixin_call.data.MixinCall.body.?.items.len);
 }
@@ -1850,11 +1932,23 @@ test "parser - include" {
     const tree = try parser.parse();
     const include = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Include, include.type);
+    try std.testing.expectEqual(ast.NodeType.Include, include.nodeType());
     try std.testing.expectEqualStrings("header.pug", include.data.Include.path);
     try std.testing.expect(include.data.Include.filter == null);
 }
 
+test "parser - include path is kept verbatim" {
+    const source = "include ../partials/site-header.pug\np after";
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+    const include = tree.data.Document.children.items[0];
+
+    try std.testing.expectEqualStrings("../partials/site-header.pug", include.data.Include.path);
+    try std.testing.expectEqual(@as(usize, 2), tree.data.Document.children.items.len);
+}
+
 test "parser - include with filter" {
     const source = "include:markdown content.md";
     var parser = try Parser.init(std.testing.allocator, source);
@@ -1863,7 +1957,7 @@ test "parser - include with filter" {
     const tree = try parser.parse();
     const include = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Include, include.type);
+    try std.testing.expectEqual(ast.NodeType.Include, include.nodeType());
     try std.testing.expectEqualStrings("content.md", include.data.Include.path);
     try std.testing.expect(include.data.Include.filter != null);
     try std.testing.expectEqualStrings("markdown", include.data.Include.filter.?);
@@ -1877,7 +1971,7 @@ test "parser - extends" {
     const tree = try parser.parse();
     const extends = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Extends, extends.type);
+    try std.testing.expectEqual(ast.NodeType.Extends, extends.nodeType());
     try std.testing.expectEqualStrings("layout.pug", extends.data.Extends.path);
 }
 
@@ -1892,7 +1986,7 @@ test "parser - block" {
     const tree = try parser.parse();
     const block = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Block, block.type);
+    try std.testing.expectEqual(ast.NodeType.Block, block.nodeType());
     try std.testing.expectEqualStrings("content", block.data.Block.name);
     try std.testing.expectEqual(ast.BlockMode.Replace, block.data.Block.mode);
     try std.testing.expectEqual(@as(usize, 1), block.data.Block.body.items.len);
@@ -1909,7 +2003,7 @@ test "parser - block append" {
     const tree = try parser.parse();
     const block = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Block, block.type);
+    try std.testing.expectEqual(ast.NodeType.Block, block.nodeType());
     try std.testing.expectEqualStrings("scripts", block.data.Block.name);
     try std.testing.expectEqual(ast.BlockMode.Append, block.data.Block.mode);
 }
@@ -1925,7 +2019,7 @@ test "parser - block prepend" {
     const tree = try parser.parse();
     const block = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Block, block.type);
+    try std.testing.expectEqual(ast.NodeType.Block, block.nodeType());
     try std.testing.expectEqualStrings("head", block.data.Block.name);
     try std.testing.expectEqual(ast.BlockMode.Prepend, block.data.Block.mode);
 }
@@ -1938,18 +2032,18 @@ test "parser - interpolation as separate node" {
     const tree = try parser.parse();
     const tag = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(ast.NodeType.Tag, tag.type);
+    try std.testing.expectEqual(ast.NodeType.Tag, tag.nodeType());
     try std.testing.expectEqualStrings("p", tag.data.Tag.name);
     try std.testing.expectEqual(@as(usize, 2), tag.data.Tag.children.items.len);
 
-    // First child should be Text
+    // First child should be Text (keeping the space before the interpolation)
     const text_node = tag.data.Tag.children.items[0];
-    try std.testing.expectEqual(ast.NodeType.Text, text_node.type);
-    try std.testing.expectEqualStrings("Hello", text_node.data.Text.content);
+    try std.testing.expectEqual(ast.NodeType.Text, text_node.nodeType());
+    try std.testing.expectEqualStrings("Hello ", text_node.data.Text.content);
 
     // Second child should be Interpolation
     const interp_node = tag.data.Tag.children.items[1];
-    try std.testing.expectEqual(ast.NodeType.Interpolation, interp_node.type);
+    try std.testing.expectEqual(ast.NodeType.Interpolation, interp_node.nodeType());
     try std.testing.expectEqualStrings("name", interp_node.data.Interpolation.expression);
     try std.testing.expectEqual(false, interp_node.data.Interpolation.is_unescaped);
 }
@@ -1962,19 +2056,23 @@ test "parser - multiple interpolations" {
     const tree = try parser.parse();
     const tag = tree.data.Document.children.items[0];
 
-    try std.testing.expectEqual(@as(usize, 3), tag.data.Tag.children.items.len);
+    try std.testing.expectEqual(@as(usize, 4), tag.data.Tag.children.items.len);
 
     // First: Interpolation
-    try std.testing.expectEqual(ast.NodeType.Interpolation, tag.data.Tag.children.items[0].type);
+    try std.testing.expectEqual(ast.NodeType.Interpolation, tag.data.Tag.children.items[0].nodeType());
     try std.testing.expectEqualStrings("greeting", tag.data.Tag.children.items[0].data.Interpolation.expression);
 
-    // Second: Interpolation
-    try std.testing.expectEqual(ast.NodeType.Interpolation, tag.data.Tag.children.items[1].type);
-    try std.testing.expectEqualStrings("name", tag.data.Tag.children.items[1].data.Interpolation.expression);
+    // Second: the space between them
+    try std.testing.expectEqual(ast.NodeType.Text, tag.data.Tag.children.items[1].nodeType());
+    try std.testing.expectEqualStrings(" ", tag.data.Tag.children.items[1].data.Text.content);
+
+    // Third: Interpolation
+    try std.testing.expectEqual(ast.NodeType.Interpolation, tag.data.Tag.children.items[2].nodeType());
+    try std.testing.expectEqualStrings("name", tag.data.Tag.children.items[2].data.Interpolation.expression);
 
-    // Third: Text
-    try std.testing.expectEqual(ast.NodeType.Text, tag.data.Tag.children.items[2].type);
-    try std.testing.expectEqualStrings("!", tag.data.Tag.children.items[2].data.Text.content);
+    // Fourth: Text
+    try std.testing.expectEqual(ast.NodeType.Text, tag.data.Tag.children.items[3].nodeType());
+    try std.testing.expectEqualStrings("!", tag.data.Tag.children.items[3].data.Text.content);
 }
 
 test "parser - unescaped interpolation" {
@@ -1988,7 +2086,7 @@ test "parser - unescaped interpolation" {
     try std.testing.expectEqual(@as(usize, 1), tag.data.Tag.children.items.len);
 
     const interp_node = tag.data.Tag.children.items[0];
-    try std.testing.expectEqual(ast.NodeType.Interpolation, interp_node.type);
+    try std.testing.expectEqual(ast.NodeType.Interpolation, interp_node.nodeType());
     try std.testing.expectEqualStrings("htmlContent", interp_node.data.Interpolation.expression);
     try std.testing.expectEqual(true, interp_node.data.Interpolation.is_unescaped);
 }
@@ -2004,7 +2102,7 @@ test "parser - interpolation with JavaScript expression" {
     try std.testing.expectEqual(@as(usize, 1), tag.data.Tag.children.items.len);
 
     const interp_node = tag.data.Tag.children.items[0];
-    try std.testing.expectEqual(ast.NodeType.Interpolation, interp_node.type);
+    try std.testing.expectEqual(ast.NodeType.Interpolation, interp_node.nodeType());
     try std.testing.expectEqualStrings("name.toLowerCase()", interp_node.data.Interpolation.expression);
 }
 
@@ -2023,18 +2121,31 @@ test "parser - pipe text with interpolation" {
 
     const pipe_container = div_tag.data.Tag.children.items[0];
     // When there are multiple nodes, parsePipeText wraps them in a Tag container
-    try std.testing.expectEqual(ast.NodeType.Tag, pipe_container.type);
+    try std.testing.expectEqual(ast.NodeType.Tag, pipe_container.nodeType());
     try std.testing.expectEqual(@as(usize, 3), pipe_container.data.Tag.children.items.len);
 
-    // First: Text "Hello"
-    try std.testing.expectEqual(ast.NodeType.Text, pipe_container.data.Tag.children.items[0].type);
-    try std.testing.expectEqualStrings("Hello", pipe_container.data.Tag.children.items[0].data.Text.content);
+    // First: Text "Hello "
+    try std.testing.expectEqual(ast.NodeType.Text, pipe_container.data.Tag.children.items[0].nodeType());
+    try std.testing.expectEqualStrings("Hello ", pipe_container.data.Tag.children.items[0].data.Text.content);
 
     // Second: Interpolation "name"
-    try std.testing.expectEqual(ast.NodeType.Interpolation, pipe_container.data.Tag.children.items[1].type);
+    try std.testing.expectEqual(ast.NodeType.Interpolation, pipe_container.data.Tag.children.items[1].nodeType());
     try std.testing.expectEqualStrings("name", pipe_container.data.Tag.children.items[1].data.Interpolation.expression);
 
-    // Third: Text "!" (note: has trailing space due to token processing)
-    try std.testing.expectEqual(ast.NodeType.Text, pipe_container.data.Tag.children.items[2].type);
-    try std.testing.expectEqualStrings("! ", pipe_container.data.Tag.children.items[2].data.Text.content);
+    // Third: Text "!"
+    try std.testing.expectEqual(ast.NodeType.Text, pipe_container.data.Tag.children.items[2].nodeType());
+    try std.testing.expectEqualStrings("!", pipe_container.data.Tag.children.items[2].data.Text.content);
+}
+
+test "parser - text nodes slice the source" {
+    const source = "p Spaced   out,  \"quoted\" text";
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+
+    const tree = try parser.parse();
+    const text = tree.data.Document.children.items[0].data.Tag.children.items[0];
+
+    try std.testing.expectEqualStrings("Spaced   out,  \"quoted\" text", text.data.Text.content);
+    // No copy: the content points into the template source
+    try std.testing.expectEqual(@intFromPtr(source.ptr) + 2, @intFromPtr(text.data.Text.content.ptr));
 }
@@ -0,0 +1,500 @@
+//! Precompiled templates - Binary `.zpugc` format loaded without parsing
+//!
+//! `zpug --precompile page.pug` writes `page.zpugc`: the parsed AST of the
+//! template in a compact binary form. Loading it maps the file into memory
+//! and rebuilds the node tree in one linear pass: no tokenizing, no
+//! parsing, and every string (static text, tag names, expressions) is a
+//! slice of the mapping rather than a copy.
+//!
+//! Layout (all integers little-endian):
+//! ```
+//! header    magic "ZPUGC\x00\r\n", version u32, node count u32,
+//!           source hash u64, string table size u32, dependency count u32
+//! strings   the template source, then strings the parser built itself
+//!           (e.g. joined class lists)
+//! deps      (offset u32, length u32) per include/extends path
+//! nodes     the AST in preorder
+//! ```
+//! A string is stored as (offset u32, length u32) into the string table.
+//! Because text nodes and expressions slice the source, the source doubles
+//! as the table of static byte segments and expressions.
+//!
+//! Each node is its type (u8), line and column (u32), then its NodeData
+//! fields in declaration order: strings as above, bools and enums as u8,
+//! optionals as a presence byte plus the value, lists as a u32 count plus
+//! the items. The encoding is derived from the ast types at comptime, so
+//! new node fields are serialized without changes here; bump
+//! format_version when they change.
+//!
+//! Example:
+//! ```zig
+//! const bytes = try precompiled.serialize(allocator, tree, source);
+//! defer allocator.free(bytes);
+//! try std.fs.cwd().writeFile(.{ .sub_path = "page.zpugc", .data = bytes });
+//!
+//! const tmpl = try precompiled.Template.load(allocator, "page.zpugc");
+//! defer tmpl.deinit();
+//! const html = try compiler.compile(tmpl.root);
+//! ```
+
+const std = @import("std");
+const builtin = @import("builtin");
+const ast = @import("ast.zig");
+const cache = @import("cache.zig");
+
+/// File extension of precompiled templates
+pub const file_extension = ".zpugc";
+
+/// Bumped whenever the encoding or the ast types change
+pub const format_version: u32 = 3;
+
+const magic = "ZPUGC\x00\r\n";
+const header_size = magic.len + 4 + 4 + 8 + 4 + 4;
+
+/// Smallest encoded node: type, line and column
+const min_node_size = 1 + 4 + 4;
+
+pub const EncodeError = error{ OutOfMemory, TemplateTooLarge };
+pub const DecodeError = error{ OutOfMemory, InvalidFormat, UnsupportedVersion };
+
+// ============================================================================
+// Serialization
+// ============================================================================
+
+/// Serialize a parsed template
+///
+/// Parameters:
+/// - root: Root node returned by Parser.parse()
+/// - source: Source the tree was parsed from
+///
+/// Returns: Encoded template (caller owns memory)
+///
+/// Errors:
+/// - TemplateTooLarge: More than 4 GiB of strings or nodes
+pub fn serialize(allocator: std.mem.Allocator, root: *const ast.AstNode, source: []const u8) EncodeError![]u8 {
+    var encoder = Encoder{ .allocator = allocator, .source = source };
+    defer encoder.deinit();
+
+    try encoder.writeNode(root);
+
+    const strings_len = std.math.cast(u32, source.len + encoder.extra.items.len) orelse return error.TemplateTooLarge;
+
+    var out = std.ArrayList(u8){};
+    errdefer out.deinit(allocator);
+    try out.ensureTotalCapacity(allocator, header_size + strings_len + encoder.deps.items.len * 8 + encoder.nodes.items.len);
+
+    const w = out.writer(allocator);
+    try w.writeAll(magic);
+    try w.writeInt(u32, format_version, .little);
+    try w.writeInt(u32, encoder.node_count, .little);
+    try w.writeInt(u64, cache.hashSource(source), .little);
+    try w.writeInt(u32, strings_len, .little);
+    try w.writeInt(u32, @intCast(encoder.deps.items.len), .little);
+
+    try w.writeAll(source);
+    try w.writeAll(encoder.extra.items);
+    for (encoder.deps.items) |dep| {
+        try w.writeInt(u32, dep.offset, .little);
+        try w.writeInt(u32, dep.len, .little);
+    }
+    try w.writeAll(encoder.nodes.items);
+
+    return out.toOwnedSlice(allocator);
+}
+
+const StringRef = struct {
+    offset: u32,
+    len: u32,
+};
+
+const Encoder = struct {
+    allocator: std.mem.Allocator,
+    source: []const u8,
+    nodes: std.ArrayList(u8) = .{}, // Encoded node stream
+    extra: std.ArrayList(u8) = .{}, // Strings not found in the source
+    extra_offsets: std.StringHashMapUnmanaged(u32) = .{}, // Dedup of extra
+    deps: std.ArrayList(StringRef) = .{},
+    node_count: u32 = 0,
+
+    fn deinit(self: *Encoder) void {
+        self.nodes.deinit(self.allocator);
+        self.extra.deinit(self.allocator);
+        self.extra_offsets.deinit(self.allocator);
+        self.deps.deinit(self.allocator);
+    }
+
+    fn writeNode(self: *Encoder, node: *const ast.AstNode) EncodeError!void {
+        self.node_count = std.math.add(u32, self.node_count, 1) catch return error.TemplateTooLarge;
+
+        try self.int(u8, @intFromEnum(node.nodeType()));
+        try self.int(u32, node.line);
+        try self.int(u32, node.column);
+
+        switch (node.data) {
+            .Include => |inc| try self.addDependency(inc.path),
+            .Extends => |ext| try self.addDependency(ext.path),
+            else => {},
+        }
+
+        switch (node.data) {
+            inline else => |payload| try self.value(payload),
+        }
+    }
+
+    fn value(self: *Encoder, v: anytype) EncodeError!void {
+        const T = @TypeOf(v);
+        switch (@typeInfo(T)) {
+            .pointer => if (T == []const u8)
+                try self.string(v)
+            else if (T == *ast.AstNode)
+                try self.writeNode(v)
+            else
+                @compileError("cannot serialize " ++ @typeName(T)),
+            .bool => try self.int(u8, @intFromBool(v)),
+            .optional => {
+                if (v) |inner| {
+                    try self.int(u8, 1);
+                    try self.value(inner);
+                } else {
+                    try self.int(u8, 0);
+                }
+            },
+            .@"enum" => try self.int(u8, @intFromEnum(v)),
+            .@"struct" => |info| {
+                if (comptime isList(T)) {
+                    try self.int(u32, std.math.cast(u32, v.items.len) orelse return error.TemplateTooLarge);
+                    for (v.items) |item| try self.value(item);
+                } else {
+                    inline for (info.fields) |field| try self.value(@field(v, field.name));
+                }
+            },
+            else => @compileError("cannot serialize " ++ @typeName(T)),
+        }
+    }
+
+    fn string(self: *Encoder, str: []const u8) EncodeError!void {
+        const ref = try self.stringRef(str);
+        try self.int(u32, ref.offset);
+        try self.int(u32, ref.len);
+    }
+
+    /// Locate a string in the source, or append it to the extra strings
+    fn stringRef(self: *Encoder, str: []const u8) EncodeError!StringRef {
+        const len = std.math.cast(u32, str.len) orelse return error.TemplateTooLarge;
+        if (str.len == 0) return .{ .offset = 0, .len = 0 };
+
+        const start = @intFromPtr(str.ptr);
+        const source_start = @intFromPtr(self.source.ptr);
+        if (start >= source_start and start + str.len <= source_start + self.source.len) {
+            return .{ .offset = @intCast(start - source_start), .len = len };
+        }
+
+        const gop = try self.extra_offsets.getOrPut(self.allocator, str);
+        if (!gop.found_existing) {
+            gop.value_ptr.* = std.math.cast(u32, self.source.len + self.extra.items.len) orelse return error.TemplateTooLarge;
+            try self.extra.appendSlice(self.allocator, str);
+        }
+        return .{ .offset = gop.value_ptr.*, .len = len };
+    }
+
+    fn addDependency(self: *Encoder, path: []const u8) EncodeError!void {
+        const ref = try self.stringRef(path);
+        for (self.deps.items) |dep| {
+            if (dep.offset == ref.offset and dep.len == ref.len) return;
+        }
+        try self.deps.append(self.allocator, ref);
+    }
+
+    fn int(self: *Encoder, comptime T: type, n: T) EncodeError!void {
+        try self.nodes.writer(self.allocator).writeInt(T, n, .little);
+    }
+};
+
+/// True for std.ArrayListUnmanaged instances
+fn isList(comptime T: type) bool {
+    return @typeInfo(T) == .@"struct" and @hasField(T, "items") and @hasField(T, "capacity");
+}
+
+// ============================================================================
+// Loading
+// ============================================================================
+
+/// A loaded precompiled template
+///
+/// Nodes live in an arena, stored contiguously in preorder; all strings
+/// point into the serialized bytes, which stay mapped until deinit().
+pub const Template = struct {
+    allocator: std.mem.Allocator,
+    arena: std.heap.ArenaAllocator,
+    bytes: []const u8,
+    storage: Storage,
+    path: ?[]const u8, // File it was loaded from (base path for includes)
+    root: *ast.AstNode,
+    source_hash: u64, // hashSource() of the original template source
+    dependencies: []const []const u8, // include/extends paths, as written
+
+    const Storage = enum { borrowed, mapped, allocated };
+
+    /// Map a .zpugc file and decode it
+    ///
+    /// Errors:
+    /// - InvalidFormat: Not a precompiled template, or truncated
+    /// - UnsupportedVersion: Written by an incompatible zpug version
+    /// - File errors from open/stat/mmap
+    pub fn load(allocator: std.mem.Allocator, path: []const u8) !*Template {
+        const file = try std.fs.cwd().openFile(path, .{});
+        defer file.close();
+
+        const size = try file.getEndPos();
+        if (size < header_size) return error.InvalidFormat;
+
+        var bytes: []const u8 = undefined;
+        var storage: Storage = undefined;
+        if (comptime builtin.os.tag == .windows) {
+            bytes = try file.readToEndAlloc(allocator, std.math.maxInt(usize));
+            storage = .allocated;
+        } else {
+            bytes = try std.posix.mmap(null, size, std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, file.handle, 0);
+            storage = .mapped;
+        }
+
+        // From here on the template owns the bytes
+        const tmpl = decode(allocator, bytes, storage) catch |err| {
+            release(allocator, bytes, storage);
+            return err;
+        };
+        errdefer tmpl.deinit();
+        tmpl.path = try tmpl.arena.allocator().dupe(u8, path);
+        return tmpl;
+    }
+
+    /// Decode a template from memory
+    ///
+    /// The bytes are borrowed: they must outlive the template.
+    pub fn fromBytes(allocator: std.mem.Allocator, bytes: []const u8) DecodeError!*Template {
+        return decode(allocator, bytes, .borrowed);
+    }
+
+    /// Free the nodes and unmap the file
+    pub fn deinit(self: *Template) void {
+        self.arena.deinit();
+        release(self.allocator, self.bytes, self.storage);
+        self.allocator.destroy(self);
+    }
+
+    fn release(allocator: std.mem.Allocator, bytes: []const u8, storage: Storage) void {
+        switch (storage) {
+            .borrowed => {},
+            .allocated => allocator.free(bytes),
+            .mapped => if (comptime builtin.os.tag != .windows) std.posix.munmap(@alignCast(bytes)),
+        }
+    }
+};
+
+/// True if the bytes start like a precompiled template
+pub fn isPrecompiled(bytes: []const u8) bool {
+    return std.mem.startsWith(u8, bytes, magic);
+}
+
+fn decode(allocator: std.mem.Allocator, bytes: []const u8, storage: Template.Storage) DecodeError!*Template {
+    var reader = Reader{ .bytes = bytes };
+
+    if (!std.mem.eql(u8, try reader.take(magic.len), magic)) return error.InvalidFormat;
+    if (try reader.int(u32) != format_version) return error.UnsupportedVersion;
+    const node_count = try reader.int(u32);
+    const source_hash = try reader.int(u64);
+    const strings_len = try reader.int(u32);
+    const dep_count = try reader.int(u32);
+
+    const strings = try reader.take(strings_len);
+    if (dep_count > reader.remaining() / 8) return error.InvalidFormat;
+    if (node_count == 0 or node_count > reader.remaining() / min_node_size) return error.InvalidFormat;
+
+    const tmpl = try allocator.create(Template);
+    errdefer allocator.destroy(tmpl);
+    tmpl.* = .{
+        .allocator = allocator,
+        .arena = std.heap.ArenaAllocator.init(allocator),
+        .bytes = bytes,
+        .storage = storage,
+        .path = null,
+        .root = undefined,
+        .source_hash = source_hash,
+        .dependencies = &.{},
+    };
+    errdefer tmpl.arena.deinit();
+    const arena = tmpl.arena.allocator();
+
+    var decoder = Decoder{
+        .arena = arena,
+        .reader = &reader,
+        .strings = strings,
+        .nodes = try arena.alloc(ast.AstNode, node_count),
+    };
+
+    const deps = try arena.alloc([]const u8, dep_count);
+    for (deps) |*dep| dep.* = try decoder.string();
+    tmpl.dependencies = deps;
+
+    tmpl.root = try decoder.readNode();
+    if (decoder.next_node != node_count or reader.remaining() != 0) return error.InvalidFormat;
+
+    return tmpl;
+}
+
+const Reader = struct {
+    bytes: []const u8,
+    pos: usize = 0,
+
+    fn remaining(self: *const Reader) usize {
+        return self.bytes.len - self.pos;
+    }
+
+    fn take(self: *Reader, len: usize) DecodeError![]const u8 {
+        if (len > self.remaining()) return error.InvalidFormat;
+        defer self.pos += len;
+        return self.bytes[self.pos..][0..len];
+    }
+
+    fn int(self: *Reader, comptime T: type) DecodeError!T {
+        const raw = try self.take(@sizeOf(T));
+        return std.mem.readInt(T, raw[0..@sizeOf(T)], .little);
+    }
+};
+
+const Decoder = struct {
+    arena: std.mem.Allocator,
+    reader: *Reader,
+    strings: []const u8,
+    nodes: []ast.AstNode, // Preallocated, filled in preorder
+    next_node: usize = 0,
+
+    fn readNode(self: *Decoder) DecodeError!*ast.AstNode {
+        if (self.next_node >= self.nodes.len) return error.InvalidFormat;
+        const node = &self.nodes[self.next_node];
+        self.next_node += 1;
+
+        const node_type = std.meta.intToEnum(ast.NodeType, try self.reader.int(u8)) catch return error.InvalidFormat;
+        node.line = try self.reader.int(u32);
+        node.column = try self.reader.int(u32);
+        node.data = switch (node_type) {
+            inline else => |tag| @unionInit(
+                ast.NodeData,
+                @tagName(tag),
+                try self.value(@FieldType(ast.NodeData, @tagName(tag))),
+            ),
+        };
+        return node;
+    }
+
+    fn value(self: *Decoder, comptime T: type) DecodeError!T {
+        switch (@typeInfo(T)) {
+            .pointer => return if (T == []const u8)
+                self.string()
+            else if (T == *ast.AstNode)
+                self.readNode()
+            else
+                @compileError("cannot deserialize " ++ @typeName(T)),
+            .bool => return (try self.reader.int(u8)) != 0,
+            .optional => |info| {
+                if (try self.reader.int(u8) == 0) return null;
+                return try self.value(info.child);
+            },
+            .@"enum" => return std.meta.intToEnum(T, try self.reader.int(u8)) catch error.InvalidFormat,
+            .@"struct" => |info| {
+                if (comptime isList(T)) {
+                    const Item = @typeInfo(@FieldType(T, "items")).pointer.child;
+                    const count = try self.reader.int(u32);
+                    if (count > self.reader.remaining()) return error.InvalidFormat;
+
+                    var list = T{};
+                    try list.ensureTotalCapacityPrecise(self.arena, count);
+                    for (0..count) |_| list.appendAssumeCapacity(try self.value(Item));
+                    return list;
+                }
+                var result: T = undefined;
+                inline for (info.fields) |field| {
+                    @field(result, field.name) = try self.value(field.type);
+                }
+                return result;
+            },
+            else => @compileError("cannot deserialize " ++ @typeName(T)),
+        }
+    }
+
+    fn string(self: *Decoder) DecodeError![]const u8 {
+        const offset = try self.reader.int(u32);
+        const len = try self.reader.int(u32);
+        if (@as(u64, offset) + len > self.strings.len) return error.InvalidFormat;
+        return self.strings[offset..][0..len];
+    }
+};
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+test "precompiled - round trip" {
+    const Parser = @import("parser.zig").Parser;
+    const source =
+        \\doctype html
+        \\html
+        \\  include header
+        \\  body.main.wide(data-id=userId)
+        \\    each item, i in items
+        \\      p Item #{i}: #{item}
+    ;
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+    const tree = try parser.parse();
+
+    const bytes = try serialize(std.testing.allocator, tree, source);
+    defer std.testing.allocator.free(bytes);
+    try std.testing.expect(isPrecompiled(bytes));
+
+    const tmpl = try Template.fromBytes(std.testing.allocator, bytes);
+    defer tmpl.deinit();
+
+    try std.testing.expectEqual(cache.hashSource(source), tmpl.source_hash);
+    try std.testing.expectEqual(@as(usize, 1), tmpl.dependencies.len);
+    try std.testing.expectEqualStrings("header", tmpl.dependencies[0]);
+
+    // Same tree, strings pointing into the serialized bytes
+    const html = tmpl.root.data.Document.children.items[0];
+    const body = html.data.Tag.children.items[1];
+    try std.testing.expectEqualStrings("body", body.data.Tag.name);
+    try std.testing.expectEqual(body.line, tree.data.Document.children.items[0].data.Tag.children.items[1].line);
+    try std.testing.expect(@intFromPtr(body.data.Tag.name.ptr) >= @intFromPtr(bytes.ptr));
+
+    var class_found = false;
+    for (body.data.Tag.attributes.items) |attr| {
+        if (std.mem.eql(u8, attr.name, "class")) {
+            try std.testing.expectEqualStrings("main wide", attr.value.?);
+            class_found = true;
+        }
+    }
+    try std.testing.expect(class_found);
+
+    const loop = body.data.Tag.children.items[0].data.Loop;
+    try std.testing.expectEqualStrings("item", loop.iterator);
+    try std.testing.expectEqualStrings("i", loop.index.?);
+    try std.testing.expectEqualStrings("Item ", loop.body.items[0].data.Tag.children.items[0].data.Text.content);
+}
+
+test "precompiled - rejects damaged input" {
+    try std.testing.expectError(error.InvalidFormat, Template.fromBytes(std.testing.allocator, "not a template"));
+
+    const Parser = @import("parser.zig").Parser;
+    const source = "p Hello";
+    var parser = try Parser.init(std.testing.allocator, source);
+    defer parser.deinit();
+    const bytes = try serialize(std.testing.allocator, try parser.parse(), source);
+    defer std.testing.allocator.free(bytes);
+
+    try std.testing.expectError(error.InvalidFormat, Template.fromBytes(std.testing.allocator, bytes[0 .. bytes.len - 1]));
+
+    const wrong_version = try std.testing.allocator.dupe(u8, bytes);
+    defer std.testing.allocator.free(wrong_version);
+    wrong_version[magic.len] +%= 1;
+    try std.testing.expectError(error.UnsupportedVersion, Template.fromBytes(std.testing.allocator, wrong_version));
+}
@@ -0,0 +1,404 @@
+//! Profiler module - Render time attribution for `zpug --profile`
+//!
+//! When a Profiler is attached to a Compiler, every compiled AST node and
+//! every evaluated JavaScript expression is timed and attributed to its
+//! template file and line. Time is recorded twice:
+//! - total: wall time including everything compiled underneath
+//! - self: total minus the time of nested nodes and expressions
+//!
+//! Self times add up to the whole render, so the hot list (sorted by self
+//! time) shows where the time actually goes.
+//!
+//! The profiler also tracks the template call path (entry template, then
+//! include, extends, mixin and block frames) and accumulates self time per
+//! path, which is written as folded stacks for flamegraph tools:
+//!
+//! ```
+//! views/page.pug;include views/nav.pug;mixin link 183200
+//! ```
+//!
+//! Example:
+//! ```zig
+//! var prof = try Profiler.init(allocator);
+//! defer prof.deinit();
+//!
+//! compiler.setProfiler(&prof);
+//! const html = try compiler.compile(document);
+//!
+//! try prof.writeHotList(stderr, 20);
+//! ```
+
+const std = @import("std");
+
+/// Kind of template call frame
+pub const FrameKind = enum {
+    template, // Entry template
+    include,
+    extends,
+    mixin,
+    block,
+};
+
+/// A profiled location: a node or an expression at file:line
+pub const Site = struct {
+    file: []const u8,
+    line: usize,
+    kind: []const u8, // Node type name, "eval", "bind" or "hoist"
+    text: []const u8, // Expression text ("" for nodes)
+};
+
+/// Accumulated measurements for a site
+pub const Stats = struct {
+    calls: u64 = 0,
+    total_ns: u64 = 0,
+    self_ns: u64 = 0,
+};
+
+const SiteContext = struct {
+    pub fn hash(_: SiteContext, site: Site) u64 {
+        var hasher = std.hash.Wyhash.init(site.line);
+        hasher.update(site.file);
+        hasher.update(&[_]u8{0});
+        hasher.update(site.kind);
+        hasher.update(&[_]u8{0});
+        hasher.update(site.text);
+        return hasher.final();
+    }
+
+    pub fn eql(_: SiteContext, a: Site, b: Site) bool {
+        return a.line == b.line and
+            std.mem.eql(u8, a.file, b.file) and
+            std.mem.eql(u8, a.kind, b.kind) and
+            std.mem.eql(u8, a.text, b.text);
+    }
+};
+
+const SiteMap = std.HashMapUnmanaged(Site, Stats, SiteContext, std.hash_map.default_max_load_percentage);
+
+/// Measurement in progress (see begin/endNode/endExpression)
+const Open = struct {
+    start: u64,
+    child_ns: u64 = 0, // Time spent in nested measurements
+};
+
+/// Longest expression text shown in the hot list
+const max_text_width = 60;
+
+/// Profiler - Collects per-node and per-expression timings
+///
+/// Not thread-safe: use one profiler per compiler thread.
+pub const Profiler = struct {
+    allocator: std.mem.Allocator,
+    timer: std.time.Timer,
+    sites: SiteMap = .{},
+    strings: std.StringHashMapUnmanaged(void) = .{}, // Interned file names and texts
+    open: std.ArrayList(Open) = .{},
+
+    // Template call path
+    path: std.ArrayList(u8) = .{}, // Current frames joined with ';'
+    frames: std.ArrayList(Frame) = .{},
+    file: []const u8 = "<template>", // File of the nodes being compiled
+    pending_ns: u64 = 0, // Self time not yet added to folded
+    folded: std.StringHashMapUnmanaged(u64) = .{},
+
+    // Where mixins and overriding blocks were defined
+    mixin_files: std.StringHashMapUnmanaged([]const u8) = .{},
+    block_files: std.StringHashMapUnmanaged([]const u8) = .{},
+
+    const Self = @This();
+
+    const Frame = struct {
+        path_len: usize, // Length of path before this frame
+        file: []const u8, // File active before this frame
+    };
+
+    pub fn init(allocator: std.mem.Allocator) !Self {
+        return .{
+            .allocator = allocator,
+            .timer = try std.time.Timer.start(),
+        };
+    }
+
+    pub fn deinit(self: *Self) void {
+        var it = self.strings.keyIterator();
+        while (it.next()) |key| self.allocator.free(key.*);
+        self.strings.deinit(self.allocator);
+        self.sites.deinit(self.allocator);
+        self.open.deinit(self.allocator);
+        self.path.deinit(self.allocator);
+        self.frames.deinit(self.allocator);
+        self.folded.deinit(self.allocator);
+        self.mixin_files.deinit(self.allocator);
+        self.block_files.deinit(self.allocator);
+    }
+
+    // ========================================================================
+    // Measurements
+    // ========================================================================
+
+    /// Start timing a node or expression
+    ///
+    /// Must be paired with endNode or endExpression (usually via defer).
+    pub fn begin(self: *Self) !void {
+        try self.open.append(self.allocator, .{ .start = self.timer.read() });
+    }
+
+    /// Finish timing an AST node
+    ///
+    /// Parameters:
+    /// - line: Node's source line (AstNode.line)
+    /// - kind: Node type name
+    pub fn endNode(self: *Self, line: usize, kind: []const u8) void {
+        self.end(.{ .file = self.file, .line = line, .kind = kind, .text = "" });
+    }
+
+    /// Finish timing an expression evaluation
+    ///
+    /// Parameters:
+    /// - line: Line of the node that owns the expression
+    /// - kind: "eval" for template expressions, "bind" for variable setup,
+    ///   "hoist" for loop-invariant expressions evaluated ahead of a loop
+    /// - text: Expression (variable or mixin name for "bind") shown in the hot list
+    pub fn endExpression(self: *Self, line: usize, kind: []const u8, text: []const u8) void {
+        self.end(.{ .file = self.file, .line = line, .kind = kind, .text = text });
+    }
+
+    fn end(self: *Self, site: Site) void {
+        const measurement = self.open.pop() orelse return;
+        const total = self.timer.read() - measurement.start;
+        const self_ns = total -| measurement.child_ns;
+
+        if (self.open.items.len > 0) {
+            self.open.items[self.open.items.len - 1].child_ns += total;
+        }
+        self.pending_ns += self_ns;
+
+        // A failed insert only loses this sample
+        const entry = self.sites.getOrPutContext(self.allocator, site, .{}) catch return;
+        if (!entry.found_existing) {
+            entry.key_ptr.text = self.intern(site.text) catch {
+                self.sites.removeByPtr(entry.key_ptr);
+                return;
+            };
+            entry.value_ptr.* = .{};
+        }
+        entry.value_ptr.calls += 1;
+        entry.value_ptr.total_ns += total;
+        entry.value_ptr.self_ns += self_ns;
+    }
+
+    // ========================================================================
+    // Call Path
+    // ========================================================================
+
+    /// Enter an include, extends, mixin or block frame
+    ///
+    /// Parameters:
+    /// - kind: Frame kind
+    /// - name: Template path, mixin name or block name
+    /// - file: File the frame's nodes come from (null keeps the current file)
+    pub fn enterFrame(self: *Self, kind: FrameKind, name: []const u8, file: ?[]const u8) !void {
+        self.flush();
+
+        const next_file = if (file) |f| try self.intern(f) else self.file;
+        const path_len = self.path.items.len;
+        try self.frames.append(self.allocator, .{ .path_len = path_len, .file = self.file });
+        errdefer {
+            self.path.shrinkRetainingCapacity(path_len);
+            _ = self.frames.pop();
+        }
+
+        if (self.path.items.len > 0) try self.path.append(self.allocator, ';');
+        if (kind != .template) {
+            try self.path.appendSlice(self.allocator, @tagName(kind));
+            try self.path.append(self.allocator, ' ');
+        }
+        // ';' separates frames in the folded format
+        for (name) |c| try self.path.append(self.allocator, if (c == ';') '_' else c);
+
+        self.file = next_file;
+    }
+
+    /// Leave the frame entered last
+    pub fn leaveFrame(self: *Self) void {
+        self.flush();
+        const frame = self.frames.pop() orelse return;
+        self.path.shrinkRetainingCapacity(frame.path_len);
+        self.file = frame.file;
+    }
+
+    /// Remember the current file as the definition site of a mixin or block
+    pub fn define(self: *Self, kind: FrameKind, name: []const u8) !void {
+        const files = switch (kind) {
+            .mixin => &self.mixin_files,
+            .block => &self.block_files,
+            else => return,
+        };
+        const entry = try files.getOrPut(self.allocator, name);
+        if (!entry.found_existing) entry.key_ptr.* = try self.intern(name);
+        entry.value_ptr.* = self.file;
+    }
+
+    /// File where a mixin or block was defined, if known
+    pub fn definitionFile(self: *const Self, kind: FrameKind, name: []const u8) ?[]const u8 {
+        return switch (kind) {
+            .mixin => self.mixin_files.get(name),
+            .block => self.block_files.get(name),
+            else => null,
+        };
+    }
+
+    /// Add the self time collected so far to the current path
+    fn flush(self: *Self) void {
+        if (self.pending_ns == 0) return;
+        const entry = self.folded.getOrPut(self.allocator, self.path.items) catch return;
+        if (!entry.found_existing) {
+            entry.key_ptr.* = self.intern(self.path.items) catch {
+                self.folded.removeByPtr(entry.key_ptr);
+                return;
+            };
+            entry.value_ptr.* = 0;
+        }
+        entry.value_ptr.* += self.pending_ns;
+        self.pending_ns = 0;
+    }
+
+    fn intern(self: *Self, str: []const u8) ![]const u8 {
+        const entry = try self.strings.getOrPut(self.allocator, str);
+        if (!entry.found_existing) {
+            entry.key_ptr.* = self.allocator.dupe(u8, str) catch |err| {
+                self.strings.removeByPtr(entry.key_ptr);
+                return err;
+            };
+        }
+        return entry.key_ptr.*;
+    }
+
+    // ========================================================================
+    // Reports
+    // ========================================================================
+
+    /// Sites sorted by self time, highest first (caller owns the slice)
+    pub fn sortedSites(self: *const Self, allocator: std.mem.Allocator) ![]SiteStats {
+        const list = try allocator.alloc(SiteStats, self.sites.count());
+        var it = self.sites.iterator();
+        var i: usize = 0;
+        while (it.next()) |entry| : (i += 1) {
+            list[i] = .{ .site = entry.key_ptr.*, .stats = entry.value_ptr.* };
+        }
+        std.mem.sort(SiteStats, list, {}, SiteStats.hotter);
+        return list;
+    }
+
+    /// Write the `limit` sites with the highest self time as a table
+    pub fn writeHotList(self: *Self, w: anytype, limit: usize) !void {
+        self.flush();
+
+        const list = try self.sortedSites(self.allocator);
+        defer self.allocator.free(list);
+
+        var total_ns: u64 = 0;
+        var nodes: u64 = 0;
+        var expressions: u64 = 0;
+        for (list) |item| {
+            total_ns += item.stats.self_ns;
+            if (item.site.text.len == 0) nodes += item.stats.calls else expressions += item.stats.calls;
+        }
+
+        try w.print("Profile: {d:.3} ms, {d} nodes, {d} expressions\n", .{ ms(total_ns), nodes, expressions });
+        try w.print("{s:>10} {s:>6} {s:>10} {s:>9}  {s}\n", .{ "self ms", "self%", "total ms", "calls", "site" });
+
+        for (list[0..@min(limit, list.len)]) |item| {
+            const share = if (total_ns == 0) 0 else 100 * @as(f64, @floatFromInt(item.stats.self_ns)) / @as(f64, @floatFromInt(total_ns));
+            try w.print("{d:>10.3} {d:>5.1}% {d:>10.3} {d:>9}  {s}:{d} {s}", .{
+                ms(item.stats.self_ns),
+                share,
+                ms(item.stats.total_ns),
+                item.stats.calls,
+                item.site.file,
+                item.site.line,
+                item.site.kind,
+            });
+            if (item.site.text.len > 0) {
+                try w.writeByte(' ');
+                const shown = item.site.text[0..@min(item.site.text.len, max_text_width)];
+                for (shown) |c| try w.writeByte(if (c == '\n' or c == '\r' or c == '\t') ' ' else c);
+                if (item.site.text.len > max_text_width) try w.writeAll("...");
+            }
+            try w.writeByte('\n');
+        }
+    }
+
+    /// Write folded stacks (`frame;frame;frame <self ns>`), sorted by path
+    pub fn writeFolded(self: *Self, w: anytype) !void {
+        self.flush();
+
+        const paths = try self.allocator.alloc([]const u8, self.folded.count());
+        defer self.allocator.free(paths);
+
+        var it = self.folded.keyIterator();
+        var i: usize = 0;
+        while (it.next()) |key| : (i += 1) paths[i] = key.*;
+        std.mem.sort([]const u8, paths, {}, struct {
+            fn lessThan(_: void, a: []const u8, b: []const u8) bool {
+                return std.mem.lessThan(u8, a, b);
+            }
+        }.lessThan);
+
+        for (paths) |path| {
+            try w.print("{s} {d}\n", .{ if (path.len == 0) "<root>" else path, self.folded.get(path).? });
+        }
+    }
+};
+
+/// A site with its measurements (see Profiler.sortedSites)
+pub const SiteStats = struct {
+    site: Site,
+    stats: Stats,
+
+    fn hotter(_: void, a: SiteStats, b: SiteStats) bool {
+        return a.stats.self_ns > b.stats.self_ns;
+    }
+};
+
+fn ms(ns: u64) f64 {
+    return @as(f64, @floatFromInt(ns)) / std.time.ns_per_ms;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+test "profiler - self time and folded stacks" {
+    var prof = try Profiler.init(std.testing.allocator);
+    defer prof.deinit();
+
+    try prof.enterFrame(.template, "page.pug", "page.pug");
+    try prof.begin(); // Document
+    {
+        try prof.begin(); // Expression inside the document
+        prof.endExpression(3, "eval", "user.name");
+
+        try prof.enterFrame(.mixin, "card", null);
+        try prof.begin();
+        prof.endNode(7, "Tag");
+        prof.leaveFrame();
+    }
+    prof.endNode(1, "Document");
+    prof.leaveFrame();
+
+    try std.testing.expectEqual(@as(usize, 3), prof.sites.count());
+
+    const doc = prof.sites.getContext(.{ .file = "page.pug", .line = 1, .kind = "Document", .text = "" }, .{}).?;
+    try std.testing.expectEqual(@as(u64, 1), doc.calls);
+    try std.testing.expect(doc.self_ns <= doc.total_ns);
+
+    var out = std.ArrayList(u8){};
+    defer out.deinit(std.testing.allocator);
+    try prof.writeFolded(out.writer(std.testing.allocator));
+    try std.testing.expect(std.mem.indexOf(u8, out.items, "page.pug;mixin card ") != null);
+
+    out.clearRetainingCapacity();
+    try prof.writeHotList(out.writer(std.testing.allocator), 10);
+    try std.testing.expect(std.mem.indexOf(u8, out.items, "page.pug:3 eval user.name") != null);
+}
@@ -43,8 +43,12 @@ pub const RuntimeError = error{
     TypeConversionFailed,  // Could not convert type
     CompileError,          // JavaScript syntax error
     RuntimeError,          // JavaScript runtime error (null access, etc.)
+    StackOverflow,         // Call frames nested too deeply
 };
 
+/// Result of an expression: its text, and whether it is a string or number
+pub const EvalResult = mujs.EvalResult;
+
 /// JavaScript value wrapper for compatibility with template variables
 ///
 /// Represents a JavaScript value as a string. With mujs, values are managed
@@ -185,10 +189,29 @@ pub const JsRuntime = struct {
     /// // result = "20"
     /// ```
     pub fn init(allocator: std.mem.Allocator) !*Self {
+        return initWithHeap(allocator, null);
+    }
+
+    /// Initialize a runtime with a separate allocator for the mujs heap
+    ///
+    /// Parameters:
+    /// - allocator: Memory allocator for the runtime and eval results
+    /// - heap: Allocator for JavaScript objects and strings (null = libc)
+    ///
+    /// Example:
+    /// ```zig
+    /// var stats = AllocStats.init(allocator);
+    /// const runtime = try JsRuntime.initWithHeap(
+    ///     stats.allocator(.compile),
+    ///     stats.allocator(.js_heap),
+    /// );
+    /// defer runtime.deinit();
+    /// ```
+    pub fn initWithHeap(allocator: std.mem.Allocator, heap: ?std.mem.Allocator) !*Self {
         const runtime = try allocator.create(Self);
         errdefer allocator.destroy(runtime);
 
-        const mujs_runtime = try mujs.JsRuntime.init(allocator);
+        const mujs_runtime = try mujs.JsRuntime.initWithHeap(allocator, heap);
         errdefer mujs_runtime.deinit();
 
         runtime.* = .{
@@ -246,7 +269,51 @@ pub const JsRuntime = struct {
     /// // concat = "Hello alice"
     /// ```
     pub fn eval(self: *Self, expr: []const u8) ![]const u8 {
-        return self.mujs_runtime.eval(expr) catch |err| {
+        return self.evalAlloc(self.allocator, expr);
+    }
+
+    /// Evaluate a JavaScript expression, allocating the result from `allocator`
+    ///
+    /// Same as eval(), for callers that keep results in an arena.
+    ///
+    /// Parameters:
+    /// - allocator: Allocator for the expression copy and the result
+    /// - expr: JavaScript expression or statement
+    ///
+    /// Returns: String representation of the result (owned by allocator)
+    pub fn evalAlloc(self: *Self, allocator: std.mem.Allocator, expr: []const u8) ![]const u8 {
+        return self.mujs_runtime.evalAlloc(allocator, expr) catch |err| {
+            return switch (err) {
+                error.CompileError => RuntimeError.EvalFailed,
+                error.RuntimeError => RuntimeError.EvalFailed,
+                error.OutOfMemory => RuntimeError.OutOfMemory,
+            };
+        };
+    }
+
+    /// Evaluate a template expression, reusing its compiled script
+    ///
+    /// Same as evalAlloc(), but the expression is parsed and compiled only
+    /// the first time; later calls with the same text run the kept script.
+    /// Use it for expressions taken from the template, not for statements
+    /// generated per call.
+    pub fn evalCachedAlloc(self: *Self, allocator: std.mem.Allocator, expr: []const u8) ![]const u8 {
+        return self.mujs_runtime.evalCachedAlloc(allocator, expr) catch |err| {
+            return switch (err) {
+                error.CompileError => RuntimeError.EvalFailed,
+                error.RuntimeError => RuntimeError.EvalFailed,
+                error.OutOfMemory => RuntimeError.OutOfMemory,
+            };
+        };
+    }
+
+    /// Evaluate a template expression, keeping the result's type
+    ///
+    /// Same as evalCachedAlloc(), but the result also tells strings and
+    /// numbers apart (and carries the number), for comparisons that must
+    /// not match 1 with "1".
+    pub fn evalResultAlloc(self: *Self, allocator: std.mem.Allocator, expr: []const u8) !EvalResult {
+        return self.mujs_runtime.evalResultAlloc(allocator, expr) catch |err| {
             return switch (err) {
                 error.CompileError => RuntimeError.EvalFailed,
                 error.RuntimeError => RuntimeError.EvalFailed,
@@ -255,6 +322,65 @@ pub const JsRuntime = struct {
         };
     }
 
+    /// Parameter bindings of one call, restored by popFrame()
+    pub const Frame = mujs.JsRuntime.Frame;
+
+    /// Bind call arguments to parameter names for the duration of a call
+    ///
+    /// Each argument expression is evaluated once and its value (not its
+    /// string form) is bound to the parameter. The rest parameter gets an
+    /// array of the remaining arguments. popFrame() restores whatever the
+    /// names held before, so parameters never leak into the global scope.
+    ///
+    /// Parameters:
+    /// - allocator: Allocator for the frame (an arena)
+    /// - params: Parameter names
+    /// - rest: Rest parameter name, if any
+    /// - args: Argument expressions
+    ///
+    /// Returns: The frame to pass to popFrame()
+    ///
+    /// Errors:
+    /// - StackOverflow: Too many frames are active at once
+    /// - OutOfMemory: Failed to allocate the frame
+    ///
+    /// Example:
+    /// ```zig
+    /// const frame = try runtime.pushFrame(arena, &.{"title"}, "items", &.{ "'A'", "1", "2" });
+    /// defer runtime.popFrame(frame);
+    /// // title = "A", items = [1, 2]
+    /// ```
+    pub fn pushFrame(
+        self: *Self,
+        allocator: std.mem.Allocator,
+        params: []const []const u8,
+        rest: ?[]const u8,
+        args: []const []const u8,
+    ) RuntimeError!Frame {
+        return self.mujs_runtime.pushFrame(allocator, params, rest, args) catch |err| {
+            return switch (err) {
+                error.StackOverflow => RuntimeError.StackOverflow,
+                error.OutOfMemory => RuntimeError.OutOfMemory,
+            };
+        };
+    }
+
+    /// Text identifying the argument values bound by a frame
+    ///
+    /// Frames with the same key hold equal arguments: same types and
+    /// values, with plain objects and arrays compared by content.
+    ///
+    /// Returns: The key (owned by allocator), or null when an argument is
+    /// not plain data (a function or a date, for example)
+    pub fn frameKey(self: *Self, allocator: std.mem.Allocator, frame: Frame) RuntimeError!?[]const u8 {
+        return self.mujs_runtime.frameKey(allocator, frame);
+    }
+
+    /// Restore the names bound by pushFrame()
+    pub fn popFrame(self: *Self, frame: Frame) void {
+        self.mujs_runtime.popFrame(frame);
+    }
+
     /// Set a context variable from a JsValue
     ///
     /// Convenience method for setting variables from JsValue wrappers.
@@ -447,6 +573,92 @@ pub const JsRuntime = struct {
         try self.mujs_runtime.setObjectFromJson(key, obj);
     }
 
+    /// Set a variable from JSON text
+    ///
+    /// Accepts any JSON value, including nested arrays and objects, and
+    /// parses it inside the interpreter.
+    ///
+    /// Parameters:
+    /// - self: The runtime instance
+    /// - key: Variable name
+    /// - json: JSON text
+    ///
+    /// Errors:
+    /// - EvalFailed: Invalid JSON
+    /// - OutOfMemory: Failed to allocate key copy
+    ///
+    /// Example:
+    /// ```zig
+    /// try runtime.setJson("user", "{\"name\":\"Alice\",\"roles\":[\"admin\"]}");
+    ///
+    /// const result = try runtime.eval("user.roles[0]");
+    /// defer allocator.free(result);
+    /// // result = "admin"
+    /// ```
+    pub fn setJson(self: *Self, key: []const u8, json: []const u8) !void {
+        self.mujs_runtime.setJson(key, json) catch |err| {
+            return switch (err) {
+                error.RuntimeError => RuntimeError.EvalFailed,
+                error.OutOfMemory => RuntimeError.OutOfMemory,
+            };
+        };
+    }
+
+    /// Set every property of a JSON object as a variable, in one pass
+    ///
+    /// Values are built directly from the JSON tokens (nested arrays and
+    /// objects included), without an intermediate std.json.Value tree or
+    /// generated JavaScript, so large data files load in a single scan.
+    ///
+    /// Parameters:
+    /// - self: The runtime instance
+    /// - json: JSON text whose root is an object
+    ///
+    /// Errors:
+    /// - InvalidExpression: Malformed JSON, non-object root or nesting too deep
+    /// - OutOfMemory: Failed to allocate scanner state
+    ///
+    /// Example:
+    /// ```zig
+    /// try runtime.setVariablesFromJson("{\"title\":\"Report\",\"rows\":[1,2,3]}");
+    ///
+    /// const result = try runtime.eval("rows.length");
+    /// defer allocator.free(result);
+    /// // result = "3"
+    /// ```
+    pub fn setVariablesFromJson(self: *Self, json: []const u8) !void {
+        self.mujs_runtime.setGlobalsFromJson(json) catch |err| {
+            return switch (err) {
+                error.OutOfMemory => RuntimeError.OutOfMemory,
+                else => RuntimeError.InvalidExpression,
+            };
+        };
+    }
+
+    /// Remove all variables set on the runtime
+    ///
+    /// Deletes every variable set through setString/setNumber/setJson/...
+    /// and clears every variable declared by template code (`- var x`, loop
+    /// variables), so one warm runtime can render unrelated requests (e.g.
+    /// `zpug --serve`) without paying JsRuntime.init each time. Builtins are
+    /// kept, and restored if a template replaced them.
+    ///
+    /// Parameters:
+    /// - self: The runtime instance
+    ///
+    /// Example:
+    /// ```zig
+    /// try runtime.setString("user", "alice");
+    /// runtime.reset();
+    ///
+    /// const result = try runtime.eval("typeof user");
+    /// defer allocator.free(result);
+    /// // result = "undefined"
+    /// ```
+    pub fn reset(self: *Self) void {
+        self.mujs_runtime.reset();
+    }
+
     /// Run garbage collection
     ///
     /// Triggers mujs garbage collector to free unused JavaScript objects.
@@ -675,3 +887,22 @@ test "runtime - complex expressions" {
     defer allocator.free(result);
     try std.testing.expectEqualStrings("John Doe", result);
 }
+
+test "runtime - call frames bind values and restore globals" {
+    const allocator = std.testing.allocator;
+    var arena = std.heap.ArenaAllocator.init(allocator);
+    defer arena.deinit();
+
+    const runtime = try JsRuntime.init(allocator);
+    defer runtime.deinit();
+
+    try runtime.setString("title", "outer");
+
+    const frame = try runtime.pushFrame(arena.allocator(), &.{ "title", "user" }, "items", &.{ "title + '!'", "({name: 'Ana'})", "1", "2" });
+    const inside = try runtime.evalCachedAlloc(arena.allocator(), "title + user.name + items.length");
+    try std.testing.expectEqualStrings("outer!Ana2", inside);
+    runtime.popFrame(frame);
+
+    const after = try runtime.evalCachedAlloc(arena.allocator(), "title + typeof user + typeof items");
+    try std.testing.expectEqualStrings("outerundefinedundefined", after);
+}
@@ -0,0 +1,336 @@
+//! Serve module - Request protocol for `zpug --serve`
+//!
+//! A long-lived zpug process reads render requests as JSON lines and answers
+//! each one with a single JSON line, so build tools can pipeline thousands
+//! of renders without paying process startup and runtime initialization.
+//!
+//! Transports:
+//! - stdio: requests on stdin, responses on stdout (logs go to stderr)
+//! - Unix domain socket: `--socket <path>`, connections served one at a time
+//!
+//! Request (one per line):
+//! ```json
+//! {"id": 1, "template": "views/page.zpug", "data": {"title": "Home"}, "output": "dist/page.html"}
+//! ```
+//! - id: Optional, echoed back (string or number)
+//! - template: Template file path (parsed once, then cached)
+//! - source: Inline template source (alternative to template)
+//! - data: Optional object of variables for this render only
+//! - output: Optional output file; without it the HTML is returned inline
+//!
+//! Responses:
+//! ```json
+//! {"id":1,"ok":true,"output":"dist/page.html","bytes":1234}
+//! {"id":2,"ok":true,"html":"<p>Hello</p>"}
+//! {"id":3,"ok":false,"error":"template not found: views/missing.zpug"}
+//! ```
+//!
+//! This module only implements the protocol; rendering is done by the
+//! Handler supplied by the CLI.
+
+const std = @import("std");
+
+/// Longest accepted request line
+const max_line_size = 64 * 1024 * 1024;
+
+/// A decoded render request (slices valid until the handler returns)
+pub const Request = struct {
+    id: ?std.json.Value = null,
+    template: ?[]const u8 = null,
+    source: ?[]const u8 = null,
+    data: ?std.json.ObjectMap = null,
+    output: ?[]const u8 = null,
+};
+
+/// Result of handling a request
+pub const Response = union(enum) {
+    html: []const u8, // Rendered HTML returned inline
+    written: usize, // Bytes written to the request's output file
+    failure: []const u8, // Error message
+};
+
+/// Render callback supplied by the caller
+///
+/// The arena is reset after each response, so everything the handler
+/// returns may be allocated from it.
+pub const Handler = struct {
+    context: *anyopaque,
+    handleFn: *const fn (*anyopaque, std.mem.Allocator, *const Request) Response,
+
+    fn handle(self: Handler, arena: std.mem.Allocator, request: *const Request) Response {
+        return self.handleFn(self.context, arena, request);
+    }
+};
+
+/// Serve requests from stdin until it is closed
+pub fn serveStdio(allocator: std.mem.Allocator, handler: Handler) !void {
+    try serveStream(allocator, std.fs.File.stdin(), std.fs.File.stdout(), handler);
+}
+
+/// Listen on a Unix domain socket and serve connections one at a time
+///
+/// An existing file at `path` is removed first. Runs until killed.
+pub fn serveSocket(allocator: std.mem.Allocator, path: []const u8, handler: Handler) !void {
+    std.fs.cwd().deleteFile(path) catch {};
+
+    const address = try std.net.Address.initUnix(path);
+    var server = try address.listen(.{});
+    defer server.deinit();
+
+    while (true) {
+        const connection = try server.accept();
+        defer connection.stream.close();
+
+        const file = std.fs.File{ .handle = connection.stream.handle };
+        serveStream(allocator, file, file, handler) catch |err| {
+            std.debug.print("zpug serve: connection closed: {}\n", .{err});
+        };
+    }
+}
+
+/// Answer each request line read from `input` with a line on `output`
+fn serveStream(allocator: std.mem.Allocator, input: std.fs.File, output: std.fs.File, handler: Handler) !void {
+    var reader = LineReader{ .allocator = allocator, .file = input };
+    defer reader.deinit();
+
+    var arena = std.heap.ArenaAllocator.init(allocator);
+    defer arena.deinit();
+
+    var response = std.ArrayList(u8){};
+    defer response.deinit(allocator);
+
+    while (try reader.next()) |line| {
+        if (std.mem.trim(u8, line, " \t\r").len == 0) continue;
+
+        defer _ = arena.reset(.retain_capacity);
+        response.clearRetainingCapacity();
+
+        try handleLine(arena.allocator(), line, handler, &response, allocator);
+        try response.append(allocator, '\n');
+        try output.writeAll(response.items);
+    }
+}
+
+fn handleLine(
+    arena: std.mem.Allocator,
+    line: []const u8,
+    handler: Handler,
+    response: *std.ArrayList(u8),
+    allocator: std.mem.Allocator,
+) !void {
+    const w = response.writer(allocator);
+
+    const parsed = std.json.parseFromSliceLeaky(std.json.Value, arena, line, .{}) catch {
+        try w.writeAll("{\"id\":null,\"ok\":false,\"error\":\"invalid JSON request\"}");
+        return;
+    };
+
+    var request = Request{};
+    const fields = switch (parsed) {
+        .object => |obj| obj,
+        else => {
+            try w.writeAll("{\"id\":null,\"ok\":false,\"error\":\"request must be a JSON object\"}");
+            return;
+        },
+    };
+
+    request.id = fields.get("id");
+    request.template = stringField(fields, "template");
+    request.source = stringField(fields, "source");
+    request.output = stringField(fields, "output");
+    if (fields.get("data")) |data| {
+        if (data == .object) request.data = data.object;
+    }
+
+    try w.writeAll("{\"id\":");
+    if (request.id) |id| {
+        try writeJsonValue(w, id);
+    } else {
+        try w.writeAll("null");
+    }
+
+    if (request.template == null and request.source == null) {
+        try w.writeAll(",\"ok\":false,\"error\":\"missing template or source\"}");
+        return;
+    }
+
+    switch (handler.handle(arena, &request)) {
+        .html => |html| {
+            try w.writeAll(",\"ok\":true,\"html\":");
+            try writeJsonString(w, html);
+        },
+        .written => |bytes| {
+            try w.writeAll(",\"ok\":true,\"output\":");
+            try writeJsonString(w, request.output orelse "");
+            try w.print(",\"bytes\":{d}", .{bytes});
+        },
+        .failure => |message| {
+            try w.writeAll(",\"ok\":false,\"error\":");
+            try writeJsonString(w, message);
+        },
+    }
+    try w.writeByte('}');
+}
+
+fn stringField(fields: std.json.ObjectMap, name: []const u8) ?[]const u8 {
+    const value = fields.get(name) orelse return null;
+    return switch (value) {
+        .string => |str| str,
+        else => null,
+    };
+}
+
+// ============================================================================
+// JSON output helpers
+// ============================================================================
+
+/// Write a string as a JSON string literal
+pub fn writeJsonString(w: anytype, str: []const u8) !void {
+    try w.writeByte('"');
+    var start: usize = 0;
+    for (str, 0..) |c, i| {
+        const escape: ?[]const u8 = switch (c) {
+            '"' => "\\\"",
+            '\\' => "\\\\",
+            '\n' => "\\n",
+            '\r' => "\\r",
+            '\t' => "\\t",
+            else => null,
+        };
+        if (escape == null and c >= 0x20) continue;
+
+        try w.writeAll(str[start..i]);
+        if (escape) |e| {
+            try w.writeAll(e);
+        } else {
+            try w.print("\\u{x:0>4}", .{c});
+        }
+        start = i + 1;
+    }
+    try w.writeAll(str[start..]);
+    try w.writeByte('"');
+}
+
+/// Write a parsed JSON value back as JSON text
+pub fn writeJsonValue(w: anytype, value: std.json.Value) !void {
+    switch (value) {
+        .null => try w.writeAll("null"),
+        .bool => |b| try w.writeAll(if (b) "true" else "false"),
+        .integer => |n| try w.print("{d}", .{n}),
+        .float => |n| try w.print("{d}", .{n}),
+        .number_string => |n| try w.writeAll(n),
+        .string => |str| try writeJsonString(w, str),
+        .array => |arr| {
+            try w.writeByte('[');
+            for (arr.items, 0..) |item, i| {
+                if (i > 0) try w.writeByte(',');
+                try writeJsonValue(w, item);
+            }
+            try w.writeByte(']');
+        },
+        .object => |obj| {
+            try w.writeByte('{');
+            var it = obj.iterator();
+            var first = true;
+            while (it.next()) |entry| {
+                if (!first) try w.writeByte(',');
+                first = false;
+                try writeJsonString(w, entry.key_ptr.*);
+                try w.writeByte(':');
+                try writeJsonValue(w, entry.value_ptr.*);
+            }
+            try w.writeByte('}');
+        },
+    }
+}
+
+// ============================================================================
+// Line Reader
+// ============================================================================
+
+/// Buffered reader returning one line at a time (without the newline)
+pub const LineReader = struct {
+    allocator: std.mem.Allocator,
+    file: std.fs.File,
+    buffer: std.ArrayList(u8) = .{},
+    start: usize = 0, // Start of the unconsumed data in buffer
+    eof: bool = false,
+
+    pub fn deinit(self: *LineReader) void {
+        self.buffer.deinit(self.allocator);
+    }
+
+    /// Next line, or null at end of input. Valid until the next call.
+    pub fn next(self: *LineReader) !?[]const u8 {
+        var scan_from = self.start;
+        while (true) {
+            if (std.mem.indexOfScalarPos(u8, self.buffer.items, scan_from, '\n')) |end| {
+                const line = self.buffer.items[self.start..end];
+                self.start = end + 1;
+                return line;
+            }
+
+            if (self.eof) {
+                if (self.start >= self.buffer.items.len) return null;
+                const line = self.buffer.items[self.start..];
+                self.start = self.buffer.items.len;
+                return line;
+            }
+
+            // Drop consumed lines before reading more
+            if (self.start > 0) {
+                const remaining = self.buffer.items.len - self.start;
+                std.mem.copyForwards(u8, self.buffer.items[0..remaining], self.buffer.items[self.start..]);
+                self.buffer.shrinkRetainingCapacity(remaining);
+                self.start = 0;
+            }
+            scan_from = self.buffer.items.len;
+
+            if (self.buffer.items.len >= max_line_size) return error.LineTooLong;
+            try self.buffer.ensureUnusedCapacity(self.allocator, 64 * 1024);
+            const n = try self.file.read(self.buffer.unusedCapacitySlice());
+            if (n == 0) {
+                self.eof = true;
+            } else {
+                self.buffer.items.len += n;
+            }
+        }
+    }
+};
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+test "serve - JSON string escaping" {
+    var out = std.ArrayList(u8){};
+    defer out.deinit(std.testing.allocator);
+
+    try writeJsonString(out.writer(std.testing.allocator), "<p class=\"a\">\n\x01</p>");
+    try std.testing.expectEqualStrings("\"<p class=\\\"a\\\">\\n\\u0001</p>\"", out.items);
+}
+
+test "serve - request round trip" {
+    const Echo = struct {
+        fn handle(_: *anyopaque, arena: std.mem.Allocator, request: *const Request) Response {
+            const title = if (request.data) |data| data.get("title").?.string else "";
+            const html = std.fmt.allocPrint(arena, "<h1>{s}</h1>", .{title}) catch return .{ .failure = "oom" };
+            return .{ .html = html };
+        }
+    };
+    var dummy: u8 = 0;
+    const handler = Handler{ .context = &dummy, .handleFn = Echo.handle };
+
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+
+    var out = std.ArrayList(u8){};
+    defer out.deinit(std.testing.allocator);
+
+    try handleLine(arena.allocator(), "{\"id\":7,\"source\":\"h1= title\",\"data\":{\"title\":\"Hi\"}}", handler, &out, std.testing.allocator);
+    try std.testing.expectEqualStrings("{\"id\":7,\"ok\":true,\"html\":\"<h1>Hi</h1>\"}", out.items);
+
+    out.clearRetainingCapacity();
+    try handleLine(arena.allocator(), "{\"id\":\"x\"}", handler, &out, std.testing.allocator);
+    try std.testing.expectEqualStrings("{\"id\":\"x\",\"ok\":false,\"error\":\"missing template or source\"}", out.items);
+}
@@ -35,8 +35,15 @@
 //! - Interpolation: #{expr} and !{expr} parsed as single tokens
 //! - Comments: // for HTML comments, //- for code comments
 //! - Position tracking: Every token has line and column info
+//!
+//! Performance:
+//! - Comments, strings and interpolations are scanned with SIMD vectors
+//!   (@Vector of u8) that look for the next delimiter many bytes at a time
+//! - Line and column are not maintained per byte; they are computed from
+//!   the byte offset when a token is created, counting newlines in bulk
 
 const std = @import("std");
+const diagnostics = @import("diagnostics.zig");
 
 /// Token types representing all possible lexical elements in Pug templates
 ///
@@ -123,6 +130,8 @@ pub const TokenType = enum {
 /// - value: The actual text from the source (empty for symbols like INDENT)
 /// - line: 1-indexed line number where token starts
 /// - column: 1-indexed column number where token starts
+/// - start/end: Byte range of the whole token in the source, delimiters
+///   included (e.g. both quotes of a string); 0 for INDENT/DEDENT
 ///
 /// Example:
 /// ```zig
@@ -134,6 +143,8 @@ pub const Token = struct {
     value: []const u8,
     line: usize,
     column: usize,
+    start: usize = 0,
+    end: usize = 0,
 
     /// Create a new token
     ///
@@ -175,15 +186,16 @@ pub const TokenizerError = error{
 
 /// Tokenizer - Converts source code into a stream of tokens
 ///
-/// State machine that scans Pug template source character by character,
-/// recognizing lexical patterns and emitting tokens. Handles indentation-
-/// based syntax similar to Python.
+/// State machine that scans Pug template source, recognizing lexical
+/// patterns and emitting tokens. Handles indentation-based syntax similar
+/// to Python.
 ///
 /// Fields:
 /// - source: The complete source code being tokenized
 /// - pos: Current position in source (byte offset)
-/// - line: Current line number (1-indexed)
-/// - column: Current column number (1-indexed)
+/// - line: Line number (1-indexed) at byte offset line_pos
+/// - line_start: Byte offset where that line begins
+/// - line_pos: Offset up to which newlines have been counted (see locate())
 /// - allocator: Memory allocator for dynamic data
 /// - indent_stack: Stack tracking nested indentation levels
 /// - pending_tokens: Queue for INDENT/DEDENT tokens
@@ -211,7 +223,8 @@ pub const Tokenizer = struct {
     source: []const u8,
     pos: usize,
     line: usize,
-    column: usize,
+    line_start: usize,
+    line_pos: usize,
     allocator: std.mem.Allocator,
     indent_stack: std.ArrayListUnmanaged(usize),
     pending_tokens: std.ArrayListUnmanaged(Token),
@@ -239,7 +252,8 @@ pub const Tokenizer = struct {
             .source = source,
             .pos = 0,
             .line = 1,
-            .column = 1,
+            .line_start = 0,
+            .line_pos = 0,
             .allocator = allocator,
             .indent_stack = .{},
             .pending_tokens = .{},
@@ -290,37 +304,61 @@ pub const Tokenizer = struct {
 
     /// Advance position and return current character
     ///
-    /// Updates line and column counters. Newlines increment line
-    /// and reset column to 1.
+    /// Line and column are not updated here; see locate().
     ///
     /// Returns: Current character before advancing, or null if at end
     fn advance(self: *Tokenizer) ?u8 {
         if (self.pos >= self.source.len) return null;
         const ch = self.source[self.pos];
         self.pos += 1;
-        if (ch == '\n') {
-            self.line += 1;
-            self.column = 1;
-        } else {
-            self.column += 1;
-        }
         return ch;
     }
 
+    /// Line and column of a byte offset
+    ///
+    /// Newlines are counted in bulk from the last located offset, so
+    /// tokenizing stays linear as long as offsets only move forward (which
+    /// they do: tokens are located at their start, in order).
+    ///
+    /// Parameters:
+    /// - offset: Byte offset in source, not before the last located offset
+    ///
+    /// Returns: 1-indexed line and column
+    fn locate(self: *Tokenizer, offset: usize) Location {
+        std.debug.assert(offset >= self.line_pos);
+
+        const skipped = self.source[self.line_pos..offset];
+        const newlines = countScalar(skipped, '\n');
+        if (newlines > 0) {
+            self.line += newlines;
+            self.line_start = self.line_pos + std.mem.lastIndexOfScalar(u8, skipped, '\n').? + 1;
+        }
+        self.line_pos = offset;
+
+        return .{ .line = self.line, .column = offset - self.line_start + 1 };
+    }
+
     /// Skip horizontal whitespace (spaces, tabs) but not newlines
     ///
     /// Newlines are significant in Pug syntax, so they must be
     /// preserved as tokens. This skips only spaces and tabs.
     fn skipWhitespaceExceptNewline(self: *Tokenizer) void {
-        while (self.peekChar()) |ch| {
-            if (ch == ' ' or ch == '\t' or ch == '\r') {
-                _ = self.advance();
-            } else {
-                break;
+        while (self.pos < self.source.len) : (self.pos += 1) {
+            switch (self.source[self.pos]) {
+                ' ', '\t', '\r' => {},
+                else => break,
             }
         }
     }
 
+    /// Skip identifier characters (alphanumeric, _ and -)
+    fn skipIdentifierChars(self: *Tokenizer) void {
+        while (self.pos < self.source.len) : (self.pos += 1) {
+            const ch = self.source[self.pos];
+            if (!std.ascii.isAlphanumeric(ch) and ch != '_' and ch != '-') break;
+        }
+    }
+
     /// Handle indentation at the start of a line
     ///
     /// Tracks indentation levels and generates INDENT/DEDENT tokens
@@ -347,17 +385,17 @@ pub const Tokenizer = struct {
     fn handleIndentation(self: *Tokenizer) !void {
         if (!self.at_line_start) return;
 
-        var indent: usize = 0;
+        const line_begin = self.pos;
         while (self.peekChar()) |ch| {
             if (ch == ' ') {
-                indent += 1;
-                _ = self.advance();
+                self.pos += 1;
             } else if (ch == '\t') {
                 return error.InvalidIndentation; // No permitir tabs
             } else {
                 break;
             }
         }
+        const indent = self.pos - line_begin;
 
         // Skip empty lines
         if (self.peekChar()) |ch| {
@@ -371,13 +409,13 @@ pub const Tokenizer = struct {
 
         if (indent > current_indent) {
             try self.indent_stack.append(self.allocator, indent);
-            try self.pending_tokens.append(self.allocator, Token.init(.Indent, "", self.line, 1));
+            try self.pending_tokens.append(self.allocator, Token.init(.Indent, "", self.locate(self.pos).line, 1));
         } else if (indent < current_indent) {
             while (self.indent_stack.items.len > 0 and
                 self.indent_stack.items[self.indent_stack.items.len - 1] > indent)
             {
                 _ = self.indent_stack.pop();
-                try self.pending_tokens.append(self.allocator, Token.init(.Dedent, "", self.line, 1));
+                try self.pending_tokens.append(self.allocator, Token.init(.Dedent, "", self.locate(self.pos).line, 1));
             }
 
             if (self.indent_stack.items.len == 0 or
@@ -406,8 +444,7 @@ pub const Tokenizer = struct {
     /// //- This is a code comment
     /// ```
     fn scanComment(self: *Tokenizer) !Token {
-        const start_line = self.line;
-        const start_col = self.column;
+        const loc = self.locate(self.pos);
 
         _ = self.advance(); // First /
         _ = self.advance(); // Second /
@@ -423,15 +460,12 @@ pub const Tokenizer = struct {
         }
 
         const start = self.pos;
-        while (self.peekChar()) |ch| {
-            if (ch == '\n') break;
-            _ = self.advance();
-        }
+        self.pos = indexOfAnyPos(self.source, start, "\n");
 
         const value = self.source[start..self.pos];
         const token_type = if (is_unbuffered) TokenType.UnbufferedComment else TokenType.BufferedComment;
 
-        return Token.init(token_type, value, start_line, start_col);
+        return Token.init(token_type, value, loc.line, loc.column);
     }
 
     /// Scan an interpolation token #{...} or !{...}
@@ -455,8 +489,7 @@ pub const Tokenizer = struct {
     /// p Count: #{items.length}     // Expression
     /// ```
     fn scanInterpolation(self: *Tokenizer) !Token {
-        const start_line = self.line;
-        const start_col = self.column;
+        const loc = self.locate(self.pos);
 
         const first_ch = self.advance().?; // # or !
         const is_unescaped = first_ch == '!';
@@ -469,22 +502,24 @@ pub const Tokenizer = struct {
         const start = self.pos;
         var brace_count: usize = 1;
 
-        while (self.peekChar()) |ch| {
-            if (ch == '{') {
+        // Jump from brace to brace
+        while (true) {
+            self.pos = indexOfAnyPos(self.source, self.pos, "{}");
+            if (self.pos >= self.source.len) return error.UnterminatedString;
+
+            if (self.source[self.pos] == '{') {
                 brace_count += 1;
-            } else if (ch == '}') {
+            } else {
                 brace_count -= 1;
                 if (brace_count == 0) {
                     const value = self.source[start..self.pos];
-                    _ = self.advance(); // }
+                    self.pos += 1; // }
                     const token_type = if (is_unescaped) TokenType.UnescapedInterpol else TokenType.EscapedInterpol;
-                    return Token.init(token_type, value, start_line, start_col);
+                    return Token.init(token_type, value, loc.line, loc.column);
                 }
             }
-            _ = self.advance();
+            self.pos += 1;
         }
-
-        return error.UnterminatedString;
     }
 
     /// Scan an identifier or keyword token
@@ -504,22 +539,15 @@ pub const Tokenizer = struct {
     /// ```
     fn scanIdentifier(self: *Tokenizer) !Token {
         const start = self.pos;
-        const start_line = self.line;
-        const start_col = self.column;
+        const loc = self.locate(start);
 
-        while (self.peekChar()) |ch| {
-            if (std.ascii.isAlphanumeric(ch) or ch == '_' or ch == '-') {
-                _ = self.advance();
-            } else {
-                break;
-            }
-        }
+        self.skipIdentifierChars();
 
         const value = self.source[start..self.pos];
 
         // Check for keywords
         const token_type = getKeyword(value) orelse .Ident;
-        return Token.init(token_type, value, start_line, start_col);
+        return Token.init(token_type, value, loc.line, loc.column);
     }
 
     /// Scan a string literal token
@@ -542,26 +570,27 @@ pub const Tokenizer = struct {
     /// "line\nbreak"     → String("line\nbreak") (with escape)
     /// ```
     fn scanString(self: *Tokenizer, quote: u8) !Token {
-        const start_line = self.line;
-        const start_col = self.column;
+        const loc = self.locate(self.pos);
         _ = self.advance(); // Skip opening quote
 
         const start = self.pos;
-        while (self.peekChar()) |ch| {
-            if (ch == quote) {
+        while (true) {
+            // Jump to the next quote or escape
+            self.pos = switch (quote) {
+                '"' => indexOfAnyPos(self.source, self.pos, "\"\\"),
+                else => indexOfAnyPos(self.source, self.pos, "'\\"),
+            };
+            if (self.pos >= self.source.len) return error.UnterminatedString;
+
+            if (self.source[self.pos] == quote) {
                 const value = self.source[start..self.pos];
-                _ = self.advance(); // Skip closing quote
-                return Token.init(.String, value, start_line, start_col);
-            }
-            if (ch == '\\') {
-                _ = self.advance(); // Skip escape
-                _ = self.advance(); // Skip escaped char
-            } else {
-                _ = self.advance();
+                self.pos += 1; // Skip closing quote
+                return Token.init(.String, value, loc.line, loc.column);
             }
-        }
 
-        return error.UnterminatedString;
+            // Skip escape and escaped char
+            self.pos = @min(self.pos + 2, self.source.len);
+        }
     }
 
     /// Scan a number literal token
@@ -578,19 +607,18 @@ pub const Tokenizer = struct {
     /// ```
     fn scanNumber(self: *Tokenizer) !Token {
         const start = self.pos;
-        const start_line = self.line;
-        const start_col = self.column;
+        const loc = self.locate(start);
 
         while (self.peekChar()) |ch| {
             if (std.ascii.isDigit(ch) or ch == '.') {
-                _ = self.advance();
+                self.pos += 1;
             } else {
                 break;
             }
         }
 
         const value = self.source[start..self.pos];
-        return Token.init(.Number, value, start_line, start_col);
+        return Token.init(.Number, value, loc.line, loc.column);
     }
 
     /// Scan a symbol or special shorthand token
@@ -616,8 +644,9 @@ pub const Tokenizer = struct {
     /// .           → Dot (when not followed by identifier)
     /// ```
     fn scanSymbol(self: *Tokenizer) !Token {
-        const start_line = self.line;
-        const start_col = self.column;
+        const loc = self.locate(self.pos);
+        const start_line = loc.line;
+        const start_col = loc.column;
         const ch = self.peekChar().?;
 
         // Handle .class shorthand
@@ -626,13 +655,7 @@ pub const Tokenizer = struct {
             if (self.peekChar()) |next_ch| {
                 if (std.ascii.isAlphabetic(next_ch) or next_ch == '_' or next_ch == '-') {
                     const start = self.pos;
-                    while (self.peekChar()) |c| {
-                        if (std.ascii.isAlphanumeric(c) or c == '_' or c == '-') {
-                            _ = self.advance();
-                        } else {
-                            break;
-                        }
-                    }
+                    self.skipIdentifierChars();
                     const value = self.source[start..self.pos];
                     return Token.init(.Class, value, start_line, start_col);
                 }
@@ -647,13 +670,7 @@ pub const Tokenizer = struct {
             if (self.peekChar()) |next_ch| {
                 if (std.ascii.isAlphabetic(next_ch) or next_ch == '_' or next_ch == '-') {
                     const start = self.pos;
-                    while (self.peekChar()) |c| {
-                        if (std.ascii.isAlphanumeric(c) or c == '_' or c == '-') {
-                            _ = self.advance();
-                        } else {
-                            break;
-                        }
-                    }
+                    self.skipIdentifierChars();
                     const value = self.source[start..self.pos];
                     return Token.init(.Id, value, start_line, start_col);
                 }
@@ -687,7 +704,7 @@ pub const Tokenizer = struct {
             '!' => .Ident, // Treat standalone ! as unexpected (will be handled as text)
             else => {
                 // For any other character, treat as unexpected
-                std.debug.print("Unexpected character at {d}:{d}: '{c}' (0x{x})\n", .{ start_line, start_col, ch, ch });
+                diagnostics.print("Unexpected character at {d}:{d}: '{c}' (0x{x})\n", .{ start_line, start_col, ch, ch });
                 return error.UnexpectedCharacter;
             },
         };
@@ -748,19 +765,31 @@ pub const Tokenizer = struct {
         // Skip whitespace (except newlines which are significant)
         self.skipWhitespaceExceptNewline();
 
+        const start = self.pos;
+        var token = try self.scanToken();
+        token.start = start;
+        token.end = self.pos;
+        return token;
+    }
+
+    /// Scan the token starting at the current position
+    ///
+    /// Called by next() once indentation and whitespace are handled.
+    fn scanToken(self: *Tokenizer) !Token {
         const ch = self.peekChar() orelse {
+            const loc = self.locate(self.pos);
             // Emit remaining DEDENT tokens at EOF
             if (self.indent_stack.items.len > 1) {
                 _ = self.indent_stack.pop();
-                return Token.init(.Dedent, "", self.line, self.column);
+                return Token.init(.Dedent, "", loc.line, loc.column);
             }
-            return Token.init(.Eof, "", self.line, self.column);
+            return Token.init(.Eof, "", loc.line, loc.column);
         };
 
         // Newline
         if (ch == '\n') {
             self.at_line_start = true;
-            const line = self.line;
+            const line = self.locate(self.pos).line;
             _ = self.advance();
             return Token.init(.Newline, "\n", line, 1);
         }
@@ -800,6 +829,65 @@ pub const Tokenizer = struct {
     }
 };
 
+/// Source position of a token (see Tokenizer.locate)
+const Location = struct {
+    line: usize,
+    column: usize,
+};
+
+// ============================================================================
+// Vectorized Scanning
+// ============================================================================
+
+/// Bytes compared per step (16 with SSE/NEON, 32 with AVX2)
+const vector_len = std.simd.suggestVectorLength(u8) orelse 16;
+const Chunk = @Vector(vector_len, u8);
+const ChunkMask = std.meta.Int(.unsigned, vector_len);
+
+/// Bitmask of the bytes in chunk equal to any of needles (bit i = byte i)
+inline fn matchAny(chunk: Chunk, comptime needles: []const u8) ChunkMask {
+    var mask: ChunkMask = 0;
+    inline for (needles) |needle| {
+        const hits: ChunkMask = @bitCast(chunk == @as(Chunk, @splat(needle)));
+        mask |= hits;
+    }
+    return mask;
+}
+
+/// Index of the first byte at or after start that is one of needles
+///
+/// Compares vector_len bytes per step, then finishes the tail byte by byte.
+///
+/// Returns: Index of the match, or haystack.len if there is none
+fn indexOfAnyPos(haystack: []const u8, start: usize, comptime needles: []const u8) usize {
+    var i = start;
+    while (i + vector_len <= haystack.len) : (i += vector_len) {
+        const chunk: Chunk = haystack[i..][0..vector_len].*;
+        const mask = matchAny(chunk, needles);
+        if (mask != 0) return i + @ctz(mask);
+    }
+    while (i < haystack.len) : (i += 1) {
+        inline for (needles) |needle| {
+            if (haystack[i] == needle) return i;
+        }
+    }
+    return haystack.len;
+}
+
+/// Number of bytes in haystack equal to needle
+fn countScalar(haystack: []const u8, comptime needle: u8) usize {
+    var count: usize = 0;
+    var i: usize = 0;
+    while (i + vector_len <= haystack.len) : (i += vector_len) {
+        const chunk: Chunk = haystack[i..][0..vector_len].*;
+        count += @popCount(matchAny(chunk, &.{needle}));
+    }
+    for (haystack[i..]) |ch| {
+        if (ch == needle) count += 1;
+    }
+    return count;
+}
+
 /// Check if identifier is a keyword
 ///
 /// Matches identifiers against known Pug keywords and special values.
@@ -991,3 +1079,67 @@ test "tokenizer - eof" {
     const token = try tokenizer.next();
     try std.testing.expectEqual(TokenType.Eof, token.type);
 }
+
+test "tokenizer - vectorized scanning" {
+    // Delimiters before, inside and after the first full vector
+    const long = "x" ** 40 ++ "\"" ++ "y" ** 7;
+    try std.testing.expectEqual(@as(usize, 40), indexOfAnyPos(long, 0, "\"\\"));
+    try std.testing.expectEqual(@as(usize, 3), indexOfAnyPos("ab\n\"", 0, "\""));
+    try std.testing.expectEqual(@as(usize, long.len), indexOfAnyPos(long, 41, "\""));
+    try std.testing.expectEqual(@as(usize, 3), countScalar("\n" ++ "a" ** 37 ++ "\n\n", '\n'));
+}
+
+test "tokenizer - lazy line and column" {
+    const source = "div\n  p(title=\"a\\\"b\") #{x}\n// " ++ "c" ** 40 ++ "\nspan";
+    var tokenizer = try Tokenizer.init(std.testing.allocator, source);
+    defer tokenizer.deinit();
+
+    _ = try tokenizer.next(); // div
+    _ = try tokenizer.next(); // \n
+    _ = try tokenizer.next(); // INDENT
+
+    const p = try tokenizer.next();
+    try std.testing.expectEqual(@as(usize, 2), p.line);
+    try std.testing.expectEqual(@as(usize, 3), p.column);
+
+    _ = try tokenizer.next(); // (
+    _ = try tokenizer.next(); // title
+    _ = try tokenizer.next(); // =
+    const str = try tokenizer.next();
+    try std.testing.expectEqualStrings("a\\\"b", str.value);
+    try std.testing.expectEqual(@as(usize, 11), str.column);
+    _ = try tokenizer.next(); // )
+
+    const interp = try tokenizer.next();
+    try std.testing.expectEqualStrings("x", interp.value);
+    try std.testing.expectEqual(@as(usize, 19), interp.column);
+
+    _ = try tokenizer.next(); // \n
+    _ = try tokenizer.next(); // DEDENT
+    const comment = try tokenizer.next();
+    try std.testing.expectEqual(@as(usize, 3), comment.line);
+    try std.testing.expectEqual(@as(usize, 40), comment.value.len);
+
+    _ = try tokenizer.next(); // \n
+    const span = try tokenizer.next();
+    try std.testing.expectEqual(@as(usize, 4), span.line);
+    try std.testing.expectEqual(@as(usize, 1), span.column);
+}
+
+test "tokenizer - token source ranges" {
+    const source = "a(title=\"x y\") #{name}";
+    var tokenizer = try Tokenizer.init(std.testing.allocator, source);
+    defer tokenizer.deinit();
+
+    _ = try tokenizer.next(); // a
+    _ = try tokenizer.next(); // (
+    _ = try tokenizer.next(); // title
+    _ = try tokenizer.next(); // =
+
+    const str = try tokenizer.next();
+    try std.testing.expectEqualStrings("\"x y\"", source[str.start..str.end]);
+
+    _ = try tokenizer.next(); // )
+    const interp = try tokenizer.next();
+    try std.testing.expectEqualStrings("#{name}", source[interp.start..interp.end]);
+}
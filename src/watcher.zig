@@ -0,0 +1,328 @@
+//! Watcher module - Incremental rebuilds for `zpug --watch`
+//!
+//! Provides the two pieces the CLI needs to rebuild only what changed:
+//!
+//! - DependencyGraph: for each entry template, the transitive set of files
+//!   it pulls in through `include` and `extends`
+//! - Watcher: Linux inotify wrapper that reports changed file paths
+//!
+//! Flow:
+//! 1. Compile every entry once, scanning its dependencies into the graph
+//! 2. Watch the directory of every entry and dependency
+//! 3. On a change, invalidate the changed files in the AstCache and
+//!    recompile only the entries whose dependency set contains them
+//!
+//! Directories are watched instead of files because most editors save by
+//! writing a new file and renaming it over the old one, which replaces the
+//! inode a per-file watch would be attached to.
+//!
+//! All paths are normalized with std.fs.path.resolve so paths coming from
+//! the command line, from include directives and from inotify compare equal.
+
+const std = @import("std");
+const ast = @import("ast.zig");
+const cache = @import("cache.zig");
+
+const linux = std.os.linux;
+
+/// Time to wait for more events after the first one, so that a burst of
+/// writes (save-all, git checkout) triggers a single rebuild.
+const debounce_ms = 50;
+
+// ============================================================================
+// Dependency Graph
+// ============================================================================
+
+/// Maps entry templates to their transitive include/extends dependencies
+///
+/// Dependencies are found statically by walking the AST, so includes in
+/// branches that were not taken during the last render are tracked too.
+/// Paths are resolved the same way as the compiler does: relative to the
+/// directory of the entry template.
+pub const DependencyGraph = struct {
+    allocator: std.mem.Allocator,
+    entries: std.StringHashMap(std.ArrayListUnmanaged([]const u8)),
+
+    const Self = @This();
+
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return .{
+            .allocator = allocator,
+            .entries = std.StringHashMap(std.ArrayListUnmanaged([]const u8)).init(allocator),
+        };
+    }
+
+    pub fn deinit(self: *Self) void {
+        var it = self.entries.iterator();
+        while (it.next()) |entry| {
+            self.allocator.free(entry.key_ptr.*);
+            freePaths(self.allocator, entry.value_ptr);
+        }
+        self.entries.deinit();
+    }
+
+    /// (Re)compute the dependencies of an entry template
+    ///
+    /// Templates are loaded through the AST cache, so scanning right after
+    /// a compilation does not parse anything again. Missing or broken
+    /// dependencies are still recorded, so fixing them triggers a rebuild.
+    ///
+    /// Parameters:
+    /// - entry_path: Entry template path (normalized internally)
+    /// - ast_cache: Cache used to load the templates
+    pub fn scan(self: *Self, entry_path: []const u8, ast_cache: *cache.AstCache) !void {
+        const key = try std.fs.path.resolve(self.allocator, &.{entry_path});
+        errdefer self.allocator.free(key);
+
+        var deps = std.ArrayListUnmanaged([]const u8){};
+        errdefer freePaths(self.allocator, &deps);
+
+        var collector = Collector{
+            .allocator = self.allocator,
+            .base_dir = std.fs.path.dirname(key) orelse ".",
+            .entry = key,
+            .deps = &deps,
+        };
+
+        // deps doubles as the worklist: every newly found file is scanned once
+        try collector.scanTemplate(key, ast_cache);
+        var i: usize = 0;
+        while (i < deps.items.len) : (i += 1) {
+            try collector.scanTemplate(deps.items[i], ast_cache);
+        }
+
+        if (try self.entries.fetchPut(key, deps)) |old| {
+            self.allocator.free(key);
+            var old_deps = old.value;
+            freePaths(self.allocator, &old_deps);
+        }
+    }
+
+    /// Check whether a changed file affects an entry template
+    ///
+    /// Parameters:
+    /// - entry_path: Normalized entry path (as returned by std.fs.path.resolve)
+    /// - changed_path: Normalized path of the changed file
+    pub fn dependsOn(self: *const Self, entry_path: []const u8, changed_path: []const u8) bool {
+        if (std.mem.eql(u8, entry_path, changed_path)) return true;
+
+        const deps = self.entries.get(entry_path) orelse return false;
+        for (deps.items) |dep| {
+            if (std.mem.eql(u8, dep, changed_path)) return true;
+        }
+        return false;
+    }
+
+    /// Dependencies of an entry template (empty if never scanned)
+    pub fn dependencies(self: *const Self, entry_path: []const u8) []const []const u8 {
+        const deps = self.entries.get(entry_path) orelse return &.{};
+        return deps.items;
+    }
+
+    fn freePaths(allocator: std.mem.Allocator, paths: *std.ArrayListUnmanaged([]const u8)) void {
+        for (paths.items) |path| allocator.free(path);
+        paths.deinit(allocator);
+    }
+};
+
+/// AST walker collecting include/extends paths of one entry template
+const Collector = struct {
+    allocator: std.mem.Allocator,
+    base_dir: []const u8,
+    entry: []const u8,
+    deps: *std.ArrayListUnmanaged([]const u8),
+
+    fn scanTemplate(self: *Collector, path: []const u8, ast_cache: *cache.AstCache) !void {
+        const tmpl = ast_cache.load(path) catch |err| switch (err) {
+            error.OutOfMemory => return err,
+            else => return, // Still tracked; rescanned once it changes
+        };
+
+        var visitor = ast.Visitor{
+            .context = self,
+            .visitFn = visitNode,
+        };
+        try visitor.visit(tmpl.root);
+    }
+
+    fn visitNode(context: *anyopaque, node: *ast.AstNode) anyerror!void {
+        const self: *Collector = @ptrCast(@alignCast(context));
+
+        const rel_path = switch (node.data) {
+            .Include => |include| include.path,
+            .Extends => |extends| extends.path,
+            else => return,
+        };
+
+        const full_path = try std.fs.path.resolve(self.allocator, &.{ self.base_dir, rel_path });
+        if (std.mem.eql(u8, full_path, self.entry) or self.contains(full_path)) {
+            self.allocator.free(full_path);
+            return;
+        }
+        errdefer self.allocator.free(full_path);
+        try self.deps.append(self.allocator, full_path);
+    }
+
+    fn contains(self: *const Collector, path: []const u8) bool {
+        for (self.deps.items) |dep| {
+            if (std.mem.eql(u8, dep, path)) return true;
+        }
+        return false;
+    }
+};
+
+// ============================================================================
+// inotify Watcher (Linux only)
+// ============================================================================
+
+/// Reports changed files using Linux inotify
+///
+/// Usage:
+/// ```zig
+/// var w = try Watcher.init(allocator);
+/// defer w.deinit();
+///
+/// try w.watchFile("views/index.zpug");
+///
+/// var changed = std.ArrayList([]const u8){};
+/// try w.waitForChanges(&changed); // blocks until something changes
+/// ```
+pub const Watcher = struct {
+    allocator: std.mem.Allocator,
+    fd: i32,
+    dirs: std.AutoHashMap(i32, []const u8), // watch descriptor → directory
+
+    const Self = @This();
+
+    const watch_mask: u32 = linux.IN.CLOSE_WRITE | linux.IN.MOVED_TO |
+        linux.IN.CREATE | linux.IN.DELETE;
+
+    pub fn init(allocator: std.mem.Allocator) !Self {
+        const fd = try std.posix.inotify_init1(linux.IN.CLOEXEC);
+        return .{
+            .allocator = allocator,
+            .fd = fd,
+            .dirs = std.AutoHashMap(i32, []const u8).init(allocator),
+        };
+    }
+
+    pub fn deinit(self: *Self) void {
+        var it = self.dirs.valueIterator();
+        while (it.next()) |dir| {
+            self.allocator.free(dir.*);
+        }
+        self.dirs.deinit();
+        std.posix.close(self.fd);
+    }
+
+    /// Start watching the directory containing a file
+    ///
+    /// Watching the same directory twice is a no-op (inotify returns the
+    /// existing watch descriptor).
+    pub fn watchFile(self: *Self, path: []const u8) !void {
+        const dir = try std.fs.path.resolve(self.allocator, &.{std.fs.path.dirname(path) orelse "."});
+        errdefer self.allocator.free(dir);
+
+        const wd = try std.posix.inotify_add_watch(self.fd, dir, watch_mask);
+
+        const result = try self.dirs.getOrPut(wd);
+        if (result.found_existing) {
+            self.allocator.free(dir);
+        } else {
+            result.value_ptr.* = dir;
+        }
+    }
+
+    /// Block until files change, then collect their normalized paths
+    ///
+    /// Paths are appended to `changed` without duplicates and are
+    /// allocated with the watcher's allocator (caller frees them).
+    pub fn waitForChanges(self: *Self, changed: *std.ArrayList([]const u8)) !void {
+        try self.readEvents(changed);
+
+        while (true) {
+            var fds = [_]std.posix.pollfd{.{
+                .fd = self.fd,
+                .events = std.posix.POLL.IN,
+                .revents = 0,
+            }};
+            if (try std.posix.poll(&fds, debounce_ms) == 0) break;
+            try self.readEvents(changed);
+        }
+    }
+
+    fn readEvents(self: *Self, changed: *std.ArrayList([]const u8)) !void {
+        var buf: [4096]u8 align(@alignOf(linux.inotify_event)) = undefined;
+        const len = try std.posix.read(self.fd, &buf);
+
+        var offset: usize = 0;
+        while (offset < len) {
+            const event: *const linux.inotify_event = @ptrCast(@alignCast(&buf[offset]));
+            const name_start = offset + @sizeOf(linux.inotify_event);
+            offset = name_start + event.len;
+
+            if (event.len == 0) continue;
+            const dir = self.dirs.get(event.wd) orelse continue;
+            const name = std.mem.sliceTo(buf[name_start .. name_start + event.len], 0);
+
+            const path = try std.fs.path.resolve(self.allocator, &.{ dir, name });
+
+            var seen = false;
+            for (changed.items) |existing| {
+                if (std.mem.eql(u8, existing, path)) {
+                    seen = true;
+                    break;
+                }
+            }
+            if (seen) {
+                self.allocator.free(path);
+                continue;
+            }
+
+            errdefer self.allocator.free(path);
+            try changed.append(self.allocator, path);
+        }
+    }
+};
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+test "watcher - dependency graph follows includes and extends" {
+    const allocator = std.testing.allocator;
+
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    try tmp.dir.makePath("partials");
+    try tmp.dir.writeFile(.{ .sub_path = "layout.zpug", .data = "html\n  block content\n" });
+    try tmp.dir.writeFile(.{ .sub_path = "partials/nav.zpug", .data = "nav Menu\n" });
+    try tmp.dir.writeFile(.{ .sub_path = "page.zpug", .data = "extends layout.zpug\nblock content\n  include partials/nav.zpug\n" });
+    try tmp.dir.writeFile(.{ .sub_path = "other.zpug", .data = "p Other\n" });
+
+    const dir_path = try tmp.dir.realpathAlloc(allocator, ".");
+    defer allocator.free(dir_path);
+    const page = try std.fs.path.join(allocator, &.{ dir_path, "page.zpug" });
+    defer allocator.free(page);
+    const nav = try std.fs.path.join(allocator, &.{ dir_path, "partials", "nav.zpug" });
+    defer allocator.free(nav);
+    const other = try std.fs.path.join(allocator, &.{ dir_path, "other.zpug" });
+    defer allocator.free(other);
+
+    var ast_cache = cache.AstCache.init(allocator);
+    defer ast_cache.deinit();
+
+    var graph = DependencyGraph.init(allocator);
+    defer graph.deinit();
+
+    try graph.scan(page, &ast_cache);
+    try std.testing.expectEqual(@as(usize, 2), graph.dependencies(page).len);
+    try std.testing.expect(graph.dependsOn(page, page));
+    try std.testing.expect(graph.dependsOn(page, nav));
+    try std.testing.expect(!graph.dependsOn(page, other));
+
+    // Rescanning replaces the previous dependency set
+    try graph.scan(page, &ast_cache);
+    try std.testing.expectEqual(@as(usize, 2), graph.dependencies(page).len);
+}